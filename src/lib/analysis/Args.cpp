@@ -101,6 +101,10 @@ Args::Ctor()
 
   doNormalizeTy = true;
 
+  jobs = 1;
+
+  profileCache = false;
+
   prof_metrics = Analysis::Args::MetricFlg_NULL;
 
   profflat_computeFinalMetricValues = true;
@@ -116,6 +120,7 @@ Args::Ctor()
   out_db_config     = "";
   db_makeMetricDB   = true;
   db_addStructId    = false;
+  db_incremental    = false;
 
   out_txt           = Analysis_OUT_TXT;
   txt_summary       = TxtSum_NULL;
@@ -202,6 +207,12 @@ Args::normalizeSearchPaths()
 void
 Args::makeDatabaseDir()
 {
+  // an incremental update reuses an existing database
+  if (db_incremental && FileUtil::isDir(db_dir.c_str())) {
+    db_dir = RealPath(db_dir.c_str());
+    return;
+  }
+
   // prepare output directory (N.B.: chooses a unique name!)
   string dir = db_dir; // make copy
   std::pair<string, bool> ret =
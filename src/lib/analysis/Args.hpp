@@ -126,6 +126,11 @@ public:
 
   // Structure files
   std::vector<std::string> structureFiles;
+  std::string structureCacheDir; // hpcstruct cache; disable: ""
+
+  // Threads for reading load modules that have no structure and for
+  // copying source files
+  uint jobs;
 
   // Group files
   std::vector<std::string> groupFiles;
@@ -137,6 +142,10 @@ public:
   // Profile files
   std::vector<std::string> profileFiles;
 
+  // Reuse the merged profiles cached in their measurement directory
+  // (hpcprof)
+  bool profileCache;
+
   bool doNormalizeTy;
 
   // -------------------------------------------------------
@@ -187,6 +196,7 @@ public:
 
 #define Analysis_OUT_DB_EXPERIMENT "experiment.xml"
 #define Analysis_OUT_DB_CSV        "experiment.csv"
+#define Analysis_OUT_DB_CCTDB      "experiment.cctdb" // cf. CCT-BinaryDB.hpp
 
 #define Analysis_DB_DIR_pfx        "hpctoolkit"
 #define Analysis_DB_DIR_nm         "database"
@@ -204,6 +214,10 @@ public:
   bool db_makeMetricDB;
   bool db_addStructId;
 
+  // update 'db_dir' in place, keeping the state needed to add more
+  // profiles to it later (hpcprof-mpi)
+  bool db_incremental;
+
   // -------------------------------------------------------
   // Output arguments: textual output
   // -------------------------------------------------------
@@ -248,7 +262,8 @@ public:
   void
   normalizeSearchPaths();
 
-  // makes a unique database dir
+  // makes a unique database dir (or, with db_incremental, reuses an
+  // existing one)
   void
   makeDatabaseDir();
 
@@ -75,6 +75,7 @@ using std::string;
 #include "CallPath.hpp" /* for normalizeFilePath */
 
 #include <lib/analysis/Util.hpp>
+#include <lib/analysis/StructCache.hpp>
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/Trace.hpp>
@@ -127,12 +128,26 @@ Options: Source Code and Static Structure:\n\
   -S <file>, --structure <file>\n\
                        Use hpcstruct structure file <file> for correlation.\n\
                        May pass multiple times (e.g., for shared libraries).\n\
+  --structure-cache <dir>\n\
+                       For load modules without a -S structure file, use a\n\
+                       structure file from the hpcstruct cache <dir> that\n\
+                       matches the module's build-id and was made with\n\
+                       hpcstruct's default options (see hpcstruct --cache).\n\
+                       Default: $HPCTOOLKIT_HPCSTRUCT_CACHE, if set.\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads to read load modules that have no\n\
+                       structure and to copy source files. {1}\n\
   -R '<old-path>=<new-path>', --replace-path '<old-path>=<new-path>'\n\
                        Substitute instances of <old-path> with <new-path>;\n\
                        apply to all paths (profile's load map, source code)\n\
                        for which <old-path> is a prefix.  Use '\\' to escape\n\
                        instances of '=' within a path. May pass multiple\n\
                        times.\n\
+  --profile-cache      (hpcprof) Save the merged profiles (before static\n\
+                       structure is added) in the measurement directory's\n\
+                       'hpcprof-cache' and reuse them on later runs while\n\
+                       the profiles, hpcprof and the metric options are\n\
+                       unchanged.\n\
 \n\
 Options: Metrics:\n\
   -M <metric>, --metric <metric>\n\
@@ -155,6 +170,11 @@ Options: Output:\n\
   --metric-db <yes|no>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {yes}\n\
+  --incremental        (hpcprof-mpi) Update the database <db-path> in place\n\
+                       with the profiles that it does not yet contain. If\n\
+                       <db-path> does not exist, create it and save the\n\
+                       state needed for later updates. The metric,\n\
+                       structure and -R options may not change.\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -185,6 +205,12 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 'S', "structure",       CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL },
+  {  0 , "structure-cache", CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "profile-cache",   CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
   { 'R', "replace-path",    CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL},
 
@@ -204,6 +230,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "metric-db",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "incremental",     CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "struct-id",       CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
 
@@ -237,6 +265,8 @@ ArgsHPCProf::ArgsHPCProf()
   // Analysis::Args
   prof_metrics = Analysis::Args::MetricFlg_StatsSum;
 
+  structureCacheDir = StructCache::defaultDir();
+
   db_makeMetricDB = true;
   remove_redundancy = false;
 }
@@ -356,6 +386,18 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       string str = parser.getOptArg("structure");
       StrUtil::tokenize_str(str, CLP_SEPARATOR, structureFiles);
     }
+    if (parser.isOpt("structure-cache")) {
+      structureCacheDir = parser.getOptArg("structure-cache");
+    }
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) { ARG_ERROR("--jobs must be at least 1"); }
+      jobs = (uint)n;
+    }
+    if (parser.isOpt("profile-cache")) {
+      profileCache = true;
+    }
     if (parser.isOpt("normalize")) { 
       const string& arg = parser.getOptArg("normalize");
       doNormalizeTy = parseArg_norm(arg, "--normalize/-N option");
@@ -409,6 +451,9 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       const string& arg = parser.getOptArg("metric-db");
       db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
     }
+    if (parser.isOpt("incremental")) {
+      db_incremental = true;
+    }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
     }
@@ -0,0 +1,568 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+
+#include "CallPath-Incremental.hpp"
+
+#include <lib/prof/CCT-Tree.hpp>
+#include <lib/prof/Struct-Tree.hpp>
+
+#include <lib/prof-lean/build-id.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+#include <lib/support/StrUtil.hpp>
+
+//*************************** Forward Declarations ***************************
+
+static const char ManifestMagic[] = "HPCPROF-incr____"; // 16 bytes
+static const char SummaryMagic[]  = "HPCPROF-incrsum_"; // 16 bytes
+static const char StateVersion[]  = "01.00";            // 5 bytes
+
+static const char ManifestFnm[] = "experiment.incr";
+static const char CCTFnm[]      = "experiment.incr-cct";
+static const char SummaryFnm[]  = "experiment.incr-summary";
+
+static string
+stateFnm(const string& dbDir, const char* fnm, bool isTmp = false)
+{
+  string x = dbDir + "/" + fnm;
+  if (isTmp) {
+    x += ".tmp";
+  }
+  return x;
+}
+
+static void
+writeHdr(FILE* fs, const char* magic);
+
+static bool
+readHdr(FILE* fs, const char* magic);
+
+static string
+readStr(FILE* fs);
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace CallPath {
+
+IncrState::IncrState()
+  : isStable(true), summaryNumMetrics(0)
+{
+}
+
+
+IncrState::~IncrState()
+{
+}
+
+
+string
+IncrState::makeConfig(const Analysis::Args& args, uint groupMax)
+{
+  string x = string("version=") + HPCTOOLKIT_VERSION_STRING
+    + "\nmetrics=" + StrUtil::toStr(args.prof_metrics)
+    + "\nnormalize=" + StrUtil::toStr(args.doNormalizeTy)
+    + "\nmetric-db=" + StrUtil::toStr(args.db_makeMetricDB)
+    + "\nagent=" + args.agent
+    + "\ngroups=" + StrUtil::toStr(groupMax)
+    + "\nstructure-cache=" + args.structureCacheDir;
+  for (uint i = 0; i < args.structureFiles.size(); ++i) {
+    x += "\nstructure=" + args.structureFiles[i];
+  }
+  for (uint i = 0; i < args.replaceInPath.size(); ++i) {
+    x += "\nreplace=" + args.replaceInPath[i] + "=" + args.replaceOutPath[i];
+  }
+  return x;
+}
+
+
+IncrState::File
+IncrState::makeFile(const string& path, uint groupId)
+{
+  File x;
+  x.path = path;
+  x.groupId = groupId;
+
+  struct stat sbuf;
+  if (stat(path.c_str(), &sbuf) == 0) {
+    x.size = sbuf.st_size;
+    x.mtime = sbuf.st_mtime;
+  }
+  return x;
+}
+
+
+const IncrState::File*
+IncrState::findFile(const string& path) const
+{
+  std::map<string, uint>::const_iterator it = m_fileIdx.find(path);
+  return (it != m_fileIdx.end()) ? &files[it->second] : NULL;
+}
+
+
+void
+IncrState::addFile(const File& file)
+{
+  m_fileIdx[file.path] = files.size();
+  files.push_back(file);
+}
+
+
+// The manifest, in hpcfmt's big-endian encoding:
+//   magic (16 bytes), version (5 bytes)
+//   config (str)
+//   num-files (int4), then per file: path (str), group (int4), size,
+//     mtime (int8 each)
+//   directories (StringSet)
+//   num-keys (int4), then the keys (int8 each)
+bool
+IncrState::read(const string& dbDir)
+{
+  string fnm = stateFnm(dbDir, ManifestFnm);
+  if (!FileUtil::isReadable(fnm)) {
+    return false;
+  }
+
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  if (!readHdr(fs, ManifestMagic)) {
+    hpcio_fclose(fs);
+    DIAG_Throw("'" << fnm << "' is not from this version of hpcprof; rebuild the database");
+  }
+
+  config = readStr(fs);
+
+  uint32_t numFiles = 0;
+  hpcfmt_int4_fread(&numFiles, fs);
+  files.clear();
+  m_fileIdx.clear();
+  for (uint i = 0; i < numFiles && !feof(fs); ++i) {
+    File file;
+    uint32_t groupId = 0;
+    file.path = readStr(fs);
+    hpcfmt_int4_fread(&groupId, fs);
+    hpcfmt_int8_fread(&file.size, fs);
+    hpcfmt_int8_fread(&file.mtime, fs);
+    file.groupId = groupId;
+    addFile(file);
+  }
+
+  StringSet* dirs = NULL;
+  StringSet::fmt_fread(dirs, fs);
+  directories.clear();
+  directories += *dirs;
+  delete dirs;
+
+  uint32_t numKeys = 0;
+  hpcfmt_int4_fread(&numKeys, fs);
+  nodeKeys.assign(numKeys, 0);
+  for (uint i = 0; i < numKeys; ++i) {
+    hpcfmt_int8_fread(&nodeKeys[i], fs);
+  }
+
+  bool isBad = ferror(fs) || feof(fs) || files.size() != numFiles;
+  hpcio_fclose(fs);
+  if (isBad) {
+    DIAG_Throw("error reading '" << fnm << "'");
+  }
+  return true;
+}
+
+
+void
+IncrState::write(const string& dbDir) const
+{
+  const char* state[] = { CCTFnm, SummaryFnm };
+  for (uint i = 0; i < sizeof(state) / sizeof(state[0]); ++i) {
+    string tmp = stateFnm(dbDir, state[i], true);
+    if (FileUtil::isReadable(tmp)
+	&& rename(tmp.c_str(), stateFnm(dbDir, state[i]).c_str()) != 0) {
+      DIAG_Throw("error renaming '" << tmp << "'");
+    }
+  }
+
+  string fnm = stateFnm(dbDir, ManifestFnm);
+  string tmp = stateFnm(dbDir, ManifestFnm, true);
+  FILE* fs = hpcio_fopen_w(tmp.c_str(), 1);
+  if (!fs) {
+    DIAG_Throw("error opening '" << tmp << "'");
+  }
+
+  writeHdr(fs, ManifestMagic);
+  hpcfmt_str_fwrite(config.c_str(), fs);
+
+  hpcfmt_int4_fwrite(files.size(), fs);
+  for (uint i = 0; i < files.size(); ++i) {
+    const File& file = files[i];
+    hpcfmt_str_fwrite(file.path.c_str(), fs);
+    hpcfmt_int4_fwrite(file.groupId, fs);
+    hpcfmt_int8_fwrite(file.size, fs);
+    hpcfmt_int8_fwrite(file.mtime, fs);
+  }
+
+  StringSet::fmt_fwrite(directories, fs);
+
+  hpcfmt_int4_fwrite(nodeKeys.size(), fs);
+  for (uint i = 0; i < nodeKeys.size(); ++i) {
+    hpcfmt_int8_fwrite(nodeKeys[i], fs);
+  }
+
+  if (ferror(fs) | hpcio_fclose(fs)) {
+    DIAG_Throw("error writing '" << tmp << "'");
+  }
+  if (rename(tmp.c_str(), fnm.c_str()) != 0) {
+    DIAG_Throw("error renaming '" << tmp << "'");
+  }
+}
+
+
+void
+IncrState::remove(const string& dbDir)
+{
+  string fnm = stateFnm(dbDir, ManifestFnm);
+  if (FileUtil::isReadable(fnm) && unlink(fnm.c_str()) != 0) {
+    DIAG_Throw("error removing '" << fnm << "'");
+  }
+}
+
+
+// The CCT is written without a file name, so that reading it back
+// does not invent a trace file for it (cf. ParallelAnalysis).
+void
+IncrState::writeProfile(const Prof::CallPath::Profile& prof,
+			const string& dbDir)
+{
+  string fnm = stateFnm(dbDir, CCTFnm, true);
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1);
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  Prof::CallPath::Profile::fmt_fwrite(prof, fs,
+				      Prof::CallPath::Profile::WFlg_VirtualMetrics);
+  if (ferror(fs) | hpcio_fclose(fs)) {
+    DIAG_Throw("error writing '" << fnm << "'");
+  }
+}
+
+
+Prof::CallPath::Profile*
+IncrState::readProfile(const string& dbDir)
+{
+  string fnm = stateFnm(dbDir, CCTFnm);
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+
+  Prof::CallPath::Profile* prof = NULL;
+  try {
+    Prof::CallPath::Profile::fmt_fread(prof, fs,
+				       Prof::CallPath::Profile::RFlg_VirtualMetrics,
+				       fnm, NULL, NULL);
+  }
+  catch (...) {
+    hpcio_fclose(fs);
+    throw;
+  }
+  hpcio_fclose(fs);
+  return prof;
+}
+
+
+// The summary, in hpcfmt's big-endian encoding:
+//   magic (16 bytes), version (5 bytes)
+//   num-metrics (int4), num-rows (int4), then per row: key (int8),
+//     then num-metrics values (real8 each)
+void
+IncrState::writeSummary(const string& dbDir) const
+{
+  string fnm = stateFnm(dbDir, SummaryFnm, true);
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1);
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+
+  writeHdr(fs, SummaryMagic);
+  hpcfmt_int4_fwrite(summaryNumMetrics, fs);
+  hpcfmt_int4_fwrite(summaryKeys.size(), fs);
+  for (uint i = 0; i < summaryKeys.size(); ++i) {
+    hpcfmt_int8_fwrite(summaryKeys[i], fs);
+    for (uint j = 0; j < summaryNumMetrics; ++j) {
+      hpcfmt_real8_fwrite(summaryValues[i * summaryNumMetrics + j], fs);
+    }
+  }
+
+  if (ferror(fs) | hpcio_fclose(fs)) {
+    DIAG_Throw("error writing '" << fnm << "'");
+  }
+}
+
+
+void
+IncrState::readSummary(const string& dbDir)
+{
+  string fnm = stateFnm(dbDir, SummaryFnm);
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  if (!readHdr(fs, SummaryMagic)) {
+    hpcio_fclose(fs);
+    DIAG_Throw("'" << fnm << "' is not from this version of hpcprof; rebuild the database");
+  }
+
+  uint32_t numMetrics = 0, numRows = 0;
+  hpcfmt_int4_fread(&numMetrics, fs);
+  hpcfmt_int4_fread(&numRows, fs);
+
+  summaryNumMetrics = numMetrics;
+  summaryKeys.assign(numRows, 0);
+  summaryValues.assign((size_t)numRows * numMetrics, 0.0);
+  for (uint i = 0; i < numRows && !feof(fs); ++i) {
+    hpcfmt_int8_fread(&summaryKeys[i], fs);
+    for (uint j = 0; j < numMetrics; ++j) {
+      hpcfmt_real8_fread(&summaryValues[i * numMetrics + j], fs);
+    }
+  }
+
+  bool isBad = ferror(fs) || feof(fs);
+  hpcio_fclose(fs);
+  if (isBad) {
+    DIAG_Throw("error reading '" << fnm << "'");
+  }
+}
+
+
+void
+IncrState::clearSummary()
+{
+  summaryNumMetrics = 0;
+  std::vector<uint64_t>().swap(summaryKeys);
+  std::vector<double>().swap(summaryValues);
+}
+
+
+//****************************************************************************
+
+static uint64_t
+hashStr(uint64_t h, const string& x)
+{
+  // include the terminator so that adjacent strings cannot run together
+  return build_id_hash_bytes(h, x.c_str(), x.size() + 1);
+}
+
+
+static uint64_t
+hashInt(uint64_t h, uint64_t x)
+{
+  return build_id_hash_bytes(h, &x, sizeof(x));
+}
+
+
+// nodeSig: the part of a node's key that is the node's own
+static uint64_t
+nodeSig(const Prof::CallPath::Profile& prof, const Prof::CCT::ANode* n,
+	bool doNormalizeTy)
+{
+  using namespace Prof;
+
+  uint64_t h = hashInt(BUILD_ID_HASH_INIT, n->type());
+
+  const Struct::ACodeNode* strct = n->structure();
+  if (strct) {
+    h = hashStr(h, strct->name());
+    h = hashInt(h, strct->begLine());
+    const Struct::File* file = strct->ancestorFile();
+    if (file) {
+      h = hashStr(h, file->name());
+    }
+  }
+
+  const CCT::ADynNode* dyn = dynamic_cast<const CCT::ADynNode*>(n);
+  if (dyn && !(doNormalizeTy && n->type() == CCT::ANode::TyStmt)) {
+    LoadMap::LMId_t lmId = dyn->lmId();
+    if (lmId != LoadMap::LMId_NULL) {
+      h = hashStr(h, prof.loadmap()->lm(lmId)->name());
+    }
+    h = hashInt(h, dyn->lmIP());
+  }
+  return h;
+}
+
+
+static bool
+cmpById(const Prof::CCT::ANode* x, const Prof::CCT::ANode* y)
+{
+  return x->id() < y->id();
+}
+
+
+// Siblings with the same signature (e.g., two calls on one line that
+// were not coalesced) are told apart by their order (by id), which is
+// not stable across runs; 'isStable' is cleared if there are any.
+static void
+makeNodeKeys(const Prof::CallPath::Profile& prof, bool doNormalizeTy,
+	     const Prof::CCT::ANode* n, uint64_t key,
+	     std::vector<uint64_t>& keys, bool& isStable)
+{
+  using namespace Prof;
+
+  keys[n->id()] = key;
+
+  std::vector<const CCT::ANode*> kids;
+  for (CCT::ANodeChildIterator it(n); it.Current(); ++it) {
+    kids.push_back(it.current());
+  }
+  std::sort(kids.begin(), kids.end(), cmpById);
+
+  std::map<uint64_t, uint64_t> sigCount;
+  for (uint i = 0; i < kids.size(); ++i) {
+    uint64_t sig = nodeSig(prof, kids[i], doNormalizeTy);
+    uint64_t ordinal = sigCount[sig]++;
+    if (ordinal > 0) {
+      isStable = false;
+    }
+    uint64_t kidKey = hashInt(hashInt(hashInt(BUILD_ID_HASH_INIT, key), sig),
+			      ordinal);
+    makeNodeKeys(prof, doNormalizeTy, kids[i], kidKey, keys, isStable);
+  }
+}
+
+
+bool
+makeNodeKeys(const Prof::CallPath::Profile& prof, bool doNormalizeTy,
+	     std::vector<uint64_t>& keys)
+{
+  const Prof::CCT::Tree& cct = *prof.cct();
+  const Prof::CCT::ANode* root = cct.root();
+
+  bool isStable = true;
+  keys.assign(cct.maxDenseId() + 1, 0);
+  if (root) {
+    makeNodeKeys(prof, doNormalizeTy, root,
+		 nodeSig(prof, root, doNormalizeTy), keys, isStable);
+  }
+  return isStable;
+}
+
+} // namespace CallPath
+
+} // namespace Analysis
+
+
+//****************************************************************************
+
+static void
+writeHdr(FILE* fs, const char* magic)
+{
+  fwrite(magic, 1, strlen(magic), fs);
+  fwrite(StateVersion, 1, sizeof(StateVersion) - 1, fs);
+}
+
+
+static bool
+readHdr(FILE* fs, const char* magic)
+{
+  char buf[64];
+  size_t len = strlen(magic) + sizeof(StateVersion) - 1;
+  return (fread(buf, 1, len, fs) == len
+	  && memcmp(buf, magic, strlen(magic)) == 0
+	  && memcmp(buf + strlen(magic), StateVersion,
+		    sizeof(StateVersion) - 1) == 0);
+}
+
+
+static string
+readStr(FILE* fs)
+{
+  char* str = NULL;
+  string x;
+  if (hpcfmt_str_fread(&str, fs, malloc) == HPCFMT_OK) {
+    x = str;
+    free(str);
+  }
+  return x;
+}
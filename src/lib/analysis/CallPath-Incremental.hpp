@@ -0,0 +1,227 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   The state that hpcprof-mpi --incremental keeps in a database so
+//   that profiles can later be added to it without reprocessing the
+//   ones it already contains.
+//
+// Description:
+//   The state is three files in the database directory:
+//
+//     experiment.incr          manifest: options, merged profiles (with
+//                              their sizes and mtimes), measurement
+//                              directories, and the key of each node
+//                              of the database's CCT (by dense id)
+//     experiment.incr-cct      the unified CCT before static structure
+//                              was added (hpcrun format, no metrics)
+//     experiment.incr-summary  the summary metric accumulators of each
+//                              node of the structured, unpruned CCT
+//
+//   CCT nodes are matched between runs by a key: a hash of the path
+//   from the root, where each node contributes its type, structure
+//   (name, file, line) and, for call sites, load module and IP.  Keys
+//   do not depend on node ids, which change when nodes are added.
+//   Siblings that contribute the same are told apart only by their
+//   position, which an update may shift, so a database whose CCT has
+//   any is not made updatable.
+//
+//   An update removes the manifest before changing the database and
+//   writes it back last, so an interrupted update leaves a database
+//   that can no longer be updated (and says so) rather than one with
+//   inconsistent state.
+//
+//***************************************************************************
+
+#ifndef Analysis_CallPath_Incremental_hpp
+#define Analysis_CallPath_Incremental_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Args.hpp"
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/StringSet.hpp>
+
+//*************************** Forward Declarations ***************************
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace CallPath {
+
+class IncrState {
+public:
+  // A profile merged into the database, as it was when it was merged.
+  struct File {
+    File()
+      : groupId(0), size(0), mtime(0)
+    { }
+
+    std::string path;
+    uint groupId;
+    uint64_t size;
+    uint64_t mtime;
+  };
+
+public:
+  IncrState();
+  ~IncrState();
+
+  // makeConfig: describes the options that determine the CCT and the
+  // layout of its summary metrics; they may not change across updates.
+  static std::string
+  makeConfig(const Analysis::Args& args, uint groupMax);
+
+  // makeFile: returns the File for 'path' as it is now.
+  static File
+  makeFile(const std::string& path, uint groupId);
+
+  // findFile: returns the merged profile 'path', or NULL
+  const File*
+  findFile(const std::string& path) const;
+
+  void
+  addFile(const File& file);
+
+  // -------------------------------------------------------
+  // manifest
+  // -------------------------------------------------------
+
+  // read: reads the manifest of 'dbDir'.  Returns false if there is
+  // none; throws if it is unreadable or was written by another
+  // version of hpcprof.
+  bool
+  read(const std::string& dbDir);
+
+  // write: publishes the CCT and summary written by writeProfile()
+  // and writeSummary(), then writes the manifest.
+  void
+  write(const std::string& dbDir) const;
+
+  // remove: removes the manifest of 'dbDir', if any.
+  static void
+  remove(const std::string& dbDir);
+
+  // -------------------------------------------------------
+  // unified CCT (before structure)
+  // -------------------------------------------------------
+
+  static void
+  writeProfile(const Prof::CallPath::Profile& prof, const std::string& dbDir);
+
+  static Prof::CallPath::Profile*
+  readProfile(const std::string& dbDir);
+
+  // -------------------------------------------------------
+  // summary metric accumulators
+  // -------------------------------------------------------
+
+  void
+  writeSummary(const std::string& dbDir) const;
+
+  void
+  readSummary(const std::string& dbDir);
+
+  void
+  clearSummary();
+
+public:
+  std::string config;
+  std::vector<File> files;
+  StringSet directories;
+
+  // false if makeNodeKeys() found keys that may not match those of a
+  // later run; the state is then not written
+  bool isStable;
+
+  // key of each node of the database's (final) CCT; index 0 unused
+  std::vector<uint64_t> nodeKeys;
+
+  // summary accumulators: row i holds 'summaryNumMetrics' values for
+  // the node with key summaryKeys[i]
+  uint summaryNumMetrics;
+  std::vector<uint64_t> summaryKeys;
+  std::vector<double> summaryValues;
+
+private:
+  std::map<std::string, uint> m_fileIdx;
+};
+
+
+// makeNodeKeys: computes the key of each node of 'prof''s CCT, which
+// must have dense ids, indexed by id.  'doNormalizeTy' is the value
+// passed to overlayStaticStructureMain(): coalesced statements are
+// matched by line rather than by IP.  Returns false if some siblings
+// could only be told apart by their position, i.e., if the keys may
+// not match those of another run.
+bool
+makeNodeKeys(const Prof::CallPath::Profile& prof, bool doNormalizeTy,
+	     std::vector<uint64_t>& keys);
+
+} // namespace CallPath
+
+} // namespace Analysis
+
+//****************************************************************************
+
+#endif // Analysis_CallPath_Incremental_hpp
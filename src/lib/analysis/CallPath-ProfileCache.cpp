@@ -0,0 +1,614 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+
+#include "CallPath-ProfileCache.hpp"
+#include "CallPath.hpp"
+#include "CallPath-Incremental.hpp"
+
+#include <lib/prof/Metric-Mgr.hpp>
+#include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/StringSet.hpp>
+
+#include <lib/prof-lean/build-id.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+#include <lib/support/StrUtil.hpp>
+
+//*************************** Forward Declarations ***************************
+
+static const char CacheMagic[]   = "HPCPROF-cache___"; // 16 bytes
+static const char CacheVersion[] = "02.00";            // 5 bytes
+
+static const char CacheDirNm[]   = "hpcprof-cache";
+static const char ProfileFnm[]   = "profile";
+
+// suffix of an entry that is still being written
+static const char TmpSfx[]       = ".tmp";
+static const size_t TmpSfxLen    = sizeof(TmpSfx) - 1;
+
+static uint64_t
+hashStr(uint64_t h, const string& x)
+{
+  // include the terminator so that adjacent strings cannot run together
+  return build_id_hash_bytes(h, x.c_str(), x.size() + 1);
+}
+
+
+static uint64_t
+hashInt(uint64_t h, uint64_t x)
+{
+  return build_id_hash_bytes(h, &x, sizeof(x));
+}
+
+
+static string
+hashToStr(uint64_t x)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)x);
+  return buf;
+}
+
+
+static bool
+readEntry(Prof::CallPath::Profile*& prof, const string& entryDir);
+
+static void
+writeEntry(Prof::CallPath::Profile& prof, const string& entryDir);
+
+static void
+removeEntry(const string& entryDir);
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace CallPath {
+
+Prof::CallPath::Profile*
+readCached(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	   int mergeTy, uint rFlags, uint mrgFlags)
+{
+  // -------------------------------------------------------
+  // 0. The cache belongs to one measurement directory
+  // -------------------------------------------------------
+  string measDir = (profileFiles.empty()) ? "" :
+    FileUtil::dirname(profileFiles[0]);
+  for (uint i = 1; i < profileFiles.size(); ++i) {
+    if (FileUtil::dirname(profileFiles[i]) != measDir) {
+      measDir = "";
+      break;
+    }
+  }
+  if (measDir.empty()) {
+    DIAG_WMsgIf(!profileFiles.empty(),
+		"--profile-cache: profiles are not from one measurement directory; not caching");
+    return read(profileFiles, groupMap, mergeTy, rFlags, mrgFlags);
+  }
+
+  // -------------------------------------------------------
+  // 1. Find the entry for these profiles and options
+  // -------------------------------------------------------
+  uint64_t filesHash = BUILD_ID_HASH_INIT;
+  for (uint i = 0; i < profileFiles.size(); ++i) {
+    uint groupId = (groupMap) ? (*groupMap)[i] : 0;
+    IncrState::File file = IncrState::makeFile(profileFiles[i], groupId);
+    filesHash = hashStr(filesHash, file.path);
+    filesHash = hashInt(filesHash, file.groupId);
+    filesHash = hashInt(filesHash, file.size);
+    filesHash = hashInt(filesHash, file.mtime);
+  }
+
+  // the word size (hashed as bytes) also distinguishes byte orders
+  uint64_t optsHash = hashStr(BUILD_ID_HASH_INIT, HPCTOOLKIT_VERSION_STRING);
+  optsHash = hashInt(optsHash, sizeof(void*));
+  optsHash = hashInt(optsHash, mergeTy);
+  optsHash = hashInt(optsHash, rFlags);
+  optsHash = hashInt(optsHash, mrgFlags);
+
+  string cacheDir = measDir + "/" + CacheDirNm;
+  string filesKey = hashToStr(filesHash);
+  string entryNm = filesKey + "-" + hashToStr(optsHash);
+  string entryDir = cacheDir + "/" + entryNm;
+
+  Prof::CallPath::Profile* prof = NULL;
+  try {
+    if (readEntry(prof, entryDir)) {
+      DIAG_Msg(1, "Using cached profile '" << entryDir << "'");
+      return prof;
+    }
+  }
+  catch (const Diagnostics::Exception& x) {
+    DIAG_WMsg(1, "--profile-cache: ignoring '" << entryDir << "': "
+	      << x.message());
+    delete prof;
+  }
+
+  // -------------------------------------------------------
+  // 2. Miss: read the profiles and write a new entry
+  // -------------------------------------------------------
+  prof = read(profileFiles, groupMap, mergeTy, rFlags, mrgFlags);
+
+  string tmpDir = entryDir + "." + StrUtil::toStr((int)getpid()) + TmpSfx;
+  try {
+    FileUtil::mkdir(cacheDir);
+    removeEntry(tmpDir);
+    FileUtil::mkdir(tmpDir);
+    writeEntry(*prof, tmpDir);
+
+    // another hpcprof may have been first
+    removeEntry(entryDir);
+    if (rename(tmpDir.c_str(), entryDir.c_str()) != 0) {
+      DIAG_Throw("error renaming '" << tmpDir << "'");
+    }
+  }
+  catch (const Diagnostics::Exception& x) {
+    DIAG_WMsg(1, "--profile-cache: unable to write '" << entryDir << "': "
+	      << x.message());
+    removeEntry(tmpDir);
+    return prof;
+  }
+
+  // Entries for other sets of profiles are stale, but only if they are
+  // older than this one: a newer one was just written by a concurrent
+  // hpcprof (which may still be using it).  Skip the '.tmp' entries
+  // that other runs are still writing.
+  struct stat entrySbuf;
+  DIR* dir = (stat(entryDir.c_str(), &entrySbuf) == 0) ?
+    opendir(cacheDir.c_str()) : NULL;
+  if (dir) {
+    std::vector<string> stale;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+      string nm = ent->d_name;
+      if (nm == "." || nm == ".."
+	  || nm.compare(0, filesKey.size(), filesKey) == 0
+	  || (nm.size() > TmpSfxLen
+	      && nm.compare(nm.size() - TmpSfxLen, TmpSfxLen, TmpSfx) == 0)) {
+	continue;
+      }
+      string path = cacheDir + "/" + nm;
+      struct stat sbuf;
+      if (stat(path.c_str(), &sbuf) == 0
+	  && sbuf.st_mtime < entrySbuf.st_mtime) {
+	stale.push_back(path);
+      }
+    }
+    closedir(dir);
+    for (uint i = 0; i < stale.size(); ++i) {
+      DIAG_Msg(2, "--profile-cache: removing stale '" << stale[i] << "'");
+      removeEntry(stale[i]);
+    }
+  }
+
+  return prof;
+}
+
+} // namespace CallPath
+
+} // namespace Analysis
+
+
+//****************************************************************************
+
+static void
+writeStr(const string& x, FILE* fs)
+{
+  hpcfmt_str_fwrite(x.c_str(), fs);
+}
+
+
+static string
+readStr(FILE* fs)
+{
+  char* str = NULL;
+  string x;
+  if (hpcfmt_str_fread(&str, fs, malloc) == HPCFMT_OK) {
+    x = str;
+    free(str);
+  }
+  return x;
+}
+
+
+// An entry's profile file, in hpcfmt's big-endian encoding:
+//   magic (16 bytes), version (5 bytes)
+//   profile name (str)
+//   measurement directories (StringSet)
+//   trace file names, relative to the entry (StringSet)
+//   epoch flags (int8)
+//   num-metrics (int4), then the full descriptor of each metric
+//     (cf. writeMetricDesc())
+//   the profile (hpcrun format, sparse metrics)
+//
+// hpcrun format keeps only the metric names, types and values, so the
+// descriptors read with the profile are overwritten by the saved ones.
+// Likewise, the profile's epoch flags are restored, since the entry is
+// written with sparse metrics.
+
+static void
+writeMetricDesc(const Prof::Metric::SampledDesc& m, FILE* fs)
+{
+  using namespace Prof;
+
+  const Metric::ADesc* partner = m.partner();
+
+  // ADesc
+  hpcfmt_int4_fwrite(m.type(), fs);
+  hpcfmt_int4_fwrite((partner) ? partner->id() : Metric::ADesc::id_NULL, fs);
+  writeStr(m.namePfx(), fs);
+  writeStr(m.nameBase(), fs);
+  writeStr(m.nameSfx(), fs);
+  writeStr(m.description(), fs);
+  hpcfmt_int4_fwrite(m.isVisible(), fs);
+  hpcfmt_int4_fwrite(m.isSortKey(), fs);
+  hpcfmt_int4_fwrite(m.doDispPercent(), fs);
+  hpcfmt_int4_fwrite(m.isPercent(), fs);
+  hpcfmt_int4_fwrite(m.computedType(), fs);
+  hpcfmt_int4_fwrite(m.dbId(), fs);
+  hpcfmt_int4_fwrite(m.dbNumMetrics(), fs);
+  hpcfmt_int8_fwrite(m.num_samples(), fs);
+  hpcfmt_int4_fwrite(m.isMultiplexed(), fs);
+  hpcfmt_real8_fwrite(m.periodMean(), fs);
+  hpcfmt_int4_fwrite(m.sampling_type(), fs);
+
+  // SampledDesc
+  hpcfmt_int8_fwrite(m.period(), fs);
+  hpcrun_metricFlags_t flags = m.flags();
+  hpcfmt_int8_fwrite(flags.bits_big[0], fs);
+  hpcfmt_int8_fwrite(flags.bits_big[1], fs);
+  hpcfmt_int4_fwrite(m.isUnitsEvents(), fs);
+  writeStr(m.profileName(), fs);
+  writeStr(m.profileRelId(), fs);
+  writeStr(m.profileType(), fs);
+}
+
+
+// readMetricDesc: reads a descriptor written by writeMetricDesc() into
+// 'm' and returns its partner's id (or id_NULL)
+static uint
+readMetricDesc(Prof::Metric::SampledDesc& m, FILE* fs)
+{
+  using namespace Prof;
+
+  uint32_t type = 0, partnerId = 0;
+  uint32_t isVisible = 0, isSortKey = 0, doDispPercent = 0, isPercent = 0;
+  uint32_t computedTy = 0, dbId = 0, dbNumMetrics = 0;
+  uint64_t numSamples = 0;
+  uint32_t isMultiplexed = 0;
+  double periodMean = 0.0;
+  uint32_t samplingTy = 0;
+
+  hpcfmt_int4_fread(&type, fs);
+  hpcfmt_int4_fread(&partnerId, fs);
+  string namePfx = readStr(fs);
+  string nameBase = readStr(fs);
+  string nameSfx = readStr(fs);
+  string description = readStr(fs);
+  hpcfmt_int4_fread(&isVisible, fs);
+  hpcfmt_int4_fread(&isSortKey, fs);
+  hpcfmt_int4_fread(&doDispPercent, fs);
+  hpcfmt_int4_fread(&isPercent, fs);
+  hpcfmt_int4_fread(&computedTy, fs);
+  hpcfmt_int4_fread(&dbId, fs);
+  hpcfmt_int4_fread(&dbNumMetrics, fs);
+  hpcfmt_int8_fread(&numSamples, fs);
+  hpcfmt_int4_fread(&isMultiplexed, fs);
+  hpcfmt_real8_fread(&periodMean, fs);
+  hpcfmt_int4_fread(&samplingTy, fs);
+
+  uint64_t period = 0;
+  hpcrun_metricFlags_t flags = hpcrun_metricFlags_NULL;
+  uint32_t isUnitsEvents = 0;
+  hpcfmt_int8_fread(&period, fs);
+  hpcfmt_int8_fread(&flags.bits_big[0], fs);
+  hpcfmt_int8_fread(&flags.bits_big[1], fs);
+  hpcfmt_int4_fread(&isUnitsEvents, fs);
+  string profName = readStr(fs);
+  string profRelId = readStr(fs);
+  string profType = readStr(fs);
+
+  // isPercent can only be given to the constructor
+  Metric::SampledDesc x(nameBase, description, period, isUnitsEvents,
+			profName, profRelId, profType, isVisible, isSortKey,
+			doDispPercent, isPercent);
+  x.type((Metric::ADesc::ADescTy)type);
+  x.namePfx(namePfx);
+  x.nameBase(nameBase);
+  x.nameSfx(nameSfx);
+  x.computedType((Metric::ADesc::ComputedTy)computedTy);
+  x.dbId(dbId);
+  x.dbNumMetrics(dbNumMetrics);
+  x.num_samples(numSamples);
+  x.isMultiplexed(isMultiplexed);
+  x.periodMean(periodMean);
+  x.sampling_type((Metric::SamplingType_t)samplingTy);
+  x.flags(flags);
+
+  m = x;
+  return partnerId;
+}
+
+
+// writeEntry: the traces are hard links, not copies, to the
+// normalized trace files (which hpcprof moves into the database) or
+// to the measurement's own traces.  If they cannot be linked, the
+// entry is not written.
+static void
+writeEntry(Prof::CallPath::Profile& prof, const string& entryDir)
+{
+  using namespace Prof;
+
+  // only sampled metrics can be restored from the entry
+  const Metric::Mgr* mMgr = prof.metricMgr();
+  for (uint i = 0; i < mMgr->size(); ++i) {
+    if (!dynamic_cast<const Metric::SampledDesc*>(mMgr->metric(i))) {
+      DIAG_Throw("metric '" << mMgr->metric(i)->name()
+		 << "' is not a sampled metric");
+    }
+  }
+
+  StringSet traceFiles;
+  const StringSet& srcTraces = prof.traceFileNameSet();
+  for (StringSet::const_iterator it = srcTraces.begin();
+       it != srcTraces.end(); ++it) {
+    const string& x = *it;
+    const string  srcFnm1 = x + "." + HPCPROF_TmpFnmSfx;
+    const string  nm = FileUtil::basename(x);
+    const string  dstFnm = entryDir + "/" + nm;
+
+    // keep the normalized trace, which hpcprof will move away
+    const string& srcFnm = (FileUtil::isReadable(srcFnm1)) ? srcFnm1 : x;
+    if (link(srcFnm.c_str(), dstFnm.c_str()) != 0) {
+      DIAG_Throw("error linking '" << srcFnm << "': " << strerror(errno));
+    }
+    traceFiles.insert(nm);
+  }
+
+  string fnm = entryDir + "/" + ProfileFnm;
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1);
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+
+  fwrite(CacheMagic, 1, sizeof(CacheMagic) - 1, fs);
+  fwrite(CacheVersion, 1, sizeof(CacheVersion) - 1, fs);
+
+  writeStr(prof.name(), fs);
+  StringSet::fmt_fwrite(prof.directorySet(), fs);
+  StringSet::fmt_fwrite(traceFiles, fs);
+  hpcfmt_int8_fwrite(prof.flags().bits, fs);
+
+  hpcfmt_int4_fwrite(mMgr->size(), fs);
+  for (uint i = 0; i < mMgr->size(); ++i) {
+    writeMetricDesc(*static_cast<const Metric::SampledDesc*>(mMgr->metric(i)),
+		    fs);
+  }
+
+  CallPath::Profile::fmt_fwrite(prof, fs,
+				CallPath::Profile::WFlg_SparseMetrics);
+
+  if (ferror(fs) | hpcio_fclose(fs)) {
+    DIAG_Throw("error writing '" << fnm << "'");
+  }
+}
+
+
+// readEntry: reads the entry in 'entryDir' into 'prof'.  Returns
+// false if there is no (complete) entry; throws if it is unreadable.
+static bool
+readEntry(Prof::CallPath::Profile*& prof, const string& entryDir)
+{
+  using namespace Prof;
+
+  string fnm = entryDir + "/" + ProfileFnm;
+  if (!FileUtil::isReadable(fnm)) {
+    return false;
+  }
+
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    return false;
+  }
+
+  char buf[64];
+  size_t len = sizeof(CacheMagic) - 1 + sizeof(CacheVersion) - 1;
+  if (fread(buf, 1, len, fs) != len
+      || memcmp(buf, CacheMagic, sizeof(CacheMagic) - 1) != 0
+      || memcmp(buf + sizeof(CacheMagic) - 1, CacheVersion,
+		sizeof(CacheVersion) - 1) != 0) {
+    hpcio_fclose(fs);
+    return false;
+  }
+
+  string name = readStr(fs);
+  StringSet* dirs = NULL;
+  StringSet* traceFiles = NULL;
+  StringSet::fmt_fread(dirs, fs);
+  StringSet::fmt_fread(traceFiles, fs);
+  epoch_flags_t flags;
+  flags.bits = 0;
+  hpcfmt_int8_fread(&flags.bits, fs);
+
+  uint32_t numMetrics = 0;
+  hpcfmt_int4_fread(&numMetrics, fs);
+  std::vector<Metric::SampledDesc> mDescs(numMetrics);
+  std::vector<uint> mPartners(numMetrics);
+  for (uint i = 0; i < numMetrics && !feof(fs); ++i) {
+    mPartners[i] = readMetricDesc(mDescs[i], fs);
+  }
+
+  // The entry's metrics are final values with their own names, so
+  // they are read without the read flags of the original profiles
+  // (RFlg_MakeInclExcl would split them again) and without suffixes;
+  // the saved descriptors then replace the ones that were read.
+  bool isBad = ferror(fs) || feof(fs) || !dirs || !traceFiles;
+  if (!isBad) {
+    try {
+      CallPath::Profile::fmt_fread(prof, fs,
+				   CallPath::Profile::RFlg_NoMetricSfx,
+				   fnm, NULL, NULL);
+    }
+    catch (...) {
+      delete dirs;
+      delete traceFiles;
+      hpcio_fclose(fs);
+      throw;
+    }
+  }
+  hpcio_fclose(fs);
+
+  if (isBad || prof->metricMgr()->size() != numMetrics) {
+    delete dirs;
+    delete traceFiles;
+    DIAG_Throw("error reading '" << fnm << "'");
+  }
+
+  // -------------------------------------------------------
+  // restore what hpcrun format does not keep
+  // -------------------------------------------------------
+  prof->name(name);
+  prof->directorySet() += *dirs;
+  prof->flags(flags);
+
+  Metric::Mgr* mMgr = prof->metricMgr();
+  for (uint i = 0; i < numMetrics; ++i) {
+    Metric::SampledDesc* m = dynamic_cast<Metric::SampledDesc*>(mMgr->metric(i));
+    if (!m || (mPartners[i] != Metric::ADesc::id_NULL
+	       && mPartners[i] >= numMetrics)) {
+      delete dirs;
+      delete traceFiles;
+      DIAG_Throw("error reading '" << fnm << "'");
+    }
+    uint id = m->id();
+    *m = mDescs[i];
+    m->id(id);
+  }
+  for (uint i = 0; i < numMetrics; ++i) {
+    mMgr->metric(i)->partner((mPartners[i] != Metric::ADesc::id_NULL)
+			     ? mMgr->metric(mPartners[i]) : NULL);
+  }
+  mMgr->recomputeMaps();
+
+  // the traces are the links in the entry
+  StringSet& traces = prof->traceFileNameSet();
+  traces.clear();
+  bool isComplete = true;
+  for (StringSet::iterator it = traceFiles->begin();
+       it != traceFiles->end(); ++it) {
+    string x = entryDir + "/" + *it;
+    isComplete = isComplete && FileUtil::isReadable(x);
+    traces.insert(x);
+  }
+
+  delete dirs;
+  delete traceFiles;
+
+  if (!isComplete) {
+    delete prof;
+    prof = NULL;
+    return false;
+  }
+  return true;
+}
+
+
+// removeEntry: removes the (flat) directory 'entryDir', if any
+static void
+removeEntry(const string& entryDir)
+{
+  DIR* dir = opendir(entryDir.c_str());
+  if (!dir) {
+    return;
+  }
+  struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+    string nm = ent->d_name;
+    if (nm != "." && nm != "..") {
+      unlink((entryDir + "/" + nm).c_str());
+    }
+  }
+  closedir(dir);
+  rmdir(entryDir.c_str());
+}
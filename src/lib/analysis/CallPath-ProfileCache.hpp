@@ -0,0 +1,116 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A persistent cache of the merged (unstructured) profile of a
+//   measurement directory, so that hpcprof --profile-cache can skip
+//   reading and merging the profiles when it is run again on the same
+//   measurements.
+//
+// Description:
+//   The cache is the directory 'hpcprof-cache' in the measurement
+//   directory.  Each entry is a subdirectory named by two hashes:
+//
+//     <files>-<options>    files:   the profile names, groups, sizes
+//                                   and mtimes
+//                          options: the hpcprof version, word size,
+//                                   and the merge and read flags
+//
+//   and holds the merged profile (hpcrun format, plus the metric
+//   descriptors, which that format does not keep) and a hard link to
+//   each normalized trace file.  Entries for other sets of profiles are
+//   stale and are removed when a newer entry is written.  An entry is
+//   written as '<name>.<pid>.tmp' and renamed when complete; those are
+//   never removed by another run.
+//
+//   Static structure (-S, -I, -R) is applied after the cache, so
+//   changing it does not invalidate an entry.
+//
+//***************************************************************************
+
+#ifndef Analysis_CallPath_ProfileCache_hpp
+#define Analysis_CallPath_ProfileCache_hpp
+
+//************************* System Include Files ****************************
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Util.hpp"
+
+#include <lib/prof/CallPath-Profile.hpp>
+
+//*************************** Forward Declarations ***************************
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace CallPath {
+
+// readCached: as read(), but returns the cached profile for
+// 'profileFiles' if there is one, and otherwise reads the profiles
+// and caches the result.  Failing to write the cache is not an error.
+//
+// N.B.: The trace files of a cached profile are the links in the
+// cache; callers must copy (not move) them.
+Prof::CallPath::Profile*
+readCached(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	   int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+
+} // namespace CallPath
+
+} // namespace Analysis
+
+//****************************************************************************
+
+#endif // Analysis_CallPath_ProfileCache_hpp
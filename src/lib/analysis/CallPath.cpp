@@ -72,8 +72,13 @@ using std::string;
 #include <cstring>
 
 #include <typeinfo>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include <sys/stat.h>
+#include <unistd.h>
 
 //*************************** User Include Files ****************************
 
@@ -83,6 +88,7 @@ using std::string;
 #include "CallPath.hpp"
 #include "CallPath-MetricComponentsFact.hpp"
 #include "Util.hpp"
+#include "StructCache.hpp"
 
 #include <lib/prof/CCT-Tree.hpp>
 #include <lib/prof/Metric-Mgr.hpp>
@@ -92,6 +98,7 @@ using std::string;
 #include <lib/profxml/PGMReader.hpp>
 
 #include <lib/prof-lean/hpcrun-metric.h>
+#include <lib/prof-lean/stdatomic.h>
 #include <lib/prof/LoadMap.hpp>
 #include <lib/binutils/LM.hpp>
 #include <lib/binutils/VMAInterval.hpp>
@@ -241,6 +248,83 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
 }
 
 
+// A cached structure file names the binary as it was when hpcstruct
+// ran; file it under the load map's name instead.
+class CachedStructDocHandlerArgs : public DocHandlerArgs {
+public:
+  CachedStructDocHandlerArgs(const string& lmName)
+    : DocHandlerArgs(&RealPathMgr::singleton()), m_lmName(lmName)
+  { }
+
+  virtual string
+  lmName(const string& GCC_ATTR_UNUSED oldpath) const
+  { return m_lmName; }
+
+private:
+  string m_lmName;
+};
+
+
+void
+readCachedStructure(Prof::CallPath::Profile& prof, const Analysis::Args& args)
+{
+  if (args.structureCacheDir.empty()) {
+    return;
+  }
+
+  const Prof::LoadMap* loadmap = prof.loadmap();
+  Prof::Struct::Tree* structure = prof.structure();
+  Prof::Struct::Root* rootStrct = structure->root();
+
+  // Visit load modules in id order so that the structure tree is
+  // built the same way on every run (and every hpcprof-mpi rank).
+  std::vector<Prof::LoadMap::LMId_t> lmIds;
+  for (std::unordered_map<uint, Prof::LoadMap::LM*>::const_iterator it =
+	 loadmap->lm_begin_id(); it != loadmap->lm_end_id(); ++it) {
+    if (it->first != Prof::LoadMap::LMId_NULL && it->second->isUsed()) {
+      lmIds.push_back(it->first);
+    }
+  }
+  std::sort(lmIds.begin(), lmIds.end());
+
+  // Use only structure made with hpcstruct's default options; other
+  // options recover different structure than the user would expect.
+  const string defaultContKey =
+    StructCache::contentKey(StructCache::ContentOptions());
+
+  for (uint i = 0; i < lmIds.size(); ++i) {
+    Prof::LoadMap::LM* lm = loadmap->lm(lmIds[i]);
+
+    const string& lm_nm = lm->name();
+    Prof::Struct::LM* lmStrct = rootStrct->findLM(lm_nm);
+    if (lmStrct && lmStrct->childCount() > 0) {
+      continue; // given with -S
+    }
+
+    string binKey = StructCache::binaryKey(lm_nm);
+    string entry = StructCache::lookupContent(args.structureCacheDir, binKey,
+					      defaultContKey);
+    if (entry.empty()) {
+      continue;
+    }
+
+    DIAG_Msg(1, "STRUCTURE: using cached '" << entry << "' for '"
+	     << lm_nm << "'");
+
+    try {
+      CachedStructDocHandlerArgs docargs(lm_nm);
+      std::vector<string> files(1, entry);
+      Prof::Struct::readStructure(*structure, files,
+				  PGMDocHandler::Doc_STRUCT, docargs);
+    }
+    catch (const Diagnostics::Exception& x) {
+      DIAG_WMsgIf(1, "Cannot read cached structure '" << entry << "': "
+		  << x.what());
+    }
+  }
+}
+
+
 } // namespace CallPath
 
 } // namespace Analysis
@@ -342,14 +426,44 @@ coalesceStmts(Prof::CallPath::Profile& prof);
 //****************************************************************************
 
 
+// An LMItem is one used load module of the load map.  Opening and
+// reading its binary (and warming its line map with the CCT's IPs)
+// may run on any thread; the overlay onto the CCT is applied in load
+// map order by whichever thread holds the apply lock.
+class LMItem {
+public:
+  LMItem(Prof::LoadMap::LM* lm_)
+    : loadmap_lm(lm_), useStruct(false), lm(NULL)
+  { atomic_init(&is_done, false); }
+
+  Prof::LoadMap::LM* loadmap_lm;
+  bool useStruct;
+  std::vector<VMA> ips;   // sorted, unique IPs of CCT nodes in this LM
+  BinUtil::LM* lm;
+  std::string warning;    // printed when the overlay is applied
+  atomic_bool is_done;    // release: the fields above are complete
+};
+
+typedef std::vector<LMItem*> LMItemList;
+
+
+static BinUtil::LM*
+openLM(Prof::CallPath::Profile& prof, Prof::LoadMap::LM* loadmap_lm,
+       bool useStruct, std::string& warning);
+
+static void
+applyLMItemList(Prof::CallPath::Profile& prof, LMItemList& itemList,
+		uint& num_done, std::string& errors, bool printProgress);
+
+
 void
 Analysis::CallPath::
 overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 			   string agent, bool doNormalizeTy,
-                           bool printProgress)
+                           bool printProgress, uint numThreads)
 {
   const Prof::LoadMap* loadmap = prof.loadmap();
-  Prof::Struct::Root* rootStrct = prof.structure()->root();
+  const Prof::Struct::Root* rootStrct = prof.structure()->root();
 
   std::string errors;
 
@@ -357,25 +471,88 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
   // Overlay static structure. N.B. To process spurious samples,
   // iteration includes LoadMap::LMId_NULL
   // -------------------------------------------------------
+  LMItemList itemList;
+  std::map<uint, LMItem*> itemMap; // LMId -> item that needs a BinUtil::LM
+
   for(std::unordered_map<uint, Prof::LoadMap::LM*>::const_iterator it=loadmap->lm_begin_id(); 
     it != loadmap->lm_end_id(); ++it) {
 
     uint i = it->second->id();
     Prof::LoadMap::LM* lm = loadmap->lm(i);
     if (lm->isUsed()) {
-      try {
-        const string& lm_nm = lm->name();
-
-        Prof::Struct::LM* lmStrct = Prof::Struct::LM::demand(rootStrct, lm_nm);
-        Analysis::CallPath::overlayStaticStructureMain(prof, lm, lmStrct,
-                                                       printProgress);
+      LMItem* item = new LMItem(lm);
+      const Prof::Struct::LM* lmStrct = rootStrct->findLM(lm->name());
+      item->useStruct = (lmStrct && lmStrct->childCount() > 0);
+      if (!item->useStruct) {
+	itemMap[i] = item;
       }
-      catch (const Diagnostics::Exception& x) {
-        errors += "  " + x.what() + "\n";
+      itemList.push_back(item);
+    }
+  }
+
+  // Gather the IPs that each opened load module will be asked about.
+  // The CCT is only read here; it is not modified until the items are
+  // applied.
+  if (numThreads > 1) {
+    Prof::CCT::ANodeIterator it(prof.cct()->root());
+    for (Prof::CCT::ANode* n = NULL; (n = it.current()); ++it) {
+      Prof::CCT::ADynNode* n_dyn = dynamic_cast<Prof::CCT::ADynNode*>(n);
+      if (n_dyn) {
+	std::map<uint, LMItem*>::iterator mit = itemMap.find(n_dyn->lmId());
+	if (mit != itemMap.end()) {
+	  mit->second->ips.push_back(n_dyn->lmIP());
+	}
       }
     }
+    for (std::map<uint, LMItem*>::iterator mit = itemMap.begin();
+	 mit != itemMap.end(); ++mit) {
+      std::vector<VMA>& ips = mit->second->ips;
+      std::sort(ips.begin(), ips.end());
+      ips.erase(std::unique(ips.begin(), ips.end()), ips.end());
+    }
   }
 
+  // Open and read the binaries concurrently (BFD itself is serialized
+  // by BinUtil::BfdLock, and the workers and the applier share the
+  // thread-safe RealPathMgr), but apply the overlays in load map order,
+  // so that the CCT and structure ids are the same as from one thread.
+  uint num_done = 0;
+  std::mutex apply_mtx;
+
+#pragma omp parallel  num_threads(numThreads)  default(none)	\
+    shared(prof, itemList, num_done, apply_mtx, errors)	\
+    firstprivate(printProgress)
+  {
+#pragma omp for  schedule(dynamic, 1)
+    for (uint i = 0; i < itemList.size(); i++) {
+      LMItem* item = itemList[i];
+      item->lm = openLM(prof, item->loadmap_lm, item->useStruct,
+			item->warning);
+
+      if (item->lm) {
+	// warm the line map
+	string func, file;
+	SrcFile::ln line;
+	for (uint k = 0; k < item->ips.size(); k++) {
+	  item->lm->findSrcCodeInfo(item->ips[k], 0, func, file, line);
+	}
+      }
+      item->ips.clear();
+
+      // Publish the item, but don't wait to apply it: that's done by
+      // whoever holds the lock (at the latest, after the loop).  The
+      // lock only serializes the applier, not the workers.
+      atomic_store_explicit(&item->is_done, true, memory_order_release);
+
+      if (apply_mtx.try_lock()) {
+	applyLMItemList(prof, itemList, num_done, errors, printProgress);
+	apply_mtx.unlock();
+      }
+    }
+  }  // end parallel
+
+  applyLMItemList(prof, itemList, num_done, errors, printProgress);
+
   if (!errors.empty()) {
     DIAG_WMsgIf(1, "Cannot fully process samples because of errors reading load modules:\n" << errors);
   }
@@ -392,24 +569,62 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 }
 
 
-void
-Analysis::CallPath::
-overlayStaticStructureMain(Prof::CallPath::Profile& prof,
-			   Prof::LoadMap::LM* loadmap_lm,
-			   Prof::Struct::LM* lmStrct,
-                           bool printProgress)
+// Apply the items that are done, in load map order, and free them.
+// This must be called locked or single threaded.
+static void
+applyLMItemList(Prof::CallPath::Profile& prof, LMItemList& itemList,
+		uint& num_done, std::string& errors, bool printProgress)
+{
+  Prof::Struct::Root* rootStrct = prof.structure()->root();
+
+  while (num_done < itemList.size()
+	 && atomic_load_explicit(&itemList[num_done]->is_done,
+				 memory_order_acquire)) {
+    LMItem* item = itemList[num_done];
+    const string& lm_nm = item->loadmap_lm->name();
+
+    if (!item->warning.empty()) {
+      DIAG_WMsgIf(printProgress, item->warning);
+    }
+    if (item->lm) {
+      DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
+    }
+
+    try {
+      Prof::Struct::LM* lmStrct = Prof::Struct::LM::demand(rootStrct, lm_nm);
+      // an earlier item with the same name may have added structure
+      BinUtil::LM* lm = (lmStrct->childCount() > 0) ? NULL : item->lm;
+      Analysis::CallPath::overlayStaticStructureMain(prof, item->loadmap_lm,
+						     lmStrct, lm,
+						     printProgress);
+    }
+    catch (const Diagnostics::Exception& x) {
+      errors += "  " + x.what() + "\n";
+    }
+
+    delete item->lm;
+    delete item;
+    itemList[num_done] = NULL;
+    num_done++;
+  }
+}
+
+
+// openLM: Returns the opened and read binary for 'loadmap_lm' if its
+// structure is to come from the binary; otherwise NULL.
+static BinUtil::LM*
+openLM(Prof::CallPath::Profile& prof, Prof::LoadMap::LM* loadmap_lm,
+       bool useStruct, std::string& warning)
 {
   const string& lm_nm = loadmap_lm->name();
   BinUtil::LM* lm = NULL;
 
-  bool useStruct = (lmStrct->childCount() > 0);
-
   if (useStruct) {
-    DIAG_MsgIf(printProgress, "STRUCTURE: " << lm_nm);
+    // no-op: use the structure file
   } else if (loadmap_lm->id() == Prof::LoadMap::LMId_NULL) {
     // no-op for this case
   } else if (vdso_loadmodule(lm_nm.c_str()))  {
-    DIAG_WMsgIf(printProgress, "Cannot fully process samples for virtual load module " << lm_nm);
+    warning = "Cannot fully process samples for virtual load module " + lm_nm;
   } else {
 
     try {
@@ -420,10 +635,48 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
     catch (const Diagnostics::Exception& x) {
       delete lm;
       lm = NULL;
-      DIAG_WMsgIf(printProgress, "Cannot fully process samples for load module " << 
-                  lm_nm << ": " << x.what());
+      warning = "Cannot fully process samples for load module " + lm_nm
+	+ ": " + x.what();
     }
-    if (lm) DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
+  }
+
+  return lm;
+}
+
+
+void
+Analysis::CallPath::
+overlayStaticStructureMain(Prof::CallPath::Profile& prof,
+			   Prof::LoadMap::LM* loadmap_lm,
+			   Prof::Struct::LM* lmStrct,
+                           bool printProgress)
+{
+  bool useStruct = (lmStrct->childCount() > 0);
+
+  std::string warning;
+  BinUtil::LM* lm = openLM(prof, loadmap_lm, useStruct, warning);
+  if (!warning.empty()) {
+    DIAG_WMsgIf(printProgress, warning);
+  }
+  if (lm) {
+    DIAG_MsgIf(printProgress, "Line map : " << loadmap_lm->name());
+  }
+
+  overlayStaticStructureMain(prof, loadmap_lm, lmStrct, lm, printProgress);
+
+  delete lm;
+}
+
+
+void
+Analysis::CallPath::
+overlayStaticStructureMain(Prof::CallPath::Profile& prof,
+			   Prof::LoadMap::LM* loadmap_lm,
+			   Prof::Struct::LM* lmStrct, BinUtil::LM* lm,
+                           bool printProgress)
+{
+  if (lmStrct->childCount() > 0) {
+    DIAG_MsgIf(printProgress, "STRUCTURE: " << loadmap_lm->name());
   }
 
   if (lm) {
@@ -433,8 +686,6 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
   
   // account for new structure inserted by BAnal::Struct::makeStructureSimple()
   lmStrct->computeVMAMaps();
-
-  delete lm;
 }
 
 
@@ -1078,6 +1329,9 @@ static void
 write(Prof::CallPath::Profile& prof, std::ostream& os,
       const Analysis::Args& args);
 
+static void
+writeBinary(Prof::CallPath::Profile& prof, const string& fnm);
+
 
 // makeDatabase: assumes Analysis::Args::makeDatabaseDir() has been called
 void
@@ -1090,7 +1344,7 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   // 1. Copy source files.  
   //    NOTE: makes file names in 'prof.structure' relative to database
   Analysis::Util::copySourceFiles(prof.structure()->root(),
-				  args.searchPathTpls, db_dir);
+				  args.searchPathTpls, db_dir, args.jobs);
 
   // 2. Copy trace files (if necessary)
   Analysis::Util::copyTraceFiles(db_dir, prof.traceFileNameSet());
@@ -1109,6 +1363,45 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   IOUtil::CloseStream(os);
 
   delete[] outBuf;
+
+  // 5. Write its binary copy of the CCT, for readers that cannot
+  //    afford to parse the XML
+  writeBinary(prof, db_dir + "/" + Analysis_OUT_DB_CCTDB);
+}
+
+
+// findVisibleMetrics: the metric ids [metricBegId, metricEndId)
+// written to the database
+static void
+findVisibleMetrics(Prof::CallPath::Profile& prof,
+		   uint& metricBegId, uint& metricEndId)
+{
+  using namespace Prof;
+
+  Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
+  Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
+  metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
+  metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
+}
+
+
+static void
+writeBinary(Prof::CallPath::Profile& prof, const string& fnm)
+{
+  uint metricBegId, metricEndId;
+  findVisibleMetrics(prof, metricBegId, metricEndId);
+
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1);
+  if (!fs) {
+    DIAG_WMsgIf(1, "could not write '" << fnm << "'");
+    return;
+  }
+
+  int ret = prof.cct()->writeBinary(fs, metricBegId, metricEndId);
+  if (hpcio_fclose(fs) != 0 || ret != HPCFMT_OK) {
+    DIAG_WMsgIf(1, "could not write '" << fnm << "'");
+    unlink(fnm.c_str());
+  }
 }
 
 
@@ -1133,15 +1426,8 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
     oFlags |= CCT::Tree::OFlg_StructId;
   }
 
-  uint metricBegId = 0;
-  uint metricEndId = prof.metricMgr()->size();
-
- {
-    Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
-    Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
-    metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
-    metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
-  }
+  uint metricBegId, metricEndId;
+  findVisibleMetrics(prof, metricBegId, metricEndId);
 
   string name = (args.title.empty()) ? prof.name() : args.title;
 
@@ -1168,7 +1454,7 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   // 
   // ------------------------------------------------------------
   os << "<SecCallPathProfileData>\n";
-  prof.cct()->writeXML(os, metricBegId, metricEndId, oFlags);
+  prof.cct()->writeXML(os, metricBegId, metricEndId, oFlags, args.jobs);
   os << "</SecCallPathProfileData>\n";
 
   os << "</SecCallPathProfile>\n";
@@ -111,6 +111,13 @@ read(const string& prof_fnm, uint groupId, uint rFlags = 0)
 void
 readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args);
 
+// readCachedStructure: for each used load module of 'prof' that has
+// no structure yet, read a matching structure file from the hpcstruct
+// cache (Args::structureCacheDir), if there is one.
+void
+readCachedStructure(Prof::CallPath::Profile& prof,
+		    const Analysis::Args& args);
+
 
 // ---------------------------------------------------------
 // 
@@ -133,10 +140,14 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args);
 //   has a CCT::Call node for a parent.
 // - Every CCT::Call and CCT::Stmt is a descendant of a CCT::ProcFrm
 // - A CCT::Stmt node is always a leaf.
+//
+// Up to 'numThreads' threads open and read the binaries of load
+// modules without structure; the overlays are applied in load map
+// order regardless.
 void
 overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 			   string agent, bool doNormalizeTy,
-                           bool printProgress);
+                           bool printProgress, uint numThreads = 1);
 
 void
 overlayStaticStructureMain(Prof::CallPath::Profile& prof,
@@ -144,6 +155,13 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 			   Prof::Struct::LM* lmStrct,
                            bool printProgress);
 
+// lm is an already opened binary for 'loadmap_lm' and may be NULL
+void
+overlayStaticStructureMain(Prof::CallPath::Profile& prof,
+			   Prof::LoadMap::LM* loadmap_lm,
+			   Prof::Struct::LM* lmStrct, BinUtil::LM* lm,
+                           bool printProgress);
+
 
 // lm is optional and may be NULL
 void 
@@ -60,6 +60,9 @@ using std::map;
 #include <vector>
 using std::vector;
 
+#include <algorithm>
+#include <mutex>
+
 #include <climits>
 
 //************************* User Include Files *******************************
@@ -75,6 +78,7 @@ using std::vector;
 
 #include <lib/prof/Struct-Tree.hpp>
 #include <lib/prof/Flat-ProfileData.hpp>
+#include <lib/prof/Metric-AExprBatch.hpp>
 
 #include <lib/binutils/LM.hpp>
 
@@ -154,7 +158,7 @@ Driver::run()
     DIAG_Msg(1, "Copying source files reached by PATH/REPLACE options to " << db_dir);
     // NOTE: makes file names in m_structure relative to database
     Analysis::Util::copySourceFiles(m_structure.root(), m_args.searchPathTpls,
-				    db_dir);
+				    db_dir, m_args.jobs);
   }
 
   const string out_path = (db_use) ? (db_dir + "/") : "";
@@ -646,6 +650,26 @@ Driver::correlateMetricsWithStructure(Prof::Metric::Mgr& mMgr,
 
 //----------------------------------------------------------------------------
 
+// An LMItem is one load module of a batch job.  Opening and reading
+// its binary (and warming its line map with the batch's VMAs) may run
+// on any thread; correlation into the structure tree is applied in
+// load module order by whichever thread holds the apply lock.
+class Driver::LMItem {
+public:
+  LMItem(const string& lmname_, const string& lmname_orig_)
+    : lmname(lmname_), lmname_orig(lmname_orig_), useStruct(false),
+      lm(NULL), is_done(false)
+  { }
+
+  string lmname;
+  string lmname_orig;
+  bool useStruct;
+  BinUtil::LM* lm;
+  string error;     // non-empty if the binary could not be read
+  bool is_done;
+};
+
+
 void
 Driver::computeRawMetrics(Prof::Metric::Mgr& mMgr, Prof::Struct::Tree& structure)
 {
@@ -675,6 +699,7 @@ Driver::computeRawMetrics(Prof::Metric::Mgr& mMgr, Prof::Struct::Tree& structure
     // For each load module: process the batch job.  A batch job
     // process a group of profile files (and their associated metrics)
     // by load module.
+    LMItemList itemList;
     Prof::Flat::ProfileData* prof = batchJob[0].first;
     for (Prof::Flat::ProfileData::const_iterator it1 = prof->begin();
 	 it1 != prof->end(); ++it1) {
@@ -687,10 +712,45 @@ Driver::computeRawMetrics(Prof::Metric::Mgr& mMgr, Prof::Struct::Tree& structure
       }
       prev_lmname_orig = lmname_orig;
 
-      const string lmname = replacePath(lmname_orig);
-      
-      bool useStruct = hasStructure(lmname, structure, hasStructureTbl);
-      computeRawBatchJob_LM(lmname, lmname_orig, structure, batchJob, useStruct);
+      LMItem* item = new LMItem(replacePath(lmname_orig), lmname_orig);
+      item->useStruct = hasStructure(item->lmname, structure, hasStructureTbl);
+      itemList.push_back(item);
+    }
+
+    // Open and read the binaries concurrently (BFD itself is
+    // serialized by BinUtil::BfdLock, paths by RealPathMgr's lock),
+    // but correlate in load module order, so that the structure tree
+    // and its ids are the same as from one thread.
+    uint numThreads = m_args.jobs;
+    uint num_done = 0;
+    std::mutex apply_mtx;
+    std::string errors;
+
+#pragma omp parallel  num_threads(numThreads)  default(none)	\
+    shared(structure, batchJob, itemList, num_done, apply_mtx, errors)
+    {
+#pragma omp for  schedule(dynamic, 1)
+      for (uint i = 0; i < itemList.size(); i++) {
+	LMItem* item = itemList[i];
+	openLMItem(item, batchJob);
+
+	// set is_done under the lock that the applier holds, but don't
+	// wait to apply, that's done by whoever holds the lock.
+	apply_mtx.lock();
+	item->is_done = true;
+	apply_mtx.unlock();
+
+	if (apply_mtx.try_lock()) {
+	  applyLMItemList(itemList, num_done, structure, batchJob, errors);
+	  apply_mtx.unlock();
+	}
+      }
+    }  // end parallel
+
+    applyLMItemList(itemList, num_done, structure, batchJob, errors);
+
+    if (!errors.empty()) {
+      DIAG_Throw("Cannot read load modules:\n" << errors);
     }
     
     clearRawBatch(batchJob);
@@ -726,22 +786,100 @@ Driver::computeRawMetrics(Prof::Metric::Mgr& mMgr, Prof::Struct::Tree& structure
 }
 
 
+// openLMItem: Opens the binary for 'item' and, without structure
+// information, reads it and looks up each (unrelocated) VMA of the
+// batch job so that correlation finds its line map ready.  Touches
+// nothing shared except through BinUtil (serialized by BfdLock) and
+// the RealPathMgr singleton (which has its own lock, since the
+// applier uses it too, via Struct::LM::demand), so it is safe to run
+// concurrently.
 void
-Driver::computeRawBatchJob_LM(const string& lmname, const string& lmname_orig,
-			      Prof::Struct::Tree& structure,
-			      ProfToMetricsTupleVec& profToMetricsVec,
-			      bool useStruct)
+Driver::openLMItem(LMItem* item, const ProfToMetricsTupleVec& profToMetricsVec)
 {
-  BinUtil::LM* lm = openLM(lmname);
-  if (!lm) {
+  item->lm = openLM(item->lmname);
+  if (!item->lm || item->useStruct) {
     return;
   }
 
-  if (!useStruct) {
+  BinUtil::LM* lm = item->lm;
+  try {
     std::set<std::string> dir;  // empty set of measurement directories
     lm->read(dir, BinUtil::LM::ReadFlg_Seg);
   }
+  catch (const Diagnostics::Exception& x) {
+    item->error = "  " + item->lmname + ": " + x.what() + "\n";
+  }
+  if (!item->error.empty()) {
+    delete lm;
+    item->lm = NULL;
+    return;
+  }
+
+  std::vector<VMA> vmas;
+  for (uint i = 0; i < profToMetricsVec.size(); ++i) {
+    const Prof::Flat::ProfileData* prof = profToMetricsVec[i].first;
+
+    using Prof::Flat::ProfileData;
+    std::pair<ProfileData::const_iterator, ProfileData::const_iterator> fnd =
+      prof->equal_range(item->lmname_orig);
+    for (ProfileData::const_iterator it = fnd.first; it != fnd.second; ++it) {
+      const Prof::Flat::LM* proflm = it->second;
+      VMA load_addr = proflm->load_addr();
+      bool doUnrelocate = lm->doUnrelocate(load_addr);
+      for (uint j = 0; j < proflm->num_events(); ++j) {
+	const Prof::Flat::EventData& profevent = proflm->event(j);
+	for (uint k = 0; k < profevent.num_data(); ++k) {
+	  VMA vma = profevent.datum(k).first;
+	  vmas.push_back((doUnrelocate) ? (vma - load_addr) : vma);
+	}
+      }
+    }
+  }
+  std::sort(vmas.begin(), vmas.end());
+  vmas.erase(std::unique(vmas.begin(), vmas.end()), vmas.end());
+
+  // warm the line map
+  string func, file;
+  SrcFile::ln line;
+  for (uint k = 0; k < vmas.size(); k++) {
+    lm->findSrcCodeInfo(vmas[k], 0, func, file, line);
+  }
+}
 
+
+// Apply the items that are done, in load module order, and free them.
+// This must be called locked or single threaded.
+void
+Driver::applyLMItemList(LMItemList& itemList, uint& num_done,
+			Prof::Struct::Tree& structure,
+			ProfToMetricsTupleVec& profToMetricsVec,
+			string& errors)
+{
+  while (num_done < itemList.size() && itemList[num_done]->is_done) {
+    LMItem* item = itemList[num_done];
+
+    if (!item->error.empty()) {
+      errors += item->error;
+    }
+    else if (item->lm) {
+      computeRawBatchJob_LM(item->lmname, item->lmname_orig, structure,
+			    profToMetricsVec, item->lm, item->useStruct);
+    }
+
+    delete item->lm;
+    delete item;
+    itemList[num_done] = NULL;
+    num_done++;
+  }
+}
+
+
+void
+Driver::computeRawBatchJob_LM(const string& lmname, const string& lmname_orig,
+			      Prof::Struct::Tree& structure,
+			      ProfToMetricsTupleVec& profToMetricsVec,
+			      BinUtil::LM* lm, bool useStruct)
+{
   Prof::Struct::LM* lmStrct =
     Prof::Struct::LM::demand(structure.root(), lmname);
 
@@ -786,8 +924,6 @@ Driver::computeRawBatchJob_LM(const string& lmname, const string& lmname_orig,
       }
     }
   }
-
-  delete lm;
 }
 
 
@@ -939,16 +1075,24 @@ Driver::computeDerivedBatch(Prof::Struct::Tree& structure,
   Prof::Struct::Root* strct = structure.root();
   uint numMetrics = m_mMgr.size();
 
-  for (Prof::Struct::ANodeIterator it(strct); it.Current(); it++) {
-    for (uint mId = mBegId; mId < mEndId; ++mId) {
-      const Prof::Metric::AExpr* expr = mExprVec[mId];
-      if (expr) {
-	double val = expr->eval(*it.current());
-	// if (!Prof::Metric::AExpr::isok(val)) ...
-	it.current()->demandMetric(mId, numMetrics/*size*/) = val;
-      }
+  Prof::Metric::AExprBatch batch(numMetrics, /*doNF*/false, /*doFinal*/true);
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Prof::Metric::AExpr* expr = mExprVec[mId];
+    if (expr) {
+      batch.add(mId, expr);
     }
   }
+
+  if (batch.empty()) {
+    return;
+  }
+
+  std::vector<Prof::Metric::IData*> nodes;
+  for (Prof::Struct::ANodeIterator it(strct); it.Current(); it++) {
+    nodes.push_back(it.current());
+  }
+
+  batch.evaluate(&nodes[0], nodes.size());
 }
 
 
@@ -987,9 +1131,13 @@ Driver::openLM(const string& fnm)
   }
   catch (const BinUtil::Exception& x) {
     DIAG_EMsg("While opening " << fnm.c_str() << ":\n" << x.message());
+    delete lm;
+    lm = NULL;
   }
   catch (...) {
     DIAG_EMsg("Exception encountered while opening " << fnm.c_str());
+    delete lm;
+    lm = NULL;
   }
   return lm;
 }
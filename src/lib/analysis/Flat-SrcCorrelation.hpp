@@ -137,6 +137,9 @@ public:
   typedef std::vector<ProfToMetricsTuple> ProfToMetricsTupleVec;
 
 private:
+  class LMItem;
+  typedef std::vector<LMItem*> LMItemList;
+
   void
   populateStructure(Prof::Struct::Tree& structure);
 
@@ -150,11 +153,20 @@ private:
   void
   computeRawMetrics(Prof::Metric::Mgr& mMgr, Prof::Struct::Tree& structure);
 
+  void
+  openLMItem(LMItem* item, const ProfToMetricsTupleVec& profToMetricsVec);
+
+  void
+  applyLMItemList(LMItemList& itemList, uint& num_done,
+		  Prof::Struct::Tree& structure,
+		  ProfToMetricsTupleVec& profToMetricsVec,
+		  string& errors);
+
   void
   computeRawBatchJob_LM(const string& lmname, const string& lmname_orig,
 			Prof::Struct::Tree& structure,
 			ProfToMetricsTupleVec& profToMetricsVec,
-			bool useStruct);
+			BinUtil::LM* lm, bool useStruct);
 
   void
   correlateRaw(Prof::Metric::ADesc* metric,
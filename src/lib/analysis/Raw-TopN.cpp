@@ -0,0 +1,644 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+#include <string>
+using std::string;
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+//*************************** User Include Files ****************************
+
+#include "Raw-TopN.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+
+//*************************** Forward Declarations ***************************
+
+// the most frames of a call path to print, innermost first
+static const uint MaxFramesToPrint = 8;
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace Raw {
+
+// The call path tree of one profile (all epochs), in file order, so
+// that a node's parent precedes it.  Load module and metric ids index
+// the profile's own name tables; merge() maps them to the query's.
+struct TopN::FileCCT {
+  std::vector<uint> parent;     // index of the parent node, or NoKey
+  std::vector<uint> lm;         // index into lmNames; 0 is the NULL lm
+  std::vector<uint64_t> ip;
+
+  // nonzero exclusive values of node i: vals[valBeg[i], valBeg[i+1])
+  std::vector<uint> valBeg;
+  std::vector<std::pair<uint, double> > vals; // (index into metricNames, val)
+
+  std::vector<string> lmNames;
+  std::vector<string> metricNames;
+};
+
+
+struct TopN::Lock {
+  std::mutex mutex;
+  std::condition_variable merged; // signaled when nextToMerge advances
+};
+
+
+TopN::TopN(uint n, KeyTy keyTy)
+  : m_n(n), m_keyTy(keyTy), m_numProfiles(0), m_lock(new Lock)
+{
+  internLM(""); // the NULL load module
+}
+
+
+TopN::~TopN()
+{
+  delete m_lock;
+}
+
+
+// add: Profiles are read concurrently but merged strictly in the
+// order of 'profileFiles', so that ids, sums and therefore the output
+// do not depend on the thread schedule.  A profile read ahead of its
+// turn waits in 'pending' until all earlier ones are merged.
+//
+// Profiles are handed out in order, and a thread does not start one
+// more than 'numThreads' past the next to merge, so that one slow
+// profile cannot leave every later profile's FileCCT in 'pending'.
+// The profiles before a waiting thread's next one are then all being
+// read, so the window always moves.
+void
+TopN::add(const std::vector<string>& profileFiles, uint numThreads)
+{
+  uint numFiles = profileFiles.size();
+  std::vector<FileCCT*> pending(numFiles, NULL);
+  std::vector<bool> isRead(numFiles, false);
+  std::vector<string> errors(numFiles);
+  uint nextToRead = 0;
+  uint nextToMerge = 0;
+  uint window = std::max(numThreads, 1u);
+
+#pragma omp parallel  num_threads(numThreads)
+  for (;;) {
+    uint i;
+    {
+      std::unique_lock<std::mutex> lock(m_lock->mutex);
+      while (nextToRead < numFiles && nextToRead >= nextToMerge + window) {
+	m_lock->merged.wait(lock);
+      }
+      i = nextToRead++;
+    }
+
+    if (i >= numFiles) {
+      break;
+    }
+
+    FileCCT* cct = new FileCCT;
+    try {
+      readFile(profileFiles[i].c_str(), *cct);
+    }
+    catch (const Diagnostics::Exception& x) {
+      errors[i] = "  " + profileFiles[i] + ": " + x.what() + "\n";
+      delete cct;
+      cct = NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock->mutex);
+    pending[i] = cct;
+    isRead[i] = true;
+    uint oldNextToMerge = nextToMerge;
+    while (nextToMerge < numFiles && isRead[nextToMerge]) {
+      if (pending[nextToMerge]) {
+	merge(*pending[nextToMerge]);
+	delete pending[nextToMerge];
+	pending[nextToMerge] = NULL;
+      }
+      nextToMerge++;
+    }
+    if (nextToMerge != oldNextToMerge) {
+      m_lock->merged.notify_all();
+    }
+  }
+
+  string errorMsg;
+  for (uint i = 0; i < errors.size(); i++) {
+    errorMsg += errors[i];
+  }
+  if (!errorMsg.empty()) {
+    DIAG_WMsgIf(1, "Skipped profiles that could not be read:\n" << errorMsg);
+  }
+}
+
+
+void
+TopN::addFile(const char* filenm)
+{
+  FileCCT cct;
+  readFile(filenm, cct);
+
+  std::lock_guard<std::mutex> lock(m_lock->mutex);
+  merge(cct);
+}
+
+
+// readFile: Read the profile 'filenm' into 'cct'.  Touches no shared
+// state, so it may run concurrently.
+void
+TopN::readFile(const char* filenm, FileCCT& cct)
+{
+  FILE* fs = hpcio_fopen_r(filenm);
+  if (!fs) {
+    DIAG_Throw("error opening file");
+  }
+
+  char* fsBuf = new char[HPCIO_RWBufferSz];
+  setvbuf(fs, fsBuf, _IOFBF, HPCIO_RWBufferSz);
+
+  cct.valBeg.push_back(0);
+  cct.lmNames.push_back(""); // the NULL load module
+
+  hpcrun_fmt_hdr_t hdr;
+  hpcrun_fmt_epochHdr_t ehdr;
+  metric_tbl_t metricTbl;
+  metric_aux_info_t* aux_info = NULL;
+  bool haveHdr = false, haveEpoch = false;
+
+  try {
+    if (hpcrun_fmt_hdr_fread(&hdr, fs, malloc) != HPCFMT_OK) {
+      DIAG_Throw("not a call path profile, or it is corrupted");
+    }
+    haveHdr = true;
+    if ( !(hdr.version >= HPCRUN_FMT_Version_20) ) {
+      DIAG_Throw("unsupported file version '" << hdr.versionStr << "'");
+    }
+
+    while ( !feof(fs) ) {
+      // ------------------------------------------------------------
+      // epoch-hdr, metric-tbl and loadmap (cf. Profile::fmt_epoch_fread)
+      // ------------------------------------------------------------
+      int ret = hpcrun_fmt_epochHdr_fread(&ehdr, fs, malloc);
+      if (ret == HPCFMT_EOF) {
+	break;
+      }
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading 'epoch-hdr'");
+      }
+      if (hpcrun_fmt_metricTbl_fread(&metricTbl, &aux_info, fs, hdr.version,
+				     malloc) != HPCFMT_OK) {
+	hpcrun_fmt_epochHdr_free(&ehdr, free);
+	DIAG_Throw("error reading 'metric-tbl'");
+      }
+      haveEpoch = true;
+
+      // Metrics with a formula are computed from the others by
+      // Profile::fmt_cct_fread(); they are not raw samples, so skip
+      // them here.
+      uint numMetrics = metricTbl.len;
+      std::vector<uint> metricIds(numMetrics, NoKey);
+      for (uint i = 0; i < numMetrics; ++i) {
+	const metric_desc_t& mdesc = metricTbl.lst[i];
+	if (!mdesc.formula || mdesc.formula[0] == '\0') {
+	  metricIds[i] = cct.metricNames.size();
+	  cct.metricNames.push_back(mdesc.name);
+	}
+      }
+
+      loadmap_t loadmap_tbl;
+      if (hpcrun_fmt_loadmap_fread(&loadmap_tbl, fs, malloc) != HPCFMT_OK) {
+	DIAG_Throw("error reading 'loadmap'");
+      }
+      std::unordered_map<uint, uint> lmIds;
+      for (uint i = 0; i < loadmap_tbl.len; ++i) {
+	const loadmap_entry_t& lm = loadmap_tbl.lst[i];
+	lmIds[lm.id] = cct.lmNames.size();
+	cct.lmNames.push_back(lm.name);
+      }
+      hpcrun_fmt_loadmap_free(&loadmap_tbl, free);
+
+      // ------------------------------------------------------------
+      // cct (cf. Profile::fmt_cct_fread)
+      // ------------------------------------------------------------
+      uint64_t numNodes = 0;
+      if (hpcfmt_int8_fread(&numNodes, fs) != HPCFMT_OK) {
+	DIAG_Throw("error reading 'cct'");
+      }
+
+      std::vector<hpcrun_metricVal_t> metrics(numMetrics);
+      hpcrun_fmt_cct_node_t nodeFmt;
+      hpcrun_fmt_cct_node_init(&nodeFmt);
+      nodeFmt.num_metrics = numMetrics;
+      nodeFmt.metrics = (numMetrics > 0) ? &metrics[0] : NULL;
+
+      std::unordered_map<int, uint> nodeMap;
+
+      for (uint64_t i = 0; i < numNodes; ++i) {
+	if (hpcrun_fmt_cct_node_fread(&nodeFmt, ehdr.flags, fs) != HPCFMT_OK) {
+	  DIAG_Throw("error reading CCT node " << nodeFmt.id);
+	}
+
+	int nodeId   = (int)nodeFmt.id;
+	int parentId = (int)nodeFmt.id_parent;
+
+	uint parent = NoKey;
+	if (parentId != HPCRUN_FMT_CCTNodeId_NULL) {
+	  std::unordered_map<int, uint>::iterator it = nodeMap.find(parentId);
+	  if (it == nodeMap.end()) {
+	    DIAG_Throw("cannot find parent for CCT node " << nodeId);
+	  }
+	  parent = it->second;
+	}
+
+	// an unknown load module id is treated as the NULL load module
+	std::unordered_map<uint, uint>::iterator lm_it =
+	  lmIds.find(nodeFmt.lm_id);
+
+	nodeMap[nodeId] = cct.parent.size();
+	cct.parent.push_back(parent);
+	cct.lm.push_back((lm_it != lmIds.end()) ? lm_it->second : 0);
+	cct.ip.push_back(nodeFmt.lm_ip);
+
+	for (uint m = 0; m < numMetrics; ++m) {
+	  if (metricIds[m] != NoKey && !hpcrun_metricVal_isZero(metrics[m])) {
+	    const metric_desc_t& mdesc = metricTbl.lst[m];
+	    double mval = hpcrun_fmt_metric_get_value(mdesc, metrics[m]);
+	    cct.vals.push_back(std::make_pair(metricIds[m],
+					      mval * (double)mdesc.period));
+	  }
+	}
+	cct.valBeg.push_back(cct.vals.size());
+      }
+
+      hpcrun_fmt_epochHdr_free(&ehdr, free);
+      hpcrun_fmt_metricTbl_free(&metricTbl, free);
+      free(aux_info);
+      haveEpoch = false;
+    }
+  }
+  catch (...) {
+    if (haveEpoch) {
+      hpcrun_fmt_epochHdr_free(&ehdr, free);
+      hpcrun_fmt_metricTbl_free(&metricTbl, free);
+      free(aux_info);
+    }
+    if (haveHdr) {
+      hpcrun_fmt_hdr_free(&hdr, free);
+    }
+    hpcio_fclose(fs);
+    delete[] fsBuf;
+    throw;
+  }
+
+  hpcrun_fmt_hdr_free(&hdr, free);
+  hpcio_fclose(fs);
+  delete[] fsBuf;
+}
+
+
+// N.B.: internLM(), internMetric() and merge() expect the caller to
+// hold m_lock.
+uint
+TopN::internLM(const string& nm)
+{
+  std::map<string, uint>::iterator it = m_lmMap.find(nm);
+  if (it != m_lmMap.end()) {
+    return it->second;
+  }
+  uint id = m_lmNames.size();
+  m_lmNames.push_back(nm);
+  m_lmMap.insert(std::make_pair(nm, id));
+  return id;
+}
+
+
+uint
+TopN::internMetric(const string& nm)
+{
+  std::map<string, uint>::iterator it = m_metricMap.find(nm);
+  if (it != m_metricMap.end()) {
+    return it->second;
+  }
+  uint id = m_metricNames.size();
+  m_metricNames.push_back(nm);
+  m_metricMap.insert(std::make_pair(nm, id));
+  m_excl.push_back(std::vector<double>());
+  return id;
+}
+
+
+// merge: Map the nodes of 'cct' to keys, creating keys as needed, and
+// add their exclusive values.
+void
+TopN::merge(const FileCCT& cct)
+{
+  std::vector<uint> lmIds(cct.lmNames.size());
+  for (uint i = 0; i < cct.lmNames.size(); ++i) {
+    lmIds[i] = internLM(cct.lmNames[i]);
+  }
+  std::vector<uint> metricIds(cct.metricNames.size());
+  for (uint i = 0; i < cct.metricNames.size(); ++i) {
+    metricIds[i] = internMetric(cct.metricNames[i]);
+  }
+
+  std::vector<uint> keys(cct.parent.size());
+  for (uint i = 0; i < cct.parent.size(); ++i) {
+    uint parent = (cct.parent[i] == NoKey) ? NoKey : keys[cct.parent[i]];
+    Key key(parent, lmIds[cct.lm[i]], cct.ip[i]);
+
+    uint id;
+    std::unordered_map<Key, uint, KeyHash>::iterator it = m_keyMap.find(key);
+    if (it != m_keyMap.end()) {
+      id = it->second;
+    }
+    else {
+      id = m_keys.size();
+      m_keys.push_back(key);
+      m_keyMap.insert(std::make_pair(key, id));
+    }
+    keys[i] = id;
+
+    for (uint v = cct.valBeg[i]; v < cct.valBeg[i + 1]; ++v) {
+      std::vector<double>& col = m_excl[metricIds[cct.vals[v].first]];
+      if (col.size() <= id) {
+	col.resize(m_keys.size(), 0.0);
+      }
+      col[id] += cct.vals[v].second;
+    }
+  }
+
+  m_numProfiles++;
+}
+
+
+//****************************************************************************
+
+void
+TopN::write(std::ostream& os) const
+{
+  uint numKeys = m_keys.size();
+
+  // upLM[k]: the nearest proper ancestor of k whose load module is not
+  // k's, so that finding a load module among k's ancestors skips whole
+  // runs of frames in other load modules.
+  std::vector<uint> upLM;
+  if (m_keyTy == KeyTy_LM) {
+    upLM.resize(numKeys);
+    for (uint k = 0; k < numKeys; ++k) {
+      uint p = m_keys[k].parent;
+      if (p == NoKey || m_keys[p].lm != m_keys[k].lm) {
+	upLM[k] = p;
+      }
+      else {
+	upLM[k] = upLM[p];
+      }
+    }
+  }
+
+  os << "Top " << m_n << ((m_keyTy == KeyTy_LM) ? " load modules" : " call paths")
+     << " over " << m_numProfiles << " profile(s)" << std::endl;
+
+  for (uint mId = 0; mId < m_metricNames.size(); ++mId) {
+    // inclusive values, by a reverse sweep (parents precede children)
+    std::vector<double> incl(m_excl[mId]);
+    incl.resize(numKeys, 0.0);
+    for (uint k = numKeys; k-- > 0; ) {
+      uint p = m_keys[k].parent;
+      if (p != NoKey) {
+	incl[p] += incl[k];
+      }
+    }
+
+    // A load module's inclusive value counts only its outermost
+    // frames, so that recursion through it is not counted twice.
+    std::vector<double> exclLM, inclLM;
+    if (m_keyTy == KeyTy_LM) {
+      exclLM.resize(m_lmNames.size(), 0.0);
+      inclLM.resize(m_lmNames.size(), 0.0);
+      const std::vector<double>& excl = m_excl[mId];
+      for (uint k = 0; k < numKeys; ++k) {
+	uint lm = m_keys[k].lm;
+	if (lm == 0) {
+	  continue;
+	}
+	if (k < excl.size()) {
+	  exclLM[lm] += excl[k];
+	}
+
+	uint p = m_keys[k].parent;
+	while (p != NoKey && m_keys[p].lm != lm) {
+	  p = upLM[p];
+	}
+	if (p == NoKey) {
+	  inclLM[lm] += incl[k];
+	}
+      }
+    }
+
+    writeMetric(os, mId, incl, exclLM, inclLM);
+  }
+}
+
+
+void
+TopN::writeMetric(std::ostream& os, uint mId, const std::vector<double>& incl,
+		  const std::vector<double>& exclLM,
+		  const std::vector<double>& inclLM) const
+{
+  const std::vector<double>& excl = m_excl[mId];
+
+  double total = 0.0;
+  for (uint k = 0; k < excl.size(); ++k) {
+    total += excl[k];
+  }
+
+  os << std::endl << m_metricNames[mId] << " (total: " << total << ")"
+     << std::endl;
+
+  for (int isIncl = 0; isIncl <= 1; ++isIncl) {
+    const std::vector<double>& vals = (m_keyTy == KeyTy_LM)
+      ? (isIncl ? inclLM : exclLM) : (isIncl ? incl : excl);
+
+    os << (isIncl ? "  inclusive:" : "  exclusive:") << std::endl;
+
+    std::vector<uint> top = topIndices(vals);
+    for (uint i = 0; i < top.size(); ++i) {
+      writeEntry(os, i + 1, top[i], vals[top[i]], total);
+    }
+  }
+}
+
+
+// topIndices: Return the indices of the (at most) m_n largest nonzero
+// values, largest first; ties are broken by name (cf. keyLess()), so
+// that the ranking does not depend on the order of the inputs.  The NULL load
+// module, and the synthetic roots, whose inclusive value is always
+// the total, are not ranked.
+std::vector<uint>
+TopN::topIndices(const std::vector<double>& vals) const
+{
+  std::vector<uint> idx;
+  for (uint i = 0; i < vals.size(); ++i) {
+    uint lm = (m_keyTy == KeyTy_LM) ? i : m_keys[i].lm;
+    if (vals[i] != 0.0 && lm != 0) {
+      idx.push_back(i);
+    }
+  }
+
+  struct Cmp {
+    Cmp(const TopN& t, const std::vector<double>& v) : topN(t), vals(v) { }
+    bool operator()(uint x, uint y) const
+      { return (vals[x] > vals[y])
+	  || (vals[x] == vals[y] && topN.keyLess(x, y)); }
+    const TopN& topN;
+    const std::vector<double>& vals;
+  };
+
+  uint sz = std::min((uint)idx.size(), m_n);
+  std::partial_sort(idx.begin(), idx.begin() + sz, idx.end(),
+		    Cmp(*this, vals));
+  idx.resize(sz);
+  return idx;
+}
+
+
+// keyLess: Order load modules by name, and call paths by their frames
+// (load module name, ip), innermost first.  Unlike ids, this does not
+// depend on the order in which the profiles were merged.
+bool
+TopN::keyLess(uint x, uint y) const
+{
+  if (m_keyTy == KeyTy_LM) {
+    return m_lmNames[x] < m_lmNames[y];
+  }
+
+  while (x != y) {
+    if (x == NoKey || y == NoKey) {
+      return (x == NoKey); // the shorter path first
+    }
+    const Key& kx = m_keys[x];
+    const Key& ky = m_keys[y];
+    if (kx.lm != ky.lm) {
+      return m_lmNames[kx.lm] < m_lmNames[ky.lm];
+    }
+    if (kx.ip != ky.ip) {
+      return kx.ip < ky.ip;
+    }
+    x = kx.parent;
+    y = ky.parent;
+  }
+  return false;
+}
+
+
+// writeEntry: Write one ranked entry: a load module name, or a call
+// path as its frames, innermost first.
+void
+TopN::writeEntry(std::ostream& os, uint rank, uint key, double val,
+		 double total) const
+{
+  char buf[64];
+  double pct = (total != 0.0) ? (100.0 * val / total) : 0.0;
+  snprintf(buf, sizeof(buf), "  %4u. %13.6g %6.1f%%  ", rank, val, pct);
+  os << buf;
+
+  if (m_keyTy == KeyTy_LM) {
+    os << m_lmNames[key] << std::endl;
+    return;
+  }
+
+  uint numFrames = 0;
+  for (uint k = key; k != NoKey; k = m_keys[k].parent) {
+    const Key& frame = m_keys[k];
+    if (frame.lm == 0) {
+      continue; // a synthetic root
+    }
+    if (numFrames == MaxFramesToPrint) {
+      os << " <- ...";
+      break;
+    }
+    snprintf(buf, sizeof(buf), "+0x%" PRIx64, frame.ip);
+    os << ((numFrames > 0) ? " <- " : "")
+       << FileUtil::basename(m_lmNames[frame.lm]) << buf;
+    numFrames++;
+  }
+  os << std::endl;
+}
+
+} // namespace Raw
+
+} // namespace Analysis
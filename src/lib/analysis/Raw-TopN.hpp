@@ -0,0 +1,208 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// class Analysis::Raw::TopN
+//
+// A streaming query over hpcrun call path profiles: for each metric,
+// report the N call paths (or load modules) with the largest
+// exclusive and inclusive values, summed over all profiles.
+//
+// Profiles are read node by node with hpcrun_fmt_cct_node_fread();
+// no Prof::CallPath::Profile is built and no load module is opened.
+// A call path is identified across profiles by its chain of (load
+// module name, normalized ip) frames, so this is a quick triage tool,
+// not a substitute for hpcprof's procedure- and loop-level view.
+//
+//***************************************************************************
+
+#ifndef Analysis_Raw_TopN_hpp
+#define Analysis_Raw_TopN_hpp
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+//*************************** Forward Declarations ***************************
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace Raw {
+
+class TopN
+{
+public:
+  enum KeyTy {
+    KeyTy_Path, // call paths
+    KeyTy_LM    // load modules
+  };
+
+  TopN(uint n, KeyTy keyTy);
+  ~TopN();
+
+  // add: Stream 'profileFiles' into the query, using up to
+  // 'numThreads' threads.  The result is as if the profiles were
+  // added one by one, in order.  A profile that can't be read is
+  // skipped with a warning.
+  void
+  add(const std::vector<std::string>& profileFiles, uint numThreads = 1);
+
+  // addFile: Stream one profile into the query.  May be called
+  // concurrently, though then the order of merging (and hence
+  // floating point rounding) depends on the callers; throws on a read
+  // error.
+  void
+  addFile(const char* filenm);
+
+  void
+  write(std::ostream& os) const;
+
+private:
+  TopN(const TopN& x);
+
+  TopN&
+  operator=(const TopN& x);
+
+  static const uint NoKey = (uint)-1;
+
+  // A call path frame: the path of 'parent' extended by (lm, ip).
+  // Keys are numbered in order of creation, so a parent's key is
+  // always less than its children's.
+  struct Key {
+    Key(uint parent_, uint lm_, uint64_t ip_)
+      : parent(parent_), lm(lm_), ip(ip_)
+      { }
+
+    bool
+    operator==(const Key& x) const
+      { return (parent == x.parent && lm == x.lm && ip == x.ip); }
+
+    uint parent;
+    uint lm;      // index into m_lmNames; 0 is the NULL load module
+    uint64_t ip;
+  };
+
+  struct KeyHash {
+    size_t
+    operator()(const Key& x) const
+      { return (x.ip * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)x.parent << 16)
+	  ^ x.lm; }
+  };
+
+  struct FileCCT;
+
+  // N.B.: <mutex> is not included here: it does not survive the
+  // 'epsilon' macro of lib/prof/Metric-AExprIncr.hpp.
+  struct Lock;
+
+  void
+  readFile(const char* filenm, FileCCT& cct);
+
+  uint
+  internLM(const std::string& nm);
+
+  uint
+  internMetric(const std::string& nm);
+
+  void
+  merge(const FileCCT& cct);
+
+  void
+  writeMetric(std::ostream& os, uint mId, const std::vector<double>& incl,
+	      const std::vector<double>& exclLM,
+	      const std::vector<double>& inclLM) const;
+
+  std::vector<uint>
+  topIndices(const std::vector<double>& vals) const;
+
+  bool
+  keyLess(uint x, uint y) const;
+
+  void
+  writeEntry(std::ostream& os, uint rank, uint key, double val,
+	     double total) const;
+
+private:
+  uint m_n;
+  KeyTy m_keyTy;
+
+  std::vector<std::string> m_lmNames;
+  std::map<std::string, uint> m_lmMap;
+
+  std::vector<std::string> m_metricNames;
+  std::map<std::string, uint> m_metricMap;
+
+  std::vector<Key> m_keys;
+  std::unordered_map<Key, uint, KeyHash> m_keyMap;
+
+  // exclusive values: [metric][key]
+  std::vector<std::vector<double> > m_excl;
+
+  uint m_numProfiles;
+
+  Lock* m_lock;
+};
+
+} // namespace Raw
+
+} // namespace Analysis
+
+//****************************************************************************
+
+#endif // Analysis_Raw_TopN_hpp
@@ -0,0 +1,804 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+#include <fstream>
+#include <string>
+using std::string;
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include "Raw-TraceStats.hpp"
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/xml/xml.hpp>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+#include <lib/support/StrUtil.hpp>
+
+//*************************** Forward Declarations ***************************
+
+// An interval longer than this many times a rank's median sampling
+// interval is a gap.
+static const uint GapFactor = 10;
+
+// the most intervals sampled to estimate the median
+static const uint MedianSampleSz = 4096;
+
+// the most procedures (call path ids) to print
+static const uint MaxKeysToPrint = 20;
+
+// the key of a call path id that is not in the database
+static const uint32_t UnknownKey = (uint32_t)-1;
+
+static const char BinaryMagic[]   = "HPCTRACE-stats__"; // 16 bytes
+static const char BinaryVersion[] = "01.00";            // 5 bytes
+
+static void
+readExperimentXML(const string& fnm,
+		  std::unordered_map<uint32_t, uint32_t>& cpIdToProc,
+		  std::map<uint32_t, string>& procNames);
+
+//****************************************************************************
+
+namespace {
+
+// A trace file, mapped read-only (cf. hpctrace_fmt_hdr_fread() and
+// hpctrace_fmt_datum_fread(): records are big-endian).
+class TraceFile
+{
+public:
+  TraceFile()
+    : m_addr(NULL), m_sz(0), m_recs(NULL), m_recSz(0), m_numRecs(0)
+    { }
+
+  ~TraceFile()
+    { if (m_addr) { munmap(m_addr, m_sz); } }
+
+  // open: Map 'fnm' and check its header.  Throws on error.
+  void
+  open(const string& fnm)
+  {
+    int fd = ::open(fnm.c_str(), O_RDONLY);
+    if (fd < 0) {
+      DIAG_Throw("error opening trace file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      DIAG_Throw("error opening trace file");
+    }
+
+    m_sz = st.st_size;
+    if (m_sz >= (size_t)HPCTRACE_FMT_HeaderLen) {
+      m_addr = mmap(NULL, m_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m_addr == MAP_FAILED) {
+	m_addr = NULL;
+      }
+    }
+    close(fd);
+    if (!m_addr) {
+      DIAG_Throw("not a trace file, or it is truncated");
+    }
+    madvise(m_addr, m_sz, MADV_SEQUENTIAL);
+
+    const unsigned char* p = (const unsigned char*)m_addr;
+    if (memcmp(p, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) != 0) {
+      DIAG_Throw("not a trace file");
+    }
+    p += HPCTRACE_FMT_MagicLen;
+
+    // version 1.00 has no flags
+    size_t hdrSz = HPCTRACE_FMT_HeaderLen;
+    hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+    if (memcmp(p, "01.00", HPCTRACE_FMT_VersionLen) == 0) {
+      hdrSz -= HPCTRACE_FMT_FlagsLen;
+    }
+    else {
+      p += HPCTRACE_FMT_VersionLen + HPCTRACE_FMT_EndianLen;
+      flags.bits = be8(p);
+    }
+
+    m_recSz = 12 + (flags.fields.isDataCentric ? 4 : 0);
+    m_recs = (const unsigned char*)m_addr + hdrSz;
+    m_numRecs = (m_sz - hdrSz) / m_recSz;
+  }
+
+  uint64_t
+  numRecs() const
+    { return m_numRecs; }
+
+  uint64_t
+  time(uint64_t i) const
+    { return be8(m_recs + i * m_recSz); }
+
+  uint32_t
+  cpId(uint64_t i) const
+    { return be4(m_recs + i * m_recSz + 8); }
+
+private:
+  static uint64_t
+  be8(const unsigned char* p)
+    { return ((uint64_t)be4(p) << 32) | be4(p + 4); }
+
+  static uint32_t
+  be4(const unsigned char* p)
+    { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	| ((uint32_t)p[2] << 8) | p[3]; }
+
+  void* m_addr;
+  size_t m_sz;
+
+  const unsigned char* m_recs;
+  size_t m_recSz;
+  uint64_t m_numRecs;
+};
+
+} // namespace
+
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace Raw {
+
+TraceStats::TraceStats(uint numPhases)
+  : m_numPhases(std::max(numPhases, 1u)), m_haveDB(false),
+    m_begTime(0), m_endTime(0), m_numRanksOK(0)
+{
+}
+
+
+TraceStats::~TraceStats()
+{
+}
+
+
+void
+TraceStats::readDB(const string& dbDir)
+{
+  string fnm = dbDir + "/experiment.xml";
+  readExperimentXML(fnm, m_cpIdToProc, m_procNames);
+  m_haveDB = true;
+}
+
+
+void
+TraceStats::add(const std::vector<string>& traceFiles, uint numThreads)
+{
+  m_ranks.clear();
+  m_ranks.resize(traceFiles.size());
+
+  // First pass: the time span of all ranks, for the phases
+  std::vector<uint64_t> begTimes(traceFiles.size(), 0);
+  std::vector<uint64_t> endTimes(traceFiles.size(), 0);
+
+#pragma omp parallel for  num_threads(numThreads)  schedule(dynamic, 1)
+  for (uint i = 0; i < traceFiles.size(); i++) {
+    Rank& rank = m_ranks[i];
+    rank.name = FileUtil::basename(traceFiles[i]);
+    try {
+      TraceFile trace;
+      trace.open(traceFiles[i]);
+      rank.numSamples = trace.numRecs();
+      if (rank.numSamples > 0) {
+	rank.begTime = trace.time(0);
+	rank.endTime = trace.time(rank.numSamples - 1);
+      }
+    }
+    catch (const Diagnostics::Exception& x) {
+      rank.error = x.what();
+    }
+  }
+
+  bool isFirst = true;
+  for (uint i = 0; i < m_ranks.size(); i++) {
+    const Rank& rank = m_ranks[i];
+    if (rank.error.empty() && rank.numSamples > 0) {
+      m_begTime = isFirst ? rank.begTime : std::min(m_begTime, rank.begTime);
+      m_endTime = isFirst ? rank.endTime : std::max(m_endTime, rank.endTime);
+      isFirst = false;
+    }
+  }
+
+  // Second pass: the statistics of each rank
+#pragma omp parallel for  num_threads(numThreads)  schedule(dynamic, 1)
+  for (uint i = 0; i < traceFiles.size(); i++) {
+    Rank& rank = m_ranks[i];
+    if (rank.error.empty()) {
+      try {
+	analyze(rank, traceFiles[i]);
+      }
+      catch (const Diagnostics::Exception& x) {
+	rank.error = x.what();
+      }
+    }
+  }
+
+  string errors;
+  m_numRanksOK = 0;
+  for (uint i = 0; i < m_ranks.size(); i++) {
+    if (m_ranks[i].error.empty()) {
+      m_numRanksOK++;
+    }
+    else {
+      errors += "  " + traceFiles[i] + ": " + m_ranks[i].error + "\n";
+    }
+  }
+  if (!errors.empty()) {
+    DIAG_WMsgIf(1, "Skipped traces that could not be read:\n" << errors);
+  }
+}
+
+
+void
+TraceStats::analyze(Rank& rank, const string& fnm) const
+{
+  TraceFile trace;
+  trace.open(fnm);
+
+  uint64_t n = trace.numRecs();
+  rank.numSamples = n;
+  rank.phaseTime.resize(m_numPhases);
+  if (n == 0) {
+    return;
+  }
+  rank.begTime = trace.time(0);
+  rank.endTime = trace.time(n - 1);
+
+  // A gap is an interval much longer than the median, estimated from
+  // evenly spaced intervals.
+  std::vector<uint64_t> dts;
+  uint64_t stride = std::max((n - 1) / MedianSampleSz, (uint64_t)1);
+  for (uint64_t i = 0; i + 1 < n; i += stride) {
+    uint64_t t0 = trace.time(i), t1 = trace.time(i + 1);
+    dts.push_back((t1 > t0) ? (t1 - t0) : 0);
+  }
+  uint64_t gapLimit = UINT64_MAX;
+  if (!dts.empty()) {
+    std::nth_element(dts.begin(), dts.begin() + dts.size() / 2, dts.end());
+    gapLimit = GapFactor * std::max(dts[dts.size() / 2], (uint64_t)1);
+  }
+
+  // Charge each interval to its sample's key and phase.  Consecutive
+  // samples usually have the same key, so sum runs before touching
+  // the maps.
+  uint32_t runCpId = 0, runKey = 0;
+  uint runPhase = 0;
+  uint64_t runTime = 0;
+
+  for (uint64_t i = 0; i + 1 < n; i++) {
+    uint64_t t0 = trace.time(i), t1 = trace.time(i + 1);
+    if (t1 <= t0) {
+      continue;
+    }
+    uint64_t dt = t1 - t0;
+    if (dt > gapLimit) {
+      rank.numGaps++;
+      rank.gapTime += dt;
+      rank.maxGap = std::max(rank.maxGap, dt);
+      continue;
+    }
+
+    uint32_t cpId = trace.cpId(i);
+    uint ph = phase(t0);
+    if (runTime == 0 || cpId != runCpId || ph != runPhase) {
+      if (runTime > 0) {
+	rank.time[runKey] += runTime;
+	rank.phaseTime[runPhase][runKey] += runTime;
+      }
+      runCpId = cpId;
+      runKey = key(cpId);
+      runPhase = ph;
+      runTime = 0;
+    }
+    runTime += dt;
+  }
+  if (runTime > 0) {
+    rank.time[runKey] += runTime;
+    rank.phaseTime[runPhase][runKey] += runTime;
+  }
+}
+
+
+// key: the procedure of 'cpId' with a database, else 'cpId' itself
+uint32_t
+TraceStats::key(uint32_t cpId) const
+{
+  if (!m_haveDB) {
+    return cpId;
+  }
+  std::unordered_map<uint32_t, uint32_t>::const_iterator it =
+    m_cpIdToProc.find(cpId);
+  return (it != m_cpIdToProc.end()) ? it->second : UnknownKey;
+}
+
+
+string
+TraceStats::keyName(uint32_t key) const
+{
+  if (!m_haveDB) {
+    return "cpid " + StrUtil::toStr(key);
+  }
+  std::map<uint32_t, string>::const_iterator it = m_procNames.find(key);
+  if (it != m_procNames.end()) {
+    return it->second;
+  }
+  return (key == UnknownKey) ? "<unknown call path>"
+    : "<procedure " + StrUtil::toStr(key) + ">";
+}
+
+
+uint
+TraceStats::phase(uint64_t time) const
+{
+  double span = (double)(m_endTime - m_begTime) + 1.0;
+  uint i = (uint)((double)(time - m_begTime) / span * m_numPhases);
+  return std::min(i, m_numPhases - 1);
+}
+
+
+uint64_t
+TraceStats::phaseBeg(uint i) const
+{
+  double span = (double)(m_endTime - m_begTime) + 1.0;
+  return m_begTime + (uint64_t)(span * i / m_numPhases);
+}
+
+
+void
+TraceStats::sumKeys(std::map<uint32_t, uint64_t>& time) const
+{
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const KeyTimeMap& rtime = m_ranks[r].time;
+    for (KeyTimeMap::const_iterator it = rtime.begin(); it != rtime.end(); ++it) {
+      time[it->first] += it->second;
+    }
+  }
+}
+
+
+void
+TraceStats::sumPhase(uint i, std::map<uint32_t, PhaseKey>& time) const
+{
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const Rank& rank = m_ranks[r];
+    if (!rank.error.empty()) {
+      continue;
+    }
+    const KeyTimeMap& rtime = rank.phaseTime[i];
+    for (KeyTimeMap::const_iterator it = rtime.begin(); it != rtime.end(); ++it) {
+      PhaseKey& x = time[it->first];
+      x.sum += it->second;
+      x.max = std::max(x.max, it->second);
+    }
+  }
+}
+
+
+//****************************************************************************
+
+static string
+csvStr(const string& x)
+{
+  string y = "\"";
+  for (uint i = 0; i < x.size(); i++) {
+    y += x[i];
+    if (x[i] == '"') {
+      y += '"';
+    }
+  }
+  return y + "\"";
+}
+
+
+static std::vector<std::pair<uint64_t, uint32_t> >
+sortByTime(const std::map<uint32_t, uint64_t>& time)
+{
+  std::vector<std::pair<uint64_t, uint32_t> > x;
+  for (std::map<uint32_t, uint64_t>::const_iterator it = time.begin();
+       it != time.end(); ++it) {
+    x.push_back(std::make_pair(it->second, it->first));
+  }
+  // largest time first; ties go to the lower key
+  std::sort(x.begin(), x.end(),
+	    [](const std::pair<uint64_t, uint32_t>& a,
+	       const std::pair<uint64_t, uint32_t>& b) {
+	      return (a.first > b.first)
+		|| (a.first == b.first && a.second < b.second);
+	    });
+  return x;
+}
+
+
+void
+TraceStats::write(std::ostream& os) const
+{
+  char buf[128];
+
+  os << "Trace statistics: " << m_numRanksOK << " rank(s), time ["
+     << m_begTime << ", " << m_endTime << "]" << std::endl;
+
+  os << std::endl << "Ranks:" << std::endl;
+  snprintf(buf, sizeof(buf), "  %10s %16s %16s %8s %12s %12s  %s",
+	   "samples", "begin", "end", "gaps", "gap-time", "max-gap", "trace");
+  os << buf << std::endl;
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const Rank& rank = m_ranks[r];
+    if (!rank.error.empty()) {
+      continue;
+    }
+    snprintf(buf, sizeof(buf), "  %10lu %16lu %16lu %8lu %12lu %12lu  ",
+	     (unsigned long)rank.numSamples, (unsigned long)rank.begTime,
+	     (unsigned long)rank.endTime, (unsigned long)rank.numGaps,
+	     (unsigned long)rank.gapTime, (unsigned long)rank.maxGap);
+    os << buf << rank.name << std::endl;
+  }
+
+  std::map<uint32_t, uint64_t> time;
+  sumKeys(time);
+  std::vector<std::pair<uint64_t, uint32_t> > top = sortByTime(time);
+
+  uint64_t total = 0;
+  for (uint i = 0; i < top.size(); i++) {
+    total += top[i].first;
+  }
+
+  os << std::endl << (m_haveDB ? "Procedures" : "Call path ids")
+     << " (time summed over ranks):" << std::endl;
+  for (uint i = 0; i < top.size() && i < MaxKeysToPrint; i++) {
+    double pct = (total > 0) ? (100.0 * top[i].first / total) : 0.0;
+    snprintf(buf, sizeof(buf), "  %16lu %6.1f%%  ",
+	     (unsigned long)top[i].first, pct);
+    os << buf << keyName(top[i].second) << std::endl;
+  }
+
+  os << std::endl << "Phases (" << m_numPhases << " of equal length; the "
+     << (m_haveDB ? "procedure" : "call path id")
+     << " with the most time in each):" << std::endl;
+  snprintf(buf, sizeof(buf), "  %5s %16s %16s %16s %9s  %s",
+	   "phase", "begin", "end", "time", "max/mean", "name");
+  os << buf << std::endl;
+  for (uint i = 0; i < m_numPhases && m_numRanksOK > 0; i++) {
+    std::map<uint32_t, PhaseKey> ptime;
+    sumPhase(i, ptime);
+
+    uint32_t maxKey = 0;
+    PhaseKey maxTime;
+    for (std::map<uint32_t, PhaseKey>::const_iterator it = ptime.begin();
+	 it != ptime.end(); ++it) {
+      if (it->second.sum > maxTime.sum) {
+	maxKey = it->first;
+	maxTime = it->second;
+      }
+    }
+    if (maxTime.sum == 0) {
+      continue;
+    }
+    double mean = (double)maxTime.sum / m_numRanksOK;
+    snprintf(buf, sizeof(buf), "  %5u %16lu %16lu %16lu %9.2f  ", i,
+	     (unsigned long)phaseBeg(i), (unsigned long)phaseBeg(i + 1),
+	     (unsigned long)maxTime.sum, maxTime.max / mean);
+    os << buf << keyName(maxKey) << std::endl;
+  }
+}
+
+
+void
+TraceStats::writeCSV(const string& pfx) const
+{
+  string fnm = pfx + "-ranks.csv";
+  std::ofstream os(fnm.c_str());
+  if (!os) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  os << "rank,trace,samples,begin,end,gaps,gap_time,max_gap\n";
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const Rank& rank = m_ranks[r];
+    if (rank.error.empty()) {
+      os << r << "," << csvStr(rank.name) << "," << rank.numSamples << ","
+	 << rank.begTime << "," << rank.endTime << "," << rank.numGaps << ","
+	 << rank.gapTime << "," << rank.maxGap << "\n";
+    }
+  }
+  os.close();
+
+  fnm = pfx + "-time.csv";
+  os.open(fnm.c_str());
+  if (!os) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  os << "rank,key,name,time\n";
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const Rank& rank = m_ranks[r];
+    std::map<uint32_t, uint64_t> time(rank.time.begin(), rank.time.end());
+    for (std::map<uint32_t, uint64_t>::const_iterator it = time.begin();
+	 it != time.end(); ++it) {
+      os << r << "," << it->first << "," << csvStr(keyName(it->first)) << ","
+	 << it->second << "\n";
+    }
+  }
+  os.close();
+
+  fnm = pfx + "-phases.csv";
+  os.open(fnm.c_str());
+  if (!os) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+  os << "phase,begin,end,key,name,sum,max,mean,imbalance\n";
+  for (uint i = 0; i < m_numPhases && m_numRanksOK > 0; i++) {
+    std::map<uint32_t, PhaseKey> ptime;
+    sumPhase(i, ptime);
+    for (std::map<uint32_t, PhaseKey>::const_iterator it = ptime.begin();
+	 it != ptime.end(); ++it) {
+      double mean = (double)it->second.sum / m_numRanksOK;
+      os << i << "," << phaseBeg(i) << "," << phaseBeg(i + 1) << ","
+	 << it->first << "," << csvStr(keyName(it->first)) << ","
+	 << it->second.sum << "," << it->second.max << "," << mean << ","
+	 << (it->second.max / mean) << "\n";
+    }
+  }
+  os.close();
+}
+
+
+// The binary summary, in hpcfmt's big-endian encoding:
+//   magic (16 bytes), version (5 bytes)
+//   num-keys (int4), then per key: key (int4), name (str)
+//   num-ranks (int4), then per rank: trace name (str), samples, begin,
+//     end, gaps, gap-time, max-gap (int8 each), num-entries (int4),
+//     then per entry: key index (int4), time (int8)
+void
+TraceStats::writeBinary(const string& fnm) const
+{
+  FILE* fs = fopen(fnm.c_str(), "w");
+  if (!fs) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+
+  std::map<uint32_t, uint64_t> time;
+  sumKeys(time);
+
+  std::map<uint32_t, uint32_t> keyIdx;
+  fwrite(BinaryMagic, 1, sizeof(BinaryMagic) - 1, fs);
+  fwrite(BinaryVersion, 1, sizeof(BinaryVersion) - 1, fs);
+  hpcfmt_int4_fwrite(time.size(), fs);
+  for (std::map<uint32_t, uint64_t>::const_iterator it = time.begin();
+       it != time.end(); ++it) {
+    uint32_t idx = keyIdx.size();
+    keyIdx[it->first] = idx;
+    hpcfmt_int4_fwrite(it->first, fs);
+    hpcfmt_str_fwrite(keyName(it->first).c_str(), fs);
+  }
+
+  hpcfmt_int4_fwrite(m_numRanksOK, fs);
+  for (uint r = 0; r < m_ranks.size(); r++) {
+    const Rank& rank = m_ranks[r];
+    if (!rank.error.empty()) {
+      continue;
+    }
+    hpcfmt_str_fwrite(rank.name.c_str(), fs);
+    hpcfmt_int8_fwrite(rank.numSamples, fs);
+    hpcfmt_int8_fwrite(rank.begTime, fs);
+    hpcfmt_int8_fwrite(rank.endTime, fs);
+    hpcfmt_int8_fwrite(rank.numGaps, fs);
+    hpcfmt_int8_fwrite(rank.gapTime, fs);
+    hpcfmt_int8_fwrite(rank.maxGap, fs);
+
+    std::map<uint32_t, uint64_t> rtime(rank.time.begin(), rank.time.end());
+    hpcfmt_int4_fwrite(rtime.size(), fs);
+    for (std::map<uint32_t, uint64_t>::const_iterator it = rtime.begin();
+	 it != rtime.end(); ++it) {
+      hpcfmt_int4_fwrite(keyIdx[it->first], fs);
+      hpcfmt_int8_fwrite(it->second, fs);
+    }
+  }
+
+  if (ferror(fs) | fclose(fs)) {
+    DIAG_Throw("error writing '" << fnm << "'");
+  }
+}
+
+} // namespace Raw
+
+} // namespace Analysis
+
+
+//****************************************************************************
+
+// attr: The value of attribute 'nm' in the attribute text 'attrs'
+// (cf. xml::MakeAttrStr()), or false if there is none.
+static bool
+attr(const string& attrs, const char* nm, string& val)
+{
+  string pat = string(" ") + nm + "=\"";
+  size_t beg = attrs.find(pat);
+  if (beg == string::npos) {
+    return false;
+  }
+  beg += pat.size();
+  size_t end = attrs.find('"', beg);
+  if (end == string::npos) {
+    return false;
+  }
+  val = attrs.substr(beg, end - beg);
+  return true;
+}
+
+
+// nextTag: Read the next tag of 'is' into 'tag', without its '<' and
+// '>', and return false at the end of the stream.  Text between tags
+// is skipped.
+static bool
+nextTag(std::istream& is, string& tag)
+{
+  while (std::getline(is, tag, '>')) {
+    size_t beg = tag.rfind('<');
+    if (beg != string::npos) {
+      tag.erase(0, beg + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// readExperimentXML: Read the procedure table and, for each trace id
+// ('it') of the CCT, its innermost procedure frame (PF) or inlined
+// procedure (Pr).  experiment.xml is written by hpcprof and is
+// regular, so it is streamed tag by tag rather than parsed with
+// Xerces, and only up to the end of the CCT.
+static void
+readExperimentXML(const string& fnm,
+		  std::unordered_map<uint32_t, uint32_t>& cpIdToProc,
+		  std::map<uint32_t, string>& procNames)
+{
+  std::ifstream is(fnm.c_str());
+  if (!is) {
+    DIAG_Throw("error opening '" << fnm << "'");
+  }
+
+  string tag;
+
+  // skip the DTD, whose declarations look like tags
+  bool isExperiment = false;
+  while (!isExperiment && nextTag(is, tag)) {
+    isExperiment = (tag.compare(0, 20, "HPCToolkitExperiment") == 0);
+  }
+  if (!isExperiment) {
+    DIAG_Throw("'" << fnm << "' is not an HPCToolkit experiment");
+  }
+
+  // the procedure of each open element of the CCT
+  std::vector<uint32_t> procStack;
+  bool inCCT = false;
+
+  while (nextTag(is, tag)) {
+    if (tag.empty()) {
+      continue;
+    }
+    bool isClose = (tag[0] == '/');
+    bool isEmpty = (tag[tag.size() - 1] == '/');
+    size_t nmBeg = isClose ? 1 : 0;
+    size_t nmEnd = tag.find_first_of(" /", nmBeg);
+    if (nmEnd == string::npos) {
+      nmEnd = tag.size();
+    }
+    string nm = tag.substr(nmBeg, nmEnd - nmBeg);
+    string attrs = tag.substr(nmEnd);
+
+    if (nm == "SecCallPathProfileData") {
+      if (isClose) {
+	break; // nothing more is needed
+      }
+      inCCT = true;
+      continue;
+    }
+
+    if (!inCCT) {
+      string id, name;
+      if (nm == "Procedure" && !isClose && attr(attrs, "i", id)
+	  && attr(attrs, "n", name)) {
+	procNames[strtoul(id.c_str(), NULL, 10)] = xml::UnEscapeStr(name);
+      }
+      continue;
+    }
+
+    if (isClose) {
+      if (!procStack.empty()) {
+	procStack.pop_back();
+      }
+      continue;
+    }
+
+    uint32_t proc = procStack.empty() ? UnknownKey : procStack.back();
+    string val;
+    if ((nm == "PF" || nm == "Pr") && attr(attrs, "n", val)) {
+      proc = strtoul(val.c_str(), NULL, 10);
+    }
+    if (attr(attrs, "it", val)) {
+      cpIdToProc[strtoul(val.c_str(), NULL, 10)] = proc;
+    }
+    if (!isEmpty) {
+      procStack.push_back(proc);
+    }
+  }
+
+  if (is.bad()) {
+    DIAG_Throw("error reading '" << fnm << "'");
+  }
+}
@@ -0,0 +1,201 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// class Analysis::Raw::TraceStats
+//
+// Aggregate statistics over hpctrace files, one per rank (or thread):
+//  - the time spent in each call path id, or with a database, in each
+//    procedure (the innermost procedure frame of the call path);
+//  - the same per phase, where the run is cut into phases of equal
+//    length, and the imbalance (max / mean over ranks) of each;
+//  - sampling gaps: intervals much longer than the rank's typical
+//    sampling interval.
+//
+// A trace sample's call path is charged with the time until the next
+// sample of the rank, and the whole interval goes to the phase in
+// which it begins.  A gap is not charged to any call path.
+//
+// Trace files are mapped read-only and ranks are processed in
+// parallel; each rank's results are kept separately, so the output
+// does not depend on the number of threads.
+//
+//***************************************************************************
+
+#ifndef Analysis_Raw_TraceStats_hpp
+#define Analysis_Raw_TraceStats_hpp
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+//*************************** Forward Declarations ***************************
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace Raw {
+
+class TraceStats
+{
+public:
+  TraceStats(uint numPhases);
+  ~TraceStats();
+
+  // readDB: Map call path ids to procedures using the experiment.xml
+  // of database 'dbDir', whose traces are to be analyzed.
+  void
+  readDB(const std::string& dbDir);
+
+  // add: Analyze 'traceFiles', using up to 'numThreads' threads.  A
+  // trace that can't be read is skipped with a warning.  (The phases
+  // span the traces of one call.)
+  void
+  add(const std::vector<std::string>& traceFiles, uint numThreads = 1);
+
+  // write: Write a text summary
+  void
+  write(std::ostream& os) const;
+
+  // writeCSV: Write 'pfx'-ranks.csv, 'pfx'-time.csv and
+  // 'pfx'-phases.csv
+  void
+  writeCSV(const std::string& pfx) const;
+
+  // writeBinary: Write the per-rank statistics and times (without
+  // phases) to 'fnm' in a compact big-endian format: see the .cpp.
+  void
+  writeBinary(const std::string& fnm) const;
+
+private:
+  TraceStats(const TraceStats& x);
+
+  TraceStats&
+  operator=(const TraceStats& x);
+
+  typedef std::unordered_map<uint32_t, uint64_t> KeyTimeMap;
+
+  struct Rank {
+    Rank()
+      : numSamples(0), begTime(0), endTime(0),
+	numGaps(0), gapTime(0), maxGap(0)
+      { }
+
+    std::string name;  // the trace file's base name
+    std::string error; // non-empty if the trace could not be read
+
+    uint64_t numSamples;
+    uint64_t begTime, endTime;
+
+    uint64_t numGaps, gapTime, maxGap;
+
+    KeyTimeMap time;                     // key -> time
+    std::vector<KeyTimeMap> phaseTime;   // [phase]: key -> time
+  };
+
+  // A phase's totals for one key over all ranks
+  struct PhaseKey {
+    PhaseKey()
+      : sum(0), max(0)
+      { }
+
+    uint64_t sum, max;
+  };
+
+  void
+  analyze(Rank& rank, const std::string& fnm) const;
+
+  uint32_t
+  key(uint32_t cpId) const;
+
+  std::string
+  keyName(uint32_t key) const;
+
+  uint
+  phase(uint64_t time) const;
+
+  uint64_t
+  phaseBeg(uint i) const;
+
+  void
+  sumKeys(std::map<uint32_t, uint64_t>& time) const;
+
+  void
+  sumPhase(uint i, std::map<uint32_t, PhaseKey>& time) const;
+
+private:
+  uint m_numPhases;
+
+  // with a database: call path id -> procedure id, and procedure names
+  bool m_haveDB;
+  std::unordered_map<uint32_t, uint32_t> m_cpIdToProc;
+  std::map<uint32_t, std::string> m_procNames;
+
+  uint64_t m_begTime, m_endTime;
+
+  std::vector<Rank> m_ranks;
+  uint m_numRanksOK;
+};
+
+} // namespace Raw
+
+} // namespace Analysis
+
+//****************************************************************************
+
+#endif // Analysis_Raw_TraceStats_hpp
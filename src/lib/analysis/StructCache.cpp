@@ -0,0 +1,431 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+
+#include "StructCache.hpp"
+
+#include <lib/prof-lean/build-id.h>
+#include <lib/prof-lean/hpcstruct-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+
+#include <lib/xml/xml.hpp>
+
+//*************************** Forward Declarations **************************
+
+static const string StructSfx = ".hpcstruct";
+
+static string
+hexKey(uint64_t h);
+
+static void
+copyEntryXML(const string& entry, const string& outFile,
+	     const string& lmName);
+
+static void
+copyEntryBinary(const string& entry, const string& outFile,
+		const string& lmName);
+
+//***************************************************************************
+
+namespace Analysis {
+
+namespace StructCache {
+
+string
+defaultDir()
+{
+  const char* dir = getenv(HPCTOOLKIT_STRUCT_CACHE_ENV);
+  return (dir) ? string(dir) : string();
+}
+
+
+string
+binaryKey(const string& binPath)
+{
+  char buf[BUILD_ID_HEX_MAX];
+
+  if (build_id_from_file(binPath.c_str(), buf, sizeof(buf)) == 0) {
+    return string(buf);
+  }
+
+  // Without a build-id, identify the file rather than hashing its
+  // contents, which would read the whole binary on every lookup.
+  struct stat sb;
+  if (stat(binPath.c_str(), &sb) == 0 && S_ISREG(sb.st_mode)) {
+    uint64_t id[5] = {
+      (uint64_t)sb.st_dev, (uint64_t)sb.st_ino, (uint64_t)sb.st_size,
+      (uint64_t)sb.st_mtim.tv_sec, (uint64_t)sb.st_mtim.tv_nsec
+    };
+    return string("file-")
+      + hexKey(build_id_hash_bytes(BUILD_ID_HASH_INIT, id, sizeof(id)));
+  }
+  return string();
+}
+
+
+ContentOptions::ContentOptions()
+  : searchPath("."), replacePath(""),
+    isIrreducibleIntervalLoop(true), isForwardSubstitution(true),
+    useBinutils(false), demangleLibrary(""), demangleFunction("")
+{
+}
+
+
+string
+contentKey(const ContentOptions& opts)
+{
+  // The tool version is part of the key: a new hpcstruct may
+  // recover different structure from the same binary.
+  std::ostringstream os;
+  os << HPCTOOLKIT_VERSION_STRING
+     << "\nsearch=" << opts.searchPath
+     << "\nreplace=" << opts.replacePath
+     << "\nloop-intvl=" << opts.isIrreducibleIntervalLoop
+     << "\nloop-fwd-subst=" << opts.isForwardSubstitution
+     << "\nbinutils=" << opts.useBinutils
+     << "\ndemangle=" << opts.demangleLibrary
+     << ":" << opts.demangleFunction;
+  string desc = os.str();
+
+  return hexKey(build_id_hash_bytes(BUILD_ID_HASH_INIT, desc.c_str(),
+				    desc.length()));
+}
+
+
+string
+formatKey(bool binaryOutput, bool prettyPrint)
+{
+  if (binaryOutput) {
+    return "bin";
+  }
+  return (prettyPrint) ? "xml" : "xml-flat";
+}
+
+
+string
+lookup(const string& cacheDir, const string& binKey, const string& contKey,
+       const string& fmtKey)
+{
+  if (cacheDir.empty() || binKey.empty()) {
+    return string();
+  }
+
+  string path = (cacheDir + "/" + binKey + "/" + contKey + "." + fmtKey
+		 + StructSfx);
+  return (FileUtil::isReadable(path)) ? path : string();
+}
+
+
+string
+lookupContent(const string& cacheDir, const string& binKey,
+	      const string& contKey)
+{
+  // Every format holds the same structure; prefer the cheapest to read.
+  static const string fmtKeys[] = {
+    formatKey(true, false), formatKey(false, false), formatKey(false, true)
+  };
+
+  for (size_t i = 0; i < sizeof(fmtKeys) / sizeof(fmtKeys[0]); ++i) {
+    string path = lookup(cacheDir, binKey, contKey, fmtKeys[i]);
+    if (!path.empty()) {
+      return path;
+    }
+  }
+  return string();
+}
+
+
+bool
+insert(const string& cacheDir, const string& binKey, const string& contKey,
+       const string& fmtKey, const string& structFile)
+{
+  if (cacheDir.empty() || binKey.empty()) {
+    return false;
+  }
+
+  string dir = cacheDir + "/" + binKey;
+  string path = dir + "/" + contKey + "." + fmtKey + StructSfx;
+  string tmpPath = path + ".tmp.XXXXXX";
+
+  try {
+    try {
+      FileUtil::mkdir(dir);
+    }
+    catch (const Diagnostics::Exception& x) {
+      // another writer may have created it first
+      if (!FileUtil::isDir(dir)) {
+	throw;
+      }
+    }
+
+    // Write to a private temporary in the same directory, then rename
+    // into place.  rename() is atomic, so a reader either finds no
+    // entry or a complete one; racing writers simply replace one
+    // complete (and identical) entry with another.
+    std::vector<char> tmpl(tmpPath.begin(), tmpPath.end());
+    tmpl.push_back('\0');
+    int fd = mkstemp(&tmpl[0]);
+    if (fd < 0) {
+      DIAG_WMsgIf(1, "hpcstruct cache: could not create a temporary file in '"
+		  << dir << "'");
+      return false;
+    }
+    close(fd);
+    tmpPath = &tmpl[0];
+
+    FileUtil::copy(tmpPath, structFile);
+    chmod(tmpPath.c_str(), 0644);
+    FileUtil::move(path, tmpPath);
+  }
+  catch (const Diagnostics::Exception& x) {
+    DIAG_WMsgIf(1, "hpcstruct cache: could not insert '" << structFile
+		<< "': " << x.message());
+    unlink(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+void
+copyEntry(const string& entry, const string& outFile, const string& lmName)
+{
+  char magic[HPCSTRUCT_FMT_MagicLen];
+
+  std::ifstream is(entry.c_str(), std::ios::in | std::ios::binary);
+  if (!is.read(magic, sizeof(magic))) {
+    DIAG_Throw("hpcstruct cache: cannot read '" << entry << "'");
+  }
+  is.close();
+
+  if (memcmp(magic, HPCSTRUCT_FMT_Magic, sizeof(magic)) == 0) {
+    copyEntryBinary(entry, outFile, lmName);
+  }
+  else {
+    copyEntryXML(entry, outFile, lmName);
+  }
+}
+
+} // namespace StructCache
+
+} // namespace Analysis
+
+
+//***************************************************************************
+
+static string
+hexKey(uint64_t h)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+  return string(buf);
+}
+
+
+// The load module names of an entry are the path of the binary it
+// was made from, possibly with a suffix (e.g., for the cubins of a
+// fatbin).  Rename every one that begins with the name of the first
+// load module.  Escaping is per character, so an escaped prefix is
+// the prefix of the escaped name.
+static void
+copyEntryXML(const string& entry, const string& outFile, const string& lmName)
+{
+  static const string LMTag = "<LM ";
+  static const string NameAttr = " n=\"";
+
+  std::ifstream is(entry.c_str());
+  std::ofstream os(outFile.c_str(), std::ios::out | std::ios::trunc);
+  if (!is || !os) {
+    DIAG_Throw("hpcstruct cache: cannot copy '" << entry << "' to '"
+	       << outFile << "'");
+  }
+
+  string newName = xml::EscapeStr(lmName);
+  string oldName;
+  bool haveOld = false;
+
+  // Names are escaped, so "<LM " occurs only as a tag.
+  string line;
+  while (std::getline(is, line)) {
+    size_t pos = 0;
+    while ((pos = line.find(LMTag, pos)) != string::npos) {
+      size_t beg = line.find(NameAttr, pos);
+      size_t end = (beg == string::npos) ? beg
+	: line.find('"', beg + NameAttr.length());
+      if (end == string::npos) {
+	DIAG_Throw("hpcstruct cache: malformed load module in '"
+		   << entry << "'");
+      }
+      beg += NameAttr.length();
+      if (!haveOld) {
+	oldName = line.substr(beg, end - beg);
+	haveOld = true;
+      }
+      if (line.compare(beg, oldName.length(), oldName) == 0) {
+	line.replace(beg, oldName.length(), newName);
+	end += newName.length() - oldName.length();
+      }
+      pos = end;
+    }
+    os << line;
+    if (!is.eof()) {
+      os << '\n';
+    }
+  }
+
+  if (is.bad() || !os) {
+    DIAG_Throw("hpcstruct cache: cannot copy '" << entry << "' to '"
+	       << outFile << "'");
+  }
+}
+
+
+// As copyEntryXML(), for the binary format: the renamed strings are
+// appended to the string section, the load module nodes are pointed
+// at them and the footer is rewritten.
+static void
+copyEntryBinary(const string& entry, const string& outFile,
+		const string& lmName)
+{
+  std::ifstream is(entry.c_str(), std::ios::in | std::ios::binary);
+  if (!is) {
+    DIAG_Throw("hpcstruct cache: cannot read '" << entry << "'");
+  }
+  std::vector<char> buf((std::istreambuf_iterator<char>(is)),
+			std::istreambuf_iterator<char>());
+  is.close();
+
+  hpcstruct_fmt_footer_t ftr;
+  if (buf.size() < sizeof(hpcstruct_fmt_hdr_t) + sizeof(ftr)) {
+    DIAG_Throw("hpcstruct cache: truncated entry '" << entry << "'");
+  }
+  memcpy(&ftr, &buf[buf.size() - sizeof(ftr)], sizeof(ftr));
+
+  uint64_t strsEnd = ftr.strs_off + ftr.strs_len;
+  if (memcmp(ftr.magic, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) != 0
+      || ftr.strs_len == 0 || strsEnd > buf.size() - sizeof(ftr)
+      || buf[strsEnd - 1] != '\0'
+      || ftr.nodes_off + ftr.num_nodes * sizeof(hpcstruct_fmt_node_t)
+         > buf.size() - sizeof(ftr)) {
+    DIAG_Throw("hpcstruct cache: malformed entry '" << entry << "'");
+  }
+
+  // Drop the padding and footer; renamed strings go after the others.
+  buf.resize(strsEnd);
+
+  string oldName;
+  bool haveOld = false;
+
+  for (uint64_t i = 0; i < ftr.num_nodes; ++i) {
+    uint64_t nodeOff = ftr.nodes_off + i * sizeof(hpcstruct_fmt_node_t);
+    hpcstruct_fmt_node_t node;
+    memcpy(&node, &buf[nodeOff], sizeof(node));
+    if (node.ty != HPCSTRUCT_FMT_Ty_LM || node.name >= ftr.strs_len) {
+      continue;
+    }
+
+    string name = &buf[ftr.strs_off + node.name];
+    if (!haveOld) {
+      oldName = name;
+      haveOld = true;
+    }
+    if (name.compare(0, oldName.length(), oldName) != 0) {
+      continue;
+    }
+
+    string newName = lmName + name.substr(oldName.length());
+    node.name = buf.size() - ftr.strs_off;
+    buf.insert(buf.end(), newName.c_str(),
+	       newName.c_str() + newName.length() + 1);
+    memcpy(&buf[nodeOff], &node, sizeof(node));
+  }
+
+  ftr.strs_len = buf.size() - ftr.strs_off;
+  buf.resize((buf.size() + 7) & ~(size_t)7, '\0');
+  buf.insert(buf.end(), (char*)&ftr, (char*)&ftr + sizeof(ftr));
+
+  std::ofstream os(outFile.c_str(),
+		   std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!os || !os.write(&buf[0], buf.size())) {
+    DIAG_Throw("hpcstruct cache: cannot write '" << outFile << "'");
+  }
+}
@@ -0,0 +1,158 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A content-addressed cache of hpcstruct results.
+//
+// Description:
+//   Entries are keyed by the identity of the binary (its GNU build-id,
+//   or the file's device, inode, size and mtime when there is none),
+//   by a hash of the hpcstruct options that determine the recovered
+//   structure, and by the output format.  An entry lives at
+//
+//     <cache-dir>/<binary-key>/<content-key>.<format-key>.hpcstruct
+//
+//   The structure file records the binary's path as the load module
+//   name; copyEntry() renames it, so one entry serves every path at
+//   which an identical binary is found.
+//
+//   Entries are published by renaming a completed temporary file into
+//   place, so concurrent writers (which produce identical entries)
+//   and readers never observe a partial structure file.
+//
+//***************************************************************************
+
+#ifndef Analysis_StructCache_hpp
+#define Analysis_StructCache_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+
+//*************************** User Include Files ****************************
+
+//*************************** Forward Declarations ***************************
+
+//****************************************************************************
+
+namespace Analysis {
+
+namespace StructCache {
+
+// Environment variable naming the default cache directory.
+#define HPCTOOLKIT_STRUCT_CACHE_ENV "HPCTOOLKIT_HPCSTRUCT_CACHE"
+
+// defaultDir: returns the directory named by the environment, or ""
+std::string
+defaultDir();
+
+// binaryKey: returns the key identifying the contents of 'binPath',
+// or "" if the file cannot be read.
+std::string
+binaryKey(const std::string& binPath);
+
+// ContentOptions: the hpcstruct options that determine the structure
+// recovered from a binary, as opposed to how it is written.  The
+// defaults are those of hpcstruct (cf. hpcstruct's Args::Ctor).
+struct ContentOptions {
+  ContentOptions();
+
+  std::string searchPath;
+  std::string replacePath;
+  bool isIrreducibleIntervalLoop;
+  bool isForwardSubstitution;
+  bool useBinutils;
+  std::string demangleLibrary;
+  std::string demangleFunction;
+};
+
+// contentKey: returns the key for 'opts' (and the tool version).
+std::string
+contentKey(const ContentOptions& opts);
+
+// formatKey: returns the key for an output format.
+std::string
+formatKey(bool binaryOutput, bool prettyPrint);
+
+// lookup: returns the path of the cache entry for 'binKey', 'contKey'
+// and 'fmtKey' if it exists, or "".
+std::string
+lookup(const std::string& cacheDir, const std::string& binKey,
+       const std::string& contKey, const std::string& fmtKey);
+
+// lookupContent: returns the path of an entry for 'binKey' and
+// 'contKey' in any format, or "".  Used by hpcprof, which reads every
+// format but can only use structure made with the default options.
+std::string
+lookupContent(const std::string& cacheDir, const std::string& binKey,
+	      const std::string& contKey);
+
+// insert: atomically copies 'structFile' into the cache as the entry
+// for 'binKey', 'contKey' and 'fmtKey'.  Returns true on success;
+// failures are reported as warnings since the cache is only an
+// optimization.
+bool
+insert(const std::string& cacheDir, const std::string& binKey,
+       const std::string& contKey, const std::string& fmtKey,
+       const std::string& structFile);
+
+// copyEntry: copies cache entry 'entry' to 'outFile', renaming its
+// load modules for a binary at 'lmName'.  Throws on error.
+void
+copyEntry(const std::string& entry, const std::string& outFile,
+	  const std::string& lmName);
+
+} // namespace StructCache
+
+} // namespace Analysis
+
+//****************************************************************************
+
+#endif // Analysis_StructCache_hpp
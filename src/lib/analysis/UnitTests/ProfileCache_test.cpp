@@ -0,0 +1,296 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Tests for the profile cache: a cache hit must give the same
+//   profile as reading the profiles without the cache.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cassert>
+using namespace std;
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../CallPath.hpp"
+#include "../CallPath-ProfileCache.hpp"
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/Metric-Mgr.hpp>
+#include <lib/prof/Metric-ADesc.hpp>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+using Prof::CallPath::Profile;
+
+// an hpcrun profile of rank 'rank' with two raw metrics (an integer
+// and a real one) over a small CCT, and a trace file if 'trace'
+static void
+writeProfile(const string& dir, int rank, bool trace)
+{
+  string rankStr = to_string(rank);
+  string base = dir + "/prog-00000" + rankStr + "-000-a8c01230-4242-0";
+  string fnm = base + "." + HPCRUN_ProfileFnmSfx;
+
+  FILE* fs = fopen(fnm.c_str(), "w");
+  assert(fs);
+  hpcrun_fmt_hdr_fwrite(fs,
+			HPCRUN_FMT_NV_prog, "prog",
+			HPCRUN_FMT_NV_mpiRank, rankStr.c_str(),
+			HPCRUN_FMT_NV_tid, "0",
+			HPCRUN_FMT_NV_traceMinTime, (trace) ? "1000" : "0",
+			HPCRUN_FMT_NV_traceMaxTime, (trace) ? "2000" : "0",
+			NULL);
+
+  epoch_flags_t flags;
+  flags.bits = 0;
+  hpcrun_fmt_epochHdr_fwrite(fs, flags, 1, NULL);
+
+  metric_desc_t cycles = metricDesc_NULL;
+  cycles.name = (char*)"CYCLES";
+  cycles.description = (char*)"cycles";
+  cycles.flags.fields.ty = MetricFlags_Ty_Raw;
+  cycles.flags.fields.valTy = MetricFlags_ValTy_Incl;
+  cycles.flags.fields.valFmt = MetricFlags_ValFmt_Int;
+  cycles.period = 1000;
+
+  metric_desc_t time = metricDesc_NULL;
+  time.name = (char*)"REALTIME";
+  time.description = (char*)"real time";
+  time.flags.fields.ty = MetricFlags_Ty_Raw;
+  time.flags.fields.valTy = MetricFlags_ValTy_Incl;
+  time.flags.fields.valFmt = MetricFlags_ValFmt_Real;
+  time.period = 1;
+  time.is_frequency_metric = true;
+
+  metric_desc_p_t lst[2] = { &cycles, &time };
+  metric_desc_p_tbl_t tbl;
+  tbl.lst = lst;
+  tbl.len = 2;
+  metric_aux_info_t aux[2];
+  aux[0].is_multiplexed = true;
+  aux[0].threshold_mean = 900.0 + rank;
+  aux[0].num_samples = 10 + rank;
+  aux[1].is_multiplexed = false;
+  aux[1].threshold_mean = 0.0;
+  aux[1].num_samples = 0;
+  hpcrun_fmt_metricTbl_fwrite(&tbl, aux, fs);
+
+  loadmap_entry_t lm;
+  lm.id = 1;
+  lm.name = (char*)"/nonexistent/prog";
+  lm.flags = 0;
+  loadmap_t loadmap;
+  loadmap.lst = &lm;
+  loadmap.len = 1;
+  hpcrun_fmt_loadmap_fwrite(&loadmap, fs);
+
+  // root -> main -> {f, g}; rank 1 also has main -> h
+  struct { uint32_t id, parent; uint16_t lm; uint64_t ip; uint64_t cyc;
+	   double t; } nodes[] = {
+    { 1, 0, 0, 0,     0, 0.0 },
+    { 2, 1, 1, 0x100, 0, 0.0 },
+    { 3, 2, 1, 0x200, 5, 0.5 },
+    { 4, 2, 1, 0x300, 7, 0.0 },
+    { 5, 2, 1, 0x400, 2, 1.25 }
+  };
+  uint numNodes = (rank == 0) ? 4 : 5;
+  hpcfmt_int8_fwrite(numNodes, fs);
+  for (uint i = 0; i < numNodes; ++i) {
+    hpcrun_metricVal_t vals[2];
+    vals[0].i = (nodes[i].cyc) ? nodes[i].cyc + rank : 0;
+    vals[1].r = nodes[i].t;
+    hpcrun_fmt_cct_node_t x;
+    hpcrun_fmt_cct_node_init(&x);
+    x.id = nodes[i].id;
+    x.id_parent = nodes[i].parent;
+    x.lm_id = nodes[i].lm;
+    x.lm_ip = nodes[i].ip;
+    x.num_metrics = 2;
+    x.metrics = vals;
+    hpcrun_fmt_cct_node_fwrite(&x, flags, fs);
+  }
+  fclose(fs);
+
+  if (trace) {
+    string tnm = base + "." + HPCRUN_TraceFnmSfx;
+    FILE* ts = fopen(tnm.c_str(), "w");
+    assert(ts);
+    fputs("trace", ts);
+    fclose(ts);
+  }
+}
+
+
+// everything in a metric descriptor, including what hpcrun format
+// does not keep
+static string
+descStr(const Prof::Metric::ADesc* m)
+{
+  const Prof::Metric::SampledDesc* s =
+    dynamic_cast<const Prof::Metric::SampledDesc*>(m);
+  assert(s);
+
+  ostringstream os;
+  os << m->id() << " " << m->type() << " "
+     << ((m->partner()) ? (int)m->partner()->id() : -1) << " '"
+     << m->namePfx() << "' '" << m->nameBase() << "' '" << m->nameSfx()
+     << "' '" << m->description() << "' " << m->isVisible()
+     << m->isSortKey() << m->doDispPercent() << m->isPercent() << " "
+     << m->computedType() << " " << m->dbId() << " " << m->dbNumMetrics()
+     << " " << m->num_samples() << " " << m->isMultiplexed() << " "
+     << m->periodMean() << " " << m->sampling_type() << " "
+     << s->period() << " " << s->flags().bits_big[0] << " "
+     << s->flags().bits_big[1] << " " << s->isUnitsEvents() << " '"
+     << s->profileName() << "' '" << s->profileRelId() << "' '"
+     << s->profileType() << "'";
+  return os.str();
+}
+
+
+// the profile as hpcrun format, which has the CCT and metric values
+static string
+profStr(Profile& prof)
+{
+  char* buf = NULL;
+  size_t len = 0;
+  FILE* fs = open_memstream(&buf, &len);
+  assert(fs);
+  Profile::fmt_fwrite(prof, fs, 0);
+  fclose(fs);
+  string x(buf, len);
+  free(buf);
+  return x;
+}
+
+
+static void
+compare(Profile& x, Profile& y)
+{
+  assert(x.name() == y.name());
+  assert(x.directorySet() == y.directorySet());
+  assert(x.traceFileNameSet().size() == y.traceFileNameSet().size());
+
+  const Prof::Metric::Mgr* xm = x.metricMgr();
+  const Prof::Metric::Mgr* ym = y.metricMgr();
+  assert(xm->size() == ym->size());
+  for (uint i = 0; i < xm->size(); ++i) {
+    assert(descStr(xm->metric(i)) == descStr(ym->metric(i)));
+  }
+
+  assert(profStr(x) == profStr(y));
+}
+
+
+static bool
+isSameFile(const string& x, const string& y)
+{
+  struct stat xs, ys;
+  return (stat(x.c_str(), &xs) == 0 && stat(y.c_str(), &ys) == 0
+	  && xs.st_dev == ys.st_dev && xs.st_ino == ys.st_ino);
+}
+
+
+static void
+cacheTest(uint rFlags)
+{
+  char tmpl[] = "/tmp/hpcprof-cache-test-XXXXXX";
+  string dir = mkdtemp(tmpl);
+  writeProfile(dir, 0, true);
+  writeProfile(dir, 1, false);
+
+  Analysis::Util::StringVec files;
+  files.push_back(dir + "/prog-000000-000-a8c01230-4242-0.hpcrun");
+  files.push_back(dir + "/prog-000001-000-a8c01230-4242-0.hpcrun");
+
+  int mergeTy = Profile::Merge_CreateMetric;
+
+  Profile* uncached = Analysis::CallPath::read(files, NULL, mergeTy, rFlags);
+  Profile* miss = Analysis::CallPath::readCached(files, NULL, mergeTy, rFlags);
+  Profile* hit = Analysis::CallPath::readCached(files, NULL, mergeTy, rFlags);
+
+  compare(*uncached, *miss);
+  compare(*uncached, *hit);
+
+  // the hit's trace is a link to the measurement's trace, not a copy
+  assert(hit->traceFileNameSet().size() == 1);
+  const string& trace = *hit->traceFileNameSet().begin();
+  assert(trace.compare(0, dir.size() + 15, dir + "/hpcprof-cache/") == 0);
+  assert(isSameFile(trace, *uncached->traceFileNameSet().begin()));
+
+  delete uncached;
+  delete miss;
+  delete hit;
+
+  string cmd = "rm -rf '" + dir + "'";
+  assert(system(cmd.c_str()) == 0);
+}
+
+
+void
+profileCacheTest()
+{
+  cacheTest(0);
+  cacheTest(Profile::RFlg_MakeInclExcl);
+}
@@ -65,11 +65,15 @@
 using std::string;
 
 #include <algorithm>
+#include <map>
+#include <set>
 #include <typeinfo>
+#include <vector>
 
 #include <cstring> // strlen()
 
 #include <dirent.h> // scandir()
+#include <sys/stat.h>
 
 //*************************** User Include Files ****************************
 
@@ -85,8 +89,10 @@ using std::string;
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrunflat-fmt.h>
 
+#include <lib/support/FileUtil.hpp>
 #include <lib/support/PathFindMgr.hpp>
 #include <lib/support/PathReplacementMgr.hpp>
+#include <lib/support/StrUtil.hpp>
 #include <lib/support/diagnostics.h>
 #include <lib/support/realpath.h>
 
@@ -351,11 +357,265 @@ demandStructure(VMA vma, Prof::Struct::LM* lmStrct,
 // 
 //***************************************************************************
 
-static string
-copySourceFileMain(const string& fnm_orig,
-		   std::map<string, string>& processedFiles,
-		   const Analysis::PathTupleVec& pathVec,
-		   const string& dstDir);
+//***************************************************************************
+// SrcPathIndex
+//***************************************************************************
+
+// SrcPathIndex: Resolves source file names with the <search-path,
+// path-view> tuples of 'pathVec'.  Each recursive search path is
+// walked once, when the index is built, into a file name -> paths
+// map, so that resolving a file does not touch the disk beyond
+// checking a non-recursive path.
+class SrcPathIndex {
+public:
+  SrcPathIndex(const Analysis::PathTupleVec& pathVec, uint numThreads);
+
+  // find: Given a file name 'filenm', determine which path in
+  // 'pathVec', if any, reaches 'filenm'.  Returns an index and string
+  // pair.  If a match is found, the index is an index in pathVec and
+  // the string is the (real) found file name; otherwise the index is
+  // negative.
+  std::pair<int, string>
+  find(const string& filenm) const;
+
+private:
+  typedef std::map<string, std::vector<string> > FileMap;
+
+  struct Entry {
+    string realPath;
+    bool isRecursive;
+    FileMap files; // recursive paths only
+  };
+
+  static void
+  scan(Entry& entry);
+
+  static const string*
+  findInFileMap(const FileMap& files, const string& relFnm);
+
+  std::vector<Entry> m_entries;
+};
+
+
+SrcPathIndex::SrcPathIndex(const Analysis::PathTupleVec& pathVec,
+			   uint numThreads)
+  : m_entries(pathVec.size())
+{
+  // the walks are independent, and on a network file system, mostly
+  // waiting
+#pragma omp parallel for  num_threads(numThreads)  schedule(dynamic, 1)
+  for (uint i = 0; i < pathVec.size(); i++) {
+    Entry& entry = m_entries[i];
+    const string& curPath = pathVec[i].first;
+
+    string realPath(curPath);
+    entry.isRecursive = PathFindMgr::isRecursivePath(curPath.c_str());
+    if (entry.isRecursive) {
+      realPath.resize(realPath.length() - PathFindMgr::RecursivePathSfxLn);
+    }
+    entry.realPath = RealPath(realPath.c_str());
+
+    if (entry.isRecursive) {
+      scan(entry);
+    }
+  }
+}
+
+
+// scan: Walk entry.realPath and its subdirectories into entry.files.
+// As with PathFindMgr, directories reached through symlinks are
+// real-pathed and each directory is visited only once.
+void
+SrcPathIndex::scan(Entry& entry)
+{
+  std::set<string> seenPaths;
+  std::vector<string> stack;
+
+  stack.push_back(entry.realPath);
+  seenPaths.insert(entry.realPath);
+
+  while (!stack.empty()) {
+    string path = stack.back();
+    stack.pop_back();
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+      continue;
+    }
+
+    struct dirent* x;
+    while ( (x = readdir(dir)) ) {
+      if (strcmp(x->d_name, ".") == 0 || strcmp(x->d_name, "..") == 0) {
+	continue;
+      }
+
+      string x_fnm = path + "/" + x->d_name;
+
+      unsigned char x_type = DT_UNKNOWN;
+#if defined(_DIRENT_HAVE_D_TYPE)
+      x_type = x->d_type;
+#endif
+      struct stat statbuf;
+      if (x_type == DT_UNKNOWN) {
+	if (lstat(x_fnm.c_str(), &statbuf) != 0) {
+	  continue;
+	}
+	x_type = (S_ISLNK(statbuf.st_mode)) ? DT_LNK
+	  : (S_ISREG(statbuf.st_mode)) ? DT_REG
+	  : (S_ISDIR(statbuf.st_mode)) ? DT_DIR : DT_UNKNOWN;
+      }
+
+      if (x_type == DT_LNK) {
+	if (stat(x_fnm.c_str(), &statbuf) != 0) {
+	  continue;
+	}
+	if (S_ISREG(statbuf.st_mode)) {
+	  x_type = DT_REG;
+	}
+	else if (S_ISDIR(statbuf.st_mode)) {
+	  x_type = DT_DIR;
+	  x_fnm = RealPath(x_fnm.c_str());
+	}
+      }
+
+      if (x_type == DT_REG) {
+	entry.files[x->d_name].push_back(x_fnm);
+      }
+      else if (x_type == DT_DIR) {
+	if (seenPaths.insert(x_fnm).second) {
+	  stack.push_back(x_fnm);
+	}
+      }
+    }
+    closedir(dir);
+  }
+}
+
+
+// findInFileMap: Find the relative file name 'relFnm' in 'files'.
+// Among the paths with the same file name, choose the one that
+// matches the most trailing components of 'relFnm', or else the
+// first one.  (cf. PathFindMgr::find)
+const string*
+SrcPathIndex::findInFileMap(const FileMap& files, const string& relFnm)
+{
+  FileMap::const_iterator it = files.find(FileUtil::basename(relFnm));
+  if (it == files.end()) {
+    return NULL;
+  }
+
+  const std::vector<string>& paths = it->second;
+  if (paths.size() == 1 || relFnm.find('/') == string::npos) {
+    return &paths[0];
+  }
+
+  // the directory components of 'relFnm' that can be matched: those
+  // after any '..'
+  std::vector<string> comps;
+  StrUtil::tokenize_char(relFnm, "/", comps);
+  comps.pop_back();
+  std::vector<string> dirs;
+  for (uint i = 0; i < comps.size(); i++) {
+    if (comps[i] == "..") {
+      dirs.clear();
+    }
+    else if (!comps[i].empty() && comps[i] != ".") {
+      dirs.push_back(comps[i]);
+    }
+  }
+
+  const string* best = &paths[0];
+  uint bestDepth = 0;
+  for (uint k = 0; k < paths.size(); k++) {
+    std::vector<string> pcomps;
+    StrUtil::tokenize_char(paths[k], "/", pcomps);
+    pcomps.pop_back();
+
+    uint depth = 0;
+    while (depth < dirs.size() && depth < pcomps.size()
+	   && dirs[dirs.size() - 1 - depth] == pcomps[pcomps.size() - 1 - depth]) {
+      depth++;
+    }
+    if (depth > bestDepth) {
+      bestDepth = depth;
+      best = &paths[k];
+    }
+  }
+  return best;
+}
+
+
+std::pair<int, string>
+SrcPathIndex::find(const string& filenm) const
+{
+  // Find the index to the path that reaches 'filenm'.
+  // It is possible that more than one path could reach the same
+  //   file because of substrings.
+  //   E.g.: p1: /p1/p2/p3/*, p2: /p1/p2/*, f: /p1/p2/p3/f.c
+  //   Choose the path that is most qualified (We assume RealPath length
+  //   is valid test.)
+  int foundIndex = -1; // index into 'pathVec'
+  int foundPathLn = 0; // length of the path represented by 'foundIndex'
+  string foundFnm;
+
+  for (uint i = 0; i < m_entries.size(); i++) {
+    const Entry& entry = m_entries[i];
+    const string& realPath = entry.realPath;
+    int realPathLn = realPath.length();
+
+    // 'filenm' should be relative.  If 'filenm' is absolute and
+    // 'realPath' is a prefix, make it relative.
+    const char* curFile = filenm.c_str();
+    if (filenm[0] == '/') { // is 'filenm' absolute?
+      if (strncmp(curFile, realPath.c_str(), realPathLn) == 0) {
+	curFile = &curFile[realPathLn];
+	while (curFile[0] == '/') { ++curFile; } // should not start with '/'
+      }
+      else {
+	continue; // the path can't posibly reach 'filenm'
+      }
+    }
+    if (curFile[0] == '\0') {
+      continue;
+    }
+
+    string fnd_fnm = realPath + "/" + curFile;
+    bool found = FileUtil::isReadable(fnd_fnm);
+    if (!found && entry.isRecursive) {
+      const string* x = findInFileMap(entry.files, curFile);
+      if (x) {
+	fnd_fnm = *x;
+	found = true;
+      }
+    }
+
+    if (found && (foundIndex < 0 || realPathLn > foundPathLn)) {
+      foundIndex = i;
+      foundPathLn = realPathLn;
+      foundFnm = RealPath(fnd_fnm.c_str());
+    }
+  }
+  return make_pair(foundIndex, foundFnm);
+}
+
+
+//***************************************************************************
+//
+//***************************************************************************
+
+// SrcFileCopy: One distinct source file name in the structure, and
+// where (if anywhere) it is copied in the database.
+struct SrcFileCopy {
+  string fnm_orig;
+  string fnm_fnd;  // the file found on this file system, or empty
+  string fnm_to;   // the copy in the database
+  string fnm_new;  // the database name (relative to the database)
+  string error;
+};
+
+static void
+resolveSourceFile(SrcFileCopy& x, const SrcPathIndex& index,
+		  const Analysis::PathTupleVec& pathVec, const string& dstDir);
 
 static bool 
 Flat_Filter(const Prof::Struct::ANode& x, long GCC_ATTR_UNUSED type)
@@ -373,13 +633,21 @@ namespace Util {
 // Prof::Struct::Alien x in 'structure' that can be reached with paths
 // in 'pathVec', copy x to its appropriate viewname path and update
 // x's path to be relative to this location.
+//
+// The search paths are indexed once; the distinct files are then
+// resolved and copied with 'numThreads' threads.  Directories are
+// created, and messages printed, by this thread in structure order.
 void
 copySourceFiles(Prof::Struct::Root* structure, 
 		const Analysis::PathTupleVec& pathVec,
-		const string& dstDir)
+		const string& dstDir, uint numThreads)
 {
-  // Prevent multiple copies of the same file (Alien scopes)
-  std::map<string, string> processedFiles;
+  // ------------------------------------------------------
+  // Collect the distinct file names (Alien scopes share files)
+  // ------------------------------------------------------
+  std::vector<SrcFileCopy> files;
+  std::map<string, uint> fileIdx;
+  std::vector<std::pair<Prof::Struct::ANode*, uint> > scopes;
 
   Prof::Struct::ANodeFilter filter(Flat_Filter, "Flat_Filter", 0);
   for (Prof::Struct::ANodeIterator it(structure, &filter); it.Current(); ++it) {
@@ -395,16 +663,85 @@ copySourceFiles(Prof::Struct::Root* structure,
        ((typeid(*strct) == typeid(Prof::Struct::Loop)) ? 
 	dynamic_cast<Prof::Struct::Loop*>(strct)->fileName() : 
 	strct->name()));
-    
-    // ------------------------------------------------------
-    // Given fnm_orig, attempt to find and copy fnm_new
-    // ------------------------------------------------------
-    string fnm_new =
-      copySourceFileMain(fnm_orig, processedFiles, pathVec, dstDir);
-    
-    // ------------------------------------------------------
-    // Update static structure
-    // ------------------------------------------------------
+
+    std::map<string, uint>::iterator fit = fileIdx.find(fnm_orig);
+    uint idx;
+    if (fit != fileIdx.end()) {
+      idx = fit->second;
+    }
+    else {
+      idx = files.size();
+      fileIdx.insert(make_pair(fnm_orig, idx));
+      files.push_back(SrcFileCopy());
+      files.back().fnm_orig = fnm_orig;
+    }
+    scopes.push_back(std::make_pair(strct, idx));
+  }
+
+  // ------------------------------------------------------
+  // Given fnm_orig, attempt to find fnm_new
+  // ------------------------------------------------------
+  SrcPathIndex index(pathVec, numThreads);
+
+#pragma omp parallel for  num_threads(numThreads)  schedule(dynamic, 16)
+  for (uint i = 0; i < files.size(); i++) {
+    resolveSourceFile(files[i], index, pathVec, dstDir);
+  }
+
+  // ------------------------------------------------------
+  // Create the database directories, then copy
+  // ------------------------------------------------------
+  std::set<string> dirs;
+  for (uint i = 0; i < files.size(); i++) {
+    SrcFileCopy& x = files[i];
+    if (x.fnm_to.empty()) {
+      continue;
+    }
+    string dir_to = FileUtil::dirname(x.fnm_to);
+    if (dirs.insert(dir_to).second) {
+      try {
+	FileUtil::mkdir(dir_to);
+      }
+      catch (const Diagnostics::Exception& ex) {
+	x.error = ex.message();
+      }
+    }
+  }
+
+#pragma omp parallel for  num_threads(numThreads)  schedule(dynamic, 16)
+  for (uint i = 0; i < files.size(); i++) {
+    SrcFileCopy& x = files[i];
+    if (x.fnm_to.empty() || !x.error.empty()) {
+      continue;
+    }
+    try {
+      FileUtil::copy(x.fnm_to, x.fnm_fnd);
+    }
+    catch (const Diagnostics::Exception& ex) {
+      x.error = ex.message();
+    }
+  }
+
+  for (uint i = 0; i < files.size(); i++) {
+    const SrcFileCopy& x = files[i];
+    if (!x.error.empty()) {
+      DIAG_EMsg(x.error);
+    }
+    if (x.fnm_new.empty()) {
+      DIAG_WMsg(2, "lost: " << x.fnm_orig);
+    }
+    else {
+      DIAG_Msg(2, "  cp:" << x.fnm_orig << " -> " << x.fnm_new);
+    }
+  }
+
+  // ------------------------------------------------------
+  // Update static structure
+  // ------------------------------------------------------
+  for (uint i = 0; i < scopes.size(); i++) {
+    Prof::Struct::ANode* strct = scopes[i].first;
+    const string& fnm_new = files[scopes[i].second].fnm_new;
+
     if (!fnm_new.empty()) {
       if (typeid(*strct) == typeid(Prof::Struct::Alien)) {
 	dynamic_cast<Prof::Struct::Alien*>(strct)->fileName(fnm_new);
@@ -422,155 +759,50 @@ copySourceFiles(Prof::Struct::Root* structure,
 
 
 
-static std::pair<int, string>
-matchFileWithPath(const string& filenm, const Analysis::PathTupleVec& pathVec);
+static void
+makeDatabaseFileName(SrcFileCopy& x, const string& filenm,
+		     const string& dstDir, const Analysis::PathTuple& pathTpl);
 
-static string
-copySourceFile(const string& filenm, const string& dstDir, 
-	       const Analysis::PathTuple& pathTpl);
-
-static string
-copySourceFileMain(const string& fnm_orig,
-		   std::map<string, string>& processedFiles,
-		   const Analysis::PathTupleVec& pathVec,
-		   const string& dstDir)
+static void
+resolveSourceFile(SrcFileCopy& x, const SrcPathIndex& index,
+		  const Analysis::PathTupleVec& pathVec, const string& dstDir)
 {
-  string fnm_new;
-  
-  std::map<string, string>::iterator it = processedFiles.find(fnm_orig);
-  if (it != processedFiles.end()) {
-    fnm_new = it->second;
-  }
-  else {
-    std::pair<int, string> fnd = matchFileWithPath(fnm_orig, pathVec);
-    int idx = fnd.first;
-    if (idx >= 0) {
-      // fnm_orig explicitly matches a <search-path, path-view> tuple
-      fnm_new = copySourceFile(fnd.second, dstDir, pathVec[idx]);
-    }
-    else if (fnm_orig[0] == '/' && FileUtil::isReadable(fnm_orig.c_str())) {
-      // fnm_orig does not match a pathVec tuple; but if it is an
-      // absolute path that is readable, use the default <search-path,
-      // path-view> tuple.
-      static const Analysis::PathTuple 
-	defaultTpl("/", Analysis::DefaultPathTupleTarget);
-      fnm_new = copySourceFile(fnm_orig, dstDir, defaultTpl);
-    }
+  const string& fnm_orig = x.fnm_orig;
 
-    if (fnm_new.empty()) {
-      DIAG_WMsg(2, "lost: " << fnm_orig);
-    }
-    else {
-      DIAG_Msg(2, "  cp:" << fnm_orig << " -> " << fnm_new);
-    }
-    processedFiles.insert(make_pair(fnm_orig, fnm_new));
+  std::pair<int, string> fnd = index.find(fnm_orig);
+  int idx = fnd.first;
+  if (idx >= 0) {
+    // fnm_orig explicitly matches a <search-path, path-view> tuple
+    makeDatabaseFileName(x, fnd.second, dstDir, pathVec[idx]);
   }
-  
-  return fnm_new;
-}
-
-
-//***************************************************************************
-
-// matchFileWithPath: Given a file name 'filenm' and a vector of paths
-// 'pathVec', use 'pathfind_r' to determine which path in 'pathVec',
-// if any, reaches 'filenm'.  Returns an index and string pair.  If a
-// match is found, the index is an index in pathVec; otherwise it is
-// negative.  If a match is found, the string is the found file name.
-static std::pair<int, string>
-matchFileWithPath(const string& filenm, const Analysis::PathTupleVec& pathVec)
-{
-  // Find the index to the path that reaches 'filenm'.
-  // It is possible that more than one path could reach the same
-  //   file because of substrings.
-  //   E.g.: p1: /p1/p2/p3/*, p2: /p1/p2/*, f: /p1/p2/p3/f.c
-  //   Choose the path that is most qualified (We assume RealPath length
-  //   is valid test.) 
-  int foundIndex = -1; // index into 'pathVec'
-  int foundPathLn = 0; // length of the path represented by 'foundIndex'
-  string foundFnm; 
-
-  for (uint i = 0; i < pathVec.size(); i++) {
-    // find the absolute form of 'curPath'
-    const string& curPath = pathVec[i].first;
-    string realPath(curPath);
-    if (PathFindMgr::isRecursivePath(curPath.c_str())) {
-      realPath[realPath.length() - PathFindMgr::RecursivePathSfxLn] = '\0';
-    }
-    realPath = RealPath(realPath.c_str());
-    int realPathLn = realPath.length();
-       
-    // 'filenm' should be relative as input for pathfind_r.  If 'filenm'
-    // is absolute and 'realPath' is a prefix, make it relative. 
-    string tmpFile(filenm);
-    char* curFile = const_cast<char*>(tmpFile.c_str());
-    if (filenm[0] == '/') { // is 'filenm' absolute?
-      if (strncmp(curFile, realPath.c_str(), realPathLn) == 0) {
-	curFile = &curFile[realPathLn];
-	while (curFile[0] == '/') { ++curFile; } // should not start with '/'
-      } 
-      else {
-	continue; // pathfind_r can't posibly find anything
-      }
-    }
-    
-    const char* fnd_fnm = PathFindMgr::singleton().pathfind(curPath.c_str(),
-							    curFile, "r");
-
-    if (fnd_fnm) {
-      bool update = false;
-      if (foundIndex < 0) {
-	update = true;
-      }
-      else if ((foundIndex >= 0) && (realPathLn > foundPathLn)) {
-	update = true;
-      }
-      
-      if (update) {
-	foundIndex = i;
-	foundPathLn = realPathLn;
-	foundFnm = RealPath(fnd_fnm);
-      }
-    }
+  else if (fnm_orig[0] == '/' && FileUtil::isReadable(fnm_orig.c_str())) {
+    // fnm_orig does not match a pathVec tuple; but if it is an
+    // absolute path that is readable, use the default <search-path,
+    // path-view> tuple.
+    static const Analysis::PathTuple 
+      defaultTpl("/", Analysis::DefaultPathTupleTarget);
+    makeDatabaseFileName(x, fnm_orig, dstDir, defaultTpl);
   }
-  return make_pair(foundIndex, foundFnm);
 }
 
 
 // Given a file 'filenm' a destination directory 'dstDir' and a
-// PathTuple, form a database file name, copy 'filenm' into the
-// database and return the database file name.
+// PathTuple, form the database file name and the name of its copy.
 // NOTE: assume filenm is already a 'real path'
-static string
-copySourceFile(const string& filenm, const string& dstDir, 
-	       const Analysis::PathTuple& pathTpl)
+static void
+makeDatabaseFileName(SrcFileCopy& x, const string& filenm,
+		     const string& dstDir, const Analysis::PathTuple& pathTpl)
 {
-  const string& fnm_fnd = filenm;
   const string& viewnm = pathTpl.second;
 
-  // Create new file name and copy commands
-  string fnm_new = "./" + viewnm + fnm_fnd;
-	
-  string fnm_to;
+  x.fnm_fnd = filenm;
+  x.fnm_new = "./" + viewnm + filenm;
+
+  x.fnm_to = "";
   if (dstDir[0]  != '/') {
-    fnm_to = "./";
-  }
-  fnm_to = fnm_to + dstDir + "/" + viewnm + fnm_fnd;
-  string dir_to(fnm_to); // need to strip off ending filename to 
-  uint end;              // get full path for 'fnm_to'
-  for (end = dir_to.length() - 1; dir_to[end] != '/'; end--) { }
-  dir_to[end] = '\0';    // should not end with '/'
-	
-  try {
-    FileUtil::mkdir(dir_to);
-    FileUtil::copy(fnm_to, fnm_fnd);
-    DIAG_DevMsgIf(0, "cp " << fnm_to);
+    x.fnm_to = "./";
   }
-  catch (const Diagnostics::Exception& x) {
-    DIAG_EMsg(x.message());
-  }
-  
-  return fnm_new;
+  x.fnm_to = x.fnm_to + dstDir + "/" + viewnm + filenm;
 }
 
 
@@ -167,7 +167,7 @@ demandStructure(VMA vma, Prof::Struct::LM* lmStrct, BinUtil::LM* lm,
 void 
 copySourceFiles(Prof::Struct::Root* structure,
 		const Analysis::PathTupleVec& pathVec,
-		const std::string& dstDir);
+		const std::string& dstDir, uint numThreads = 1);
 
 void
 copyTraceFiles(const std::string& dstDir,
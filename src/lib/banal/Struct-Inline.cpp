@@ -67,12 +67,16 @@
 // handler per process, so this could break other libraries or the
 // main program.
 //
-// 3. Apologies for the single static buffer.  Ideally, we would read
+// 3. Apologies for the static symtab pointer.  Ideally, we would read
 // the dwarf info from inside lib/binutils and carry it down into
 // makeStructure() and determineContext().  But that requires
 // integrating symtab too deeply into our code.  We may rework this,
 // especially if we rewrite the inline support directly from libdwarf
 // (which is cross platform).
+//
+// The pointer and the jump buffer are per-thread, so that several
+// binaries may be analyzed at once.  A thread that works on a binary
+// opened by another thread must first call setSymtab().
 
 //***************************************************************************
 
@@ -80,7 +84,9 @@
 #include <signal.h>
 #include <string.h>
 
+#include <atomic>
 #include <list>
+#include <mutex>
 #include <set>
 #include <string>
 #include <utility>
@@ -106,16 +112,19 @@ using namespace std;
 
 static const string UNKNOWN_PROC ("unknown-proc");
 
-// FIXME: uses a single static buffer.
-static Symtab *the_symtab = NULL;
+static thread_local Symtab *the_symtab = NULL;
+
+// the handlers are installed while any symtab is open
+static mutex sig_mtx;
+static int sig_users = 0;
 
 static struct sigaction old_act_abrt;
 static struct sigaction old_act_segv;
-static sigjmp_buf jbuf;
-static int jbuf_active = 0;
+static thread_local sigjmp_buf jbuf;
+static thread_local int jbuf_active = 0;
 
-static int num_queries = 0;
-static int num_errors = 0;
+static atomic <int> num_queries(0);
+static atomic <int> num_errors(0);
 
 #define DEBUG_INLINE_NAMES  0
 
@@ -130,8 +139,10 @@ banal_sighandler(int sig)
     siglongjmp(jbuf, 1);
   }
 
-  // caught a signal, but it didn't come from symtab
-  restore_sighandler();
+  // caught a signal, but it didn't come from symtab.  don't take
+  // sig_mtx here, we may have interrupted its owner.
+  sigaction(SIGABRT, &old_act_abrt, NULL);
+  sigaction(SIGSEGV, &old_act_segv, NULL);
   DIAG_Die("banal caught unexpected signal " << sig);
 }
 
@@ -146,23 +157,32 @@ init_sighandler(void)
   sigemptyset(&act.sa_mask);
 
   jbuf_active = 0;
-  sigaction(SIGABRT, &act, &old_act_abrt);
-  sigaction(SIGSEGV, &act, &old_act_segv);
+
+  lock_guard <mutex> guard (sig_mtx);
+  if (sig_users++ == 0) {
+    sigaction(SIGABRT, &act, &old_act_abrt);
+    sigaction(SIGSEGV, &act, &old_act_segv);
+  }
 }
 
 static void
 restore_sighandler(void)
 {
-  sigaction(SIGABRT, &old_act_abrt, NULL);
-  sigaction(SIGSEGV, &old_act_segv, NULL);
   jbuf_active = 0;
+
+  lock_guard <mutex> guard (sig_mtx);
+  if (sig_users > 0 && --sig_users == 0) {
+    sigaction(SIGABRT, &old_act_abrt, NULL);
+    sigaction(SIGSEGV, &old_act_segv, NULL);
+  }
 }
 
 //***************************************************************************
 
 namespace Inline {
 
-// These functions return true on success.
+// Open the symtab for elfFile and make it current for this thread.
+// Returns NULL on failure.
 Symtab *
 openSymtab(ElfFile *elfFile)
 {
@@ -191,20 +211,24 @@ openSymtab(ElfFile *elfFile)
   if (! ret) {
     DIAG_WMsgIf(1, "SymtabAPI was unable to open: " << elfFile->getFileName());
     the_symtab = NULL;
+    restore_sighandler();
   }
 
   return the_symtab;
 }
 
+// Returns true on success.
 bool
-closeSymtab()
+closeSymtab(Symtab *symtab)
 {
   bool ret = false;
 
-  if (the_symtab != NULL) {
-    ret = Symtab::closeSymtab(the_symtab);
+  if (symtab != NULL) {
+    ret = Symtab::closeSymtab(symtab);
+  }
+  if (the_symtab == symtab) {
+    the_symtab = NULL;
   }
-  the_symtab = NULL;
 
   restore_sighandler();
 
@@ -216,6 +240,13 @@ closeSymtab()
   return ret;
 }
 
+// Make symtab (opened by another thread) current for this thread.
+void
+setSymtab(Symtab *symtab)
+{
+  the_symtab = symtab;
+}
+
 //***************************************************************************
 
 // Lookup the Module (comp unit) containing 'vma' to see if it is from
@@ -343,7 +343,8 @@ public:
 //***************************************************************************
 
 Symtab * openSymtab(ElfFile *elfFile);
-bool closeSymtab();
+bool closeSymtab(Symtab *symtab);
+void setSymtab(Symtab *symtab);
 
 bool analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr *);
 
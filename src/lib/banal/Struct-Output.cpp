@@ -55,6 +55,11 @@
 // tool/hpcstruct/main.c and lib/support/IOUtil.hpp.
 //
 // 3. We allow ostream = NULL to mean that we don't want output.
+//
+// 4. With the binary format (prof-lean/hpcstruct-fmt.h), the same
+// tree walk emits fixed-size node records through BinaryFile instead
+// of XML tags.  The preorder index numbers are identical in both
+// formats.
 
 // FIXME and TODO:
 //
@@ -67,13 +72,18 @@
 //***************************************************************************
 
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <list>
 #include <map>
 #include <ostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <lib/binutils/VMAInterval.hpp>
+#include <lib/prof-lean/hpcstruct-fmt.h>
 #include <lib/support/FileUtil.hpp>
 #include <lib/support/StringTable.hpp>
 #include <lib/support/dictionary.h>
@@ -92,6 +102,7 @@ using namespace std;
 
 static long next_index;
 static long gaps_line;
+static bool binary_format = false;
 
 static const char * hpcstruct_xml_head =
 #include <lib/xml/hpc-structure.dtd.h>
@@ -128,6 +139,161 @@ doIndent(ostream * os, int depth)
 namespace BAnal {
 namespace Output {
 
+// Writer for the binary hpcstruct format.  Node records are streamed
+// to the ostream as the tree is walked (each record is held back
+// until its vma ranges are complete), while the vma ranges and the
+// unique strings are kept in memory and written at the end, followed
+// by the footer that locates the sections.
+//
+class BinaryFile {
+public:
+  BinaryFile(ostream * os)
+  {
+    m_os = os;
+    m_offset = 0;
+    m_num_nodes = 0;
+    m_pending = false;
+
+    hpcstruct_fmt_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen);
+    memcpy(hdr.version, HPCSTRUCT_FMT_Version, HPCSTRUCT_FMT_VersionLen);
+    hdr.endian = HPCSTRUCT_FMT_Endian;
+    write(&hdr, sizeof(hdr));
+
+    // string offset 0 is always the empty string
+    str2offset("");
+  }
+
+  void
+  beginNode(hpcstruct_fmt_ty_t ty, long id, long line, const string & name,
+	    const string & file = "", const string & link_name = "",
+	    long symbol = 0)
+  {
+    flushNode();
+
+    memset(&m_node, 0, sizeof(m_node));
+    m_node.ty = ty;
+    m_node.line = line;
+    m_node.id = id;
+    m_node.parent = m_stack.empty() ? HPCSTRUCT_FMT_NoParent : m_stack.back();
+    m_node.name = str2offset(name);
+    m_node.link_name = str2offset(link_name);
+    m_node.file = str2offset(file);
+    m_node.symbol = symbol;
+    m_node.vma_first = m_vmas.size();
+    m_node.num_vma = 0;
+    m_pending = true;
+
+    m_stack.push_back(m_num_nodes);
+    m_num_nodes++;
+  }
+
+  // add [beg, end) to the node most recently begun
+  void
+  addVMA(VMA beg, VMA end)
+  {
+    hpcstruct_fmt_vma_t vma;
+    vma.beg = beg;
+    vma.end = end;
+    m_vmas.push_back(vma);
+    m_node.num_vma++;
+  }
+
+  void
+  endNode()
+  {
+    flushNode();
+    m_stack.pop_back();
+  }
+
+  void
+  finish()
+  {
+    flushNode();
+
+    hpcstruct_fmt_footer_t footer;
+    memset(&footer, 0, sizeof(footer));
+
+    footer.nodes_off = sizeof(hpcstruct_fmt_hdr_t);
+    footer.num_nodes = m_num_nodes;
+
+    footer.vmas_off = m_offset;
+    footer.num_vmas = m_vmas.size();
+    if (! m_vmas.empty()) {
+      write(&m_vmas[0], m_vmas.size() * sizeof(hpcstruct_fmt_vma_t));
+    }
+
+    footer.strs_off = m_offset;
+    footer.strs_len = m_strs.size();
+    write(m_strs.data(), m_strs.size());
+    align();
+
+    memcpy(footer.magic, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen);
+    write(&footer, sizeof(footer));
+
+    m_vmas.clear();
+    m_strs.clear();
+    m_strMap.clear();
+  }
+
+private:
+  void
+  write(const void * buf, size_t len)
+  {
+    m_os->write((const char *) buf, len);
+    m_offset += len;
+  }
+
+  void
+  align()
+  {
+    static const char zeros[8] = { 0 };
+    size_t extra = m_offset % 8;
+
+    if (extra != 0) {
+      write(zeros, 8 - extra);
+    }
+  }
+
+  void
+  flushNode()
+  {
+    if (m_pending) {
+      write(&m_node, sizeof(m_node));
+      m_pending = false;
+    }
+  }
+
+  uint64_t
+  str2offset(const string & str)
+  {
+    auto it = m_strMap.find(str);
+    if (it != m_strMap.end()) {
+      return it->second;
+    }
+
+    uint64_t offset = m_strs.size();
+    m_strs.append(str.c_str(), str.size() + 1);
+    m_strMap[str] = offset;
+
+    return offset;
+  }
+
+  ostream * m_os;
+  uint64_t  m_offset;
+  uint64_t  m_num_nodes;
+  bool      m_pending;
+
+  hpcstruct_fmt_node_t m_node;
+  vector <uint64_t> m_stack;
+  vector <hpcstruct_fmt_vma_t> m_vmas;
+  string m_strs;
+  unordered_map <string, uint64_t> m_strMap;
+};
+
+static BinaryFile * binFile = NULL;
+
 typedef map <long, TreeNode *> AlienMap;
 typedef map <long, VMAIntervalSet *> LineNumberMap;
 
@@ -160,9 +326,23 @@ doLoopList(ostream *, int, TreeNode *, HPC::StringTable &);
 static void
 locateTree(TreeNode *, ScopeInfo &, HPC::StringTable &, bool = false);
 
+static void
+doAlienBegin(ostream *, int, long, const string &, const string &);
+
+static void
+doScopeEnd(ostream *, int, const char *);
+
 //----------------------------------------------------------------------
 
-// DOCTYPE header and <HPCToolkitStructure> tag.
+// Select XML (default) or binary output for the next structure file.
+void
+setBinaryFormat(bool binary)
+{
+  binary_format = binary;
+}
+
+// DOCTYPE header and <HPCToolkitStructure> tag, or the binary file
+// header.
 void
 printStructFileBegin(ostream * os, ostream * gaps, string filenm)
 {
@@ -170,11 +350,16 @@ printStructFileBegin(ostream * os, ostream * gaps, string filenm)
     return;
   }
 
-  *os << "<?xml version=\"1.0\"?>\n"
-      << "<!DOCTYPE HPCToolkitStructure [\n"
-      << hpcstruct_xml_head
-      << "]>\n"
-      << "<HPCToolkitStructure i=\"0\" version=\"4.7\" n=\"\">\n";
+  if (binary_format) {
+    binFile = new BinaryFile(os);
+  }
+  else {
+    *os << "<?xml version=\"1.0\"?>\n"
+	<< "<!DOCTYPE HPCToolkitStructure [\n"
+	<< hpcstruct_xml_head
+	<< "]>\n"
+	<< "<HPCToolkitStructure i=\"0\" version=\"4.7\" n=\"\">\n";
+  }
 
   if (gaps != NULL) {
     *gaps << "This file describes the unclaimed vma ranges (gaps) in the control\n"
@@ -185,7 +370,7 @@ printStructFileBegin(ostream * os, ostream * gaps, string filenm)
   }
 }
 
-// Closing tag.
+// Closing tag, or the binary sections and footer.
 void
 printStructFileEnd(ostream * os, ostream * gaps)
 {
@@ -193,7 +378,14 @@ printStructFileEnd(ostream * os, ostream * gaps)
     return;
   }
 
-  *os << "</HPCToolkitStructure>\n";
+  if (binFile != NULL) {
+    binFile->finish();
+    delete binFile;
+    binFile = NULL;
+  }
+  else {
+    *os << "</HPCToolkitStructure>\n";
+  }
   os->flush();
 
   if (gaps != NULL) {
@@ -213,6 +405,11 @@ printLoadModuleBegin(ostream * os, string lmName)
 
   next_index = INIT_LM_INDEX;
 
+  if (binFile != NULL) {
+    binFile->beginNode(HPCSTRUCT_FMT_Ty_LM, next_index++, 0, lmName);
+    return;
+  }
+
   *os << "<LM"
       << INDEX
       << STRING("n", lmName)
@@ -227,6 +424,11 @@ printLoadModuleEnd(ostream * os)
     return;
   }
 
+  if (binFile != NULL) {
+    binFile->endNode();
+    return;
+  }
+
   *os << "</LM>\n";
 }
 
@@ -240,6 +442,11 @@ printFileBegin(ostream * os, FileInfo * finfo)
     return;
   }
 
+  if (binFile != NULL) {
+    binFile->beginNode(HPCSTRUCT_FMT_Ty_File, next_index++, 0, finfo->fileName);
+    return;
+  }
+
   doIndent(os, 1);
   *os << "<F"
       << INDEX
@@ -255,6 +462,11 @@ printFileEnd(ostream * os, FileInfo * finfo)
     return;
   }
 
+  if (binFile != NULL) {
+    binFile->endNode();
+    return;
+  }
+
   doIndent(os, 1);
   *os << "</F>\n";
 }
@@ -277,20 +489,30 @@ printProc(ostream * os, ostream * gaps, string gaps_file,
   long base_index = strTab.str2index(FileUtil::basename(finfo->fileName.c_str()));
   ScopeInfo scope(file_index, base_index, pinfo->line_num);
 
-  doIndent(os, 2);
-  *os << "<P"
-      << INDEX
-      << STRING("n", pinfo->prettyName);
+  if (binFile != NULL) {
+    string linkName =
+      (pinfo->linkName != pinfo->prettyName) ? pinfo->linkName : "";
 
-  if (pinfo->linkName != pinfo->prettyName) {
-    *os << STRING("ln", pinfo->linkName);
+    binFile->beginNode(HPCSTRUCT_FMT_Ty_Proc, next_index++, pinfo->line_num,
+		       pinfo->prettyName, "", linkName, pinfo->symbol_index);
+    binFile->addVMA(pinfo->entry_vma, pinfo->entry_vma + 1);
   }
-  if (pinfo->symbol_index != 0) {
-    *os << NUMBER("s", pinfo->symbol_index);
+  else {
+    doIndent(os, 2);
+    *os << "<P"
+	<< INDEX
+	<< STRING("n", pinfo->prettyName);
+
+    if (pinfo->linkName != pinfo->prettyName) {
+      *os << STRING("ln", pinfo->linkName);
+    }
+    if (pinfo->symbol_index != 0) {
+      *os << NUMBER("s", pinfo->symbol_index);
+    }
+    *os << NUMBER("l", pinfo->line_num)
+	<< VRANGE(pinfo->entry_vma, 1)
+	<< ">\n";
   }
-  *os << NUMBER("l", pinfo->line_num)
-      << VRANGE(pinfo->entry_vma, 1)
-      << ">\n";
 
   // write the gaps to the first proc (low vma) of the group.  this
   // only applies to full gaps.
@@ -300,6 +522,11 @@ printProc(ostream * os, ostream * gaps, string gaps_file,
 
   doTreeNode(os, 3, root, scope, strTab);
 
+  if (binFile != NULL) {
+    binFile->endNode();
+    return;
+  }
+
   doIndent(os, 2);
   *os << "</P>\n";
 }
@@ -328,23 +555,9 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 	<< "0x" << hex << ginfo->start << "--0x" << ginfo->end << dec << "\n\n";
   gaps_line += 6;
 
-  doIndent(os, 3);
-  *os << "<A"
-      << INDEX
-      << NUMBER("l", pinfo->line_num)
-      << STRING("f", finfo->fileName)
-      << STRING("n", "")
-      << " v=\"{}\""
-      << ">\n";
-
-  doIndent(os, 4);
-  *os << "<A"
-      << INDEX
-      << NUMBER("l", gaps_line - 4)
-      << STRING("f", gaps_file)
-      << STRING("n", "unclaimed region in: " + pinfo->prettyName)
-      << " v=\"{}\""
-      << ">\n";
+  doAlienBegin(os, 3, pinfo->line_num, finfo->fileName, "");
+  doAlienBegin(os, 4, gaps_line - 4, gaps_file,
+	       "unclaimed region in: " + pinfo->prettyName);
 
   for (auto git = ginfo->gapSet.begin(); git != ginfo->gapSet.end(); ++git) {
     long start = git->beg();
@@ -355,6 +568,13 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 	  << dec << "  (" << len << ")\n";
     gaps_line++;
 
+    if (binFile != NULL) {
+      binFile->beginNode(HPCSTRUCT_FMT_Ty_Stmt, next_index++, gaps_line, "");
+      binFile->addVMA(start, end);
+      binFile->endNode();
+      continue;
+    }
+
     doIndent(os, 5);
     *os << "<S"
 	<< INDEX
@@ -363,11 +583,8 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 	<< "/>\n";
   }
 
-  doIndent(os, 4);
-  *os << "</A>\n";
-
-  doIndent(os, 3);
-  *os << "</A>\n";
+  doScopeEnd(os, 4, "A");
+  doScopeEnd(os, 3, "A");
 }
 
 //----------------------------------------------------------------------
@@ -468,20 +685,13 @@ doTreeNode(ostream * os, int depth, TreeNode * root, ScopeInfo scope,
     locateTree(node, alien_scope, strTab, true);
 
     // guard alien
-    doIndent(os, depth);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", alien_scope.line_num)
-	<< STRING("f", strTab.index2str(file_index))
-	<< STRING("n", GUARD_NAME)
-	<< " v=\"{}\""
-	<< ">\n";
+    doAlienBegin(os, depth, alien_scope.line_num,
+		 strTab.index2str(file_index), GUARD_NAME);
 
     doStmtList(os, depth + 1, node);
     doLoopList(os, depth + 1, node, strTab);
 
-    doIndent(os, depth);
-    *os << "</A>\n";
+    doScopeEnd(os, depth, "A");
 
     node->clear();
     delete node;
@@ -503,33 +713,17 @@ doTreeNode(ostream * os, int depth, TreeNode * root, ScopeInfo scope,
 
     // outer, caller alien.  use file and line from flp call site, but
     // empty proc name.
-    doIndent(os, depth);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", flp.line_num)
-	<< STRING("f", strTab.index2str(flp.file_index))
-	<< STRING("n", "")
-	<< " v=\"{}\""
-	<< ">\n";
+    doAlienBegin(os, depth, flp.line_num, strTab.index2str(flp.file_index), "");
 
     // inner, callee alien.  use proc name from flp call site, but
     // file and line from subtree.
-    doIndent(os, depth + 1);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", subscope.line_num)
-	<< STRING("f", strTab.index2str(subscope.file_index))
-	<< STRING("n", callname)
-	<< " v=\"{}\""
-	<< ">\n";
+    doAlienBegin(os, depth + 1, subscope.line_num,
+		 strTab.index2str(subscope.file_index), callname);
 
     doTreeNode(os, depth + 2, subtree, subscope, strTab);
 
-    doIndent(os, depth + 1);
-    *os << "</A>\n";
-
-    doIndent(os, depth);
-    *os << "</A>\n";
+    doScopeEnd(os, depth + 1, "A");
+    doScopeEnd(os, depth, "A");
   }
 }
 
@@ -565,6 +759,16 @@ doStmtList(ostream * os, int depth, TreeNode * node)
     long line = mit->first;
     VMAIntervalSet * vset = mit->second;
 
+    if (binFile != NULL) {
+      binFile->beginNode(HPCSTRUCT_FMT_Ty_Stmt, next_index++, line, "");
+      for (auto vit = vset->begin(); vit != vset->end(); ++vit) {
+	binFile->addVMA(vit->beg(), vit->end());
+      }
+      binFile->endNode();
+      delete vset;
+      continue;
+    }
+
     doIndent(os, depth);
     *os << "<S"
 	<< INDEX
@@ -587,19 +791,62 @@ doLoopList(ostream * os, int depth, TreeNode * node, HPC::StringTable & strTab)
     LoopInfo * linfo = *lit;
     ScopeInfo scope(linfo->file_index, linfo->base_index);
 
-    doIndent(os, depth);
-    *os << "<L"
-	<< INDEX
-	<< NUMBER("l", linfo->line_num)
-	<< STRING("f", strTab.index2str(linfo->file_index))
-	<< VRANGE(linfo->entry_vma, 1)
-	<< ">\n";
+    if (binFile != NULL) {
+      binFile->beginNode(HPCSTRUCT_FMT_Ty_Loop, next_index++, linfo->line_num,
+			 "", strTab.index2str(linfo->file_index));
+      binFile->addVMA(linfo->entry_vma, linfo->entry_vma + 1);
+    }
+    else {
+      doIndent(os, depth);
+      *os << "<L"
+	  << INDEX
+	  << NUMBER("l", linfo->line_num)
+	  << STRING("f", strTab.index2str(linfo->file_index))
+	  << VRANGE(linfo->entry_vma, 1)
+	  << ">\n";
+    }
 
     doTreeNode(os, depth + 1, linfo->node, scope, strTab);
 
-    doIndent(os, depth);
-    *os << "</L>\n";
+    doScopeEnd(os, depth, "L");
+  }
+}
+
+//----------------------------------------------------------------------
+
+// Begin <A> alien tag with empty vma set (guard, caller and callee
+// aliens all have this form).
+//
+static void
+doAlienBegin(ostream * os, int depth, long line, const string & file,
+	     const string & name)
+{
+  if (binFile != NULL) {
+    binFile->beginNode(HPCSTRUCT_FMT_Ty_Alien, next_index++, line, name, file);
+    return;
   }
+
+  doIndent(os, depth);
+  *os << "<A"
+      << INDEX
+      << NUMBER("l", line)
+      << STRING("f", file)
+      << STRING("n", name)
+      << " v=\"{}\""
+      << ">\n";
+}
+
+// Closing tag for <A> and <L> scopes.
+static void
+doScopeEnd(ostream * os, int depth, const char * tag)
+{
+  if (binFile != NULL) {
+    binFile->endNode();
+    return;
+  }
+
+  doIndent(os, depth);
+  *os << "</" << tag << ">\n";
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +66,8 @@ namespace Output {
 using namespace Struct;
 using namespace std;
 
+void setBinaryFormat(bool);
+
 void printStructFileBegin(ostream *, ostream *, string);
 void printStructFileEnd(ostream *, ostream *);
 
@@ -75,6 +75,7 @@
 #include <set>
 #include <string>
 #include <vector>
+#include <condition_variable>
 #include <mutex>
 #include <ostream>
 #include <sstream>
@@ -152,8 +153,9 @@ static const string & unknown_file = "<unknown file>";
 static const string & unknown_proc = "<unknown proc>";
 static const string & unknown_link = "_unknown_proc_";
 
-// FIXME: temporary until the line map problems are resolved
-static Symtab * the_symtab = NULL;
+// FIXME: temporary until the line map problems are resolved.
+// Per-thread for makeImageList(), see Struct-Inline.cpp.
+static thread_local Symtab * the_symtab = NULL;
 
 static BAnal::Struct::Options opts;
 
@@ -165,6 +167,7 @@ namespace Struct {
 class HeaderInfo;
 class WorkEnv;
 class WorkItem;
+class ImageItem;
 class LineMapCache;
 
 typedef map <Block *, bool> BlockSet;
@@ -172,12 +175,13 @@ typedef map <VMA, HeaderInfo> HeaderList;
 typedef map <VMA, Region *> RegionMap;
 typedef vector <Statement::Ptr> StatementVector;
 typedef vector <WorkItem *> WorkList;
+typedef vector <ImageItem *> ImageList;
 
 static FileMap *
 makeSkeleton(CodeObject *, const string &);
 
 static void
-doWorkItem(WorkItem *, string &, bool, bool);
+doWorkItem(WorkItem *, string &, bool, bool, Symtab *);
 
 static void
 makeWorkList(FileMap *, WorkList &, WorkList &);
@@ -185,6 +189,10 @@ makeWorkList(FileMap *, WorkList &, WorkList &);
 static void
 printWorkList(WorkList &, uint &, ostream *, ostream *, string &);
 
+static void
+makeImageList(ElfFileVector *, const string &, ostream *, ostream *,
+	      string &, string &);
+
 static void
 doFunctionList(WorkEnv &, FileInfo *, GroupInfo *, bool);
 
@@ -345,6 +353,29 @@ public:
 
 //----------------------------------------------------------------------
 
+// One ELF image from the input file and its analysis, for analyzing
+// several images at once.  Each image is analyzed by one thread.
+class ImageItem {
+public:
+  ElfFile * elfFile;
+  Symtab * symtab;
+  SymtabCodeSource * code_src;
+  CodeObject * code_obj;
+  WorkList wlPrint;
+  bool is_done;
+
+  ImageItem(ElfFile * elf)
+  {
+    elfFile = elf;
+    symtab = NULL;
+    code_src = NULL;
+    code_obj = NULL;
+    is_done = false;
+  }
+};
+
+//----------------------------------------------------------------------
+
 // A simple cache of getStatement() that stores one line range.  This
 // saves extra calls to getSourceLines() if we don't need them.
 //
@@ -574,8 +605,21 @@ makeStructure(string filename,
     return;
   }
 
+  Output::setBinaryFormat(opts.binary_format);
   Output::printStructFileBegin(outFile, gapsFile, sfilename);
 
+  // many small images (cuda fatbins, archives) parallelize better
+  // across images than within each one.
+  if (opts.jobs_images > 1 && elfFileVector->size() > 1) {
+    string basename = FileUtil::basename(cfilename);
+
+    makeImageList(elfFileVector, basename, outFile, gapsFile,
+		  gaps_filenm, search_path);
+
+    Output::printStructFileEnd(outFile, gapsFile);
+    return;
+  }
+
   for (uint i = 0; i < elfFileVector->size(); i++) {
     ElfFile *elfFile = (*elfFileVector)[i];
 
@@ -661,11 +705,11 @@ makeStructure(string filename,
 
 #pragma omp parallel  default(none)				\
     shared(wlPrint, wlLaunch, num_done, output_mtx)		\
-    firstprivate(outFile, gapsFile, search_path, gaps_filenm, cuda_file)
+    firstprivate(outFile, gapsFile, search_path, gaps_filenm, cuda_file, symtab)
     {
 #pragma omp for  schedule(dynamic, 1)
       for (uint i = 0; i < wlLaunch.size(); i++) {
-	doWorkItem(wlLaunch[i], search_path, cuda_file, gapsFile != NULL);
+	doWorkItem(wlLaunch[i], search_path, cuda_file, gapsFile != NULL, symtab);
 
 	// the printing must be single threaded
 	if (output_mtx.try_lock()) {
@@ -696,7 +740,7 @@ makeStructure(string filename,
 
       delete code_obj;
       delete code_src;
-      Inline::closeSymtab();
+      Inline::closeSymtab(symtab);
     }
   }
 
@@ -705,17 +749,165 @@ makeStructure(string filename,
 
 //----------------------------------------------------------------------
 
+//
+// Analyze one image start to finish on this thread: symtab, line map,
+// parseapi, skeleton and all of its work items.  Inner parallel
+// regions are nested, so they run with one thread.
+//
+static void
+analyzeImage(ImageItem * image, const string & basename,
+	     string & search_path, bool fullGaps)
+{
+  Symtab * symtab = Inline::openSymtab(image->elfFile);
+
+  if (symtab != NULL) {
+    the_symtab = symtab;
+    bool cuda_file = SYMTAB_ARCH_CUDA(symtab);
+
+    vector <Module *> modVec;
+    symtab->getAllModules(modVec);
+
+    for (uint i = 0; i < modVec.size(); i++) {
+      modVec[i]->parseLineInformation();
+    }
+
+    image->code_src = new SymtabCodeSource(symtab);
+    image->code_obj = new CodeObject(image->code_src);
+
+    if (! cuda_file) {
+      image->code_obj->parse();
+    }
+
+    FileMap * fileMap = makeSkeleton(image->code_obj, basename);
+    WorkList wlLaunch;
+
+    makeWorkList(fileMap, image->wlPrint, wlLaunch);
+
+    for (uint i = 0; i < wlLaunch.size(); i++) {
+      doWorkItem(wlLaunch[i], search_path, cuda_file, fullGaps, symtab);
+    }
+  }
+
+  image->symtab = symtab;
+}
+
+//
+// Print the images that are done, in image order, and free them.  As
+// with printWorkList(), this must be called locked or single threaded.
+//
+static void
+printImageList(ImageList & imageList, uint & num_done, ostream * outFile,
+	       ostream * gapsFile, string & gaps_filenm)
+{
+  while (num_done < imageList.size() && imageList[num_done]->is_done) {
+    ImageItem * image = imageList[num_done];
+
+    if (image->symtab != NULL) {
+      uint num_items = 0;
+
+      Output::printLoadModuleBegin(outFile, image->elfFile->getFileName());
+      printWorkList(image->wlPrint, num_items, outFile, gapsFile, gaps_filenm);
+      Output::printLoadModuleEnd(outFile);
+
+      for (uint i = 0; i < image->wlPrint.size(); i++) {
+	delete image->wlPrint[i];
+      }
+      delete image->code_obj;
+      delete image->code_src;
+      Inline::closeSymtab(image->symtab);
+    }
+
+    delete image;
+    imageList[num_done] = NULL;
+    num_done++;
+  }
+}
+
+//
+// Analyze up to opts.jobs_images images at once.  The output is
+// assembled in image order, so the structure file is the same as
+// from the serial loop in makeStructure().
+//
+// An image is freed only after it and all earlier images are
+// printed, so a thread doesn't start an image more than jobs_images
+// past the first unprinted one.  Otherwise, one slow image would
+// keep every later image's symtab and code object in memory.  Images
+// are handed out in order under output_mtx, so the images before a
+// waiting thread's next one are all in progress or done.
+//
+static void
+makeImageList(ElfFileVector * elfFileVector, const string & basename,
+	      ostream * outFile, ostream * gapsFile, string & gaps_filenm,
+	      string & search_path)
+{
+  ImageList imageList;
+  uint num_done = 0;
+  uint num_next = 0;
+  uint window = opts.jobs_images;
+  mutex output_mtx;
+  condition_variable done_cv;
+
+  for (uint i = 0; i < elfFileVector->size(); i++) {
+    imageList.push_back(new ImageItem((*elfFileVector)[i]));
+  }
+
+#pragma omp parallel  num_threads(opts.jobs_images)  default(none)	\
+    shared(imageList, num_done, num_next, window, output_mtx, done_cv,	\
+	   basename)							\
+    firstprivate(outFile, gapsFile, search_path, gaps_filenm)
+  {
+    for (;;) {
+      uint i;
+      {
+	unique_lock <mutex> lock(output_mtx);
+
+	// wait for the window to move, printing whatever is done
+	for (;;) {
+	  printImageList(imageList, num_done, outFile, gapsFile, gaps_filenm);
+	  if (num_next >= imageList.size() || num_next < num_done + window) {
+	    break;
+	  }
+	  done_cv.wait(lock);
+	}
+	i = num_next++;
+      }
+
+      if (i >= imageList.size()) {
+	break;
+      }
+
+      analyzeImage(imageList[i], basename, search_path, gapsFile != NULL);
+
+      // set is_done under the lock that the printer holds and wake
+      // the waiters.  This thread prints it at the top of the loop,
+      // unless another thread gets there first.
+      output_mtx.lock();
+      imageList[i]->is_done = true;
+      output_mtx.unlock();
+      done_cv.notify_all();
+    }
+  }  // end parallel
+
+  printImageList(imageList, num_done, outFile, gapsFile, gaps_filenm);
+}
+
+//----------------------------------------------------------------------
+
 //
 // Make the inline tree for funcs in one proc group.  This much can
 // run concurrently.
 //
 static void
 doWorkItem(WorkItem * witem, string & search_path, bool cuda_file,
-	   bool fullGaps)
+	   bool fullGaps, Symtab * symtab)
 {
   FileInfo * finfo = witem->finfo;
   GroupInfo * ginfo = witem->ginfo;
 
+  // the symtab may have been opened on another thread
+  the_symtab = symtab;
+  Inline::setSymtab(symtab);
+
   // each work item gets its own string table and path manager to
   // avoid lock contention.
   HPC::StringTable * strTab = new HPC::StringTable;
@@ -64,16 +64,20 @@ public:
   int  jobs;
   int  jobs_parse;
   int  jobs_symtab;
+  int  jobs_images;
   bool show_time;
   bool ourDemangle;
+  bool binary_format;
 
   Options()
   {
     jobs = 1;
     jobs_parse = 1;
     jobs_symtab = 1;
+    jobs_images = 1;
     show_time = false;
     ourDemangle = false;
+    binary_format = false;
   }
 };
 
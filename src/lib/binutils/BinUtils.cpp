@@ -50,6 +50,7 @@ using std::string;
 
 #include <cstdlib> // for 'free'
 #include <cstring> // for 'strlen', 'strcpy'
+#include <mutex>
 
 #include <hpctoolkit-config.h>
 
@@ -101,4 +102,24 @@ demangleProcName(const std::string& name)
   return bestname;
 }
 
+
+static std::recursive_mutex&
+bfdMutex()
+{
+  static std::recursive_mutex mtx;
+  return mtx;
+}
+
+
+BfdLock::BfdLock()
+{
+  bfdMutex().lock();
+}
+
+
+BfdLock::~BfdLock()
+{
+  bfdMutex().unlock();
+}
+
 } // namespace BinUtil
@@ -85,6 +85,20 @@ std::string
 demangleProcName(const std::string& name);
 
 
+// BfdLock: BFD is not thread safe.  Different load modules may be
+// opened, read and queried on different threads, but calls into BFD
+// must hold this (recursive) lock for the lifetime of a BfdLock object.
+class BfdLock {
+public:
+  BfdLock();
+  ~BfdLock();
+
+private:
+  BfdLock(const BfdLock&);
+  BfdLock& operator=(const BfdLock&);
+};
+
+
 } // namespace BinUtil
 
 
@@ -93,6 +93,7 @@ using std::endl;
 #include "Proc.hpp"
 #include "SimpleSymbolsFactories.hpp"
 #include "Dbg-LM.hpp"
+#include "LineTable.hpp"
 
 //***************************************************************************
 // macros
@@ -325,6 +326,9 @@ public:
 static void
 dumpSymFlag(std::ostream& o, asymbol* sym, int flag, const char* txt, bool& hasPrinted);
 
+static bool
+isSameFile(const string& lineFile, const string& procFile);
+
 
 //***************************************************************************
 
@@ -345,6 +349,7 @@ BinUtil::LM::LM(bool useBinutils)
     m_bfdDynSymTab(NULL), m_bfdSynthTab(NULL),
     m_bfdSymTabSort(NULL), m_bfdSymTabSz(0), m_bfdDynSymTabSz(0),
     m_bfdSymTabSortSz(0), m_bfdSynthTabSz(0), m_noreturns(0), 
+    m_lineTable(NULL), m_lineTableRead(false),
     m_realpathMgr(RealPathMgr::singleton()), m_useBinutils(useBinutils),
     m_simpleSymbols(0)
 {
@@ -365,6 +370,7 @@ BinUtil::LM::~LM()
 
   // BFD info
   if (m_bfd) {
+    BfdLock guard;
     bfd_close(m_bfd);
     m_bfd = NULL;
   }
@@ -381,13 +387,14 @@ BinUtil::LM::~LM()
   m_bfdSymTabSz = 0;
   m_bfdSymTabSortSz = 0;
   m_bfdSynthTabSz = 0;
-  
-  // reset isa
-  delete isa;
-  isa = NULL;
+
+  // N.B.: 'isa' is shared with any other open LMs; keep it.
 
   delete m_noreturns;
   m_noreturns = NULL;
+
+  delete m_lineTable;
+  m_lineTable = NULL;
 }
 
 
@@ -396,7 +403,7 @@ BinUtil::LM::open(const char* filenm)
 {
   DIAG_Assert(Logic::implies(!m_name.empty(), m_name.c_str() == filenm),
 	      "Cannot open a different file!");
-  
+
   if (simpleSymbolsFactories.find(filenm)) {
     m_name = filenm;
     return;
@@ -404,55 +411,54 @@ BinUtil::LM::open(const char* filenm)
 
   // -------------------------------------------------------
   // 1. Initialize bfd and open the object file.
-  // -------------------------------------------------------
-
-  // Determine file existence.
-  bfd_init();
-  m_bfd = bfd_openr(filenm, "default");
-  if (!m_bfd) {
-    BINUTIL_Throw("'" << filenm << "': " << bfd_errmsg(bfd_get_error()));
-  }
-  
-  // bfd_object:  may contain data, symbols, relocations and debug info
-  // bfd_archive: contains other BFDs and an optional index
-  // bfd_core:    contains the result of an executable core dump
-  if (!bfd_check_format(m_bfd, bfd_object)) {
-    BINUTIL_Throw("'" << filenm << "': not an object or executable");
-  }
-  
-  m_name = filenm;
-  m_realpathMgr.realpath(m_name);
-  
-  // -------------------------------------------------------
   // 2. Collect data from BFD
+  // 3. Configure ISA.
   // -------------------------------------------------------
 
-  // Set flags.  FIXME: both executable and dynamic flags can be set
-  // on some architectures (e.g. alpha).
-  flagword flags = bfd_get_file_flags(m_bfd);
-  if (flags & EXEC_P) {         // BFD is directly executable
-    m_type = TypeExe;
-  } 
-  else if (flags & DYNAMIC) { // BFD is a dynamic object
-    m_type = TypeDSO;
-  } 
-  else {
-    m_type = TypeNULL;
-  }
+  // Only the BFD calls (and the shared 'isa') need the BfdLock;
+  // resolving the real path below is done outside it.
+  {
+    BfdLock guard;
 
-  m_txtBeg = bfd_get_start_address(m_bfd); // entry point
-  m_begVMA = m_txtBeg;
+    // Determine file existence.
+    bfd_init();
+    m_bfd = bfd_openr(filenm, "default");
+    if (!m_bfd) {
+      BINUTIL_Throw("'" << filenm << "': " << bfd_errmsg(bfd_get_error()));
+    }
 
-  // -------------------------------------------------------
-  // 3. Configure ISA.  
-  // -------------------------------------------------------
+    // bfd_object:  may contain data, symbols, relocations and debug info
+    // bfd_archive: contains other BFDs and an optional index
+    // bfd_core:    contains the result of an executable core dump
+    if (!bfd_check_format(m_bfd, bfd_object)) {
+      BINUTIL_Throw("'" << filenm << "': not an object or executable");
+    }
+
+    // Set flags.  FIXME: both executable and dynamic flags can be set
+    // on some architectures (e.g. alpha).
+    flagword flags = bfd_get_file_flags(m_bfd);
+    if (flags & EXEC_P) {         // BFD is directly executable
+      m_type = TypeExe;
+    }
+    else if (flags & DYNAMIC) { // BFD is a dynamic object
+      m_type = TypeDSO;
+    }
+    else {
+      m_type = TypeNULL;
+    }
 
-  // We no longer use binutils to crack instructions on any platform,
-  // so EmptyISA is a stub until we remove binutils entirely.
+    m_txtBeg = bfd_get_start_address(m_bfd); // entry point
+    m_begVMA = m_txtBeg;
 
-  if (! isa) {
-    isa = new EmptyISA;
+    // We no longer use binutils to crack instructions on any platform,
+    // so EmptyISA is a stub until we remove binutils entirely.
+    if (! isa) {
+      isa = new EmptyISA;
+    }
   }
+
+  m_name = filenm;
+  m_realpathMgr.realpath(m_name);
 }
 
 
@@ -464,6 +470,8 @@ BinUtil::LM::read(const std::set<std::string> &directorySet, LM::ReadFlg readflg
 
   m_readFlags = (ReadFlg)(readflg | LM::ReadFlg_fSeg); // enforce ReadFlg rules
 
+  // N.B.: the readers below take the BfdLock around their BFD calls
+  // only, so other load modules may be read meanwhile.
   SimpleSymbolsFactory *sf = simpleSymbolsFactories.find(m_name.c_str());
   if (sf){
     m_simpleSymbols = sf->create();
@@ -548,7 +556,63 @@ BinUtil::LM::findSrcCodeInfo(VMA vma, ushort opIndex,
     return STATUS;
   }
 
+  // Try the sorted line table first.  The function is the enclosing
+  // procedure, whose name also comes from the debugging information
+  // (cf. TextSeg::findProcName()).  Fall back to BFD for addresses
+  // outside of any procedure or line table row, and for inlined code,
+  // where BFD names the inlined function instead.  Only the fallback
+  // and the first query per file need a BfdLock.
+  if (!m_lineTableRead) {
+    m_lineTableRead = true;
+    m_lineTable = new LineTable;
+    if (!m_lineTable->read(m_bfd) || m_lineTable->empty()) {
+      delete m_lineTable;
+      m_lineTable = NULL;
+    }
+  }
+
+  Proc* proc = (m_lineTable) ? findProc(vma) : NULL;
+  uint fileIdx = 0;
+  SrcFile::ln ln = 0;
+  if (proc && !m_lineTable->isInlined(opVMA)
+      && m_lineTable->find(opVMA, fileIdx, ln)) {
+    if (!m_lineTable->isResolved(fileIdx)) {
+      BfdLock guard;
+
+      // .debug_line lacks the compilation directory; ask BFD once
+      string nm = m_lineTable->fileName(fileIdx);
+      if (nm.empty() || nm[0] != '/') {
+	const char *bfd_func = NULL, *bfd_file = NULL;
+	uint bfd_line = 0;
+	bfd_boolean fnd =
+	  bfd_find_nearest_line(m_bfd, bfdSeg, m_bfdSymTab, opVMA - base,
+				&bfd_file, &bfd_func, &bfd_line);
+	if (fnd && bfd_file) {
+	  nm = bfd_file;
+	}
+      }
+      if (!nm.empty()) {
+	m_realpathMgr.realpath(nm);
+      }
+      m_lineTable->resolve(fileIdx, nm);
+    }
+
+    // A row from another file than the procedure's (inlining that
+    // .debug_info did not describe) also goes to BFD.
+    const string& nm = m_lineTable->fileName(fileIdx);
+    if (isSameFile(nm, proc->filename())) {
+      func = proc->name();
+      file = nm;
+      line = ln;
+
+      STATUS = (!file.empty() && !func.empty() && SrcFile::isValid(line));
+      return STATUS;
+    }
+  }
+
   // Obtain the source line information.
+  BfdLock guard;
+
   const char *bfd_func = NULL, *bfd_file = NULL;
   uint bfd_line = 0;
   bfd_boolean fnd = 
@@ -807,56 +871,61 @@ BinUtil::LM::cmpBFDSymByVMA(const void* s1, const void* s2)
 void
 BinUtil::LM::readSymbolTables()
 {
-  // -------------------------------------------------------
-  // Read the normal symbol table
-  // -------------------------------------------------------
-  long bytesNeeded = bfd_get_symtab_upper_bound(m_bfd);
-  
-  if (bytesNeeded > 0) {
-    m_bfdSymTab = new asymbol*[bytesNeeded / sizeof(asymbol*)];
-    m_bfdSymTabSz = bfd_canonicalize_symtab(m_bfd, m_bfdSymTab);
-
-    if (m_bfdSymTabSz == 0) {
-      delete[] m_bfdSymTab;
-      m_bfdSymTab = NULL;
-      DIAG_Msg(2, "'" << name() << "': No regular symbols found.");
-    }
-  }
-
-  // -------------------------------------------------------
-  // Read the dynamic symbol table 
-  // -------------------------------------------------------
+  // Only reading the tables calls into BFD; sorting our copy does not.
   {
-    bytesNeeded = bfd_get_dynamic_symtab_upper_bound(m_bfd);
+    BfdLock guard;
 
+    // -------------------------------------------------------
+    // Read the normal symbol table
+    // -------------------------------------------------------
+    long bytesNeeded = bfd_get_symtab_upper_bound(m_bfd);
+  
     if (bytesNeeded > 0) {
-      m_bfdDynSymTab = new asymbol*[bytesNeeded / sizeof(asymbol*)];
-      m_bfdDynSymTabSz = bfd_canonicalize_dynamic_symtab(m_bfd, m_bfdDynSymTab);
+      m_bfdSymTab = new asymbol*[bytesNeeded / sizeof(asymbol*)];
+      m_bfdSymTabSz = bfd_canonicalize_symtab(m_bfd, m_bfdSymTab);
+
+      if (m_bfdSymTabSz == 0) {
+        delete[] m_bfdSymTab;
+        m_bfdSymTab = NULL;
+        DIAG_Msg(2, "'" << name() << "': No regular symbols found.");
+      }
     }
 
-    if (m_bfdDynSymTabSz == 0) {
-      DIAG_Msg(2, "'" << name() << "': No dynamic symbols found.");
+    // -------------------------------------------------------
+    // Read the dynamic symbol table 
+    // -------------------------------------------------------
+    {
+      bytesNeeded = bfd_get_dynamic_symtab_upper_bound(m_bfd);
+
+      if (bytesNeeded > 0) {
+        m_bfdDynSymTab = new asymbol*[bytesNeeded / sizeof(asymbol*)];
+        m_bfdDynSymTabSz = bfd_canonicalize_dynamic_symtab(m_bfd, m_bfdDynSymTab);
+      }
+
+      if (m_bfdDynSymTabSz == 0) {
+        DIAG_Msg(2, "'" << name() << "': No dynamic symbols found.");
+      }
     }
-  }
 
-  // -------------------------------------------------------
-  // Append the synthetic symbol table to our copy for sorting.
-  // On many platforms this is empty, but it helps on powerpc.
-  //
-  // Note: the synthetic table is an array of asymbol structs,
-  // not an array of pointers, and not null-terminated.
-  // Note: the sorted table may be larger than the original table,
-  // and size is the size of the sorted table (regular + synthetic).
-  // -------------------------------------------------------
-  m_bfdSynthTabSz = bfd_get_synthetic_symtab(m_bfd, m_bfdSymTabSz, m_bfdSymTab, 
-					     m_bfdDynSymTabSz, m_bfdDynSymTab, 
-					     &m_bfdSynthTab);
-  if (m_bfdSynthTabSz < 0) {
-    m_bfdSynthTabSz = 0;
-  }
+    // -------------------------------------------------------
+    // Append the synthetic symbol table to our copy for sorting.
+    // On many platforms this is empty, but it helps on powerpc.
+    //
+    // Note: the synthetic table is an array of asymbol structs,
+    // not an array of pointers, and not null-terminated.
+    // Note: the sorted table may be larger than the original table,
+    // and size is the size of the sorted table (regular + synthetic).
+    // -------------------------------------------------------
+    m_bfdSynthTabSz = bfd_get_synthetic_symtab(m_bfd, m_bfdSymTabSz, m_bfdSymTab, 
+					       m_bfdDynSymTabSz, m_bfdDynSymTab, 
+					       &m_bfdSynthTab);
+    if (m_bfdSynthTabSz < 0) {
+      m_bfdSynthTabSz = 0;
+    }
 
-  if (m_bfdSynthTabSz == 0) {
-    DIAG_Msg(2, "'" << name() << "': No synthetic symbols found.");
+    if (m_bfdSynthTabSz == 0) {
+      DIAG_Msg(2, "'" << name() << "': No synthetic symbols found.");
+    }
   }
 
   m_bfdSymTabSort = new asymbol*[m_bfdSymTabSz + m_bfdSynthTabSz + 1];
@@ -882,7 +951,10 @@ BinUtil::LM::readSegs()
   // Create sections.
   // Pass symbol table and debug summary information for each section
   // into that section as it is created.
-  m_dbgInfo.read(m_bfd, m_bfdSymTab);
+  {
+    BfdLock guard;
+    m_dbgInfo.read(m_bfd, m_bfdSymTab);
+  }
 
   // Process each section in the object file.
   for (asection* sec = m_bfd->sections; (sec); sec = sec->next) {
@@ -1119,6 +1191,32 @@ dumpSymFlag(std::ostream& o,
 }
 
 
+// isSameFile: whether 'lineFile', a resolved line table file name,
+// names the file 'procFile' from a procedure's debugging information,
+// which may be relative to the compilation directory.
+static bool
+isSameFile(const string& lineFile, const string& procFile)
+{
+  if (procFile.empty()) {
+    return false;
+  }
+  if (lineFile == procFile) {
+    return true;
+  }
+  if (procFile[0] == '/') {
+    return false;
+  }
+
+  string rel = procFile;
+  while (rel.compare(0, 2, "./") == 0) {
+    rel = rel.substr(2);
+  }
+  return (lineFile.size() > rel.size()
+	  && lineFile.compare(lineFile.size() - rel.size(), rel.size(), rel) == 0
+	  && lineFile[lineFile.size() - rel.size() - 1] == '/');
+}
+
+
 //***************************************************************************
 // Exe
 //***************************************************************************
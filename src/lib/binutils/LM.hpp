@@ -104,6 +104,7 @@ class Proc;
 class Insn;
 //class LMImpl;
 class NoReturns;
+class LineTable;
 
 // --------------------------------------------------------------------------
 // 'LM' represents a load module, a binary loaded into memory
@@ -579,6 +580,10 @@ private:
 
   NoReturns *m_noreturns;
 
+  // sorted .debug_line rows for findSrcCodeInfo(), built on first use
+  LineTable* m_lineTable;
+  bool       m_lineTableRead;
+
   RealPathMgr& m_realpathMgr;
 
   bool m_useBinutils;
@@ -0,0 +1,1333 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <algorithm>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+#include <include/gnu_bfd.h>
+
+#include "LineTable.hpp"
+#include "BinUtils.hpp"
+
+#include <lib/support/diagnostics.h>
+
+//*************************** Forward Declarations **************************
+
+// DWARF constants (cf. dwarf.h)
+#define DW_LNS_copy               0x01
+#define DW_LNS_advance_pc         0x02
+#define DW_LNS_advance_line       0x03
+#define DW_LNS_set_file           0x04
+#define DW_LNS_const_add_pc       0x08
+#define DW_LNS_fixed_advance_pc   0x09
+
+#define DW_LNE_end_sequence       0x01
+#define DW_LNE_set_address        0x02
+#define DW_LNE_define_file        0x03
+
+#define DW_LNCT_path              0x1
+#define DW_LNCT_directory_index   0x2
+
+#define DW_UT_compile             0x01
+#define DW_UT_type                0x02
+#define DW_UT_partial             0x03
+#define DW_UT_skeleton            0x04
+#define DW_UT_split_compile       0x05
+#define DW_UT_split_type          0x06
+
+#define DW_TAG_inlined_subroutine 0x1d
+#define DW_TAG_compile_unit       0x11
+#define DW_TAG_partial_unit       0x3c
+#define DW_TAG_skeleton_unit      0x4a
+
+#define DW_AT_stmt_list           0x10
+#define DW_AT_low_pc              0x11
+#define DW_AT_high_pc             0x12
+#define DW_AT_ranges              0x55
+#define DW_AT_str_offsets_base    0x72
+#define DW_AT_addr_base           0x73
+#define DW_AT_rnglists_base       0x74
+#define DW_AT_dwo_name            0x76
+#define DW_AT_GNU_dwo_name        0x2130
+#define DW_AT_GNU_addr_base       0x2133
+
+#define DW_FORM_addr              0x01
+#define DW_FORM_block2            0x03
+#define DW_FORM_block4            0x04
+#define DW_FORM_data2             0x05
+#define DW_FORM_data4             0x06
+#define DW_FORM_data8             0x07
+#define DW_FORM_string            0x08
+#define DW_FORM_block             0x09
+#define DW_FORM_block1            0x0a
+#define DW_FORM_data1             0x0b
+#define DW_FORM_flag              0x0c
+#define DW_FORM_sdata             0x0d
+#define DW_FORM_strp              0x0e
+#define DW_FORM_udata             0x0f
+#define DW_FORM_ref_addr          0x10
+#define DW_FORM_ref1              0x11
+#define DW_FORM_ref2              0x12
+#define DW_FORM_ref4              0x13
+#define DW_FORM_ref8              0x14
+#define DW_FORM_ref_udata         0x15
+#define DW_FORM_indirect          0x16
+#define DW_FORM_sec_offset        0x17
+#define DW_FORM_exprloc           0x18
+#define DW_FORM_flag_present      0x19
+#define DW_FORM_strx              0x1a
+#define DW_FORM_addrx             0x1b
+#define DW_FORM_ref_sup4          0x1c
+#define DW_FORM_strp_sup          0x1d
+#define DW_FORM_data16            0x1e
+#define DW_FORM_line_strp         0x1f
+#define DW_FORM_ref_sig8          0x20
+#define DW_FORM_implicit_const    0x21
+#define DW_FORM_loclistx          0x22
+#define DW_FORM_rnglistx          0x23
+#define DW_FORM_ref_sup8          0x24
+#define DW_FORM_strx1             0x25
+#define DW_FORM_strx2             0x26
+#define DW_FORM_strx3             0x27
+#define DW_FORM_strx4             0x28
+#define DW_FORM_addrx1            0x29
+#define DW_FORM_addrx2            0x2a
+#define DW_FORM_addrx3            0x2b
+#define DW_FORM_addrx4            0x2c
+#define DW_FORM_GNU_addr_index    0x1f01
+#define DW_FORM_GNU_str_index     0x1f02
+#define DW_FORM_GNU_ref_alt       0x1f20
+#define DW_FORM_GNU_strp_alt      0x1f21
+
+#define DW_RLE_end_of_list        0x00
+#define DW_RLE_base_addressx      0x01
+#define DW_RLE_startx_endx        0x02
+#define DW_RLE_startx_length      0x03
+#define DW_RLE_offset_pair        0x04
+#define DW_RLE_base_address       0x05
+#define DW_RLE_start_end          0x06
+#define DW_RLE_start_length       0x07
+
+typedef BinUtil::LineTable::Section Section;
+typedef BinUtil::LineTable::Sections Sections;
+
+static const uint64_t NoOffset = UINT64_MAX;
+
+//***************************************************************************
+// Cursor: bounds-checked reads from a DWARF section
+//***************************************************************************
+
+namespace {
+
+class Cursor {
+public:
+  Cursor(const unsigned char* beg, const unsigned char* end, bool isBig)
+    : m_p(beg), m_end(end), m_isBig(isBig), m_ok(true)
+  { }
+
+  bool
+  ok() const
+  { return m_ok; }
+
+  bool
+  atEnd() const
+  { return !m_ok || m_p >= m_end; }
+
+  const unsigned char*
+  pos() const
+  { return m_p; }
+
+  void
+  seek(const unsigned char* p)
+  {
+    if (p < m_p || p > m_end) { m_ok = false; }
+    else { m_p = p; }
+  }
+
+  void
+  skip(uint64_t n)
+  {
+    if (!m_ok || n > (uint64_t)(m_end - m_p)) { m_ok = false; }
+    else { m_p += n; }
+  }
+
+  // an n-byte unsigned value in the binary's byte order
+  uint64_t
+  fixed(uint n)
+  {
+    uint64_t x = 0;
+    if (!m_ok || n > (uint64_t)(m_end - m_p)) {
+      m_ok = false;
+      return 0;
+    }
+    if (m_isBig) {
+      for (uint i = 0; i < n; ++i) { x = (x << 8) | m_p[i]; }
+    }
+    else {
+      for (uint i = n; i > 0; --i) { x = (x << 8) | m_p[i - 1]; }
+    }
+    m_p += n;
+    return x;
+  }
+
+  uint64_t
+  uleb()
+  {
+    uint64_t x = 0;
+    uint shift = 0;
+    while (m_ok) {
+      if (m_p >= m_end) { m_ok = false; break; }
+      unsigned char b = *m_p++;
+      if (shift < 64) { x |= ((uint64_t)(b & 0x7f)) << shift; }
+      shift += 7;
+      if (!(b & 0x80)) { break; }
+    }
+    return x;
+  }
+
+  int64_t
+  sleb()
+  {
+    int64_t x = 0;
+    uint shift = 0;
+    unsigned char b = 0;
+    while (m_ok) {
+      if (m_p >= m_end) { m_ok = false; break; }
+      b = *m_p++;
+      if (shift < 64) { x |= ((int64_t)(b & 0x7f)) << shift; }
+      shift += 7;
+      if (!(b & 0x80)) { break; }
+    }
+    if (shift < 64 && (b & 0x40)) {
+      x |= -(((int64_t)1) << shift);
+    }
+    return x;
+  }
+
+  const char*
+  cstr()
+  {
+    const unsigned char* s = m_p;
+    while (m_ok && m_p < m_end && *m_p != '\0') { m_p++; }
+    if (m_p >= m_end) {
+      m_ok = false;
+      return "";
+    }
+    m_p++; // '\0'
+    return (const char*)s;
+  }
+
+private:
+  const unsigned char* m_p;
+  const unsigned char* m_end;
+  bool m_isBig;
+  bool m_ok;
+};
+
+} // namespace
+
+
+//***************************************************************************
+// DWARF helpers
+//***************************************************************************
+
+namespace {
+
+// getSection: reads section 'nm' of 'abfd' into a malloc'd buffer
+// (to be freed by the caller), or returns false.
+bool
+getSection(bfd* abfd, const char* nm, Section& sec,
+	   std::vector<bfd_byte*>& bufs)
+{
+  BinUtil::BfdLock guard;
+
+  asection* bsec = bfd_get_section_by_name(abfd, nm);
+  bfd_byte* buf = NULL;
+  if (!bsec) {
+    return false;
+  }
+  // also decompresses compressed debug sections
+  if (!bfd_malloc_and_get_section(abfd, bsec, &buf)) {
+    return false;
+  }
+  bufs.push_back(buf);
+  sec.data = buf;
+  sec.size = bfd_section_size(abfd, bsec);
+  return true;
+}
+
+
+// strAt: the string at 'off' in 'sec', or "" if out of range
+const char*
+strAt(const Section& sec, uint64_t off)
+{
+  if (!sec.data || off >= sec.size
+      || !memchr(sec.data + off, '\0', sec.size - off)) {
+    return "";
+  }
+  return (const char*)(sec.data + off);
+}
+
+
+// fixedAt: the 'n'-byte value at 'off' in 'sec'.  Returns false if
+// out of range.
+bool
+fixedAt(const Sections& secs, const Section& sec, uint64_t off, uint n,
+	uint64_t& val)
+{
+  if (!sec.data || off > sec.size || n > sec.size - off) {
+    return false;
+  }
+  Cursor cur(sec.data + off, sec.data + sec.size, secs.isBig);
+  val = cur.fixed(n);
+  return cur.ok();
+}
+
+
+// An attribute specification of an abbreviation
+class AttrSpec {
+public:
+  uint64_t name;
+  uint64_t form;
+  int64_t  implicitConst;
+};
+
+
+class Abbrev {
+public:
+  Abbrev()
+    : tag(0)
+  { }
+
+  uint64_t tag; // 0: no such abbreviation
+  std::vector<AttrSpec> attrs;
+};
+
+
+// readAbbrevs: reads the abbreviation table at 'off', indexed by code.
+bool
+readAbbrevs(const Sections& secs, uint64_t off, std::vector<Abbrev>& abbrevs)
+{
+  const uint64_t MaxCode = 1 << 20;
+
+  if (off >= secs.abbrev.size) {
+    return false;
+  }
+  Cursor cur(secs.abbrev.data + off, secs.abbrev.data + secs.abbrev.size,
+	     secs.isBig);
+
+  while (cur.ok()) {
+    uint64_t code = cur.uleb();
+    if (code == 0) {
+      break;
+    }
+    if (code > MaxCode) {
+      return false;
+    }
+    if (code >= abbrevs.size()) {
+      abbrevs.resize(code + 1);
+    }
+    Abbrev& ab = abbrevs[code];
+    ab.tag = cur.uleb();
+    ab.attrs.clear();
+    cur.fixed(1); // DW_CHILDREN_*
+
+    while (cur.ok()) {
+      AttrSpec spec;
+      spec.name = cur.uleb();
+      spec.form = cur.uleb();
+      spec.implicitConst = 0;
+      if (spec.name == 0 && spec.form == 0) {
+	break;
+      }
+      if (spec.form == DW_FORM_implicit_const) {
+	spec.implicitConst = cur.sleb();
+      }
+      ab.attrs.push_back(spec);
+    }
+  }
+  return cur.ok();
+}
+
+
+bool
+isAddrIndexForm(uint64_t form)
+{
+  return (form == DW_FORM_addrx || form == DW_FORM_GNU_addr_index
+	  || (form >= DW_FORM_addrx1 && form <= DW_FORM_addrx4));
+}
+
+
+bool
+isConstantForm(uint64_t form)
+{
+  return (form == DW_FORM_data1 || form == DW_FORM_data2
+	  || form == DW_FORM_data4 || form == DW_FORM_data8
+	  || form == DW_FORM_udata || form == DW_FORM_sdata
+	  || form == DW_FORM_implicit_const);
+}
+
+
+// readForm: reads a value of 'form' (which DW_FORM_indirect replaces
+// with the actual form).  Constants, addresses, references, offsets
+// and indexes are returned in 'val'; strings and blocks are skipped.
+// Returns false for a form we do not know.
+bool
+readForm(Cursor& cur, uint64_t& form, int64_t implicitConst,
+	 uint version, uint offSz, uint addrSz, uint64_t& val)
+{
+  val = 0;
+  switch (form) {
+  case DW_FORM_addr:           val = cur.fixed(addrSz); break;
+  case DW_FORM_block1:         cur.skip(cur.fixed(1)); break;
+  case DW_FORM_block2:         cur.skip(cur.fixed(2)); break;
+  case DW_FORM_block4:         cur.skip(cur.fixed(4)); break;
+  case DW_FORM_block:
+  case DW_FORM_exprloc:        cur.skip(cur.uleb()); break;
+  case DW_FORM_data1:
+  case DW_FORM_flag:
+  case DW_FORM_ref1:
+  case DW_FORM_strx1:
+  case DW_FORM_addrx1:         val = cur.fixed(1); break;
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+  case DW_FORM_strx2:
+  case DW_FORM_addrx2:         val = cur.fixed(2); break;
+  case DW_FORM_strx3:
+  case DW_FORM_addrx3:         val = cur.fixed(3); break;
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_ref_sup4:
+  case DW_FORM_strx4:
+  case DW_FORM_addrx4:         val = cur.fixed(4); break;
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_sig8:
+  case DW_FORM_ref_sup8:       val = cur.fixed(8); break;
+  case DW_FORM_data16:         cur.skip(16); break;
+  case DW_FORM_string:         cur.cstr(); break;
+  case DW_FORM_sdata:          val = (uint64_t)cur.sleb(); break;
+  case DW_FORM_udata:
+  case DW_FORM_ref_udata:
+  case DW_FORM_strx:
+  case DW_FORM_addrx:
+  case DW_FORM_loclistx:
+  case DW_FORM_rnglistx:
+  case DW_FORM_GNU_addr_index:
+  case DW_FORM_GNU_str_index:  val = cur.uleb(); break;
+  case DW_FORM_strp:
+  case DW_FORM_line_strp:
+  case DW_FORM_sec_offset:
+  case DW_FORM_strp_sup:
+  case DW_FORM_GNU_ref_alt:
+  case DW_FORM_GNU_strp_alt:   val = cur.fixed(offSz); break;
+  case DW_FORM_ref_addr:
+    val = cur.fixed((version <= 2) ? addrSz : offSz);
+    break;
+  case DW_FORM_flag_present:   val = 1; break;
+  case DW_FORM_implicit_const: val = (uint64_t)implicitConst; break;
+  case DW_FORM_indirect:
+    form = cur.uleb();
+    if (form == DW_FORM_indirect || form == DW_FORM_implicit_const) {
+      return false;
+    }
+    return readForm(cur, form, 0, version, offSz, addrSz, val);
+  default:
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+
+//***************************************************************************
+// Unit: the parts of a .debug_info unit needed to interpret addresses
+//***************************************************************************
+
+class BinUtil::LineTable::Unit {
+public:
+  Unit()
+    : version(0), offSz(4), addrSz(8), addrBase(0), rnglistsBase(0),
+      base(0)
+  { }
+
+  // addrAt: the address at index 'idx' of .debug_addr
+  bool
+  addrAt(const Sections& secs, uint64_t idx, VMA& addr) const
+  {
+    uint64_t val = 0;
+    bool ok = fixedAt(secs, secs.addr, addrBase + idx * addrSz, addrSz, val);
+    addr = val;
+    return ok;
+  }
+
+  uint version;
+  uint offSz;
+  uint addrSz;
+  uint64_t addrBase;
+  uint64_t rnglistsBase;
+  VMA base; // base address for range lists
+};
+
+
+//***************************************************************************
+// LineTable
+//***************************************************************************
+
+BinUtil::LineTable::LineTable()
+{
+}
+
+
+BinUtil::LineTable::~LineTable()
+{
+}
+
+
+bool
+BinUtil::LineTable::read(bfd* abfd)
+{
+  // .debug_line in a relocatable object needs relocation
+  if (bfd_get_flavour(abfd) != bfd_target_elf_flavour
+      || (bfd_get_file_flags(abfd) & HAS_RELOC)) {
+    m_rows.clear();
+    m_files.clear();
+    m_resolved.clear();
+    m_inlined.clear();
+    return false;
+  }
+
+  Sections secs;
+  std::vector<bfd_byte*> bufs;
+
+  secs.isBig = bfd_big_endian(abfd);
+  if (getSection(abfd, ".debug_line", secs.line, bufs)) {
+    getSection(abfd, ".debug_str", secs.str, bufs);
+    getSection(abfd, ".debug_line_str", secs.lineStr, bufs);
+    getSection(abfd, ".debug_str_offsets", secs.strOffsets, bufs);
+    getSection(abfd, ".debug_info", secs.info, bufs);
+    getSection(abfd, ".debug_abbrev", secs.abbrev, bufs);
+    getSection(abfd, ".debug_addr", secs.addr, bufs);
+    getSection(abfd, ".debug_ranges", secs.ranges, bufs);
+    getSection(abfd, ".debug_rnglists", secs.rnglists, bufs);
+  }
+  // else: no line info, an empty table
+
+  secs.fileName = bfd_get_filename(abfd);
+
+  bool ret = read(secs);
+
+  for (uint i = 0; i < bufs.size(); ++i) {
+    free(bufs[i]);
+  }
+  return ret;
+}
+
+
+bool
+BinUtil::LineTable::read(const Sections& secs)
+{
+  m_rows.clear();
+  m_files.clear();
+  m_resolved.clear();
+  m_inlined.clear();
+
+  if (!secs.line.data) {
+    return true; // no line info: an empty table
+  }
+
+  // Find the inlined subroutines, and the string offsets base of each
+  // unit's line number program (for DW_FORM_strx in DWARF 5).  If a
+  // unit cannot be read, its inlining is unknown; then treat every
+  // address as inlined.
+  std::map<uint64_t, uint64_t> strOffBases; // .debug_line offset -> base
+
+  if (secs.info.data) {
+    uint64_t off = 0;
+    while (off < secs.info.size) {
+      if (!readInfoUnit(secs, off, strOffBases)) {
+	DIAG_DevMsg(2, "LineTable: malformed .debug_info at offset " << off);
+	m_inlined.push_back(Range(0, ~(VMA)0));
+	break;
+      }
+    }
+  }
+
+  std::sort(m_inlined.begin(), m_inlined.end());
+  std::vector<Range> inlined;
+  for (size_t i = 0; i < m_inlined.size(); ++i) {
+    if (!inlined.empty() && m_inlined[i].beg <= inlined.back().end) {
+      inlined.back().end = std::max(inlined.back().end, m_inlined[i].end);
+    }
+    else {
+      inlined.push_back(m_inlined[i]);
+    }
+  }
+  m_inlined.swap(inlined);
+
+  // Decode each unit's line number program.  A malformed unit ends the
+  // scan, but keeps rows from the earlier units.  A unit that uses a
+  // form we do not know is skipped (its addresses have no rows).
+  uint64_t off = 0;
+  uint64_t badForm = 0;
+  uint numBad = 0;
+  while (off < secs.line.size) {
+    std::map<uint64_t, uint64_t>::const_iterator it = strOffBases.find(off);
+    uint64_t strOffBase = (it != strOffBases.end()) ? it->second : NoOffset;
+    uint64_t unitForm = 0;
+    if (!readUnit(secs, off, strOffBase, unitForm)) {
+      DIAG_DevMsg(2, "LineTable: malformed .debug_line at offset " << off);
+      break;
+    }
+    if (unitForm != 0) {
+      badForm = unitForm;
+      numBad++;
+    }
+  }
+  if (numBad > 0) {
+    DIAG_WMsg(1, "'" << secs.fileName << "': skipped " << numBad
+	      << " .debug_line unit(s) with unsupported DWARF form 0x"
+	      << std::hex << badForm << std::dec
+	      << "; their addresses are looked up with BFD");
+  }
+
+  // Sort by VMA.  At equal VMAs (across sequences), prefer the last
+  // valid row (in program order) over an end of sequence.
+  std::stable_sort(m_rows.begin(), m_rows.end());
+
+  std::vector<Row> rows;
+  rows.reserve(m_rows.size());
+  for (size_t i = 0; i < m_rows.size(); /* */) {
+    size_t j = i;
+    const Row* best = &m_rows[i];
+    for ( ; j < m_rows.size() && m_rows[j].vma == m_rows[i].vma; ++j) {
+      if (m_rows[j].line != 0 || best->line == 0) {
+	best = &m_rows[j];
+      }
+    }
+    rows.push_back(*best);
+    i = j;
+  }
+  m_rows.swap(rows);
+
+  DIAG_DevMsg(2, "LineTable: " << m_rows.size() << " rows, "
+	      << m_files.size() << " files, "
+	      << m_inlined.size() << " inlined ranges");
+  return true;
+}
+
+
+bool
+BinUtil::LineTable::find(VMA vma, uint& fileIdx, SrcFile::ln& line) const
+{
+  // the last row with row.vma <= vma
+  std::vector<Row>::const_iterator it =
+    std::upper_bound(m_rows.begin(), m_rows.end(), Row(vma));
+  if (it == m_rows.begin()) {
+    return false;
+  }
+  --it;
+
+  if (it->line == 0) {
+    return false; // past the end of a sequence
+  }
+  fileIdx = it->file;
+  line = (SrcFile::ln)it->line;
+  return true;
+}
+
+
+bool
+BinUtil::LineTable::isInlined(VMA vma) const
+{
+  // the last range with range.beg <= vma
+  std::vector<Range>::const_iterator it =
+    std::upper_bound(m_inlined.begin(), m_inlined.end(), Range(vma));
+  if (it == m_inlined.begin()) {
+    return false;
+  }
+  --it;
+  return (vma < it->end);
+}
+
+
+uint
+BinUtil::LineTable::addFile(const string& dir, const string& name)
+{
+  string path;
+
+  if (name.empty() || name[0] == '/' || dir.empty()) {
+    path = name;
+  }
+  else {
+    path = dir + "/" + name;
+  }
+
+  m_files.push_back(path);
+  m_resolved.push_back(false);
+  return (uint)(m_files.size() - 1);
+}
+
+
+void
+BinUtil::LineTable::addRange(VMA beg, VMA end)
+{
+  // the linker moves discarded functions to 0 (or -1 with lld)
+  if (beg != 0 && beg < end) {
+    m_inlined.push_back(Range(beg, end));
+  }
+}
+
+
+// readUnit: decodes the line number program at 'off' and advances
+// 'off' past it.  'strOffBase' is the unit's DW_AT_str_offsets_base
+// (or NoOffset).  If the unit uses a form we do not know, it is
+// skipped and 'badForm' is set to the form.
+bool
+BinUtil::LineTable::readUnit(const Sections& secs, uint64_t& off,
+			     uint64_t strOffBase, uint64_t& badForm)
+{
+  const unsigned char* secBeg = secs.line.data;
+  const unsigned char* secEnd = secs.line.data + secs.line.size;
+
+  const uint NoFile = UINT_MAX;
+
+  Cursor hdr(secBeg + off, secEnd, secs.isBig);
+
+  // ------------------------------------------------------------
+  // Header
+  // ------------------------------------------------------------
+  uint offSz = 4;
+  uint64_t unitLen = hdr.fixed(4);
+  if (unitLen == 0xffffffff) {
+    offSz = 8;
+    unitLen = hdr.fixed(8);
+  }
+  if (!hdr.ok() || unitLen > (uint64_t)(secEnd - hdr.pos())) {
+    return false;
+  }
+  const unsigned char* unitEnd = hdr.pos() + unitLen;
+  off = unitEnd - secBeg;
+
+  Cursor cur(hdr.pos(), unitEnd, secs.isBig);
+
+  uint version = cur.fixed(2);
+  if (version < 2 || version > 5) {
+    return true; // skip units we do not understand
+  }
+
+  uint addrSz = 0;
+  if (version >= 5) {
+    addrSz = cur.fixed(1);
+    cur.fixed(1); // segment_selector_size
+  }
+
+  uint64_t hdrLen = cur.fixed(offSz);
+  const unsigned char* progBeg = cur.pos() + hdrLen;
+
+  uint minInsnLen = cur.fixed(1);
+  if (version >= 4) {
+    cur.fixed(1); // maximum_operations_per_instruction (VLIW only)
+  }
+  cur.fixed(1); // default_is_stmt
+  int lineBase = (signed char)cur.fixed(1);
+  uint lineRange = cur.fixed(1);
+  uint opBase = cur.fixed(1);
+
+  if (!cur.ok() || lineRange == 0 || opBase == 0) {
+    return false;
+  }
+
+  std::vector<uint> opLens(opBase, 0);
+  for (uint i = 1; i < opBase; ++i) {
+    opLens[i] = cur.fixed(1);
+  }
+
+  // ------------------------------------------------------------
+  // Directory and file tables
+  // ------------------------------------------------------------
+  std::vector<string> dirs;
+  std::vector<uint> files; // unit file number -> m_files index
+
+  if (version < 5) {
+    dirs.push_back(""); // 0: the compilation directory (unknown here)
+    while (cur.ok()) {
+      const char* dir = cur.cstr();
+      if (dir[0] == '\0') { break; }
+      dirs.push_back(dir);
+    }
+
+    files.push_back(NoFile); // file numbers are 1-based
+    while (cur.ok()) {
+      const char* nm = cur.cstr();
+      if (nm[0] == '\0') { break; }
+      uint64_t dirIdx = cur.uleb();
+      cur.uleb(); // mtime
+      cur.uleb(); // length
+      const string& dir = (dirIdx < dirs.size()) ? dirs[dirIdx] : dirs[0];
+      files.push_back(addFile(dir, nm));
+    }
+  }
+  else {
+    // DWARF 5: self-describing entry formats, both tables 0-based
+    for (int tbl = 0; tbl < 2 && cur.ok(); ++tbl) {
+      uint fmtCnt = cur.fixed(1);
+      std::vector<std::pair<uint64_t, uint64_t> > fmt;
+      for (uint i = 0; i < fmtCnt; ++i) {
+	uint64_t lnct = cur.uleb();
+	uint64_t form = cur.uleb();
+	fmt.push_back(std::make_pair(lnct, form));
+      }
+
+      uint64_t cnt = cur.uleb();
+      for (uint64_t i = 0; i < cnt && cur.ok(); ++i) {
+	const char* path = "";
+	uint64_t dirIdx = 0;
+
+	for (uint k = 0; k < fmt.size(); ++k) {
+	  uint64_t lnct = fmt[k].first;
+	  uint64_t val = 0;
+	  const char* str = NULL;
+
+	  uint64_t form = fmt[k].second;
+	  switch (form) {
+	  case DW_FORM_string:    str = cur.cstr(); break;
+	  case DW_FORM_line_strp:
+	    str = strAt(secs.lineStr, cur.fixed(offSz));
+	    break;
+	  case DW_FORM_strp:
+	    str = strAt(secs.str, cur.fixed(offSz));
+	    break;
+	  case DW_FORM_strx:
+	  case DW_FORM_strx1:
+	  case DW_FORM_strx2:
+	  case DW_FORM_strx3:
+	  case DW_FORM_strx4: {
+	    // an index into the unit's string offsets (from .debug_info)
+	    uint64_t idx = 0, strOff = 0;
+	    readForm(cur, form, 0, version, offSz, 0, idx);
+	    if (strOffBase == NoOffset
+		|| !fixedAt(secs, secs.strOffsets, strOffBase + idx * offSz,
+			    offSz, strOff)) {
+	      badForm = form;
+	      return true;
+	    }
+	    str = strAt(secs.str, strOff);
+	    break;
+	  }
+	  case DW_FORM_udata:     val = cur.uleb(); break;
+	  case DW_FORM_data1:     val = cur.fixed(1); break;
+	  case DW_FORM_data2:     val = cur.fixed(2); break;
+	  case DW_FORM_data4:     val = cur.fixed(4); break;
+	  case DW_FORM_data8:     val = cur.fixed(8); break;
+	  case DW_FORM_data16:    cur.skip(16); break;
+	  case DW_FORM_block:     cur.skip(cur.uleb()); break;
+	  default:
+	    badForm = form; // unknown form: can not parse this unit
+	    return true;
+	  }
+
+	  if (lnct == DW_LNCT_path && str) {
+	    path = str;
+	  }
+	  else if (lnct == DW_LNCT_directory_index) {
+	    dirIdx = val;
+	  }
+	}
+
+	if (tbl == 0) {
+	  dirs.push_back(path);
+	}
+	else {
+	  const string& dir = (dirIdx < dirs.size()) ? dirs[dirIdx] : "";
+	  files.push_back(addFile(dir, path));
+	}
+      }
+    }
+  }
+
+  if (!cur.ok()) {
+    return false;
+  }
+
+  // ------------------------------------------------------------
+  // Line number program
+  // ------------------------------------------------------------
+  cur.seek(progBeg);
+
+  VMA addr = 0;
+  uint64_t file = 1;
+  int64_t line = 1;
+  bool skipSeq = false; // sequence of a discarded function
+
+  std::vector<Row> seq;
+
+  while (!cur.atEnd()) {
+    uint op = cur.fixed(1);
+
+    if (op >= opBase) {
+      // special opcode
+      uint adj = op - opBase;
+      addr += (adj / lineRange) * minInsnLen;
+      line += lineBase + (int)(adj % lineRange);
+    }
+    else if (op == 0) {
+      // extended opcode
+      uint64_t len = cur.uleb();
+      const unsigned char* next = cur.pos() + len;
+      if (len == 0 || len > (uint64_t)(unitEnd - cur.pos())) {
+	return false;
+      }
+      uint eop = cur.fixed(1);
+
+      if (eop == DW_LNE_end_sequence) {
+	// rows at the end address are empty ranges
+	while (!seq.empty() && seq.back().vma == addr) {
+	  seq.pop_back();
+	}
+	seq.push_back(Row(addr, NoFile, 0));
+	if (!skipSeq) {
+	  m_rows.insert(m_rows.end(), seq.begin(), seq.end());
+	}
+	seq.clear();
+	addr = 0;
+	file = 1;
+	line = 1;
+	skipSeq = false;
+      }
+      else if (eop == DW_LNE_set_address) {
+	uint sz = (addrSz) ? addrSz : (uint)(len - 1);
+	addr = cur.fixed(sz);
+	// the linker moves discarded functions to 0 (or -1 with lld)
+	skipSeq = (addr == 0 || addr >= (VMA)-2);
+      }
+      else if (eop == DW_LNE_define_file) {
+	const char* nm = cur.cstr();
+	uint64_t dirIdx = cur.uleb();
+	const string& dir = (dirIdx < dirs.size()) ? dirs[dirIdx] : dirs[0];
+	files.push_back(addFile(dir, nm));
+      }
+      cur.seek(next);
+      continue;
+    }
+    else {
+      switch (op) {
+      case DW_LNS_copy:
+	break;
+      case DW_LNS_advance_pc:
+	addr += cur.uleb() * minInsnLen;
+	continue;
+      case DW_LNS_advance_line:
+	line += cur.sleb();
+	continue;
+      case DW_LNS_set_file:
+	file = cur.uleb();
+	continue;
+      case DW_LNS_const_add_pc:
+	addr += ((255 - opBase) / lineRange) * minInsnLen;
+	continue;
+      case DW_LNS_fixed_advance_pc:
+	addr += cur.fixed(2);
+	continue;
+      default:
+	// set_column, negate_stmt, etc. and unknown standard opcodes:
+	// skip their uleb operands
+	for (uint i = 0; i < opLens[op]; ++i) {
+	  cur.uleb();
+	}
+	continue;
+      }
+    }
+
+    // append a row (special opcode or DW_LNS_copy); within a sequence,
+    // the last row at an address wins
+    if (!seq.empty() && seq.back().vma == addr) {
+      seq.pop_back();
+    }
+    uint fileIdx = (file < files.size()) ? files[file] : NoFile;
+    if (fileIdx != NoFile && line > 0) {
+      seq.push_back(Row(addr, fileIdx, (uint)line));
+    }
+    else {
+      seq.push_back(Row(addr, NoFile, 0));
+    }
+  }
+
+  return cur.ok();
+}
+
+
+// readInfoUnit: records the address ranges of the inlined subroutines
+// of the .debug_info unit at 'off' and advances 'off' past it.  Also
+// maps the unit's DW_AT_stmt_list to its DW_AT_str_offsets_base.  A
+// unit whose inlining is unknown (a skeleton for split DWARF, or one
+// using a form we do not know) counts as inlined throughout.  Returns
+// false if the unit's addresses are unknown.
+bool
+BinUtil::LineTable::readInfoUnit(const Sections& secs, uint64_t& off,
+				 std::map<uint64_t, uint64_t>& strOffBases)
+{
+  const unsigned char* secBeg = secs.info.data;
+  const unsigned char* secEnd = secs.info.data + secs.info.size;
+
+  Cursor hdr(secBeg + off, secEnd, secs.isBig);
+
+  // ------------------------------------------------------------
+  // Header
+  // ------------------------------------------------------------
+  Unit unit;
+  uint64_t unitLen = hdr.fixed(4);
+  if (unitLen == 0xffffffff) {
+    unit.offSz = 8;
+    unitLen = hdr.fixed(8);
+  }
+  if (!hdr.ok() || unitLen > (uint64_t)(secEnd - hdr.pos())) {
+    return false;
+  }
+  const unsigned char* unitEnd = hdr.pos() + unitLen;
+  off = unitEnd - secBeg;
+
+  Cursor cur(hdr.pos(), unitEnd, secs.isBig);
+
+  unit.version = cur.fixed(2);
+  if (unit.version < 2 || unit.version > 5) {
+    return false;
+  }
+
+  uint unitTy = DW_UT_compile;
+  uint64_t abbrevOff = 0;
+  if (unit.version >= 5) {
+    unitTy = cur.fixed(1);
+    unit.addrSz = cur.fixed(1);
+    abbrevOff = cur.fixed(unit.offSz);
+    if (unitTy == DW_UT_skeleton || unitTy == DW_UT_split_compile) {
+      cur.skip(8); // dwo_id
+    }
+    else if (unitTy == DW_UT_type || unitTy == DW_UT_split_type) {
+      return true; // no code
+    }
+  }
+  else {
+    abbrevOff = cur.fixed(unit.offSz);
+    unit.addrSz = cur.fixed(1);
+  }
+
+  std::vector<Abbrev> abbrevs;
+  if (!cur.ok() || (unit.addrSz != 4 && unit.addrSz != 8)
+      || !readAbbrevs(secs, abbrevOff, abbrevs)) {
+    return false;
+  }
+
+  // ------------------------------------------------------------
+  // DIEs: the unit's DIE, then its descendants in preorder
+  // ------------------------------------------------------------
+  bool isSkeleton = (unitTy == DW_UT_skeleton);
+  bool isFirst = true;
+
+  // the unit's own ranges, in case its inlining is unknown
+  bool cuHasRanges = false, cuRangesIsIdx = false, cuHasHigh = false;
+  uint64_t cuRanges = 0;
+  VMA cuLow = 0, cuHigh = 0;
+
+  while (!cur.atEnd()) {
+    uint64_t code = cur.uleb();
+    if (code == 0) {
+      continue; // end of siblings
+    }
+
+    bool ok = (code < abbrevs.size() && abbrevs[code].tag != 0);
+    const Abbrev& ab = abbrevs[(ok) ? code : 0];
+
+    bool isUnit = (ab.tag == DW_TAG_compile_unit
+		   || ab.tag == DW_TAG_partial_unit
+		   || ab.tag == DW_TAG_skeleton_unit);
+    bool isInlined = (ab.tag == DW_TAG_inlined_subroutine);
+
+    uint64_t lowVal = 0, highVal = 0, rangesVal = 0;
+    uint64_t lowForm = 0, highForm = 0, rangesForm = 0;
+    uint64_t stmtList = NoOffset, strOffBase = NoOffset;
+
+    for (uint i = 0; ok && i < ab.attrs.size(); ++i) {
+      const AttrSpec& spec = ab.attrs[i];
+      uint64_t form = spec.form;
+      uint64_t val = 0;
+      ok = readForm(cur, form, spec.implicitConst, unit.version,
+		    unit.offSz, unit.addrSz, val) && cur.ok();
+      if (!ok || !(isUnit || isInlined)) {
+	continue;
+      }
+
+      switch (spec.name) {
+      case DW_AT_low_pc:  lowVal = val;  lowForm = form;  break;
+      case DW_AT_high_pc: highVal = val; highForm = form; break;
+      case DW_AT_ranges:  rangesVal = val; rangesForm = form; break;
+      default:
+	if (!isUnit) {
+	  break;
+	}
+	switch (spec.name) {
+	case DW_AT_stmt_list:        stmtList = val; break;
+	case DW_AT_str_offsets_base: strOffBase = val; break;
+	case DW_AT_addr_base:
+	case DW_AT_GNU_addr_base:    unit.addrBase = val; break;
+	case DW_AT_rnglists_base:    unit.rnglistsBase = val; break;
+	case DW_AT_dwo_name:
+	case DW_AT_GNU_dwo_name:     isSkeleton = true; break;
+	default:                     break;
+	}
+      }
+    }
+
+    if (!ok) {
+      // Without the abbreviation or the size of a form we cannot find
+      // the next DIE; count the rest of the unit as inlined.
+      if (isFirst) {
+	return false;
+      }
+      DIAG_DevMsg(2, "LineTable: unsupported DWARF form in .debug_info unit "
+		  "ending at offset " << off);
+      if (cuHasRanges) {
+	return readRanges(secs, unit, cuRanges, cuRangesIsIdx);
+      }
+      if (cuHasHigh) {
+	addRange(cuLow, cuHigh);
+	return true;
+      }
+      return false;
+    }
+
+    // Resolve the DIE's address range
+    VMA low = lowVal, high = 0;
+    bool hasLow = (lowForm != 0), hasHigh = false;
+    if (hasLow && isAddrIndexForm(lowForm)) {
+      hasLow = unit.addrAt(secs, lowVal, low);
+    }
+    if (hasLow && highForm != 0) {
+      hasHigh = true;
+      if (isConstantForm(highForm)) {
+	high = low + highVal;
+      }
+      else if (isAddrIndexForm(highForm)) {
+	hasHigh = unit.addrAt(secs, highVal, high);
+      }
+      else {
+	high = highVal;
+      }
+    }
+
+    if (isFirst) {
+      isFirst = false;
+      if (!isUnit) {
+	return false;
+      }
+      unit.base = (hasLow) ? low : 0;
+      if (stmtList != NoOffset && strOffBase != NoOffset) {
+	strOffBases[stmtList] = strOffBase;
+      }
+
+      cuHasRanges = (rangesForm != 0);
+      cuRangesIsIdx = (rangesForm == DW_FORM_rnglistx);
+      cuRanges = rangesVal;
+      cuHasHigh = hasHigh;
+      cuLow = low;
+      cuHigh = high;
+
+      if (isSkeleton) {
+	// the inlined subroutines are in the .dwo file
+	if (cuHasRanges) {
+	  return readRanges(secs, unit, cuRanges, cuRangesIsIdx);
+	}
+	if (cuHasHigh) {
+	  addRange(cuLow, cuHigh);
+	  return true;
+	}
+	return !hasLow; // no code
+      }
+    }
+    else if (isInlined) {
+      if (rangesForm != 0) {
+	if (!readRanges(secs, unit, rangesVal,
+			rangesForm == DW_FORM_rnglistx)) {
+	  return false;
+	}
+      }
+      else if (hasHigh) {
+	addRange(low, high);
+      }
+    }
+  }
+
+  return cur.ok();
+}
+
+
+// readRanges: records the address ranges of the range list at 'off'
+// (or, if 'isIndex', at index 'off' of the unit's offsets table).
+bool
+BinUtil::LineTable::readRanges(const Sections& secs, const Unit& unit,
+			       uint64_t off, bool isIndex)
+{
+  VMA base = unit.base;
+
+  // ------------------------------------------------------------
+  // DWARF 2-4: .debug_ranges
+  // ------------------------------------------------------------
+  if (unit.version < 5) {
+    if (!secs.ranges.data || off >= secs.ranges.size) {
+      return false;
+    }
+    const VMA maxAddr = (unit.addrSz == 8) ? ~(VMA)0 : (VMA)0xffffffff;
+
+    Cursor cur(secs.ranges.data + off, secs.ranges.data + secs.ranges.size,
+	       secs.isBig);
+    while (true) {
+      VMA beg = cur.fixed(unit.addrSz);
+      VMA end = cur.fixed(unit.addrSz);
+      if (!cur.ok()) {
+	return false;
+      }
+      if (beg == 0 && end == 0) {
+	return true;
+      }
+      if (beg == maxAddr) {
+	base = end;
+      }
+      else {
+	addRange(base + beg, base + end);
+      }
+    }
+  }
+
+  // ------------------------------------------------------------
+  // DWARF 5: .debug_rnglists
+  // ------------------------------------------------------------
+  if (isIndex) {
+    uint64_t rel = 0;
+    if (!fixedAt(secs, secs.rnglists, unit.rnglistsBase + off * unit.offSz,
+		 unit.offSz, rel)) {
+      return false;
+    }
+    off = unit.rnglistsBase + rel;
+  }
+  if (!secs.rnglists.data || off >= secs.rnglists.size) {
+    return false;
+  }
+
+  Cursor cur(secs.rnglists.data + off,
+	     secs.rnglists.data + secs.rnglists.size, secs.isBig);
+  while (cur.ok()) {
+    VMA beg = 0, end = 0;
+    bool ok = true;
+
+    switch (cur.fixed(1)) {
+    case DW_RLE_end_of_list:
+      return cur.ok();
+    case DW_RLE_base_addressx:
+      if (!unit.addrAt(secs, cur.uleb(), base)) {
+	return false;
+      }
+      continue;
+    case DW_RLE_startx_endx:
+      ok = unit.addrAt(secs, cur.uleb(), beg);
+      ok = unit.addrAt(secs, cur.uleb(), end) && ok;
+      break;
+    case DW_RLE_startx_length:
+      ok = unit.addrAt(secs, cur.uleb(), beg);
+      end = beg + cur.uleb();
+      break;
+    case DW_RLE_offset_pair:
+      beg = base + cur.uleb();
+      end = base + cur.uleb();
+      break;
+    case DW_RLE_base_address:
+      base = cur.fixed(unit.addrSz);
+      continue;
+    case DW_RLE_start_end:
+      beg = cur.fixed(unit.addrSz);
+      end = cur.fixed(unit.addrSz);
+      break;
+    case DW_RLE_start_length:
+      beg = cur.fixed(unit.addrSz);
+      end = beg + cur.uleb();
+      break;
+    default:
+      return false;
+    }
+
+    if (!ok) {
+      return false;
+    }
+    addRange(beg, end);
+  }
+  return false;
+}
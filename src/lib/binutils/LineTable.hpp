@@ -0,0 +1,232 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A sorted line table for a load module, read once from the DWARF
+//   .debug_line section.
+//
+// Description:
+//   bfd_find_nearest_line() is slow when called once per address on
+//   a large binary.  Instead, we decode every line number program up
+//   front into a VMA-sorted array of rows and answer each query with a
+//   binary search.  Each row covers [vma, next row's vma).
+//
+//   Rows only give a file and line.  For inlined code, the row is the
+//   callee's while the enclosing procedure is the caller, so the
+//   address ranges of inlined subroutines are read from .debug_info;
+//   clients should not attribute those addresses to the enclosing
+//   procedure (see isInlined()).
+//
+//   Only linked binaries (executables and shared libraries) are
+//   supported, since .debug_line in a relocatable object must first
+//   be relocated.
+//
+//***************************************************************************
+
+#ifndef BinUtil_LineTable_hpp
+#define BinUtil_LineTable_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/gnu_bfd.h>
+#include <include/uint.h>
+
+#include <lib/isa/ISATypes.hpp>
+
+#include <lib/support/SrcFile.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+
+namespace BinUtil {
+
+class LineTable {
+public:
+  // A DWARF section's contents (not owned).
+  struct Section {
+    Section()
+      : data(NULL), size(0)
+    { }
+
+    const unsigned char* data;
+    uint64_t size;
+  };
+
+  // The DWARF sections that the table is decoded from; all but 'line'
+  // are optional.
+  struct Sections {
+    Sections()
+      : isBig(false)
+    { }
+
+    std::string fileName; // for diagnostics
+    bool isBig;
+    Section line, str, lineStr, strOffsets;
+    Section info, abbrev, addr, ranges, rnglists;
+  };
+
+public:
+  LineTable();
+  ~LineTable();
+
+  // read: decodes .debug_line (and the inlined subroutines of
+  // .debug_info) of 'abfd'.  Returns true if the table is usable
+  // (possibly empty); false if 'abfd' is not supported.
+  bool
+  read(bfd* abfd);
+
+  // read: as above, from sections already in memory.
+  bool
+  read(const Sections& secs);
+
+  bool
+  empty() const
+  { return m_rows.empty(); }
+
+  // find: finds the row for (unrelocated) 'vma'.  Returns true and sets
+  // 'fileIdx' and 'line' if 'vma' is covered by a line table row.
+  bool
+  find(VMA vma, uint& fileIdx, SrcFile::ln& line) const;
+
+  // isInlined: whether (unrelocated) 'vma' lies in an inlined
+  // subroutine, or in a unit whose inlining is unknown.
+  bool
+  isInlined(VMA vma) const;
+
+  // The file name for 'fileIdx', as named in .debug_line, until the
+  // client resolves it to its final name.  (Names relative to the
+  // compilation directory cannot be resolved from .debug_line alone.)
+  const std::string&
+  fileName(uint fileIdx) const
+  { return m_files[fileIdx]; }
+
+  bool
+  isResolved(uint fileIdx) const
+  { return m_resolved[fileIdx]; }
+
+  void
+  resolve(uint fileIdx, const std::string& name)
+  {
+    m_files[fileIdx] = name;
+    m_resolved[fileIdx] = true;
+  }
+
+private:
+  class Row {
+  public:
+    VMA  vma;
+    uint file;
+    uint line; // 0: end of sequence
+
+    Row(VMA v = 0, uint f = 0, uint l = 0)
+      : vma(v), file(f), line(l)
+    { }
+
+    bool
+    operator<(const Row& x) const
+    { return vma < x.vma; }
+  };
+
+  // [beg, end)
+  class Range {
+  public:
+    VMA beg;
+    VMA end;
+
+    Range(VMA b = 0, VMA e = 0)
+      : beg(b), end(e)
+    { }
+
+    bool
+    operator<(const Range& x) const
+    { return beg < x.beg; }
+  };
+
+  class Unit;
+
+  bool
+  readUnit(const Sections& secs, uint64_t& off, uint64_t strOffBase,
+	   uint64_t& badForm);
+
+  bool
+  readInfoUnit(const Sections& secs, uint64_t& off,
+	       std::map<uint64_t, uint64_t>& strOffBases);
+
+  bool
+  readRanges(const Sections& secs, const Unit& unit, uint64_t off,
+	     bool isIndex);
+
+  void
+  addRange(VMA beg, VMA end);
+
+  uint
+  addFile(const std::string& dir, const std::string& name);
+
+private:
+  std::vector<Row> m_rows;
+  std::vector<std::string> m_files;
+  std::vector<bool> m_resolved;
+  std::vector<Range> m_inlined; // sorted and disjoint
+};
+
+} // namespace BinUtil
+
+//***************************************************************************
+
+#endif // BinUtil_LineTable_hpp
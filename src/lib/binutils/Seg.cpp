@@ -403,6 +403,7 @@ BinUtil::TextSeg::ctor_readSegment()
   m_contents = (char *)( ((uintptr_t)contentsTmp + 15) & ~15 ); // align
 
   bfd* abfd = m_lm->abfd();
+  BfdLock guard;
   asection* bfdSeg = bfd_get_section_by_name(abfd, name().c_str());
   int ret = bfd_get_section_contents(abfd, bfdSeg, m_contents, 0, size());
   if (!ret) {
@@ -478,7 +479,9 @@ BinUtil::TextSeg::findProcName(bfd* abfd, asymbol* procSym) const
 {
   string procName;
 
-  // cf. LM::findSrcCodeInfo()
+  // cf. LM::findSrcCodeInfo().  'bfd_func' points into BFD's state, so
+  // hold the BfdLock until it has been copied.
+  BfdLock guard;
   asection* bfdSeg = bfd_get_section_by_name(abfd, name().c_str());
 
   bfd_boolean bfd_fnd = false;
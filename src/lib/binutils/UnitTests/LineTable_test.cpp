@@ -0,0 +1,385 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Tests for LineTable, on DWARF sections built by hand.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cassert>
+using namespace std;
+
+#include "../LineTable.hpp"
+
+using BinUtil::LineTable;
+
+// A little-endian DWARF section under construction
+class Buf {
+public:
+  void u8(uint64_t x)  { b.push_back((unsigned char)x); }
+  void u16(uint64_t x) { u8(x); u8(x >> 8); }
+  void u32(uint64_t x) { u16(x); u16(x >> 16); }
+  void u64(uint64_t x) { u32(x); u32(x >> 32); }
+  void uleb(uint64_t x)
+  {
+    do {
+      unsigned char c = x & 0x7f;
+      x >>= 7;
+      u8((x) ? (c | 0x80) : c);
+    } while (x);
+  }
+  void sleb(int64_t x)
+  {
+    bool more = true;
+    while (more) {
+      unsigned char c = x & 0x7f;
+      x >>= 7;
+      more = !((x == 0 && !(c & 0x40)) || (x == -1 && (c & 0x40)));
+      u8((more) ? (c | 0x80) : c);
+    }
+  }
+  void str(const char* s) { while (*s) { u8(*s++); } u8(0); }
+
+  // a 32-bit length, of what follows it up to end()
+  size_t beg() { size_t at = b.size(); u32(0); return at; }
+  void end(size_t at)
+  {
+    uint64_t len = b.size() - at - 4;
+    for (int i = 0; i < 4; ++i) { b[at + i] = (unsigned char)(len >> (8*i)); }
+  }
+
+  size_t size() const { return b.size(); }
+
+  void
+  set(LineTable::Section& sec) const
+  {
+    sec.data = &b[0];
+    sec.size = b.size();
+  }
+
+  std::vector<unsigned char> b;
+};
+
+
+// a DWARF 4 line program: directory "/src", files a.c and b.h, one
+// sequence [0x1000, 0x1030) with a.c:10, b.h:20 and a.c:12
+static void
+addLineUnit4(Buf& line)
+{
+  size_t len = line.beg();
+  line.u16(4);
+  size_t hdr = line.beg(); // header_length
+  line.u8(1);   // minimum_instruction_length
+  line.u8(1);   // maximum_operations_per_instruction
+  line.u8(1);   // default_is_stmt
+  line.u8(-5);  // line_base
+  line.u8(14);  // line_range
+  line.u8(13);  // opcode_base
+  const unsigned char opLens[] = { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 };
+  for (int i = 0; i < 12; ++i) { line.u8(opLens[i]); }
+  line.str("/src"); line.u8(0);
+  line.str("a.c"); line.uleb(1); line.uleb(0); line.uleb(0);
+  line.str("b.h"); line.uleb(1); line.uleb(0); line.uleb(0);
+  line.u8(0);
+  line.end(hdr);
+
+  line.u8(0); line.uleb(9); line.u8(0x02); line.u64(0x1000); // set_address
+  line.u8(0x03); line.sleb(9);     // advance_line: 10
+  line.u8(0x01);                   // copy
+  line.u8(0x02); line.uleb(0x10);  // advance_pc
+  line.u8(0x04); line.uleb(2);     // set_file b.h
+  line.u8(0x03); line.sleb(10);    // line 20
+  line.u8(0x01);
+  line.u8(0x02); line.uleb(0x10);
+  line.u8(0x04); line.uleb(1);     // a.c
+  line.u8(0x03); line.sleb(-8);    // line 12
+  line.u8(0x01);
+  line.u8(0x02); line.uleb(0x10);
+  line.u8(0); line.uleb(1); line.u8(0x01); // end_sequence at 0x1030
+  line.end(len);
+}
+
+
+// a DWARF 5 line program whose file table uses 'form' for the path;
+// one sequence [addr, addr + 0x10) at line 7 of file 0
+static void
+addLineUnit5(Buf& line, uint64_t form, uint64_t pathVal, uint64_t addr)
+{
+  size_t len = line.beg();
+  line.u16(5);
+  line.u8(8);   // address_size
+  line.u8(0);   // segment_selector_size
+  size_t hdr = line.beg();
+  line.u8(1); line.u8(1); line.u8(1); line.u8(-5); line.u8(14); line.u8(13);
+  const unsigned char opLens[] = { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 };
+  for (int i = 0; i < 12; ++i) { line.u8(opLens[i]); }
+  // directories: path as DW_FORM_string
+  line.u8(1); line.uleb(0x1); line.uleb(0x08);
+  line.uleb(1); line.str("/src5");
+  // files: path as 'form', directory index as udata
+  line.u8(2); line.uleb(0x1); line.uleb(form); line.uleb(0x2); line.uleb(0x0f);
+  line.uleb(1); line.u8(pathVal); line.uleb(0);
+  line.end(hdr);
+
+  line.u8(0); line.uleb(9); line.u8(0x02); line.u64(addr);
+  line.u8(0x04); line.uleb(0);
+  line.u8(0x03); line.sleb(6);
+  line.u8(0x01);
+  line.u8(0x02); line.uleb(0x10);
+  line.u8(0); line.uleb(1); line.u8(0x01);
+  line.end(len);
+}
+
+
+static void
+findTest(const LineTable& tbl, VMA vma, const string& file, uint line)
+{
+  uint fileIdx = 0;
+  SrcFile::ln ln = 0;
+  bool fnd = tbl.find(vma, fileIdx, ln);
+  if (file.empty()) {
+    assert(!fnd);
+    return;
+  }
+  assert(fnd);
+  assert(tbl.fileName(fileIdx) == file);
+  assert(ln == line);
+}
+
+
+static void
+lineTest()
+{
+  Buf line;
+  addLineUnit4(line);
+
+  LineTable::Sections secs;
+  line.set(secs.line);
+
+  LineTable tbl;
+  assert(tbl.read(secs));
+  findTest(tbl, 0x0fff, "", 0);
+  findTest(tbl, 0x1000, "/src/a.c", 10);
+  findTest(tbl, 0x100f, "/src/a.c", 10);
+  findTest(tbl, 0x1010, "/src/b.h", 20);
+  findTest(tbl, 0x102f, "/src/a.c", 12);
+  findTest(tbl, 0x1030, "", 0);
+  assert(!tbl.isInlined(0x1010)); // no .debug_info
+
+  cout << "LineTable rows verified." << endl;
+}
+
+
+// DWARF 4 .debug_info: a unit [0x1000, 0x1030) with a procedure and
+// two inlined subroutines, one with low/high pc and one with ranges.
+// If 'badForm', the second is replaced by a DIE with an unknown form.
+static void
+buildInfo4(Buf& info, Buf& abbrev, Buf& ranges, bool badForm)
+{
+  abbrev.uleb(1); abbrev.uleb(0x11); abbrev.u8(1);      // compile_unit
+  abbrev.uleb(0x11); abbrev.uleb(0x01);                 //   low_pc addr
+  abbrev.uleb(0x12); abbrev.uleb(0x06);                 //   high_pc data4
+  abbrev.uleb(0x10); abbrev.uleb(0x17);                 //   stmt_list
+  abbrev.uleb(0x03); abbrev.uleb(0x08);                 //   name string
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(2); abbrev.uleb(0x2e); abbrev.u8(1);      // subprogram
+  abbrev.uleb(0x11); abbrev.uleb(0x01);
+  abbrev.uleb(0x12); abbrev.uleb(0x06);
+  abbrev.uleb(0x3f); abbrev.uleb(0x19);                 //   external
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(3); abbrev.uleb(0x1d); abbrev.u8(0);      // inlined_subroutine
+  abbrev.uleb(0x31); abbrev.uleb(0x13);                 //   abstract_origin
+  abbrev.uleb(0x11); abbrev.uleb(0x01);
+  abbrev.uleb(0x12); abbrev.uleb(0x06);
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(4); abbrev.uleb(0x1d); abbrev.u8(0);      // inlined_subroutine
+  abbrev.uleb(0x31); abbrev.uleb(0x13);
+  abbrev.uleb(0x55); abbrev.uleb(0x17);                 //   ranges
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(5); abbrev.uleb(0x34); abbrev.u8(0);      // variable
+  abbrev.uleb(0x02); abbrev.uleb(0x7f);                 //   unknown form
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(0);
+
+  // relative to the unit's low_pc: [0x20, 0x24) and [0x28, 0x2a)
+  ranges.u64(0x20); ranges.u64(0x24);
+  ranges.u64(0x28); ranges.u64(0x2a);
+  ranges.u64(0); ranges.u64(0);
+
+  size_t len = info.beg();
+  info.u16(4); info.u32(0); info.u8(8);
+  info.uleb(1); info.u64(0x1000); info.u32(0x30); info.u32(0); info.str("a.c");
+  info.uleb(2); info.u64(0x1000); info.u32(0x30);
+  info.uleb(3); info.u32(0); info.u64(0x1010); info.u32(0x10);
+  if (badForm) {
+    info.uleb(5); info.u8(0);
+  }
+  else {
+    info.uleb(4); info.u32(0); info.u32(0);
+  }
+  info.uleb(0);
+  info.uleb(0);
+  info.end(len);
+}
+
+
+static void
+inlineTest()
+{
+  Buf line, info, abbrev, ranges;
+  addLineUnit4(line);
+  buildInfo4(info, abbrev, ranges, false);
+
+  LineTable::Sections secs;
+  line.set(secs.line);
+  info.set(secs.info);
+  abbrev.set(secs.abbrev);
+  ranges.set(secs.ranges);
+
+  LineTable tbl;
+  assert(tbl.read(secs));
+  findTest(tbl, 0x1010, "/src/b.h", 20);
+  assert(!tbl.isInlined(0x1000));
+  assert(!tbl.isInlined(0x100f));
+  assert(tbl.isInlined(0x1010));
+  assert(tbl.isInlined(0x101f));
+  assert(tbl.isInlined(0x1020));
+  assert(tbl.isInlined(0x1023));
+  assert(!tbl.isInlined(0x1024));
+  assert(tbl.isInlined(0x1029));
+  assert(!tbl.isInlined(0x102a));
+
+  // After a form we do not know, the rest of the unit is unknown and
+  // counts as inlined.
+  Buf info2, abbrev2, ranges2;
+  buildInfo4(info2, abbrev2, ranges2, true);
+  info2.set(secs.info);
+  abbrev2.set(secs.abbrev);
+  ranges2.set(secs.ranges);
+
+  LineTable tbl2;
+  assert(tbl2.read(secs));
+  findTest(tbl2, 0x1010, "/src/b.h", 20);
+  assert(tbl2.isInlined(0x1000));
+  assert(tbl2.isInlined(0x102f));
+  assert(!tbl2.isInlined(0x1030));
+
+  cout << "LineTable inlined ranges verified." << endl;
+}
+
+
+// DWARF 5: a file name given as DW_FORM_strx1 is found through the
+// str_offsets_base of the unit whose DW_AT_stmt_list names the line
+// program; a unit with a form we do not know is skipped, but the
+// others are read.
+static void
+dwarf5Test()
+{
+  Buf line, info, abbrev, str, strOffsets;
+
+  str.str("");
+  size_t nameOff = str.size();
+  str.str("c.c");
+
+  size_t soLen = strOffsets.beg();    // .debug_str_offsets header
+  strOffsets.u16(5); strOffsets.u16(0);
+  size_t soBase = strOffsets.size();
+  strOffsets.u32(nameOff);
+  strOffsets.end(soLen);
+
+  size_t unitA = line.size();
+  addLineUnit5(line, 0x25, 0, 0x2000); // strx1, index 0
+  addLineUnit5(line, 0x99, 0, 0x3000); // unknown form
+  addLineUnit4(line);
+
+  abbrev.uleb(1); abbrev.uleb(0x11); abbrev.u8(0);      // compile_unit
+  abbrev.uleb(0x10); abbrev.uleb(0x17);                 //   stmt_list
+  abbrev.uleb(0x72); abbrev.uleb(0x17);                 //   str_offsets_base
+  abbrev.uleb(0); abbrev.uleb(0);
+  abbrev.uleb(0);
+
+  size_t len = info.beg();
+  info.u16(5); info.u8(0x01); info.u8(8); info.u32(0);
+  info.uleb(1); info.u32(unitA); info.u32(soBase);
+  info.end(len);
+
+  LineTable::Sections secs;
+  line.set(secs.line);
+  info.set(secs.info);
+  abbrev.set(secs.abbrev);
+  str.set(secs.str);
+  strOffsets.set(secs.strOffsets);
+
+  LineTable tbl;
+  assert(tbl.read(secs));
+  findTest(tbl, 0x2000, "/src5/c.c", 7);
+  findTest(tbl, 0x3000, "", 0);
+  findTest(tbl, 0x1010, "/src/b.h", 20);
+
+  cout << "LineTable DWARF 5 forms verified." << endl;
+}
+
+
+void
+lineTableTest()
+{
+  lineTest();
+  inlineTest();
+  dwarf5Test();
+}
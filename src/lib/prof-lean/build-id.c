@@ -0,0 +1,274 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Identify a binary by its contents (its GNU build-id note), and
+//   hash small keys.
+//
+//   These routines *must not* allocate dynamic memory; all reads go
+//   through pread() into stack buffers.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include "build-id.h"
+
+//*************************** Forward Declarations **************************
+
+#define NOTE_BUF_SZ   4096
+
+#define FNV_PRIME   (0x100000001b3ULL)
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+# define NATIVE_ELFDATA  ELFDATA2MSB
+#else
+# define NATIVE_ELFDATA  ELFDATA2LSB
+#endif
+
+// a note segment or section: file offset and size
+typedef struct note_region_t {
+  uint64_t offset;
+  uint64_t size;
+} note_region_t;
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static int
+read_full(int fd, void* buf, size_t len, uint64_t offset)
+{
+  ssize_t ret = pread(fd, buf, len, offset);
+  return (ret == (ssize_t) len) ? 0 : -1;
+}
+
+
+static void
+to_hex(const unsigned char* data, size_t num, char* buf)
+{
+  static const char digits[] = "0123456789abcdef";
+  size_t i;
+
+  for (i = 0; i < num; i++) {
+    buf[2*i]     = digits[data[i] >> 4];
+    buf[2*i + 1] = digits[data[i] & 0xf];
+  }
+  buf[2*num] = '\0';
+}
+
+
+// Scan the notes in [offset, offset + size) for the GNU build-id.
+static int
+scan_notes(int fd, note_region_t region, char* buf, size_t len)
+{
+  unsigned char notes[NOTE_BUF_SZ];
+  size_t size = (region.size < NOTE_BUF_SZ) ? region.size : NOTE_BUF_SZ;
+  size_t pos = 0;
+
+  if (size == 0 || read_full(fd, notes, size, region.offset) != 0) {
+    return -1;
+  }
+
+  // Elf32_Nhdr and Elf64_Nhdr have the same layout
+  while (pos + sizeof(Elf64_Nhdr) <= size) {
+    Elf64_Nhdr* nhdr = (Elf64_Nhdr*) (notes + pos);
+    size_t name_pos = pos + sizeof(Elf64_Nhdr);
+    size_t desc_pos = name_pos + ((nhdr->n_namesz + 3) & ~3);
+    size_t next_pos = desc_pos + ((nhdr->n_descsz + 3) & ~3);
+
+    if (next_pos > size || next_pos <= pos) {
+      break;
+    }
+    if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4
+	&& memcmp(notes + name_pos, "GNU", 4) == 0
+	&& nhdr->n_descsz > 0 && 2 * nhdr->n_descsz < len) {
+      to_hex(notes + desc_pos, nhdr->n_descsz, buf);
+      return 0;
+    }
+    pos = next_pos;
+  }
+
+  return -1;
+}
+
+
+// Collect the PT_NOTE segments, or else the SHT_NOTE sections, for
+// ELF class 'cls'.  Returns the number of regions found.
+static int
+find_notes(int fd, int cls, note_region_t* regions, int max)
+{
+  int num = 0;
+  uint64_t phoff, shoff;
+  unsigned phnum, phentsize, shnum, shentsize;
+  unsigned i;
+
+  if (cls == ELFCLASS64) {
+    Elf64_Ehdr ehdr;
+    if (read_full(fd, &ehdr, sizeof(ehdr), 0) != 0) {
+      return 0;
+    }
+    phoff = ehdr.e_phoff;  phnum = ehdr.e_phnum;  phentsize = ehdr.e_phentsize;
+    shoff = ehdr.e_shoff;  shnum = ehdr.e_shnum;  shentsize = ehdr.e_shentsize;
+  }
+  else {
+    Elf32_Ehdr ehdr;
+    if (read_full(fd, &ehdr, sizeof(ehdr), 0) != 0) {
+      return 0;
+    }
+    phoff = ehdr.e_phoff;  phnum = ehdr.e_phnum;  phentsize = ehdr.e_phentsize;
+    shoff = ehdr.e_shoff;  shnum = ehdr.e_shnum;  shentsize = ehdr.e_shentsize;
+  }
+
+  for (i = 0; i < phnum && num < max && phoff != 0; i++) {
+    uint64_t off = phoff + (uint64_t) i * phentsize;
+    if (cls == ELFCLASS64) {
+      Elf64_Phdr phdr;
+      if (read_full(fd, &phdr, sizeof(phdr), off) != 0) break;
+      if (phdr.p_type != PT_NOTE) continue;
+      regions[num].offset = phdr.p_offset;
+      regions[num].size = phdr.p_filesz;
+    }
+    else {
+      Elf32_Phdr phdr;
+      if (read_full(fd, &phdr, sizeof(phdr), off) != 0) break;
+      if (phdr.p_type != PT_NOTE) continue;
+      regions[num].offset = phdr.p_offset;
+      regions[num].size = phdr.p_filesz;
+    }
+    num++;
+  }
+  if (num > 0) {
+    return num;
+  }
+
+  // relocatable files (and some gpu binaries) have no segments
+  for (i = 0; i < shnum && num < max && shoff != 0; i++) {
+    uint64_t off = shoff + (uint64_t) i * shentsize;
+    if (cls == ELFCLASS64) {
+      Elf64_Shdr shdr;
+      if (read_full(fd, &shdr, sizeof(shdr), off) != 0) break;
+      if (shdr.sh_type != SHT_NOTE) continue;
+      regions[num].offset = shdr.sh_offset;
+      regions[num].size = shdr.sh_size;
+    }
+    else {
+      Elf32_Shdr shdr;
+      if (read_full(fd, &shdr, sizeof(shdr), off) != 0) break;
+      if (shdr.sh_type != SHT_NOTE) continue;
+      regions[num].offset = shdr.sh_offset;
+      regions[num].size = shdr.sh_size;
+    }
+    num++;
+  }
+
+  return num;
+}
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+int
+build_id_from_file(const char* fnm, char* buf, size_t len)
+{
+  unsigned char ident[EI_NIDENT];
+  note_region_t regions[16];
+  int ret = -1;
+  int i, num;
+
+  int fd = open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (read_full(fd, ident, EI_NIDENT, 0) != 0
+      || memcmp(ident, ELFMAG, SELFMAG) != 0
+      || ident[EI_DATA] != NATIVE_ELFDATA
+      || (ident[EI_CLASS] != ELFCLASS32 && ident[EI_CLASS] != ELFCLASS64)) {
+    close(fd);
+    return -1;
+  }
+
+  num = find_notes(fd, ident[EI_CLASS], regions, 16);
+  for (i = 0; i < num && ret != 0; i++) {
+    ret = scan_notes(fd, regions[i], buf, len);
+  }
+
+  close(fd);
+  return ret;
+}
+
+
+uint64_t
+build_id_hash_bytes(uint64_t seed, const void* data, size_t len)
+{
+  const unsigned char* p = (const unsigned char*) data;
+  uint64_t hash = seed;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
@@ -0,0 +1,104 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Identify a binary by its contents: the GNU build-id note, or
+//   failing that, a hash of the whole file.  These are used as keys
+//   for caches of per-binary analysis results.
+//
+//   These routines *must not* allocate dynamic memory.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef prof_lean_build_id_h
+#define prof_lean_build_id_h
+
+//************************* System Include Files ****************************
+
+#include <stddef.h>
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+// Large enough for any build-id in hex, plus '\0'.
+#define BUILD_ID_HEX_MAX  (2 * 64 + 1)
+
+// build_id_from_file: reads the NT_GNU_BUILD_ID note of ELF file
+// 'fnm' and writes it to 'buf' (of size 'len') as lower-case hex.
+// Returns 0 on success, -1 if the file cannot be read, is not a
+// native-endian ELF file or has no build-id.
+int
+build_id_from_file(const char* fnm, char* buf, size_t len);
+
+// build_id_hash_bytes: 64-bit FNV-1a hash of 'data', continued from
+// 'seed' (use BUILD_ID_HASH_INIT to begin).
+#define BUILD_ID_HASH_INIT  (0xcbf29ce484222325ULL)
+
+uint64_t
+build_id_hash_bytes(uint64_t seed, const void* data, size_t len);
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* prof_lean_build_id_h */
@@ -611,6 +611,59 @@ hpcrun_fmt_loadmapEntry_free(loadmap_entry_t* x, hpcfmt_free_fn dealloc)
 // cct
 //***************************************************************************
 
+// Sparse node metrics: the number of nonzero metrics (int4), then for
+// each, in increasing order of id, the metric id (int4) and value
+// (int8).  Metrics with an id beyond x->num_metrics (e.g., when the
+// reader wants no metric values) are read and dropped.
+static int
+hpcrun_fmt_cct_node_metrics_sparse_fread(hpcrun_fmt_cct_node_t* x, FILE* fs)
+{
+  uint32_t num_nz = 0;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&num_nz, fs));
+
+  for (uint i = 0; i < x->num_metrics; ++i) {
+    x->metrics[i].bits = 0;
+  }
+
+  for (uint32_t i = 0; i < num_nz; ++i) {
+    uint32_t id;
+    uint64_t bits;
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&id, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&bits, fs));
+    if (id < x->num_metrics) {
+      x->metrics[id].bits = bits;
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
+static int
+hpcrun_fmt_cct_node_metrics_sparse_fwrite(hpcrun_fmt_cct_node_t* x, FILE* fs)
+{
+  uint32_t num_nz = 0;
+
+  for (uint i = 0; i < x->num_metrics; ++i) {
+    if (!hpcrun_metricVal_isZero(x->metrics[i])) {
+      num_nz++;
+    }
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(num_nz, fs));
+
+  for (uint i = 0; i < x->num_metrics; ++i) {
+    if (!hpcrun_metricVal_isZero(x->metrics[i])) {
+      HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(i, fs));
+      HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
  int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs)
@@ -631,6 +684,10 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
     hpcrun_fmt_lip_fread(&x->lip, fs);
   }
 
+  if (flags.fields.isSparseMetrics) {
+    return hpcrun_fmt_cct_node_metrics_sparse_fread(x, fs);
+  }
+
   for (int i = 0; i < x->num_metrics; ++i) {
     HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
   }
@@ -657,6 +714,10 @@ hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
     HPCFMT_ThrowIfError(hpcrun_fmt_lip_fwrite(&x->lip, fs));
   }
 
+  if (flags.fields.isSparseMetrics) {
+    return hpcrun_fmt_cct_node_metrics_sparse_fwrite(x, fs);
+  }
+
   for (int i = 0; i < x->num_metrics; ++i) {
     HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
   }
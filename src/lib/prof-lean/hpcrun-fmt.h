@@ -173,7 +173,8 @@ static const int  HPCRUN_FMT_EpochTagLen = (sizeof(HPCRUN_FMT_EpochTag) - 1);
 
 typedef struct epoch_flags_bitfield {
   bool isLogicalUnwind : 1;
-  uint64_t unused      : 63;
+  bool isSparseMetrics : 1; // cct nodes list only their nonzero metrics
+  uint64_t unused      : 62;
 } epoch_flags_bitfield;
 
 
@@ -537,6 +538,9 @@ typedef struct hpcrun_fmt_cct_node_t {
   // static logical instruction pointer
   lush_lip_t lip;
 
+  // N.B.: in memory the metrics are always a dense array.  If the
+  // epoch's isSparseMetrics flag is set, the file lists only the
+  // nonzero metrics, as (metric id, value) pairs.
   hpcfmt_uint_t num_metrics;
   hpcrun_metricVal_t* metrics;
 
@@ -731,6 +735,88 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// hpcprof-cctdb (located here for now)
+//***************************************************************************
+
+// A binary copy of the CCT and metric values in experiment.xml, laid
+// out so that a reader can mmap it and use it in place:
+//
+//   hdr
+//   node[numNodes]                  (preorder, in experiment.xml order)
+//   metricId[numMetrics]            (uint32_t; experiment.xml 'n')
+//   columnBeg[numMetrics + 1]       (uint64_t; index into value[])
+//   value[numValues]                (hpccctdb_fmt_value_t)
+//
+// Metric values are sparse: column c (the values of metricId[c]) is
+// value[columnBeg[c], columnBeg[c + 1]), holding only the nonzero
+// values, in increasing node order.
+//
+// Each section starts at the offset given in the header (a multiple
+// of 8).  Integers and doubles are in the writer's byte order; a
+// reader checks 'endian' against HPCCCTDB_FMT_EndianCheck.
+
+static const char HPCCCTDB_FMT_Magic[]   = "HPCPROF-cctdb___"; // 16 bytes
+static const uint32_t HPCCCTDB_FMT_Version = 2;
+static const uint32_t HPCCCTDB_FMT_EndianCheck = 0x01020304;
+
+#define HPCCCTDB_FMT_MagicLenX (sizeof(HPCCCTDB_FMT_Magic) - 1)
+
+// parent index of the root node
+#define HPCCCTDB_FMT_NoParent (UINT32_MAX)
+
+
+typedef struct hpccctdb_fmt_hdr_t {
+
+  char magic[HPCCCTDB_FMT_MagicLenX];
+  uint32_t version;
+  uint32_t endian;
+
+  uint64_t numNodes;
+  uint64_t numMetrics;
+  uint64_t numValues;
+
+  uint64_t nodeOffset;
+  uint64_t metricIdOffset;
+  uint64_t columnOffset;
+  uint64_t valueOffset;
+  uint64_t fileSize;
+
+} hpccctdb_fmt_hdr_t;
+
+
+typedef enum hpccctdb_fmt_nodeFlags_t {
+  HPCCCTDB_FMT_NodeAlien = 0x1
+} hpccctdb_fmt_nodeFlags_t;
+
+
+// Ids are those in experiment.xml.  'lmId' and 'procId' are only set
+// for procedure frames; 'fileId' for procedure frames and loops.
+typedef struct hpccctdb_fmt_node_t {
+
+  uint32_t id;       // 'i'
+  uint32_t parent;   // index of the parent node
+  uint32_t structId; // 's'
+  uint32_t line;     // 'l'
+  uint32_t lmId;     // 'lm'
+  uint32_t fileId;   // 'f'
+  uint32_t procId;   // 'n'
+  uint16_t type;     // Prof::CCT::ANode::ANodeTy
+  uint16_t flags;    // hpccctdb_fmt_nodeFlags_t
+
+} hpccctdb_fmt_node_t;
+
+
+typedef struct hpccctdb_fmt_value_t {
+
+  uint32_t node;     // index of the node
+  uint32_t pad;
+  double value;
+
+} hpccctdb_fmt_value_t;
+
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
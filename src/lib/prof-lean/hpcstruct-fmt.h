@@ -0,0 +1,183 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Layout of the binary (mmap-able) hpcstruct file.
+//
+//   hpcstruct writes this format with --format=binary as an
+//   alternative to the XML structure file.  The file is written
+//   sequentially (so it may go to a pipe) and is read by mapping it
+//   into memory: all records are fixed size and naturally aligned and
+//   all strings are NUL-terminated in place, so the reader never
+//   copies or parses a string before it needs it.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcstruct_fmt_h
+#define prof_lean_hpcstruct_fmt_h
+
+//************************* System Include Files ****************************
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+/*
+   File format (native byte order, every section 8-byte aligned):
+
+   <hdr>      hpcstruct_fmt_hdr_t
+   <nodes>    hpcstruct_fmt_node_t[num_nodes], in preorder
+   <vmas>     hpcstruct_fmt_vma_t[num_vmas]
+   <strings>  NUL-terminated strings back to back; offset 0 is ""
+   <footer>   hpcstruct_fmt_footer_t, always the last bytes of the file
+
+   The nodes mirror the elements of the XML structure file: LM, F, P,
+   A, L and S.  Each node names its parent by node index, so a reader
+   can rebuild the tree in one forward pass.  Attributes that refer to
+   strings (n, ln, f) are byte offsets into <strings> and the v
+   attribute is the range [vma_first, vma_first + num_vma) in <vmas>.
+*/
+
+static const char HPCSTRUCT_FMT_Magic[]   = "HPCSTRUCT-binary"; // 16 bytes
+static const char HPCSTRUCT_FMT_Version[] = "01.00";            // 5 bytes
+
+static const int HPCSTRUCT_FMT_MagicLen   = (sizeof(HPCSTRUCT_FMT_Magic) - 1);
+static const int HPCSTRUCT_FMT_VersionLen = (sizeof(HPCSTRUCT_FMT_Version) - 1);
+
+#define HPCSTRUCT_FMT_EndianLittle 'l'
+#define HPCSTRUCT_FMT_EndianBig    'b'
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+# define HPCSTRUCT_FMT_Endian  HPCSTRUCT_FMT_EndianBig
+#else
+# define HPCSTRUCT_FMT_Endian  HPCSTRUCT_FMT_EndianLittle
+#endif
+
+#define HPCSTRUCT_FMT_NoParent  (UINT64_MAX)
+
+
+typedef enum {
+
+  HPCSTRUCT_FMT_Ty_NULL = 0,
+  HPCSTRUCT_FMT_Ty_LM,
+  HPCSTRUCT_FMT_Ty_File,
+  HPCSTRUCT_FMT_Ty_Proc,
+  HPCSTRUCT_FMT_Ty_Alien,
+  HPCSTRUCT_FMT_Ty_Loop,
+  HPCSTRUCT_FMT_Ty_Stmt
+
+} hpcstruct_fmt_ty_t;
+
+
+typedef struct hpcstruct_fmt_hdr_t {
+
+  char magic[16];     // HPCSTRUCT_FMT_Magic, no terminator
+  char version[8];    // HPCSTRUCT_FMT_Version, NUL padded
+  char endian;        // HPCSTRUCT_FMT_Endian
+  char pad[7];
+
+} hpcstruct_fmt_hdr_t;
+
+
+typedef struct hpcstruct_fmt_node_t {
+
+  uint32_t ty;        // hpcstruct_fmt_ty_t
+  uint32_t line;      // 'l'
+  uint64_t id;        // 'i' (preorder id within the LM)
+  uint64_t parent;    // node index of parent or HPCSTRUCT_FMT_NoParent
+  uint64_t name;      // 'n'
+  uint64_t link_name; // 'ln' (procs only)
+  uint64_t file;      // 'f' (aliens and loops only)
+  uint64_t symbol;    // 's' (procs only)
+  uint64_t vma_first; // 'v'
+  uint64_t num_vma;
+
+} hpcstruct_fmt_node_t;
+
+
+typedef struct hpcstruct_fmt_vma_t {
+
+  uint64_t beg;
+  uint64_t end;       // exclusive
+
+} hpcstruct_fmt_vma_t;
+
+
+typedef struct hpcstruct_fmt_footer_t {
+
+  uint64_t nodes_off;
+  uint64_t num_nodes;
+  uint64_t vmas_off;
+  uint64_t num_vmas;
+  uint64_t strs_off;
+  uint64_t strs_len;
+  char magic[16];     // HPCSTRUCT_FMT_Magic again, for truncated files
+
+} hpcstruct_fmt_footer_t;
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* prof_lean_hpcstruct_fmt_h */
@@ -0,0 +1,221 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "CCT-BinaryDB.hpp"
+
+#include <lib/support/diagnostics.h>
+
+//*************************** Forward Declarations ***************************
+
+//***************************************************************************
+
+
+namespace Prof {
+
+namespace CCT {
+
+//***************************************************************************
+// BinaryDB
+//***************************************************************************
+
+BinaryDB::BinaryDB(const string& fnm)
+  : m_addr(NULL), m_size(0), m_hdr(NULL), m_nodes(NULL),
+    m_metricIds(NULL), m_columnBeg(NULL), m_values(NULL)
+{
+  int fd = open(fnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    DIAG_Throw("could not open '" << fnm << "'");
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(hpccctdb_fmt_hdr_t)) {
+    m_size = st.st_size;
+    m_addr = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+
+  if (m_addr == NULL || m_addr == MAP_FAILED) {
+    m_addr = NULL;
+    DIAG_Throw("could not read '" << fnm << "'");
+  }
+
+  const char* base = static_cast<const char*>(m_addr);
+  const hpccctdb_fmt_hdr_t* hdr =
+    reinterpret_cast<const hpccctdb_fmt_hdr_t*>(base);
+
+  // N.B.: the sections must fit in the file.  The counts are bounded
+  // first, so that the section sizes cannot overflow, and each offset
+  // before it is subtracted, so that no comparison can wrap around.
+  bool isValid =
+    (memcmp(hdr->magic, HPCCCTDB_FMT_Magic, HPCCCTDB_FMT_MagicLenX) == 0
+     && hdr->version == HPCCCTDB_FMT_Version
+     && hdr->endian == HPCCCTDB_FMT_EndianCheck
+     && hdr->fileSize == m_size
+     && hdr->numNodes <= m_size / sizeof(hpccctdb_fmt_node_t)
+     && hdr->numMetrics < m_size / sizeof(uint64_t)
+     && hdr->numValues <= m_size / sizeof(hpccctdb_fmt_value_t)
+     && hdr->nodeOffset % 8 == 0 && hdr->columnOffset % 8 == 0
+     && hdr->valueOffset % 8 == 0
+     && hdr->nodeOffset >= sizeof(hpccctdb_fmt_hdr_t)
+     && hdr->nodeOffset <= hdr->metricIdOffset
+     && hdr->metricIdOffset <= hdr->columnOffset
+     && hdr->columnOffset <= hdr->valueOffset
+     && hdr->valueOffset <= m_size);
+
+  if (isValid) {
+    uint64_t nodesSz = hdr->numNodes * sizeof(hpccctdb_fmt_node_t);
+    uint64_t metricIdsSz = hdr->numMetrics * sizeof(uint32_t);
+    uint64_t columnsSz = (hdr->numMetrics + 1) * sizeof(uint64_t);
+    uint64_t valuesSz = hdr->numValues * sizeof(hpccctdb_fmt_value_t);
+    isValid =
+      (nodesSz <= hdr->metricIdOffset - hdr->nodeOffset
+       && metricIdsSz <= hdr->columnOffset - hdr->metricIdOffset
+       && columnsSz <= hdr->valueOffset - hdr->columnOffset
+       && valuesSz <= m_size - hdr->valueOffset);
+  }
+
+  // column boundaries must be increasing and end at 'numValues', and
+  // each column's node indices increasing and in range
+  if (isValid) {
+    const uint64_t* columnBeg =
+      reinterpret_cast<const uint64_t*>(base + hdr->columnOffset);
+    const hpccctdb_fmt_value_t* values =
+      reinterpret_cast<const hpccctdb_fmt_value_t*>(base + hdr->valueOffset);
+    isValid = (columnBeg[0] == 0 && columnBeg[hdr->numMetrics] == hdr->numValues);
+    for (uint64_t c = 0; isValid && c < hdr->numMetrics; ++c) {
+      isValid = (columnBeg[c] <= columnBeg[c + 1]);
+      for (uint64_t k = columnBeg[c]; isValid && k < columnBeg[c + 1]; ++k) {
+	isValid = (values[k].node < hdr->numNodes
+		   && (k == columnBeg[c] || values[k - 1].node < values[k].node));
+      }
+    }
+  }
+
+  if (!isValid) {
+    munmap(m_addr, m_size);
+    m_addr = NULL;
+    DIAG_Throw("invalid hpcprof-cctdb file '" << fnm << "'");
+  }
+
+  m_hdr = hdr;
+  m_nodes = reinterpret_cast<const hpccctdb_fmt_node_t*>(base + hdr->nodeOffset);
+  m_metricIds = reinterpret_cast<const uint32_t*>(base + hdr->metricIdOffset);
+  m_columnBeg = reinterpret_cast<const uint64_t*>(base + hdr->columnOffset);
+  m_values =
+    reinterpret_cast<const hpccctdb_fmt_value_t*>(base + hdr->valueOffset);
+}
+
+
+BinaryDB::~BinaryDB()
+{
+  if (m_addr) {
+    munmap(m_addr, m_size);
+  }
+}
+
+
+uint64_t
+BinaryDB::findColumn(uint32_t mId) const
+{
+  // ids are written in increasing order
+  const uint32_t* beg = m_metricIds;
+  const uint32_t* end = m_metricIds + m_hdr->numMetrics;
+  const uint32_t* it = std::lower_bound(beg, end, mId);
+  return (it != end && *it == mId) ? (uint64_t)(it - beg) : npos;
+}
+
+
+static bool
+nodeLt(const hpccctdb_fmt_value_t& x, uint64_t i)
+{
+  return x.node < i;
+}
+
+
+double
+BinaryDB::value(uint64_t i, uint64_t c) const
+{
+  const hpccctdb_fmt_value_t* beg = columnBeg(c);
+  const hpccctdb_fmt_value_t* end = columnEnd(c);
+  const hpccctdb_fmt_value_t* it = std::lower_bound(beg, end, i, nodeLt);
+  return (it != end && it->node == i) ? it->value : 0.0;
+}
+
+
+} // namespace CCT
+
+} // namespace Prof
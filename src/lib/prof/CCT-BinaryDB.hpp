@@ -0,0 +1,163 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Read-only access to an hpcprof-cctdb file (the binary copy of the
+//   CCT and metrics in experiment.xml; cf. CCT::Tree::writeBinary()).
+//
+// Description:
+//   The file is mmapped and used in place, so opening it costs the
+//   same regardless of the size of the CCT.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_CCT_BinaryDB_hpp
+#define prof_Prof_CCT_BinaryDB_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+//*************************** Forward Declarations ***************************
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace CCT {
+
+//***************************************************************************
+// BinaryDB
+//***************************************************************************
+
+class BinaryDB
+{
+public:
+  static const uint64_t npos = UINT64_MAX;
+
+public:
+  // Opens 'fnm'; throws a Diagnostics::Exception if it cannot be read
+  // or is not a valid hpcprof-cctdb file.
+  BinaryDB(const std::string& fnm);
+
+  ~BinaryDB();
+
+  // -------------------------------------------------------
+  // nodes, in preorder (node 0 is the root)
+  // -------------------------------------------------------
+
+  uint64_t
+  numNodes() const
+  { return m_hdr->numNodes; }
+
+  const hpccctdb_fmt_node_t&
+  node(uint64_t i) const
+  { return m_nodes[i]; }
+
+  // -------------------------------------------------------
+  // metrics: column 'c' holds the nonzero values of metric
+  // 'metricId(c)', in increasing node order
+  // -------------------------------------------------------
+
+  uint64_t
+  numMetrics() const
+  { return m_hdr->numMetrics; }
+
+  uint32_t
+  metricId(uint64_t c) const
+  { return m_metricIds[c]; }
+
+  // findColumn: returns the column for metric 'mId' or npos
+  uint64_t
+  findColumn(uint32_t mId) const;
+
+  const hpccctdb_fmt_value_t*
+  columnBeg(uint64_t c) const
+  { return m_values + m_columnBeg[c]; }
+
+  const hpccctdb_fmt_value_t*
+  columnEnd(uint64_t c) const
+  { return m_values + m_columnBeg[c + 1]; }
+
+  // value: returns the value of node 'i' in column 'c' (0 if absent)
+  double
+  value(uint64_t i, uint64_t c) const;
+
+private:
+  BinaryDB(const BinaryDB&);
+  BinaryDB& operator=(const BinaryDB&);
+
+private:
+  void* m_addr;
+  size_t m_size;
+
+  const hpccctdb_fmt_hdr_t* m_hdr;
+  const hpccctdb_fmt_node_t* m_nodes;
+  const uint32_t* m_metricIds;
+  const uint64_t* m_columnBeg;
+  const hpccctdb_fmt_value_t* m_values;
+};
+
+
+} // namespace CCT
+
+} // namespace Prof
+
+
+#endif /* prof_Prof_CCT_BinaryDB_hpp */
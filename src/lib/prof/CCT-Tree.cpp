@@ -71,17 +71,22 @@ using std::string;
 #include <vector>
 using std::vector;
 
+#include <map>
+
 #include <set>
 using std::set;
 
 #include <typeinfo>
 
+#include <algorithm>
+
 //*************************** User Include Files ****************************
 
 #include <include/gcc-attr.h>
 #include <include/uint.h>
 
 #include "CCT-Tree.hpp"
+#include "Metric-AExprBatch.hpp"
 #include "CallPath-Profile.hpp" // for CCT::Tree::metadata()
 
 #include <lib/xml/xml.hpp> 
@@ -275,13 +280,148 @@ Tree::verifyUniqueCPIds()
 }
 
 
+//***************************************************************************
+// Parallel XML writer
+//
+// The tree is cut into an ordered list of segments: whole subtrees
+// small enough to be formatted by one thread, and the opening and
+// closing tags of the (few) nodes above them.  Segments are formatted
+// into their own buffers in parallel and written in order, a window
+// at a time, so the output is identical to the serial writer's while
+// at most a fraction of it is held in memory.
+//***************************************************************************
+
+struct XMLSegment {
+  enum Kind { Pre, Subtree, Post };
+
+  XMLSegment(const ANode* n, Kind k, const string& p, size_t sz)
+    : node(n), kind(k), pfx(p), size(sz)
+  { }
+
+  const ANode* node;
+  Kind kind;
+  string pfx;
+  size_t size; // (estimated) number of nodes formatted
+  string text;
+};
+
+
+// subtrees per thread: enough for dynamic scheduling to balance a
+// skewed tree
+static const size_t XMLSegmentsPerThread = 16;
+
+
+static size_t
+countNodes(const ANode* node)
+{
+  size_t n = 1;
+  for (const NonUniformDegreeTreeNode* x = node->FirstChild(); x != NULL;
+       x = x->NextSibling()) {
+    n += countNodes(static_cast<const ANode*>(x));
+  }
+  return n;
+}
+
+
+// findLargeSubtrees: insert into 'large' the nodes whose subtrees
+// have more than 'grain' nodes (which are split further); returns the
+// size of 'node's subtree
+static size_t
+findLargeSubtrees(const ANode* node, size_t grain,
+		  std::map<const ANode*, size_t>& large)
+{
+  size_t n = 1;
+  for (const NonUniformDegreeTreeNode* x = node->FirstChild(); x != NULL;
+       x = x->NextSibling()) {
+    n += findLargeSubtrees(static_cast<const ANode*>(x), grain, large);
+  }
+  if (n > grain) {
+    large[node] = n;
+  }
+  return n;
+}
+
+
+// makeSegments: append the segments for 'node' (in output order),
+// mirroring ANode::writeXML()
+static void
+makeSegments(const ANode* node, const string& pfx, const string& indent,
+	     size_t grain, const std::map<const ANode*, size_t>& large,
+	     std::vector<XMLSegment>& segs)
+{
+  if (large.find(node) == large.end()) {
+    segs.push_back(XMLSegment(node, XMLSegment::Subtree, pfx, grain));
+    return;
+  }
+
+  segs.push_back(XMLSegment(node, XMLSegment::Pre, pfx, 1));
+  string prefix = pfx + indent;
+  for (ANodeSortedChildIterator cit(node, ANodeSortedIterator::cmpByStructureInfo);
+       cit.current(); cit++) {
+    makeSegments(cit.current(), prefix, indent, grain, large, segs);
+  }
+  segs.push_back(XMLSegment(node, XMLSegment::Post, pfx, 1));
+}
+
+
 std::ostream&
 Tree::writeXML(std::ostream& os, uint metricBeg, uint metricEnd,
-	       uint oFlags) const
+	       uint oFlags, uint numThreads) const
 {
-  if (m_root) {
+  if (!m_root) {
+    return os;
+  }
+
+  size_t numNodes = (numThreads > 1) ? countNodes(m_root) : 0;
+  size_t grain = numNodes / (numThreads * XMLSegmentsPerThread);
+
+  if (numThreads <= 1 || grain < 2) {
     m_root->writeXML(os, metricBeg, metricEnd, oFlags);
+    return os;
+  }
+
+  string indent = (oFlags & OFlg_Compressed) ? "" : "  ";
+
+  std::map<const ANode*, size_t> large;
+  findLargeSubtrees(m_root, grain, large);
+
+  std::vector<XMLSegment> segs;
+  makeSegments(m_root, "", indent, grain, large, segs);
+
+  // format and write about a quarter of the tree at a time
+  size_t windowSz = numNodes / 4;
+
+  for (size_t beg = 0; beg < segs.size(); ) {
+    size_t end = beg, sz = 0;
+    while (end < segs.size() && sz < windowSz) {
+      sz += segs[end].size;
+      end++;
+    }
+
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    for (size_t i = beg; i < end; i++) {
+      XMLSegment& seg = segs[i];
+      const char* pfx = seg.pfx.c_str();
+      switch (seg.kind) {
+      case XMLSegment::Pre:
+	seg.node->writeXML_pre(seg.text, metricBeg, metricEnd, oFlags, pfx);
+	break;
+      case XMLSegment::Subtree:
+	seg.node->writeXML(seg.text, metricBeg, metricEnd, oFlags, pfx);
+	break;
+      case XMLSegment::Post:
+	seg.node->writeXML_post(seg.text, oFlags, pfx);
+	break;
+      }
+    }
+
+    for (size_t i = beg; i < end; i++) {
+      os.write(segs[i].text.data(), segs[i].text.size());
+      string().swap(segs[i].text);
+    }
+    beg = end;
   }
+
   return os;
 }
 
@@ -599,13 +739,29 @@ ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
     return;
   }
   
-  // N.B. pre-order walk assumes point-wise metrics
+  // N.B. assumes point-wise metrics: the batch evaluates metric by
+  // metric over blocks of nodes (cf. computeMetricsMe()).
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  Metric::AExprBatch batch(mMgr.size(), /*doNF*/true, doFinal);
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    const Metric::DerivedDesc* mm = dynamic_cast<const Metric::DerivedDesc*>(m);
+    if (mm && mm->expr()) {
+      batch.add(mId, mm->expr());
+    }
+  }
+
+  if (batch.empty()) {
+    return;
+  }
+
+  std::vector<Metric::IData*> nodes;
   for (ANodeIterator it(this); it.Current(); ++it) {
-    ANode* n = it.current();
-    n->computeMetricsMe(mMgr, mBegId, mEndId, doFinal);
+    nodes.push_back(it.current());
   }
+
+  batch.evaluate(&nodes[0], nodes.size());
 }
 
 
@@ -641,9 +797,26 @@ ANode::computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  // Resolve the expressions once rather than once per node
+  std::vector<const Metric::AExprIncr*> exprs;
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    const Metric::DerivedIncrDesc* mm =
+      dynamic_cast<const Metric::DerivedIncrDesc*>(m);
+    if (mm && mm->expr()) {
+      exprs.push_back(mm->expr());
+    }
+  }
+
+  if (exprs.empty()) {
+    return;
+  }
+
   for (ANodeIterator it(this); it.Current(); ++it) {
     ANode* n = it.current();
-    n->computeMetricsIncrMe(mMgr, mBegId, mEndId, fn);
+    for (uint i = 0; i < exprs.size(); ++i) {
+      computeMetricIncr(exprs[i], *n, fn);
+    }
   }
 }
 
@@ -657,26 +830,33 @@ ANode::computeMetricsIncrMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
     const Metric::DerivedIncrDesc* mm =
       dynamic_cast<const Metric::DerivedIncrDesc*>(m);
     if (mm && mm->expr()) {
-      const Metric::AExprIncr* expr = mm->expr();
-      switch (fn) {
-        case Metric::AExprIncr::FnInit:
-	  expr->initialize(*this); break;
-        case Metric::AExprIncr::FnInitSrc:
-	  expr->initializeSrc(*this); break;
-        case Metric::AExprIncr::FnAccum:
-	  expr->accumulate(*this); break;
-        case Metric::AExprIncr::FnCombine:
-	  expr->combine(*this); break;
-        case Metric::AExprIncr::FnFini:
-	  expr->finalize(*this); break;
-        default:
-	  DIAG_Die(DIAG_UnexpectedInput);
-      }
+      computeMetricIncr(mm->expr(), *this, fn);
     }
   }
 }
 
 
+void
+ANode::computeMetricIncr(const Metric::AExprIncr* expr, Metric::IData& mdata,
+			 Metric::AExprIncr::FnTy fn)
+{
+  switch (fn) {
+    case Metric::AExprIncr::FnInit:
+      expr->initialize(mdata); break;
+    case Metric::AExprIncr::FnInitSrc:
+      expr->initializeSrc(mdata); break;
+    case Metric::AExprIncr::FnAccum:
+      expr->accumulate(mdata); break;
+    case Metric::AExprIncr::FnCombine:
+      expr->combine(mdata); break;
+    case Metric::AExprIncr::FnFini:
+      expr->finalize(mdata); break;
+    default:
+      DIAG_Die(DIAG_UnexpectedInput);
+  }
+}
+
+
 void
 ANode::pruneByMetrics(const Metric::Mgr& mMgr, const VMAIntervalSet& ivalset,
 		      const ANode* root, double thresholdPct,
@@ -1453,6 +1633,49 @@ ANode::ddumpMe() const
 bool
 ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 		    uint oFlags, const char* pfx) const
+{
+  string buf;
+  bool doPost = writeXML_pre(buf, metricBeg, metricEnd, oFlags, pfx);
+  os << buf;
+  return doPost;
+}
+
+
+void
+ANode::writeXML_post(ostream& os, uint oFlags, const char* pfx) const
+{
+  string buf;
+  writeXML_post(buf, oFlags, pfx);
+  os << buf;
+}
+
+
+void
+ANode::writeXML(string& buf, uint metricBeg, uint metricEnd,
+		uint oFlags, const char* pfx) const
+{
+  string indent = "  ";
+  if (oFlags & CCT::Tree::OFlg_Compressed) {
+    pfx = "";
+    indent = "";
+  }
+
+  bool doPost = writeXML_pre(buf, metricBeg, metricEnd, oFlags, pfx);
+  string prefix = pfx + indent;
+  for (ANodeSortedChildIterator it(this, ANodeSortedIterator::cmpByStructureInfo);
+       it.current(); it++) {
+    ANode* n = it.current();
+    n->writeXML(buf, metricBeg, metricEnd, oFlags, prefix.c_str());
+  }
+  if (doPost) {
+    writeXML_post(buf, oFlags, pfx);
+  }
+}
+
+
+bool
+ANode::writeXML_pre(string& buf, uint metricBeg, uint metricEnd,
+		    uint oFlags, const char* pfx) const
 {
   bool doTag = (type() != TyRoot);
   bool doMetrics = ((oFlags & Tree::OFlg_LeafMetricsOnly)
@@ -1462,18 +1685,16 @@ ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 
   // 1. Write element name
   if (doTag) {
-    if (isXMLLeaf) {
-      os << pfx << "<" << toStringMe(oFlags) << "/>\n";
-    }
-    else {
-      os << pfx << "<" << toStringMe(oFlags) << ">\n";
-    }
+    buf += pfx;
+    buf += "<";
+    buf += toStringMe(oFlags);
+    buf += (isXMLLeaf) ? "/>\n" : ">\n";
   }
 
   // 2. Write associated metrics
   if (doMetrics) {
-    writeMetricsXML(os, metricBeg, metricEnd, oFlags, pfx);
-    os << "\n";
+    writeMetricsXML(buf, metricBeg, metricEnd, oFlags, pfx);
+    buf += "\n";
   }
 
   return !isXMLLeaf; // whether to execute writeXML_post()
@@ -1481,15 +1702,18 @@ ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 
 
 void
-ANode::writeXML_post(ostream& os, uint GCC_ATTR_UNUSED oFlags,
+ANode::writeXML_post(string& buf, uint GCC_ATTR_UNUSED oFlags,
 		     const char* pfx) const
 {
   bool doTag = (type() != ANode::TyRoot);
   if (!doTag) {
     return;
   }
-  
-  os << pfx << "</" << ANodeTyToName(type()) << ">\n";
+
+  buf += pfx;
+  buf += "</";
+  buf += ANodeTyToName(type());
+  buf += ">\n";
 }
 
 
@@ -1520,6 +1744,186 @@ int ANodeLineComp(ANode* x, ANode* y)
 }
 
 
+//***************************************************************************
+// Tree::writeBinary
+//***************************************************************************
+
+static void
+collectPreorder(const ANode* node, uint32_t parent,
+		vector<const ANode*>& nodes, vector<uint32_t>& parents)
+{
+  uint32_t idx = nodes.size();
+  nodes.push_back(node);
+  parents.push_back(parent);
+  for (ANodeSortedChildIterator it(node, ANodeSortedIterator::cmpByStructureInfo);
+       it.current(); it++) {
+    collectPreorder(it.current(), idx, nodes, parents);
+  }
+}
+
+
+// makeBinaryNode: the ids mirror the toStringMe() routines
+static void
+makeBinaryNode(const ANode* node, uint32_t parent, hpccctdb_fmt_node_t& x)
+{
+  memset(&x, 0, sizeof(x));
+
+  ANode::ANodeTy ty = node->type();
+  const Struct::ACodeNode* strct = node->structure();
+
+  uint sId = (strct) ? strct->id() : 0;
+  if (ty == ANode::TyProcFrm || ty == ANode::TyProc) {
+    sId = getProcIdFromMap(sId);
+  }
+
+  x.id = node->id();
+  x.parent = parent;
+  x.structId = sId;
+  x.line = node->begLine();
+  x.type = ty;
+
+  if (ty == ANode::TyProcFrm || ty == ANode::TyProc) {
+    const AProcNode* n = static_cast<const AProcNode*>(node);
+    if (strct) {
+      x.lmId = (ty == ANode::TyProcFrm) ? getLoadModuleFromMap(n->lmId())
+	                                : n->lmId();
+      x.fileId = getFileIdFromMap(n->fileId());
+      x.procId = getProcIdFromMap(n->procId());
+      if (n->isAlien()) {
+	x.flags |= HPCCCTDB_FMT_NodeAlien;
+      }
+    }
+  }
+  else if (ty == ANode::TyLoop) {
+    x.fileId = getFileIdFromMap(static_cast<const Loop*>(node)->fileId());
+  }
+}
+
+
+static int
+writePadding(FILE* fs, uint64_t& offset)
+{
+  static const char zeros[8] = { 0 };
+  uint64_t len = (8 - (offset % 8)) % 8;
+  if (len > 0 && fwrite(zeros, 1, len, fs) != len) {
+    return HPCFMT_ERR;
+  }
+  offset += len;
+  return HPCFMT_OK;
+}
+
+
+int
+Tree::writeBinary(FILE* fs, uint metricBeg, uint metricEnd) const
+{
+  vector<const ANode*> nodes;
+  vector<uint32_t> parents;
+  if (m_root) {
+    collectPreorder(m_root, HPCCCTDB_FMT_NoParent, nodes, parents);
+  }
+
+  if (metricBeg == Metric::IData::npos || metricEnd == Metric::IData::npos
+      || metricEnd < metricBeg) {
+    metricBeg = metricEnd = 0;
+  }
+
+  // 0. count the nonzero values of each metric, so that the header
+  // can be written first
+  uint numMetrics = metricEnd - metricBeg;
+  vector<uint64_t> columnBeg(numMetrics + 1, 0);
+  for (uint i = 0; i < nodes.size(); ++i) {
+    const ANode* n = nodes[i];
+    uint end = std::min(metricEnd, n->numMetrics());
+    for (uint mId = metricBeg; mId < end; ++mId) {
+      if (n->metric(mId) != 0.0) {
+	columnBeg[mId - metricBeg + 1]++;
+      }
+    }
+  }
+  for (uint c = 0; c < numMetrics; ++c) {
+    columnBeg[c + 1] += columnBeg[c];
+  }
+
+  // 1. header
+  hpccctdb_fmt_hdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, HPCCCTDB_FMT_Magic, HPCCCTDB_FMT_MagicLenX);
+  hdr.version = HPCCCTDB_FMT_Version;
+  hdr.endian = HPCCCTDB_FMT_EndianCheck;
+  hdr.numNodes = nodes.size();
+  hdr.numMetrics = numMetrics;
+  hdr.numValues = columnBeg[numMetrics];
+
+  uint64_t offset = sizeof(hdr);
+  hdr.nodeOffset = offset + (8 - (offset % 8)) % 8;
+  hdr.metricIdOffset = hdr.nodeOffset
+    + hdr.numNodes * sizeof(hpccctdb_fmt_node_t);
+  hdr.columnOffset = hdr.metricIdOffset + hdr.numMetrics * sizeof(uint32_t);
+  hdr.columnOffset += (8 - (hdr.columnOffset % 8)) % 8;
+  hdr.valueOffset = hdr.columnOffset
+    + (hdr.numMetrics + 1) * sizeof(uint64_t);
+  hdr.fileSize = hdr.valueOffset
+    + hdr.numValues * sizeof(hpccctdb_fmt_value_t);
+
+  if (fwrite(&hdr, sizeof(hdr), 1, fs) != 1
+      || writePadding(fs, offset) != HPCFMT_OK) {
+    return HPCFMT_ERR;
+  }
+
+  // 2. nodes
+  vector<hpccctdb_fmt_node_t> xnodes(nodes.size());
+  for (uint i = 0; i < nodes.size(); ++i) {
+    makeBinaryNode(nodes[i], parents[i], xnodes[i]);
+  }
+  if (fwrite(xnodes.data(), sizeof(hpccctdb_fmt_node_t), xnodes.size(), fs)
+      != xnodes.size()) {
+    return HPCFMT_ERR;
+  }
+  offset += xnodes.size() * sizeof(hpccctdb_fmt_node_t);
+
+  // 3. metric ids
+  for (uint mId = metricBeg; mId < metricEnd; ++mId) {
+    uint32_t x = mId;
+    if (fwrite(&x, sizeof(x), 1, fs) != 1) {
+      return HPCFMT_ERR;
+    }
+    offset += sizeof(x);
+  }
+  if (writePadding(fs, offset) != HPCFMT_OK) {
+    return HPCFMT_ERR;
+  }
+
+  // 4. column boundaries
+  if (fwrite(columnBeg.data(), sizeof(uint64_t), columnBeg.size(), fs)
+      != columnBeg.size()) {
+    return HPCFMT_ERR;
+  }
+
+  // 5. nonzero metric values, one column at a time
+  vector<hpccctdb_fmt_value_t> column;
+  for (uint mId = metricBeg; mId < metricEnd; ++mId) {
+    column.clear();
+    for (uint i = 0; i < nodes.size(); ++i) {
+      const ANode* n = nodes[i];
+      double v = (mId < n->numMetrics()) ? n->metric(mId) : 0.0;
+      if (v != 0.0) {
+	hpccctdb_fmt_value_t x;
+	x.node = i;
+	x.pad = 0;
+	x.value = v;
+	column.push_back(x);
+      }
+    }
+    if (fwrite(column.data(), sizeof(hpccctdb_fmt_value_t), column.size(), fs)
+	!= column.size()) {
+      return HPCFMT_ERR;
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
 } // namespace CCT
 
 } // namespace Prof
@@ -98,6 +98,7 @@
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/NonUniformDegreeTree.hpp>
+#include <lib/support/SlabAlloc.hpp>
 #include <lib/support/SrcFile.hpp>
 #include <lib/support/Unique.hpp>
 
@@ -218,11 +219,23 @@ public:
   // -------------------------------------------------------
   // Write contents
   // -------------------------------------------------------
+  // writeXML: If 'numThreads' > 1, subtrees are formatted in
+  // parallel into per-subtree buffers, which are written in order;
+  // the output is identical.
   std::ostream&
   writeXML(std::ostream& os,
 	   uint metricBeg = Metric::IData::npos,
 	   uint metricEnd = Metric::IData::npos,
-	   uint oFlags = 0) const;
+	   uint oFlags = 0, uint numThreads = 1) const;
+
+  // writeBinary: Writes the CCT and metrics [metricBeg, metricEnd)
+  // in hpcprof-cctdb format (cf. hpcrun-fmt.h), with nodes in the
+  // same order and with the same ids as writeXML().  Returns
+  // HPCFMT_OK or HPCFMT_ERR.
+  int
+  writeBinary(FILE* fs,
+	      uint metricBeg = Metric::IData::npos,
+	      uint metricEnd = Metric::IData::npos) const;
 
   std::ostream&
   dump(std::ostream& os = std::cerr, uint oFlags = 0) const;
@@ -334,7 +347,16 @@ public:
 
   virtual ~ANode()
   { }
-  
+
+  // nodes are slab allocated (cf. SlabAlloc)
+  static void*
+  operator new(size_t sz)
+  { return SlabAlloc::allocate(sz); }
+
+  static void
+  operator delete(void* p, size_t sz)
+  { SlabAlloc::deallocate(p, sz); }
+
   // deep copy of internals (but without children)
   ANode(const ANode& x)
     : NonUniformDegreeTreeNode(NULL),
@@ -540,6 +562,13 @@ public:
   computeMetricsIncrMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
 		       Metric::AExprIncr::FnTy fn);
 
+private:
+  static void
+  computeMetricIncr(const Metric::AExprIncr* expr, Metric::IData& mdata,
+		    Metric::AExprIncr::FnTy fn);
+
+public:
+
   // pruneByMetrics: TODO: make this static for consistency
   void
   pruneByMetrics(const Metric::Mgr& mMgr, const VMAIntervalSet& ivalset,
@@ -633,6 +662,24 @@ public:
 	   uint metricEnd = Metric::IData::npos,
 	   uint oFlags = 0, const char* pfx = "") const;
 
+  // writeXML, writeXML_pre, writeXML_post: as their ostream
+  // counterparts, but append to 'buf' (cf. Tree::writeXML())
+  void
+  writeXML(std::string& buf,
+	   uint metricBeg = Metric::IData::npos,
+	   uint metricEnd = Metric::IData::npos,
+	   uint oFlags = 0, const char* pfx = "") const;
+
+  bool
+  writeXML_pre(std::string& buf,
+	       uint metricBeg = Metric::IData::npos,
+	       uint metricEnd = Metric::IData::npos,
+	       uint oFlags = 0,
+	       const char* pfx = "") const;
+
+  void
+  writeXML_post(std::string& buf, uint oFlags = 0, const char* pfx = "") const;
+
   std::ostream&
   dump(std::ostream& os = std::cerr, uint oFlags = 0, const char* pfx = "") const;
 
@@ -725,7 +772,7 @@ public:
   { }
 
   virtual ~ADynNode()
-  { delete m_lip; }
+  { free_lip(m_lip); }
    
   // deep copy of internals (but without children)
   ADynNode(const ADynNode& x)
@@ -748,7 +795,7 @@ public:
       m_lmId = x.m_lmId;
       m_lmIP = x.m_lmIP;
       m_opIdx = x.m_opIdx;
-      delete m_lip;
+      free_lip(m_lip);
       m_lip = clone_lip(x.m_lip);
     }
     return *this;
@@ -859,17 +906,23 @@ public:
   lip(const lush_lip_t* lip)
   { m_lip = const_cast<lush_lip_t*>(lip); }
 
+  // clone_lip, free_lip: lips are slab allocated, like their nodes
   static lush_lip_t*
   clone_lip(const lush_lip_t* x)
   {
     lush_lip_t* x_clone = NULL;
     if (x) {
-      x_clone = new lush_lip_t;
+      x_clone =
+	static_cast<lush_lip_t*>(SlabAlloc::allocate(sizeof(lush_lip_t)));
       memcpy(x_clone, x, sizeof(lush_lip_t));
     }
     return x_clone;
   }
 
+  static void
+  free_lip(lush_lip_t* x)
+  { SlabAlloc::deallocate(x, sizeof(lush_lip_t)); }
+
   bool
   isValid_lip() const
   { return (m_lip && (lush_lip_getLMId(m_lip) != 0)); }
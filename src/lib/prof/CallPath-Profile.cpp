@@ -227,7 +227,10 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   DIAG_WMsgIf(x.m_fmtVersion != y.m_fmtVersion,
 	      "CallPath::Profile::merge(): ignoring incompatible versions: "
 	      << x.m_fmtVersion << " vs. " << y.m_fmtVersion);
-  DIAG_WMsgIf(x.m_flags.bits != y.m_flags.bits,
+  // isSparseMetrics only describes how the file was encoded
+  epoch_flags_t x_flags = x.m_flags, y_flags = y.m_flags;
+  x_flags.fields.isSparseMetrics = y_flags.fields.isSparseMetrics = false;
+  DIAG_WMsgIf(x_flags.bits != y_flags.bits,
 	      "CallPath::Profile::merge(): ignoring incompatible flags: "
 	      << x.m_flags.bits << " vs. " << y.m_flags.bits);
   DIAG_WMsgIf(x.m_measurementGranularity != y.m_measurementGranularity,
@@ -333,6 +336,16 @@ Profile::mergeMetrics(Profile& y, int mergeTy, uint& x_newMetricBegIdx)
     x.metricMgr()->insert(m->clone());
   }
 
+  // clones still point to their partners in y; redirect them into x
+  for (uint i = y_newMetricIdx; i < y.metricMgr()->size(); ++i) {
+    const Metric::ADesc* m = y.metricMgr()->metric(i);
+    Metric::ADesc* m_x = x.metricMgr()->metric(yBeg_mapsTo_xIdx + i);
+    const Metric::ADesc* p = m->partner();
+    uint p_xIdx = (p) ? yBeg_mapsTo_xIdx + p->id() : Metric::Mgr::npos;
+    m_x->partner((p_xIdx < x.metricMgr()->size()) ?
+		 x.metricMgr()->metric(p_xIdx) : NULL);
+  }
+
   if (!isMetricMgrVirtual()) {
     x_newMetricBegIdx = yBeg_mapsTo_xIdx;
   }
@@ -844,7 +857,9 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
-  if (!traceFileNameSet().empty()) {
+  // N.B.: an incremental update may add no traces to a database
+  // that has some; its trace times still describe them.
+  if (!traceFileNameSet().empty() || m_traceMaxTime != 0) {
     os << "  <TraceDBTable>\n";
     os << "    <TraceDB i" << MakeAttrNum(0)
        << " db-glob=\"" << "*." << HPCRUN_TraceFnmSfx << "\""
@@ -1463,6 +1478,9 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     numMetricsSrc = 0;
   }
 
+  // N.B.: hpcrun_fmt_cct_node_fread() expands a sparse node record
+  // (isSparseMetrics) into this dense array, and skips the values of
+  // any metrics beyond numMetricsSrc.
   hpcrun_fmt_cct_node_t nodeFmt;
   nodeFmt.num_metrics = numMetricsSrc;
   nodeFmt.metrics = (numMetricsSrc > 0) ?
@@ -1613,8 +1631,13 @@ Profile::fmt_epoch_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   if (prof.isMetricMgrVirtual() || (wFlags & WFlg_VirtualMetrics) ) {
     virtualMetrics = "1";
   }
+
+  epoch_flags_t flags = prof.m_flags;
+  if (wFlags & WFlg_SparseMetrics) {
+    flags.fields.isSparseMetrics = true;
+  }
  
-  ret = hpcrun_fmt_epochHdr_fwrite(fs, prof.m_flags,
+  ret = hpcrun_fmt_epochHdr_fwrite(fs, flags,
 			     prof.m_measurementGranularity,
 			     "TODO:epoch-name", "TODO:epoch-value",
 			     FmtEpoch_NV_virtualMetrics, virtualMetrics,
@@ -1733,6 +1756,12 @@ Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
     numMetrics = 0;
   }
 
+  // N.B.: must match the flags written by fmt_epoch_fwrite()
+  epoch_flags_t flags = prof.m_flags;
+  if (wFlags & WFlg_SparseMetrics) {
+    flags.fields.isSparseMetrics = true;
+  }
+
   hpcrun_fmt_cct_node_t nodeFmt;
   nodeFmt.num_metrics = numMetrics;
   nodeFmt.metrics =
@@ -1740,9 +1769,9 @@ Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
 
   for (CCT::ANodeIterator it(prof.cct()->root()); it.Current(); ++it) {
     CCT::ANode* n = it.current();
-    fmt_cct_makeNode(nodeFmt, *n, prof.m_flags);
+    fmt_cct_makeNode(nodeFmt, *n, flags);
 
-    ret = hpcrun_fmt_cct_node_fwrite(&nodeFmt, prof.m_flags, fs);
+    ret = hpcrun_fmt_cct_node_fwrite(&nodeFmt, flags, fs);
     if (ret != HPCFMT_OK) return HPCFMT_ERR;
   }
 
@@ -2061,10 +2090,12 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
     }
 
     // Note: use n_fmt.num_metrics rather than n_dyn.numMetrics() to
-    // support skipping the writing of metrics.
+    // support skipping the writing of metrics.  A node may have fewer
+    // metrics than the profile (e.g., one made when the CCT was
+    // canonicalized); the rest are zero.
     for (uint i = 0; i < n_fmt.num_metrics; ++i) {
       hpcrun_metricVal_t m; // C99: (hpcrun_metricVal_t){.r = n_dyn.metric(i)};
-      m.r = n_dyn.metric(i);
+      m.r = (i < n_dyn.numMetrics()) ? n_dyn.metric(i) : 0.0;
       n_fmt.metrics[i] = m;
     }
   }
@@ -122,6 +122,16 @@ public:
   { return m_fmtVersion; }
 
 
+  // the hpcrun-fmt epoch flags
+  epoch_flags_t
+  flags() const
+  { return m_flags; }
+
+  void
+  flags(epoch_flags_t x)
+  { m_flags = x; }
+
+
   const StringSet&
   traceFileNameSet() const
   { return m_traceFileNameSet; }
@@ -271,6 +281,10 @@ public:
     // affects the normalizations applied to obtain a canonical CCT.
     RFlg_HpcrunData = (1 << 4),
 
+    // write only the non-zero metric values of each CCT node
+    // (isSparseMetrics)
+    WFlg_SparseMetrics  = (1 << 14),
+
     // only write metric descriptors, even if CCT nodes have metrics
     WFlg_VirtualMetrics = (1 << 15)
   };
@@ -67,6 +67,7 @@ using std::endl;
 #include <include/uint.h>
 
 #include "Metric-AExpr.hpp"
+#include "Metric-AExprBatch.hpp"
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/NaN.h>
@@ -101,6 +102,23 @@ AExpr::toString() const
 }
 
 
+// compileOpands: compile each operand.  N.B.: an n-ary expression
+// without operands is left to the scalar routines.
+bool
+AExpr::compileOpands(AExprProg& prog, AExpr** opands, uint sz)
+{
+  if (sz == 0) {
+    return false;
+  }
+  for (uint i = 0; i < sz; ++i) {
+    if (!opands[i]->compile(prog)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 void
 AExpr::dump_opands(std::ostream& os, AExpr** opands, uint sz, const char* sep)
 {
@@ -117,6 +135,14 @@ AExpr::dump_opands(std::ostream& os, AExpr** opands, uint sz, const char* sep)
 // class Const
 // ----------------------------------------------------------------------
 
+bool
+Const::compile(AExprProg& prog) const
+{
+  prog.pushConst(m_c);
+  return true;
+}
+
+
 std::ostream&
 Const::dumpMe(std::ostream& os) const
 {
@@ -139,6 +165,17 @@ Neg::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Neg::compile(AExprProg& prog) const
+{
+  if (!m_expr->compile(prog)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpNeg, 1);
+  return true;
+}
+
+
 std::ostream&
 Neg::dumpMe(std::ostream& os) const
 {
@@ -153,6 +190,14 @@ Neg::dumpMe(std::ostream& os) const
 // class Var
 // ----------------------------------------------------------------------
 
+bool
+Var::compile(AExprProg& prog) const
+{
+  prog.pushVar(m_metricId);
+  return true;
+}
+
+
 std::ostream&
 Var::dumpMe(std::ostream& os) const
 {
@@ -177,6 +222,17 @@ Power::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Power::compile(AExprProg& prog) const
+{
+  if (!(m_base->compile(prog) && m_exponent->compile(prog))) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpPower, 2);
+  return true;
+}
+
+
 std::ostream&
 Power::dumpMe(std::ostream& os) const
 {
@@ -209,6 +265,17 @@ Divide::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Divide::compile(AExprProg& prog) const
+{
+  if (!(m_numerator->compile(prog) && m_denominator->compile(prog))) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpDivide, 2);
+  return true;
+}
+
+
 std::ostream&
 Divide::dumpMe(std::ostream& os) const
 {
@@ -237,6 +304,17 @@ Minus::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Minus::compile(AExprProg& prog) const
+{
+  if (!(m_minuend->compile(prog) && m_subtrahend->compile(prog))) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpMinus, 2);
+  return true;
+}
+
+
 std::ostream&
 Minus::dumpMe(std::ostream& os) const
 {
@@ -271,6 +349,17 @@ Plus::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Plus::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpPlus, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Plus::dumpMe(std::ostream& os) const
 {
@@ -308,6 +397,17 @@ Times::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Times::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpTimes, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Times::dumpMe(std::ostream& os) const
 {
@@ -345,6 +445,17 @@ Max::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Max::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpMax, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Max::dumpMe(std::ostream& os) const
 {
@@ -386,6 +497,17 @@ Min::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Min::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpMin, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Min::dumpMe(std::ostream& os) const
 {
@@ -419,6 +541,28 @@ Mean::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Mean::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpMean, m_sz);
+  return true;
+}
+
+
+bool
+Mean::compileNF(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpPlus, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Mean::dumpMe(std::ostream& os) const
 {
@@ -453,6 +597,28 @@ StdDev::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+StdDev::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpStdDev, m_sz);
+  return true;
+}
+
+
+bool
+StdDev::compileNF(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpSumSquares, m_sz);
+  return true;
+}
+
+
 std::ostream&
 StdDev::dumpMe(std::ostream& os) const
 {
@@ -492,6 +658,28 @@ CoefVar::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+CoefVar::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpCoefVar, m_sz);
+  return true;
+}
+
+
+bool
+CoefVar::compileNF(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpSumSquares, m_sz);
+  return true;
+}
+
+
 std::ostream&
 CoefVar::dumpMe(std::ostream& os) const
 {
@@ -531,6 +719,28 @@ RStdDev::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+RStdDev::compile(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpRStdDev, m_sz);
+  return true;
+}
+
+
+bool
+RStdDev::compileNF(AExprProg& prog) const
+{
+  if (!compileOpands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.pushOp(AExprProg::OpSumSquares, m_sz);
+  return true;
+}
+
+
 std::ostream&
 RStdDev::dumpMe(std::ostream& os) const
 {
@@ -545,6 +755,14 @@ RStdDev::dumpMe(std::ostream& os) const
 // class NumSource
 // ----------------------------------------------------------------------
 
+bool
+NumSource::compile(AExprProg& prog) const
+{
+  prog.pushConst((double)m_numSrc);
+  return true;
+}
+
+
 std::ostream&
 NumSource::dumpMe(std::ostream& os) const
 {
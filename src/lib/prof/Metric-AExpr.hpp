@@ -95,6 +95,12 @@
 
 //************************ Forward Declarations ******************************
 
+namespace Prof {
+namespace Metric {
+class AExprProg;
+} // namespace Metric
+} // namespace Prof
+
 //****************************************************************************
 
 #define epsilon  (0.000001)
@@ -148,6 +154,23 @@ public:
   }
 
 
+  // ------------------------------------------------------------
+  // batch evaluation (cf. Metric::AExprBatch)
+  // ------------------------------------------------------------
+
+  // compile: append postfix code for eval() to 'prog'.  Returns false
+  // if the expression has no compiled form.
+  virtual bool
+  compile(AExprProg& GCC_ATTR_UNUSED prog) const
+  { return false; }
+
+  // compileNF: same, but for evalNF(), leaving the value of each
+  // accumulator on the stack
+  virtual bool
+  compileNF(AExprProg& prog) const
+  { return compile(prog); }
+
+
   static bool
   isok(double x)
   { return !(c_isnan_d(x) || c_isinf_d(x)); }
@@ -319,6 +342,10 @@ protected:
   }
 
 
+  static bool
+  compileOpands(AExprProg& prog, AExpr** opands, uint sz);
+
+
   static void
   dump_opands(std::ostream& os, AExpr** opands, uint sz,
 	      const char* sep = ", ");
@@ -350,6 +377,10 @@ public:
   { return m_c; }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -391,6 +422,10 @@ public:
   eval(const Metric::IData& mdata) const;
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -436,6 +471,10 @@ public:
   { return mdata.demandMetric(m_metricId); }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -491,6 +530,10 @@ public:
   eval(const Metric::IData& mdata) const;
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -540,6 +583,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -587,6 +634,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -631,6 +682,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -681,6 +736,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -727,6 +786,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -776,6 +839,10 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -834,6 +901,13 @@ public:
   }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+  virtual bool
+  compileNF(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -891,6 +965,13 @@ public:
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+  virtual bool
+  compileNF(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -957,6 +1038,13 @@ public:
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+  virtual bool
+  compileNF(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -1023,6 +1111,13 @@ public:
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+  virtual bool
+  compileNF(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -1087,6 +1182,10 @@ public:
   { return (double)m_numSrc; }
 
 
+  virtual bool
+  compile(AExprProg& prog) const;
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -0,0 +1,398 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <algorithm>
+
+#include <cmath>
+#include <cfloat>
+
+//************************* User Include Files *******************************
+
+#include "Metric-AExprBatch.hpp"
+#include "Metric-AExpr.hpp"
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/NaN.h>
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Metric {
+
+// ----------------------------------------------------------------------
+// class AExprBatch
+// ----------------------------------------------------------------------
+
+const uint AExprBatch::BlockSz;
+
+// two scratch slots above the deepest program
+static const uint NumScratch = 2;
+
+
+AExprBatch::AExprBatch(uint numMetrics, bool doNF, bool doFinal)
+  : m_numMetrics(numMetrics), m_doNF(doNF), m_doFinal(doFinal),
+    m_maxDepth(0)
+{
+}
+
+
+AExprBatch::~AExprBatch()
+{
+}
+
+
+void
+AExprBatch::add(uint mId, const AExpr* expr)
+{
+  m_entries.push_back(Entry(mId, expr));
+  Entry& e = m_entries.back();
+
+  e.isCompiled = ((!m_doNF || expr->compileNF(e.progNF))
+		  && (!m_doFinal || expr->compile(e.prog)));
+  if (!e.isCompiled) {
+    e.progNF.clear();
+    e.prog.clear();
+    return;
+  }
+
+  m_maxDepth = std::max(m_maxDepth,
+			std::max(e.progNF.maxDepth(), e.prog.maxDepth()));
+  m_stack.resize((m_maxDepth + NumScratch) * BlockSz);
+}
+
+
+void
+AExprBatch::evaluate(Metric::IData* const* rows, uint numRows)
+{
+  for (uint i = 0; i < numRows; i += BlockSz) {
+    uint n = numRows - i;
+    if (n > BlockSz) {
+      n = BlockSz;
+    }
+    evaluateBlock(rows + i, n);
+  }
+}
+
+
+void
+AExprBatch::evaluateBlock(Metric::IData* const* rows, uint numRows)
+{
+  for (uint k = 0; k < m_entries.size(); ++k) {
+    const Entry& e = m_entries[k];
+
+    if (!e.isCompiled) {
+      for (uint i = 0; i < numRows; ++i) {
+	if (m_doNF) {
+	  e.expr->evalNF(*rows[i]);
+	}
+	if (m_doFinal) {
+	  double val = e.expr->eval(*rows[i]);
+	  rows[i]->demandMetric(e.mId, m_numMetrics/*size*/) = val;
+	}
+      }
+      continue;
+    }
+
+    if (m_doNF) {
+      run(e.progNF, rows, numRows);
+      for (uint j = 0; j < e.progNF.depth(); ++j) {
+	uint aId = e.expr->accumId(j);
+	const double* z = slot(j);
+	for (uint i = 0; i < numRows; ++i) {
+	  rows[i]->demandMetric(aId) = z[i];
+	}
+      }
+    }
+
+    if (m_doFinal) {
+      run(e.prog, rows, numRows);
+      const double* z = slot(0);
+      for (uint i = 0; i < numRows; ++i) {
+	rows[i]->demandMetric(e.mId, m_numMetrics/*size*/) = z[i];
+      }
+    }
+  }
+}
+
+
+// N.B.: Each case mirrors the corresponding AExpr::eval() (and
+// AExpr's evalSum(), evalVariance(), etc.) operation for operation;
+// keep them in sync.
+void
+AExprBatch::run(const AExprProg& prog, Metric::IData* const* rows,
+		uint numRows)
+{
+  const uint n = numRows;
+  double* t1 = slot(m_maxDepth);
+  double* t2 = slot(m_maxDepth + 1);
+
+  uint d = 0; // stack depth
+
+  const std::vector<AExprProg::Op>& ops = prog.ops();
+  for (uint p = 0; p < ops.size(); ++p) {
+    const AExprProg::Op& op = ops[p];
+
+    switch (op.ty) {
+      case AExprProg::OpConst: {
+	double* z = slot(d++);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = op.c;
+	}
+	break;
+      }
+
+      case AExprProg::OpVar: {
+	double* z = slot(d++);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = rows[i]->demandMetric(op.n);
+	}
+	break;
+      }
+
+      case AExprProg::OpNeg: {
+	double* z = slot(d - 1);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = -z[i];
+	}
+	break;
+      }
+
+      case AExprProg::OpPower: {
+	d--;
+	double* z = slot(d - 1);
+	const double* x = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = pow(z[i], x[i]);
+	}
+	break;
+      }
+
+      case AExprProg::OpDivide: {
+	d--;
+	double* z = slot(d - 1);
+	const double* x = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  double dn = x[i];
+	  z[i] = (AExpr::isok(dn) && dn != 0.0) ? (z[i] / dn) : c_FP_NAN_d;
+	}
+	break;
+      }
+
+      case AExprProg::OpMinus: {
+	d--;
+	double* z = slot(d - 1);
+	const double* x = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = (z[i] - x[i]);
+	}
+	break;
+      }
+
+      case AExprProg::OpPlus:
+      case AExprProg::OpMean: {
+	d -= op.n;
+	double* z = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = 0.0 + z[i];
+	}
+	for (uint k = 1; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] += x[i];
+	  }
+	}
+	if (op.ty == AExprProg::OpMean) {
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] = z[i] / (double) op.n;
+	  }
+	}
+	d++;
+	break;
+      }
+
+      case AExprProg::OpTimes: {
+	d -= op.n;
+	double* z = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = 1.0 * z[i];
+	}
+	for (uint k = 1; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] *= x[i];
+	  }
+	}
+	d++;
+	break;
+      }
+
+      case AExprProg::OpMax: {
+	d -= op.n;
+	double* z = slot(d);
+	for (uint k = 1; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] = std::max(z[i], x[i]);
+	  }
+	}
+	d++;
+	break;
+      }
+
+      case AExprProg::OpMin: {
+	// observational min (cf. Min::eval())
+	d -= op.n;
+	for (uint i = 0; i < n; ++i) {
+	  t1[i] = DBL_MAX;
+	}
+	for (uint k = 0; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    if (x[i] != 0.0) {
+	      t1[i] = std::min(t1[i], x[i]);
+	    }
+	  }
+	}
+	double* z = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = (t1[i] == DBL_MAX) ? DBL_MIN : t1[i];
+	}
+	d++;
+	break;
+      }
+
+      case AExprProg::OpStdDev:
+      case AExprProg::OpCoefVar:
+      case AExprProg::OpRStdDev: {
+	// t1: mean, t2: variance (cf. AExpr::evalVariance())
+	d -= op.n;
+	for (uint i = 0; i < n; ++i) {
+	  t1[i] = 0.0;
+	  t2[i] = 0.0;
+	}
+	for (uint k = 0; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    double t = x[i];
+	    double delta = t - t1[i];
+	    t1[i] += delta / (k + 1);
+	    t2[i] += delta * (t - t1[i]);
+	  }
+	}
+	double* z = slot(d);
+	for (uint i = 0; i < n; ++i) {
+	  double sdev = sqrt(t2[i] / op.n);
+	  double mean = t1[i];
+	  if (op.ty == AExprProg::OpStdDev) {
+	    z[i] = sdev;
+	  }
+	  else if (op.ty == AExprProg::OpCoefVar) {
+	    z[i] = (mean > epsilon) ? (sdev / mean) : 0.0;
+	  }
+	  else {
+	    z[i] = (mean > epsilon) ? ((sdev / mean) * 100) : 0.0;
+	  }
+	}
+	d++;
+	break;
+      }
+
+      case AExprProg::OpSumSquares: {
+	// t1: sum, t2: sum of squares (cf. AExpr::evalSumSquares())
+	d -= op.n;
+	for (uint i = 0; i < n; ++i) {
+	  t1[i] = 0.0;
+	  t2[i] = 0.0;
+	}
+	for (uint k = 0; k < op.n; ++k) {
+	  const double* x = slot(d + k);
+	  for (uint i = 0; i < n; ++i) {
+	    t1[i] += x[i];
+	    t2[i] += (x[i] * x[i]);
+	  }
+	}
+	double* z1 = slot(d);
+	double* z2 = slot(d + 1);
+	for (uint i = 0; i < n; ++i) {
+	  z1[i] = t1[i];
+	  z2[i] = t2[i];
+	}
+	d += 2;
+	break;
+      }
+
+      default:
+	DIAG_Die(DIAG_UnexpectedInput);
+    }
+  }
+
+  DIAG_Assert(d == prog.depth(), "AExprBatch::run: bad stack depth");
+}
+
+
+//****************************************************************************
+
+} // namespace Metric
+
+} // namespace Prof
@@ -0,0 +1,264 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// class Prof::Metric::AExprProg
+// class Prof::Metric::AExprBatch
+//
+// Batch evaluation of Metric::AExpr's.  Rather than walking an
+// expression tree (a virtual call per operator) for every node and
+// metric, each expression is compiled once into a flat postfix
+// program (AExprProg) that a small stack machine runs over a block of
+// nodes at a time.  Each stack slot holds one value per node of the
+// block, so every operator is a simple loop over arrays that the
+// compiler can vectorize.
+//
+// Results are identical to AExpr::eval() and AExpr::evalNF(): each
+// operator performs the same floating point operations in the same
+// order, and metric values are read and written with the same
+// IData::demandMetric() calls.  Expressions without a compiled form
+// are evaluated with the scalar routines.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_Metric_AExprBatch_hpp
+#define prof_Prof_Metric_AExprBatch_hpp
+
+//************************ System Include Files ******************************
+
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include <include/uint.h>
+
+#include "Metric-IData.hpp"
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Metric {
+
+class AExpr;
+
+// ----------------------------------------------------------------------
+// class AExprProg
+//   A postfix program for one AExpr (cf. AExpr::compile())
+// ----------------------------------------------------------------------
+
+class AExprProg
+{
+public:
+  enum OpTy {
+    OpConst,       // push 'c'
+    OpVar,         // push metric 'n'
+    OpNeg,         // unary
+    OpPower,       // binary
+    OpDivide,      // binary
+    OpMinus,       // binary
+    OpPlus,        // n-ary
+    OpTimes,       // n-ary
+    OpMin,         // n-ary
+    OpMax,         // n-ary
+    OpMean,        // n-ary
+    OpStdDev,      // n-ary
+    OpCoefVar,     // n-ary
+    OpRStdDev,     // n-ary
+    OpSumSquares   // n-ary: replaces operands with <sum, sum of squares>
+  };
+
+  struct Op {
+    Op(OpTy ty_, uint n_, double c_)
+      : ty(ty_), n(n_), c(c_)
+    { }
+
+    OpTy   ty;
+    uint   n; // number of operands (OpVar: metric id)
+    double c; // OpConst: value
+  };
+
+public:
+  AExprProg()
+    : m_depth(0), m_maxDepth(0)
+  { }
+
+  ~AExprProg()
+  { }
+
+  void
+  pushConst(double c)
+  { push(Op(OpConst, 0, c), 0, 1); }
+
+  void
+  pushVar(uint mId)
+  { push(Op(OpVar, mId, 0.0), 0, 1); }
+
+  // pushOp: append an operator over the top 'n' stack values
+  void
+  pushOp(OpTy ty, uint n)
+  { push(Op(ty, n, 0.0), n, (ty == OpSumSquares) ? 2 : 1); }
+
+
+  const std::vector<Op>&
+  ops() const
+  { return m_ops; }
+
+  // depth: number of values left on the stack by the program
+  uint
+  depth() const
+  { return m_depth; }
+
+  uint
+  maxDepth() const
+  { return m_maxDepth; }
+
+  void
+  clear()
+  {
+    m_ops.clear();
+    m_depth = m_maxDepth = 0;
+  }
+
+private:
+  void
+  push(const Op& op, uint numPop, uint numPush)
+  {
+    m_ops.push_back(op);
+    m_depth = m_depth - numPop + numPush;
+    if (m_depth > m_maxDepth) {
+      m_maxDepth = m_depth;
+    }
+  }
+
+private:
+  std::vector<Op> m_ops;
+  uint m_depth;
+  uint m_maxDepth;
+};
+
+
+// ----------------------------------------------------------------------
+// class AExprBatch
+//   Evaluates a set of derived metrics over many IData's
+// ----------------------------------------------------------------------
+
+class AExprBatch
+{
+public:
+  // number of IData's evaluated together
+  static const uint BlockSz = 256;
+
+public:
+  // Constructor: 'numMetrics' is the size given to demandMetric() when
+  // storing finalized values.  'doNF' selects AExpr::evalNF() (storing
+  // into the accumulators); 'doFinal' selects AExpr::eval() (storing
+  // into the metric itself).  When both are set, evalNF() is first.
+  AExprBatch(uint numMetrics, bool doNF, bool doFinal);
+
+  ~AExprBatch();
+
+  // add: evaluate 'expr' for metric 'mId'.  Metrics are evaluated in
+  // the order they are added.
+  void
+  add(uint mId, const AExpr* expr);
+
+  // evaluate: evaluates each metric for each of 'rows'.  N.B.: assumes
+  // point-wise metrics, i.e., a row's metrics depend only on the row.
+  void
+  evaluate(Metric::IData* const* rows, uint numRows);
+
+  bool
+  empty() const
+  { return m_entries.empty(); }
+
+private:
+  struct Entry {
+    Entry(uint mId_, const AExpr* expr_)
+      : mId(mId_), expr(expr_), isCompiled(false)
+    { }
+
+    uint mId;
+    const AExpr* expr;
+    bool isCompiled;
+    AExprProg progNF;
+    AExprProg prog;
+  };
+
+  void
+  evaluateBlock(Metric::IData* const* rows, uint numRows);
+
+  // run: runs 'prog' over 'rows', leaving prog.depth() result slots
+  void
+  run(const AExprProg& prog, Metric::IData* const* rows, uint numRows);
+
+  double*
+  slot(uint i)
+  { return &m_stack[i * BlockSz]; }
+
+private:
+  uint m_numMetrics;
+  bool m_doNF;
+  bool m_doFinal;
+
+  std::vector<Entry> m_entries;
+  uint m_maxDepth; // over all programs
+  std::vector<double> m_stack; // slots of BlockSz values
+};
+
+
+//****************************************************************************
+
+} // namespace Metric
+
+} // namespace Prof
+
+//****************************************************************************
+
+#endif /* prof_Prof_Metric_AExprBatch_hpp */
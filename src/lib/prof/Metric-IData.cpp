@@ -66,6 +66,9 @@ using std::string;
 
 #include <typeinfo>
 
+#include <cmath>
+#include <cstdio>
+
 //*************************** User Include Files ****************************
 
 #include <include/gcc-attr.h>
@@ -101,6 +104,52 @@ IData::toStringMetrics(int oFlags, const char* pfx) const
 
 std::ostream&
 IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
+		       int oFlags, const char* pfx) const
+{
+  string buf;
+  writeMetricsXML(buf, mBegId, mEndId, oFlags, pfx);
+  os << buf;
+  return os;
+}
+
+
+// appendUInt, appendDouble: append 'x' to 'buf' exactly as
+// xml::MakeAttrNum() would format it ("%u" and "%g"), but without
+// allocating temporaries.  Most metric values are small integers,
+// which "%g" prints as plain decimals.
+static inline void
+appendUInt(string& buf, unsigned long x)
+{
+  char str[24];
+  char* p = str + sizeof(str);
+  do {
+    *--p = '0' + (x % 10);
+    x /= 10;
+  } while (x != 0);
+  buf.append(p, str + sizeof(str) - p);
+}
+
+
+static inline void
+appendDouble(string& buf, double x)
+{
+  if (x > -1e6 && x < 1e6 && x == (double)(long)x && !std::signbit(x)) {
+    appendUInt(buf, (unsigned long)x);
+  }
+  else if (x > -1e6 && x < 0 && x == (double)(long)x) {
+    buf += '-';
+    appendUInt(buf, (unsigned long)(-x));
+  }
+  else {
+    char str[32];
+    int len = snprintf(str, sizeof(str), "%g", x);
+    buf.append(str, len);
+  }
+}
+
+
+void
+IData::writeMetricsXML(string& buf, uint mBegId, uint mEndId,
 		       int GCC_ATTR_UNUSED oFlags, const char* pfx) const
 {
   bool wasMetricWritten = false;
@@ -113,14 +162,21 @@ IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
   for (uint i = mBegId; i < mEndId; i++) {
     if (hasMetric(i)) {
       double m = metric(i);
-      os << ((!wasMetricWritten) ? pfx : "");
-      os << "<M " << "n" << xml::MakeAttrNum(i) 
-	 << " v" << xml::MakeAttrNum(m) << "/>";
+      if (!wasMetricWritten) {
+	buf += pfx;
+      }
+      buf += "<M n";
+      buf += xml::attB;
+      appendUInt(buf, i);
+      buf += xml::attE;
+      buf += " v";
+      buf += xml::attB;
+      appendDouble(buf, m);
+      buf += xml::attE;
+      buf += "/>";
       wasMetricWritten = true;
     }
   }
-
-  return os;
 }
 
 
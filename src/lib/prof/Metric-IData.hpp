@@ -236,6 +236,14 @@ public:
 		  uint mEndId = Metric::IData::npos,
 		  int oFlags = 0, const char* pfx = "") const;
 
+  // appends the same text to 'buf' (without iostreams, for the
+  // parallel XML writer)
+  void
+  writeMetricsXML(std::string& buf,
+		  uint mBegId = Metric::IData::npos,
+		  uint mEndId = Metric::IData::npos,
+		  int oFlags = 0, const char* pfx = "") const;
+
 
   std::ostream&
   dumpMetrics(std::ostream& os = std::cerr, int oFlags = 0,
@@ -84,6 +84,7 @@
 #include <lib/support/Logic.hpp>
 #include <lib/support/NonUniformDegreeTree.hpp>
 #include <lib/support/RealPathMgr.hpp>
+#include <lib/support/SlabAlloc.hpp>
 #include <lib/support/SrcFile.hpp>
 using SrcFile::ln_NULL;
 #include <lib/support/Unique.hpp>
@@ -296,6 +297,15 @@ public:
 		  << " " << std::hex << this << std::dec);
   }
 
+  // nodes are slab allocated (cf. SlabAlloc)
+  static void*
+  operator new(size_t sz)
+  { return SlabAlloc::allocate(sz); }
+
+  static void
+  operator delete(void* p, size_t sz)
+  { SlabAlloc::deallocate(p, sz); }
+
   // clone: return a shallow copy, unlinked from the tree
   virtual ANode*
   clone()
@@ -97,6 +97,16 @@ public:
       return oldpath;
     }
   }
+
+  // lmName: the name given to a load module read from a structure
+  // file.  A structure file found by content (e.g., in the hpcstruct
+  // cache) names the binary where it was analyzed, which may differ
+  // from the profile's load map.
+  virtual std::string
+  lmName(const std::string& oldpath) const
+  {
+    return realpath(oldpath);
+  }
   
 private:
   const RealPathMgr* m_realpathMgr;
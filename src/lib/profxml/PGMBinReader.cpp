@@ -0,0 +1,392 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Read a binary structure file (prof-lean/hpcstruct-fmt.h) into a
+//   Prof::Struct::Tree.
+//
+// Description:
+//   The file is mapped read-only and the node records are visited in
+//   preorder.  Strings are used in place from the mapping; names that
+//   go through DocHandlerArgs::realpath() are resolved once per unique
+//   string rather than once per node.
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+using std::string;
+
+#include <unordered_map>
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include "PGMBinReader.hpp"
+
+#include <lib/prof/Struct-Tree.hpp>
+
+#include <lib/prof-lean/hpcstruct-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/SrcFile.hpp>
+
+//************************ Forward Declarations ******************************
+
+#define DBG 0
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+// The mapped file and its sections, after validation.
+class BinStructFile {
+public:
+  BinStructFile(const char* filenm, const char* base, size_t size)
+    : m_filenm(filenm), m_base(base), m_size(size)
+  {
+    const hpcstruct_fmt_hdr_t* hdr = (const hpcstruct_fmt_hdr_t*) base;
+
+    if (size < sizeof(hpcstruct_fmt_hdr_t) + sizeof(hpcstruct_fmt_footer_t)
+	|| strncmp(hdr->magic, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) != 0) {
+      DIAG_Throw("'" << m_filenm << "' is not a binary structure file");
+    }
+    if (strncmp(hdr->version, HPCSTRUCT_FMT_Version,
+		HPCSTRUCT_FMT_VersionLen) != 0) {
+      DIAG_Throw("'" << m_filenm << "': unsupported binary structure version '"
+		 << string(hdr->version, HPCSTRUCT_FMT_VersionLen) << "'");
+    }
+    if (hdr->endian != HPCSTRUCT_FMT_Endian) {
+      DIAG_Throw("'" << m_filenm << "': binary structure file was written on a"
+		 << " host with different byte order");
+    }
+
+    const hpcstruct_fmt_footer_t* footer = (const hpcstruct_fmt_footer_t*)
+      (base + size - sizeof(hpcstruct_fmt_footer_t));
+
+    if (strncmp(footer->magic, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) != 0) {
+      DIAG_Throw("'" << m_filenm << "': binary structure file is truncated");
+    }
+
+    checkSection(footer->nodes_off, footer->num_nodes,
+		 sizeof(hpcstruct_fmt_node_t));
+    checkSection(footer->vmas_off, footer->num_vmas,
+		 sizeof(hpcstruct_fmt_vma_t));
+    checkSection(footer->strs_off, footer->strs_len, 1);
+
+    // every string offset below strs_len is then NUL-terminated
+    if (footer->strs_len == 0 || base[footer->strs_off + footer->strs_len - 1] != '\0') {
+      DIAG_Throw("'" << m_filenm << "': corrupt string table");
+    }
+
+    m_nodes = (const hpcstruct_fmt_node_t*) (base + footer->nodes_off);
+    m_num_nodes = footer->num_nodes;
+    m_vmas = (const hpcstruct_fmt_vma_t*) (base + footer->vmas_off);
+    m_num_vmas = footer->num_vmas;
+    m_strs = base + footer->strs_off;
+    m_strs_len = footer->strs_len;
+  }
+
+  uint64_t
+  numNodes() const
+  { return m_num_nodes; }
+
+  const hpcstruct_fmt_node_t&
+  node(uint64_t i) const
+  { return m_nodes[i]; }
+
+  const char*
+  str(uint64_t offset) const
+  {
+    if (offset >= m_strs_len) {
+      DIAG_Throw("'" << m_filenm << "': string offset " << offset
+		 << " out of range");
+    }
+    return m_strs + offset;
+  }
+
+  void
+  insertVMAs(const hpcstruct_fmt_node_t& node, VMAIntervalSet& vset) const
+  {
+    if (node.vma_first > m_num_vmas || node.num_vma > m_num_vmas - node.vma_first) {
+      DIAG_Throw("'" << m_filenm << "': vma range out of bounds");
+    }
+    for (uint64_t i = 0; i < node.num_vma; ++i) {
+      const hpcstruct_fmt_vma_t& vma = m_vmas[node.vma_first + i];
+      vset.insert(vma.beg, vma.end);
+    }
+  }
+
+private:
+  void
+  checkSection(uint64_t off, uint64_t num, uint64_t elemSz)
+  {
+    uint64_t limit = m_size - sizeof(hpcstruct_fmt_footer_t);
+    if (off < sizeof(hpcstruct_fmt_hdr_t) || off > limit || off % 8 != 0
+	|| num > (limit - off) / elemSz) {
+      DIAG_Throw("'" << m_filenm << "': corrupt section table");
+    }
+  }
+
+  const char* m_filenm;
+  const char* m_base;
+  size_t m_size;
+
+  const hpcstruct_fmt_node_t* m_nodes;
+  uint64_t m_num_nodes;
+  const hpcstruct_fmt_vma_t* m_vmas;
+  uint64_t m_num_vmas;
+  const char* m_strs;
+  uint64_t m_strs_len;
+};
+
+
+// Aliens, loops and stmts nest inside procs, aliens and loops.
+static inline bool
+isCodeScope(uint32_t ty)
+{
+  return (ty == HPCSTRUCT_FMT_Ty_Proc || ty == HPCSTRUCT_FMT_Ty_Alien
+	  || ty == HPCSTRUCT_FMT_Ty_Loop);
+}
+
+
+// Build the structure tree from the node records.  This follows
+// PGMDocHandler::startElement() for Doc_STRUCT documents.
+static void
+buildTree(Tree& structure, const BinStructFile& file, DocHandlerArgs& args)
+{
+  Root* root = structure.root();
+  uint64_t numNodes = file.numNodes();
+
+  std::vector<ANode*> nodeVec(numNodes, NULL);
+  std::vector<uint32_t> tyVec(numNodes, HPCSTRUCT_FMT_Ty_NULL);
+
+  // realpath() is expensive and file names repeat on every alien,
+  // loop and proc, so resolve each unique string only once.
+  std::unordered_map<uint64_t, string> pathMap;
+  auto realpath = [&](uint64_t offset) -> const string& {
+    auto it = pathMap.find(offset);
+    if (it == pathMap.end()) {
+      it = pathMap.emplace(offset, args.realpath(file.str(offset))).first;
+    }
+    return it->second;
+  };
+
+  for (uint64_t i = 0; i < numNodes; ++i) {
+    const hpcstruct_fmt_node_t& node = file.node(i);
+
+    uint32_t parentTy = HPCSTRUCT_FMT_Ty_NULL;
+    ANode* parent = NULL;
+    if (node.parent != HPCSTRUCT_FMT_NoParent) {
+      if (node.parent >= i) {
+	DIAG_Throw("binary structure node " << i << " is not in preorder");
+      }
+      parent = nodeVec[node.parent];
+      parentTy = tyVec[node.parent];
+    }
+
+    SrcFile::ln line = (SrcFile::ln) node.line;
+    ANode* curStrct = NULL;
+
+    switch (node.ty) {
+    case HPCSTRUCT_FMT_Ty_LM: {
+      DIAG_Assert(parentTy == HPCSTRUCT_FMT_Ty_NULL, "Parse error!");
+      curStrct = LM::demand(root, args.lmName(file.str(node.name)));
+      break;
+    }
+
+    case HPCSTRUCT_FMT_Ty_File: {
+      DIAG_Assert(parentTy == HPCSTRUCT_FMT_Ty_LM, "Parse error!");
+      curStrct = File::demand(dynamic_cast<LM*>(parent), realpath(node.name));
+      break;
+    }
+
+    case HPCSTRUCT_FMT_Ty_Proc: {
+      DIAG_Assert(parentTy == HPCSTRUCT_FMT_Ty_File, "Parse error: Support for nested procedures is disabled (cf. buildLMSkeleton())!");
+      File* fileStrct = dynamic_cast<File*>(parent);
+      const char* nm = file.str(node.name);
+
+      // Assume that VMA information fully qualifies procedures.
+      Proc* proc = fileStrct->findProc(nm);
+      if (proc && !proc->vmaSet().empty() && node.num_vma != 0) {
+	proc = NULL;
+      }
+
+      if (!proc) {
+	proc = new Proc(nm, fileStrct, file.str(node.link_name), false,
+			line, line);
+	file.insertVMAs(node, proc->vmaSet());
+	proc->m_origId = node.id;
+      }
+      else {
+	DIAG_Msg(0, "Warning: Found procedure '" << nm << "' multiple times within file '" << fileStrct->name() << "'; information for this procedure will be aggregated. If you do not want this, edit the STRUCTURE file and adjust the names by hand.");
+      }
+      curStrct = proc;
+      break;
+    }
+
+    case HPCSTRUCT_FMT_Ty_Alien: {
+      DIAG_Assert(isCodeScope(parentTy), "Parse error!");
+      const char* nm = file.str(node.name);
+      Alien* alien = new Alien(dynamic_cast<ACodeNode*>(parent),
+			       realpath(node.file).c_str(), nm, nm, line, line);
+      alien->proc(NULL);
+      alien->m_origId = node.id;
+      curStrct = alien;
+      break;
+    }
+
+    case HPCSTRUCT_FMT_Ty_Loop: {
+      DIAG_Assert(isCodeScope(parentTy), "Parse error!");
+      string fnm = realpath(node.file);
+      Loop* loop = new Loop(dynamic_cast<ACodeNode*>(parent), fnm, line, line);
+      loop->m_origId = node.id;
+      curStrct = loop;
+      break;
+    }
+
+    case HPCSTRUCT_FMT_Ty_Stmt: {
+      DIAG_Assert(isCodeScope(parentTy), "Parse error!");
+      Stmt* stmt = new Stmt(dynamic_cast<ACodeNode*>(parent), line, line);
+      file.insertVMAs(node, stmt->vmaSet());
+      stmt->m_origId = node.id;
+      curStrct = stmt;
+      break;
+    }
+
+    default:
+      DIAG_Throw("binary structure node " << i << " has unknown type "
+		 << node.ty);
+    }
+
+    DIAG_DevMsgIf(DBG, "PGMBinReader: " << curStrct->toStringMe());
+
+    nodeVec[i] = curStrct;
+    tyVec[i] = node.ty;
+  }
+}
+
+
+bool
+isBinaryStructure(const char* filenm)
+{
+  char buf[sizeof(HPCSTRUCT_FMT_Magic)];
+
+  int fd = open(filenm, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  ssize_t ret = read(fd, buf, HPCSTRUCT_FMT_MagicLen);
+  close(fd);
+
+  return (ret == HPCSTRUCT_FMT_MagicLen
+	  && strncmp(buf, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) == 0);
+}
+
+
+void
+read_PGMBinary(Tree& structure,
+	       const char* filenm,
+	       DocHandlerArgs& docHandlerArgs)
+{
+  int fd = open(filenm, O_RDONLY);
+  if (fd < 0) {
+    DIAG_Throw("unable to open structure file '" << filenm << "': "
+	       << strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    DIAG_Throw("unable to stat structure file '" << filenm << "': "
+	       << strerror(errno));
+  }
+
+  size_t size = st.st_size;
+  void* base = MAP_FAILED;
+  if (size > 0) {
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    DIAG_Throw("unable to map structure file '" << filenm << "'");
+  }
+
+  try {
+    BinStructFile file(filenm, (const char*) base, size);
+    buildTree(structure, file, docHandlerArgs);
+  }
+  catch (...) {
+    munmap(base, size);
+    DIAG_EMsg("While processing '" << filenm << "'...");
+    throw;
+  }
+
+  munmap(base, size);
+}
+
+
+} // namespace Struct
+
+} // namespace Prof
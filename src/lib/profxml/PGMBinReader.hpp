@@ -0,0 +1,95 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Read a binary structure file (prof-lean/hpcstruct-fmt.h) into a
+//   Prof::Struct::Tree.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef _profxml_PGMBinReader_
+#define _profxml_PGMBinReader_
+
+//************************ System Include Files ******************************
+
+//************************* User Include Files *******************************
+
+#include "DocHandlerArgs.hpp"
+
+#include <lib/prof/Struct-Tree.hpp>
+
+//************************ Forward Declarations ******************************
+
+namespace Prof {
+
+namespace Struct {
+
+// true if 'filenm' begins with the binary structure file magic string
+bool
+isBinaryStructure(const char* filenm);
+
+// Map 'filenm' into memory and add its LM, F, P, A, L and S nodes to
+// 'structure', with the same semantics as a STRUCTURE document read
+// by PGMDocHandler.
+void
+read_PGMBinary(Tree& structure,
+	       const char* filenm,
+	       DocHandlerArgs& docHandlerArgs);
+
+} // namespace Struct
+
+} // namespace Prof
+
+//****************************************************************************
+
+#endif  // _profxml_PGMBinReader_
@@ -291,7 +291,7 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string nm = getAttr(attributes, attrName); // must exist
     DIAG_Assert(m_curRoot && !m_curLM, "Parse error!");
 
-    nm = m_args.realpath(nm);
+    nm = m_args.lmName(nm);
     m_curLM = Prof::Struct::LM::demand(m_curRoot, nm);
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curLM->toStringMe());
 
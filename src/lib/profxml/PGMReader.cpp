@@ -76,8 +76,11 @@ using std::string;
 //************************* User Include Files *******************************
 
 #include "PGMReader.hpp"
+#include "PGMBinReader.hpp"
 #include "XercesUtil.hpp"
 
+#include <lib/support-lean/timer.h>
+
 //*********************** Xerces Include Files *******************************
 
 #include <xercesc/util/XMLString.hpp>
@@ -141,7 +144,15 @@ readStructure(Struct::Tree& structure,
 
   for (uint i = 0; i < structureFiles.size(); ++i) {
     const string& fnm = structureFiles[i];
+    uint64_t t1 = 0, t2 = 0;
+
+    time_getTime_us(CLOCK_MONOTONIC, &t1);
     read_PGM(structure, fnm.c_str(), docty, docargs);
+    time_getTime_us(CLOCK_MONOTONIC, &t2);
+
+    // load time, to compare the xml and binary formats
+    DIAG_Msg(1, "STRUCTURE: read '" << fnm << "' in "
+	     << (double)(t2 - t1) / 1000000.0 << " sec");
   }
 
   FiniXerces();
@@ -161,6 +172,13 @@ read_PGM(Struct::Tree& structure,
   string fpath = filenm;
   string docType = PGMDocHandler::ToString(docty);
 
+  // structure files may also be in the binary format from
+  // 'hpcstruct --format=binary'
+  if (docty == PGMDocHandler::Doc_STRUCT && isBinaryStructure(filenm)) {
+    read_PGMBinary(structure, filenm, docHandlerArgs);
+    return;
+  }
+
   xmlSanityCheck(filenm, docType);
 
   if (!fpath.empty()) {
@@ -62,6 +62,7 @@
 #include <string>
 using std::string;
 
+#include <mutex>
 
 //*************************** User Include Files ****************************
 
@@ -87,9 +88,17 @@ using std::string;
 static RealPathMgr s_singleton;
 
 
+// The cache is shared by threads that read different load modules
+// (e.g., hpcprof's structure overlay).
+struct RealPathMgr::Lock {
+  std::mutex mutex;
+};
+
+
 // Constructor with static singleton objects for PathFindMgr and
 // PathReplacementMgr.
 RealPathMgr::RealPathMgr()
+  : m_lock(new Lock)
 {
   m_pathFindMgr = NULL;
   m_pathReplaceMgr = NULL;
@@ -99,6 +108,7 @@ RealPathMgr::RealPathMgr()
 // Constructor with params for PathFindMgr and PathReplacementMgr to
 // use instead of singletons.
 RealPathMgr::RealPathMgr(PathFindMgr * findMgr, PathReplacementMgr * replaceMgr)
+  : m_lock(new Lock)
 {
   m_pathFindMgr = findMgr;
   m_pathReplaceMgr = replaceMgr;
@@ -114,6 +124,7 @@ RealPathMgr::~RealPathMgr()
   if (m_pathReplaceMgr != NULL) {
     delete m_pathReplaceMgr;
   }
+  delete m_lock;
 }
 
 
@@ -132,6 +143,10 @@ RealPathMgr::realpath(string& pathNm) const
   
   // INVARIANT: 'pathNm' is not empty
 
+  // N.B.: the lock also serializes the path find and replacement
+  // managers, whose caches are not thread safe either.
+  std::lock_guard<std::mutex> guard(m_lock->mutex);
+
   // INVARIANT: all entries in the map are non-empty
   MyMap::iterator it = m_cache.find(pathNm);
 
@@ -244,6 +259,8 @@ std::ostream&
 RealPathMgr::dump(std::ostream& os, uint GCC_ATTR_UNUSED flags,
 		  const char* pfx) const
 {
+  std::lock_guard<std::mutex> guard(m_lock->mutex);
+
   os << pfx << "[ RealPathMgr:" << std::endl;
   for (MyMap::const_iterator it = m_cache.begin(); it != m_cache.end(); ++it) {
     const string& x = it->first;
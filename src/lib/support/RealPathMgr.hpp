@@ -102,7 +102,7 @@ public:
   // realpath: Given 'fnm', convert it to its 'realpath' (if possible)
   // and return true.  Return true if 'fnm' is as fully resolved as it
   // can be (which does not necessarily mean it exists); otherwise
-  // return false.
+  // return false.  Thread safe.
   bool
   realpath(std::string& pathNm) const;
   
@@ -140,13 +140,18 @@ public:
 
 
 private:
+  RealPathMgr(const RealPathMgr&);
+  RealPathMgr& operator=(const RealPathMgr&);
+
   typedef std::map<std::string, std::string> MyMap;
+  struct Lock;
 
   PathFindMgr * m_pathFindMgr;
   PathReplacementMgr * m_pathReplaceMgr;
 
   std::string m_searchPaths;
   mutable MyMap m_cache;
+  Lock* m_lock; // guards m_cache
 };
 
 
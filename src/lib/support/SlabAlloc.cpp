@@ -0,0 +1,398 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <new>
+#include <mutex>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//*************************** User Include Files ****************************
+
+#include "SlabAlloc.hpp"
+
+//*************************** Forward Declarations ***************************
+
+// Objects are rounded up to a multiple of Granule, which also gives
+// the alignment of ::operator new().  Larger objects use the heap.
+static const size_t Granule    = 16;
+static const size_t MaxObjSize = 1024;
+static const size_t NumClasses = (MaxObjSize / Granule) + 1;
+
+// Pages are aligned to PageSize, so an object's page is found by
+// masking its address.
+static const size_t PageSize   = (1 << 16);
+
+// a thread cache moves objects to and from the pages Batch at a time
+// and holds at most 2 * Batch objects per class
+static const size_t Batch      = 32;
+
+// empty pages kept for reuse; the rest are returned to the system
+static const size_t MaxEmptyPages = 64;
+
+struct FreeObj {
+  FreeObj* next;
+};
+
+
+// Page header; the objects follow it.  A page is on its class's
+// partial list iff it has free objects, i.e., 'freeList' or
+// [cur, end) is non-empty.  'numLive' counts the objects handed out
+// to threads (including those in thread caches).
+struct Page {
+  Page* prev;
+  Page* next;
+  FreeObj* freeList;
+  char* cur;
+  char* end;
+  size_t numLive;
+};
+
+static const size_t PageHdrSize =
+  ((sizeof(Page) + Granule - 1) / Granule) * Granule;
+
+
+// shared state: per-class partial lists, guarded by the class's lock
+// (and, inside it, the empty-page pool's lock)
+struct SizeClass {
+  std::mutex lock;
+  Page* partial;
+};
+
+static SizeClass s_class[NumClasses];
+
+static std::mutex s_emptyLock;
+static Page* s_emptyPages;
+static size_t s_numEmptyPages;
+
+
+// per-thread state: a cache of free objects per class.  It is plain
+// data, so that it stays usable after the thread's destructors run;
+// 's_isExiting' then sends frees straight to the pages.
+struct ThreadCache {
+  FreeObj* head[NumClasses];
+  size_t count[NumClasses];
+};
+
+static __thread ThreadCache s_cache;
+static __thread bool s_isExiting;
+
+static void
+flushCache();
+
+// empties the thread's cache at thread exit
+struct CacheFlusher {
+  bool isUsed;
+
+  ~CacheFlusher()
+  {
+    flushCache();
+    s_isExiting = true;
+  }
+};
+
+static thread_local CacheFlusher s_flusher;
+
+
+//***************************************************************************
+
+static inline size_t
+sizeClass(size_t sz)
+{
+  size_t cls = (sz + Granule - 1) / Granule;
+  return (cls == 0) ? 1 : cls;
+}
+
+
+static inline Page*
+pageOf(void* p)
+{
+  return reinterpret_cast<Page*>(reinterpret_cast<uintptr_t>(p)
+				 & ~(uintptr_t)(PageSize - 1));
+}
+
+
+static inline bool
+hasFree(const Page* page)
+{
+  return page->freeList || page->cur < page->end;
+}
+
+
+static void
+pushPartial(SizeClass& sc, Page* page)
+{
+  page->prev = NULL;
+  page->next = sc.partial;
+  if (sc.partial) {
+    sc.partial->prev = page;
+  }
+  sc.partial = page;
+}
+
+
+static void
+removePartial(SizeClass& sc, Page* page)
+{
+  if (page->prev) {
+    page->prev->next = page->next;
+  }
+  else {
+    sc.partial = page->next;
+  }
+  if (page->next) {
+    page->next->prev = page->prev;
+  }
+}
+
+
+// newPage: returns an empty page for class 'cls', from the pool if
+// possible.  Throws std::bad_alloc on failure.
+static Page*
+newPage(size_t cls)
+{
+  Page* page = NULL;
+  {
+    std::lock_guard<std::mutex> guard(s_emptyLock);
+    if (s_emptyPages) {
+      page = s_emptyPages;
+      s_emptyPages = page->next;
+      s_numEmptyPages--;
+    }
+  }
+
+  if (!page) {
+    void* mem = NULL;
+    if (posix_memalign(&mem, PageSize, PageSize) != 0) {
+      throw std::bad_alloc();
+    }
+    page = static_cast<Page*>(mem);
+  }
+
+  size_t objSz = cls * Granule;
+  char* beg = reinterpret_cast<char*>(page) + PageHdrSize;
+  page->prev = page->next = NULL;
+  page->freeList = NULL;
+  page->cur = beg;
+  page->end = beg + ((PageSize - PageHdrSize) / objSz) * objSz;
+  page->numLive = 0;
+  return page;
+}
+
+
+static void
+deletePage(Page* page)
+{
+  {
+    std::lock_guard<std::mutex> guard(s_emptyLock);
+    if (s_numEmptyPages < MaxEmptyPages) {
+      page->next = s_emptyPages;
+      s_emptyPages = page;
+      s_numEmptyPages++;
+      return;
+    }
+  }
+  free(page);
+}
+
+
+// takeObjs: fills the (empty) thread cache for class 'cls' with up to
+// 'n' free objects from the pages.  Throws std::bad_alloc on failure.
+static void
+takeObjs(size_t cls, size_t n)
+{
+  SizeClass& sc = s_class[cls];
+  size_t objSz = cls * Granule;
+
+  std::lock_guard<std::mutex> guard(sc.lock);
+
+  // keep the page order, so that fresh objects are handed out in
+  // address order
+  FreeObj** tail = &s_cache.head[cls];
+
+  for (size_t i = 0; i < n; ++i) {
+    Page* page = sc.partial;
+    if (!page) {
+      page = newPage(cls);
+      pushPartial(sc, page);
+    }
+
+    FreeObj* x = page->freeList;
+    if (x) {
+      page->freeList = x->next;
+    }
+    else {
+      x = reinterpret_cast<FreeObj*>(page->cur);
+      page->cur += objSz;
+    }
+    page->numLive++;
+
+    if (!hasFree(page)) {
+      removePartial(sc, page);
+    }
+
+    x->next = NULL;
+    *tail = x;
+    tail = &x->next;
+    s_cache.count[cls]++;
+  }
+}
+
+
+// returnObjs: moves 'n' objects of class 'cls' from the thread cache
+// back to their pages, releasing pages that become empty
+static void
+returnObjs(size_t cls, size_t n)
+{
+  SizeClass& sc = s_class[cls];
+  FreeObj*& head = s_cache.head[cls];
+
+  std::lock_guard<std::mutex> guard(sc.lock);
+
+  for (size_t i = 0; i < n && head; ++i) {
+    FreeObj* x = head;
+    head = x->next;
+    s_cache.count[cls]--;
+
+    Page* page = pageOf(x);
+    bool hadFree = hasFree(page);
+    x->next = page->freeList;
+    page->freeList = x;
+    page->numLive--;
+
+    if (page->numLive == 0) {
+      if (hadFree) {
+	removePartial(sc, page);
+      }
+      deletePage(page);
+    }
+    else if (!hadFree) {
+      pushPartial(sc, page);
+    }
+  }
+}
+
+
+static void
+flushCache()
+{
+  for (size_t cls = 1; cls < NumClasses; ++cls) {
+    returnObjs(cls, s_cache.count[cls]);
+  }
+}
+
+
+//***************************************************************************
+
+namespace SlabAlloc {
+
+void*
+allocate(size_t sz)
+{
+  if (sz > MaxObjSize) {
+    return ::operator new(sz);
+  }
+
+  size_t cls = sizeClass(sz);
+
+  if (!s_cache.head[cls]) {
+    // the first use registers the thread's exit-time flush
+    if (!s_isExiting) {
+      s_flusher.isUsed = true;
+    }
+    takeObjs(cls, Batch);
+  }
+
+  FreeObj* x = s_cache.head[cls];
+  s_cache.head[cls] = x->next;
+  s_cache.count[cls]--;
+  return x;
+}
+
+
+void
+deallocate(void* p, size_t sz)
+{
+  if (!p) {
+    return;
+  }
+
+  if (sz > MaxObjSize) {
+    ::operator delete(p);
+    return;
+  }
+
+  size_t cls = sizeClass(sz);
+
+  FreeObj* x = static_cast<FreeObj*>(p);
+  x->next = s_cache.head[cls];
+  s_cache.head[cls] = x;
+  s_cache.count[cls]++;
+
+  if (s_isExiting) {
+    returnObjs(cls, s_cache.count[cls]);
+  }
+  else if (s_cache.count[cls] >= 2 * Batch) {
+    returnObjs(cls, Batch);
+  }
+}
+
+} // namespace SlabAlloc
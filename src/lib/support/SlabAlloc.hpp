@@ -0,0 +1,112 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Slab allocation for large numbers of small, individually
+//   allocated objects (tree nodes).
+//
+// Description:
+//   Each size class has its own pages (64 KB, aligned to their size),
+//   and objects are carved out of a page in allocation order, so the
+//   nodes of a tree built in preorder (e.g., read from a file) are
+//   laid out in preorder.  Neither allocation nor deallocation calls
+//   malloc() except to obtain a new page.
+//
+//   Each thread keeps a small cache of free objects per size class,
+//   so most calls need no locking.  When a cache is empty it takes a
+//   batch of objects from the shared pages; when it is full it gives
+//   a batch back, and it is emptied when its thread exits.  An object
+//   may be freed by a thread other than the one that allocated it.
+//   Thus objects freed on one thread (e.g., an OpenMP worker) are
+//   reused by the others, and a page whose objects are all free goes
+//   to a small shared pool of empty pages (for any size class) or
+//   back to the system.
+//
+//   Classes use it through class-specific operator new/delete; with a
+//   virtual destructor, operator delete receives the size of the
+//   most-derived class:
+//
+//     static void* operator new(size_t sz)
+//     { return SlabAlloc::allocate(sz); }
+//
+//     static void operator delete(void* p, size_t sz)
+//     { SlabAlloc::deallocate(p, sz); }
+//
+//***************************************************************************
+
+#ifndef support_SlabAlloc_hpp
+#define support_SlabAlloc_hpp
+
+//************************* System Include Files ****************************
+
+#include <cstddef>
+
+//*************************** User Include Files ****************************
+
+//*************************** Forward Declarations ***************************
+
+//***************************************************************************
+
+namespace SlabAlloc {
+
+// allocate: returns 'sz' bytes, aligned as for ::operator new().
+// Throws std::bad_alloc on failure.
+void*
+allocate(size_t sz);
+
+// deallocate: frees 'p', where 'sz' is the size given to allocate()
+void
+deallocate(void* p, size_t sz);
+
+} // namespace SlabAlloc
+
+
+#endif /* support_SlabAlloc_hpp */
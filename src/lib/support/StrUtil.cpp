@@ -237,7 +237,9 @@ toDbl(const char* str, unsigned* endidx)
 //
 // --------------------------------------------------------------------------
 
-static char buf[32];
+// per-thread, so that the toStr() routines are safe to call from
+// parallel writers (e.g., CCT::Tree::writeXML())
+static __thread char buf[32];
 
 string
 toStr(const int x, int base)
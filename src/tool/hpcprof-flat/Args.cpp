@@ -142,6 +142,9 @@ Options: Source Structure Correlation:\n\
   -S <file>, --structure <file>\n\
                        Use hpcstruct structure file <file> for correlation.\n\
                        May pass multiple times (e.g., for shared libraries).\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads to read load modules and their line\n\
+                       maps and to copy source files. {1}\n\
   -R '<old-path>=<new-path>', --replace-path '<old-path>=<new-path>'\n\
                        Substitute instances of <old-path> with <new-path>;\n\
                        apply to all paths (profile's load map, source code)\n\
@@ -198,6 +201,8 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      NULL },
   { 'R', "replace-path",    CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL},
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // Output options
   { 'o', "output",          CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
@@ -398,6 +403,13 @@ Args::parse(int argc, const char* const argv[])
       }
     }
 
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) { ARG_ERROR("--jobs must be at least 1"); }
+      jobs = (uint)n;
+    }
+
     // Check for other options: Output options
     if (parser.isOpt("output")) {
       db_dir = parser.getOptArg("output");
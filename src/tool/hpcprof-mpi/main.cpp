@@ -75,6 +75,8 @@ using std::string;
 #include <vector>
 using std::vector;
 
+#include <map>
+
 #include <cstdlib> // getenv()
 #include <cmath>   // ceil()
 #include <climits> // UCHAR_MAX, PATH_MAX
@@ -89,6 +91,7 @@ using std::vector;
 #include "ParallelAnalysis.hpp"
 
 #include <lib/analysis/CallPath.hpp>
+#include <lib/analysis/CallPath-Incremental.hpp>
 #include <lib/analysis/Util.hpp>
 
 #include <lib/binutils/VMAInterval.hpp>
@@ -111,16 +114,32 @@ realmain(int argc, char* const* argv);
 static Analysis::Util::NormalizeProfileArgs_t
 myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 		       vector<uint>& groupIdToGroupSizeMap,
+		       Analysis::CallPath::IncrState* incr,
 		       int myRank, int numRanks);
 
+static Prof::CallPath::Profile*
+mergeIncrProfile(Prof::CallPath::Profile* profNew,
+		 const Analysis::CallPath::IncrState& incr,
+		 const string& dbDir);
 
 static void
 makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
+		   Analysis::CallPath::IncrState* incr, bool isUpdate,
 		   int myRank, int numRanks);
 
+static void
+makeIncrSummary(Prof::CallPath::Profile& profGbl,
+		const Analysis::Args& args,
+		Analysis::CallPath::IncrState& incr, bool isUpdate,
+		uint mDrvdBeg, uint mDrvdEnd, uint mXDrvdBeg, uint mXDrvdEnd);
+
+static void
+checkIncrKeys(Analysis::CallPath::IncrState& incr,
+	      const Analysis::Args& args, bool isUpdate, int myRank);
+
 static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
@@ -157,6 +176,11 @@ static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
 	       const string& metricDBFnm);
 
+static void
+remapMetricsDB(const string& metricDBFnm,
+	       const vector<uint64_t>& oldKeys,
+	       const std::map<uint64_t, uint>& newKeyToId, uint numNodes);
+
 
 static void
 writeStructure(const Prof::Struct::Tree& structure, const char* baseNm,
@@ -268,6 +292,11 @@ realmain(int argc, char* const* argv)
     }
   }
 
+  // each rank reads its profiles twice (CCT and metrics), so there
+  // is no single merged profile to cache
+  DIAG_WMsgIf(args.profileCache && myRank == 0,
+	      "hpcprof-mpi ignores --profile-cache");
+
   // -------------------------------------------------------
   // 0. Make empty Experiment database (ensure file system works)
   // -------------------------------------------------------
@@ -284,6 +313,28 @@ realmain(int argc, char* const* argv)
   MPI_Bcast((void*)dbDirBuf, PATH_MAX, MPI_CHAR, 0, MPI_COMM_WORLD);
   args.db_dir = dbDirBuf;
 
+  // -------------------------------------------------------
+  // 0. Incremental update: read the state of the existing database.
+  //    Only rank 0 changes 'incr'; the other ranks use it to remap
+  //    the old metric db files.
+  // -------------------------------------------------------
+  Analysis::CallPath::IncrState incr;
+  bool isUpdate = false;
+
+  if (args.db_incremental) {
+    isUpdate = incr.read(args.db_dir);
+
+    string experimentFnm = args.db_dir + "/" + args.out_db_experiment;
+    if (!isUpdate && FileUtil::isReadable(experimentFnm) && myRank == 0) {
+      DIAG_EMsg("database '" << args.db_dir << "' was not made with "
+		"--incremental or an update of it was interrupted; "
+		"rebuild it");
+      prof_abort(-1);
+    }
+  }
+
+  uint numOldFiles = incr.files.size();
+
   // -------------------------------------------------------
   // 1a. Create local CCT (from local set of profile files)
   // -------------------------------------------------------
@@ -291,16 +342,50 @@ realmain(int argc, char* const* argv)
 
   vector<uint> groupIdToGroupSizeMap; // only initialized for rank 0
 
+  // N.B.: with --incremental, only the profiles that are not yet in
+  // the database are distributed (but groups are sized with all).
   Analysis::Util::NormalizeProfileArgs_t nArgs =
     myNormalizeProfileArgs(args.profileFiles, groupIdToGroupSizeMap,
+			   (args.db_incremental && myRank == 0) ? &incr : NULL,
 			   myRank, numRanks);
 
+  if (myRank == 0 && isUpdate) {
+    string config =
+      Analysis::CallPath::IncrState::makeConfig(args, nArgs.groupMax);
+    if (incr.config != config) {
+      DIAG_EMsg("the options or groups of measurement directories differ "
+		"from those used to make database '" << args.db_dir
+		<< "'; rebuild it");
+      prof_abort(-1);
+    }
+  }
+
+  uint isUpToDate = (isUpdate && nArgs.paths->size() == 0);
+  MPI_Bcast((void*)&isUpToDate, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+  if (isUpToDate) {
+    if (myRank == 0) {
+      std::cerr << "Database '" << args.db_dir << "' is up to date\n";
+    }
+    nArgs.destroy();
+    MPI_Finalize();
+    return 0;
+  }
+
   if (nArgs.paths->size() == 0 && myRank == 0) {
     std::cerr << "ERROR: command line directories"
       " contain no .hpcrun files; no database generated\n";
     prof_abort(-1);
   }
 
+  // Every rank has read the old state; invalidate it until the update
+  // is complete.
+  if (isUpdate) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (myRank == 0) {
+      Analysis::CallPath::IncrState::remove(args.db_dir);
+    }
+  }
+
   int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
   uint rFlags = (Prof::CallPath::Profile::RFlg_VirtualMetrics
 		 | Prof::CallPath::Profile::RFlg_NoMetricSfx
@@ -324,19 +409,27 @@ realmain(int argc, char* const* argv)
   if (myRank == 0) {
     profGbl = profLcl;
     profLcl = NULL;
+
+    profGbl->metricMgr()->mergePerfEventStatistics_finalize(numRanks - 1);
+
+    // An update's canonical CCT is the saved one plus the new profiles'
+    if (isUpdate) {
+      profGbl = mergeIncrProfile(profGbl, incr, args.db_dir);
+    }
   }
 
   // Post-INVARIANT: 'profGbl' is the canonical CCT
   ParallelAnalysis::broadcast(profGbl, myRank);
 
-  if (myRank == 0) {
-    profGbl->metricMgr()->mergePerfEventStatistics_finalize(numRanks - 1);
-  }
-
   ParallelAnalysis::broadcast(profGbl->directorySet(), myRank);
 
   delete profLcl;
 
+  // Save the canonical CCT (before structure) for the next update
+  if (args.db_incremental && myRank == 0) {
+    Analysis::CallPath::IncrState::writeProfile(*profGbl, args.db_dir);
+  }
+
   // -------------------------------------------------------
   // 1c. Add static structure to canonical CCT; form dense node ids
   //
@@ -349,6 +442,7 @@ realmain(int argc, char* const* argv)
     Analysis::CallPath::readStructure(structure, args);
   }
   profGbl->structure(structure);
+  Analysis::CallPath::readCachedStructure(*profGbl, args);
 
 
   // N.B.: Ensures that each rank adds static structure in the same
@@ -356,7 +450,7 @@ realmain(int argc, char* const* argv)
   bool printProgress =  (myRank == 0);
   Analysis::CallPath::overlayStaticStructureMain(*profGbl, args.agent,
 						 args.doNormalizeTy,
-                                                 printProgress);
+                                                 printProgress, args.jobs);
 
   // N.B.: Dense ids are assigned w.r.t. Prof::CCT::...::cmpByStructureInfo()
   profGbl->cct()->makeDensePreorderIds();
@@ -367,6 +461,7 @@ realmain(int argc, char* const* argv)
   // Post-INVARIANT: rank 0's 'profGbl' contains summary metrics
   // -------------------------------------------------------
   makeSummaryMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
+		     (args.db_incremental) ? &incr : NULL, isUpdate,
 		     myRank, numRanks);
 
   // -------------------------------------------------------
@@ -403,6 +498,34 @@ realmain(int argc, char* const* argv)
   // N.B.: Dense ids are assigned w.r.t. Prof::CCT::...::cmpByStructureInfo()
   profGbl->cct()->makeDensePreorderIds();
 
+  // -------------------------------------------------------
+  // 2b'. Incremental update: move the rows of the old profiles'
+  //      metric db files to the nodes' new ids
+  // -------------------------------------------------------
+  if (args.db_incremental) {
+    vector<uint64_t> nodeKeys;
+    if (!Analysis::CallPath::makeNodeKeys(*profGbl, args.doNormalizeTy,
+					  nodeKeys)) {
+      checkIncrKeys(incr, args, isUpdate, myRank);
+    }
+
+    if (isUpdate && args.db_makeMetricDB) {
+      std::map<uint64_t, uint> keyToId;
+      for (uint id = 1; id < nodeKeys.size(); ++id) {
+	keyToId.insert(std::make_pair(nodeKeys[id], id));
+      }
+
+      uint numNodes = profGbl->cct()->maxDenseId();
+      for (uint i = myRank; i < numOldFiles; i += numRanks) {
+	const Analysis::CallPath::IncrState::File& file = incr.files[i];
+	string dbFnm = makeDBFileName(args.db_dir, file.groupId, file.path);
+	remapMetricsDB(dbFnm, incr.nodeKeys, keyToId, numNodes);
+      }
+    }
+
+    incr.nodeKeys.swap(nodeKeys);
+  }
+
   // -------------------------------------------------------
   // 2c. Create thread-level metric DB // Normalize trace files
   // -------------------------------------------------------
@@ -431,6 +554,18 @@ realmain(int argc, char* const* argv)
     Analysis::Util::copyTraceFiles(args.db_dir, profGbl->traceFileNameSet());
   }
 
+  // The database is complete: publish the state for the next update
+  if (args.db_incremental) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (myRank == 0 && incr.isStable) {
+      incr.config =
+	Analysis::CallPath::IncrState::makeConfig(args, nArgs.groupMax);
+      incr.directories.clear();
+      incr.directories += profGbl->directorySet();
+      incr.write(args.db_dir);
+    }
+  }
+
   // -------------------------------------------------------
   // Cleanup/MPI finalize
   // -------------------------------------------------------
@@ -449,9 +584,14 @@ realmain(int argc, char* const* argv)
 // myNormalizeProfileArgs: creates canonical list of profiles files and
 //   distributes chunks of size ceil(numFiles / numRanks) to each process.
 //   The last process may have a smaller chunk than the others.
+//
+//   If 'incr' is given (rank 0), only the files that it does not
+//   contain are distributed, and they are added to it.  The files it
+//   does contain must not have changed.
 static Analysis::Util::NormalizeProfileArgs_t
 myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 		       vector<uint>& groupIdToGroupSizeMap,
+		       Analysis::CallPath::IncrState* incr,
 		       int myRank, int numRanks)
 {
   Analysis::Util::NormalizeProfileArgs_t out;
@@ -471,28 +611,62 @@ myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
     Analysis::Util::NormalizeProfileArgs_t nArgs =
       Analysis::Util::normalizeProfileArgs(profileFiles);
     
-    Analysis::Util::StringVec* canonicalFiles = nArgs.paths;
     pathLenMax = nArgs.pathLenMax;
     groupIdMax = nArgs.groupMax;
 
     DIAG_Assert(nArgs.groupMax <= UCHAR_MAX, "myNormalizeProfileArgs: 'groupMax' cannot be packed into a uchar!");
 
+    groupIdToGroupSizeMap.resize(groupIdMax + 1);
+
+    vector<uint> sendFiles; // indices into nArgs.paths
+    uint numOldFiles = 0;
+
+    for (uint i = 0; i < nArgs.paths->size(); ++i) {
+      const std::string& nm = (*nArgs.paths)[i];
+      uint groupId = (*nArgs.groupMap)[i];
+
+      groupIdToGroupSizeMap[groupId]++;
+
+      const Analysis::CallPath::IncrState::File* file =
+	(incr) ? incr->findFile(nm) : NULL;
+      if (file) {
+	Analysis::CallPath::IncrState::File now =
+	  Analysis::CallPath::IncrState::makeFile(nm, groupId);
+	if (now.size != file->size || now.mtime != file->mtime
+	    || now.groupId != file->groupId) {
+	  DIAG_EMsg("profile '" << nm << "' has changed since it was added "
+		    "to the database; rebuild it");
+	  prof_abort(-1);
+	}
+	numOldFiles++;
+      }
+      else {
+	sendFiles.push_back(i);
+      }
+    }
+
+    if (incr && numOldFiles != incr->files.size()) {
+      DIAG_EMsg("the database contains " << incr->files.size() - numOldFiles
+		<< " profile(s) that are not listed; rebuild it");
+      prof_abort(-1);
+    }
+
     uint chunkSz = (uint)
-      ceil( (double)canonicalFiles->size() / (double)numRanks);
+      ceil( (double)sendFiles.size() / (double)numRanks);
     
     sendFilesChunkSz = chunkSz * (groupIdLen + pathLenMax + 1);
     sendFilesBufSz = sendFilesChunkSz * numRanks;
     sendFilesBuf = new char[sendFilesBufSz];
     memset(sendFilesBuf, '\0', sendFilesBufSz);
 
-    groupIdToGroupSizeMap.resize(groupIdMax + 1);
-    
-    for (uint i = 0, j = 0; i < canonicalFiles->size(); 
+    for (uint i = 0, j = 0; i < sendFiles.size(); 
 	 i++, j += (groupIdLen + pathLenMax + 1)) {
-      const std::string& nm = (*canonicalFiles)[i];
-      uint groupId = (*nArgs.groupMap)[i];
+      const std::string& nm = (*nArgs.paths)[sendFiles[i]];
+      uint groupId = (*nArgs.groupMap)[sendFiles[i]];
 
-      groupIdToGroupSizeMap[groupId]++;
+      if (incr) {
+	incr->addFile(Analysis::CallPath::IncrState::makeFile(nm, groupId));
+      }
 
       // pack into sendFilesBuf
       sendFilesBuf[j] = (char)groupId;
@@ -562,15 +736,68 @@ myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 }
 
 
+// mergeIncrProfile: merges the new profiles' canonical CCT 'profNew'
+// into the one saved in 'dbDir' and returns the result; deletes
+// 'profNew'.  (rank 0)
+static Prof::CallPath::Profile*
+mergeIncrProfile(Prof::CallPath::Profile* profNew,
+		 const Analysis::CallPath::IncrState& incr,
+		 const string& dbDir)
+{
+  Prof::CallPath::Profile* prof =
+    Analysis::CallPath::IncrState::readProfile(dbDir);
+
+  Prof::Metric::Mgr* mMgr = prof->metricMgr();
+  uint numMetrics = mMgr->size();
+
+  uint mBeg = prof->merge(*profNew,
+			  Prof::CallPath::Profile::Merge_MergeMetricByName);
+
+  // N.B.: the summary metrics and metric db files are laid out by
+  // metric; new metrics would change that layout.
+  if (mMgr->size() != numMetrics) {
+    DIAG_EMsg("the new profiles have metrics that database '" << dbDir
+	      << "' does not; rebuild it");
+    prof_abort(-1);
+  }
+
+  // perf-event statistics: the mean period is weighted by samples
+  Prof::Metric::Mgr* mMgrNew = profNew->metricMgr();
+  for (uint i = 0; i < mMgrNew->size(); ++i) {
+    Prof::Metric::ADesc* m = mMgr->metric(mBeg + i);
+    const Prof::Metric::ADesc* mNew = mMgrNew->metric(i);
+
+    uint64_t samples = m->num_samples() + mNew->num_samples();
+    if (samples > 0) {
+      double period = ((double)m->periodMean() * m->num_samples()
+		       + (double)mNew->periodMean() * mNew->num_samples());
+      m->periodMean(period / samples);
+    }
+    m->num_samples(samples);
+  }
+
+  prof->directorySet() += profNew->directorySet();
+  prof->directorySet() += incr.directories;
+
+  delete profNew;
+  return prof;
+}
+
+
 //***************************************************************************
 
 // makeSummaryMetrics: Assumes 'profGbl' is the canonical CCT (with
 // structure and with canonical ids).
+//
+// With 'incr', rank 0 also saves the summary accumulators for the
+// next update; if 'isUpdate', it first combines them with the saved
+// ones (which cover the profiles already in the database).
 static void
 makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
+		   Analysis::CallPath::IncrState* incr, bool isUpdate,
 		   int myRank, int numRanks)
 {
   uint mDrvdBeg = 0, mDrvdEnd = 0;   // [ )
@@ -636,6 +863,11 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   ParallelAnalysis::reduce(std::make_pair(&profGbl, packedMetrics),
 			   myRank, numRanks);
 
+  if (incr && myRank == 0) {
+    makeIncrSummary(profGbl, args, *incr, isUpdate,
+		    mDrvdBeg, mDrvdEnd, mXDrvdBeg, mXDrvdEnd);
+  }
+
   // -------------------------------------------------------
   // finalize metrics
   // -------------------------------------------------------
@@ -656,6 +888,114 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 }
 
 
+// checkIncrKeys: Called when makeNodeKeys() found CCT siblings that
+// are told apart only by their position, so that their keys may not
+// match across runs.  An update is refused by every rank before any
+// old metric db file is remapped; a new database is made but is not
+// made updatable.
+static void
+checkIncrKeys(Analysis::CallPath::IncrState& incr,
+	      const Analysis::Args& args, bool isUpdate, int myRank)
+{
+  if (isUpdate) {
+    if (myRank == 0) {
+      DIAG_EMsg("the CCT of database '" << args.db_dir << "' has nodes "
+		"that cannot be matched reliably across updates; rebuild it");
+    }
+    prof_abort(-1);
+  }
+
+  if (incr.isStable && myRank == 0) {
+    DIAG_WMsg(1, "the CCT has nodes that cannot be matched reliably "
+	      "across updates; database '" << args.db_dir
+	      << "' will not be updatable with --incremental");
+  }
+  incr.isStable = false;
+}
+
+
+// makeIncrSummary: (rank 0) Combine the summary accumulators
+// [mDrvdBeg, mDrvdEnd) of 'profGbl' with the saved ones of the same
+// nodes (if 'isUpdate'), and save the result in 'incr' (and a temporary
+// file).  As in the reduction, the saved values are unpacked into the
+// temporary accumulators [mXDrvdBeg, mXDrvdEnd) and combined; nodes
+// that are new are combined with 0, the identity.
+static void
+makeIncrSummary(Prof::CallPath::Profile& profGbl,
+		const Analysis::Args& args,
+		Analysis::CallPath::IncrState& incr, bool isUpdate,
+		uint mDrvdBeg, uint mDrvdEnd, uint mXDrvdBeg, uint mXDrvdEnd)
+{
+  uint maxCCTId = profGbl.cct()->maxDenseId();
+  uint numMetrics = mDrvdEnd - mDrvdBeg;
+
+  vector<uint64_t> nodeKeys;
+  if (!Analysis::CallPath::makeNodeKeys(profGbl, args.doNormalizeTy,
+					nodeKeys)) {
+    checkIncrKeys(incr, args, isUpdate, 0/*myRank*/);
+  }
+
+  if (isUpdate) {
+    incr.readSummary(args.db_dir);
+    if (incr.summaryNumMetrics != numMetrics) {
+      DIAG_EMsg("the summary metrics of database '" << args.db_dir
+		<< "' do not match; rebuild it");
+      prof_abort(-1);
+    }
+
+    std::map<uint64_t, uint> keyToId;
+    for (uint id = 1; id <= maxCCTId; ++id) {
+      keyToId.insert(std::make_pair(nodeKeys[id], id));
+    }
+
+    ParallelAnalysis::PackedMetrics packedMetrics(maxCCTId + 1,
+						  mXDrvdBeg, mXDrvdEnd,
+						  mDrvdBeg, mDrvdEnd);
+    for (uint id = 1; id <= maxCCTId; ++id) {
+      for (uint j = 0; j < numMetrics; ++j) {
+	packedMetrics.idx(id, j) = 0.0;
+      }
+    }
+
+    uint numLost = 0;
+    for (uint i = 0; i < incr.summaryKeys.size(); ++i) {
+      std::map<uint64_t, uint>::const_iterator it =
+	keyToId.find(incr.summaryKeys[i]);
+      if (it == keyToId.end()) {
+	numLost++;
+	continue;
+      }
+      for (uint j = 0; j < numMetrics; ++j) {
+	packedMetrics.idx(it->second, j) =
+	  incr.summaryValues[i * numMetrics + j];
+      }
+    }
+    DIAG_WMsgIf(numLost > 0, "Cannot match " << numLost
+		<< " CCT node(s) of the saved summary metrics; their values are lost");
+
+    ParallelAnalysis::unpackMetrics(profGbl, packedMetrics);
+  }
+
+  // save [mDrvdBeg, mDrvdEnd) by key
+  ParallelAnalysis::PackedMetrics packedMetrics(maxCCTId + 1,
+						mDrvdBeg, mDrvdEnd,
+						mDrvdBeg, mDrvdEnd);
+  ParallelAnalysis::packMetrics(profGbl, packedMetrics);
+
+  incr.summaryNumMetrics = numMetrics;
+  incr.summaryKeys.assign(nodeKeys.begin() + 1, nodeKeys.end());
+  incr.summaryValues.resize((size_t)maxCCTId * numMetrics);
+  for (uint id = 1; id <= maxCCTId; ++id) {
+    for (uint j = 0; j < numMetrics; ++j) {
+      incr.summaryValues[(id - 1) * numMetrics + j] = packedMetrics.idx(id, j);
+    }
+  }
+
+  incr.writeSummary(args.db_dir);
+  incr.clearSummary();
+}
+
+
 static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
@@ -1045,6 +1385,77 @@ badwrite:
 }
 
 
+// remapMetricsDB: Rewrite the metric db file 'metricDBFnm' of a profile
+// from an earlier version of the database, whose nodes had keys
+// 'oldKeys', for the current CCT of 'numNodes' nodes.  Nodes that are
+// new get 0; nodes that have disappeared are dropped.
+static void
+remapMetricsDB(const string& metricDBFnm,
+	       const vector<uint64_t>& oldKeys,
+	       const std::map<uint64_t, uint>& newKeyToId, uint numNodes)
+{
+  FILE* fs = hpcio_fopen_r(metricDBFnm.c_str());
+  if (!fs) {
+    DIAG_EMsg("failed opening metric db file '" << metricDBFnm
+	      << "' for reading; aborting.");
+    prof_abort(-1);
+  }
+
+  hpcmetricDB_fmt_hdr_t hdr;
+  int ret = hpcmetricDB_fmt_hdr_fread(&hdr, fs);
+  if (ret != HPCFMT_OK || hdr.numNodes + 1 != oldKeys.size()) {
+    DIAG_EMsg("metric db file '" << metricDBFnm
+	      << "' does not match the database; rebuild it");
+    prof_abort(-1);
+  }
+
+  uint numMetrics = hdr.numMetrics;
+  vector<double> values((size_t)(numNodes + 1) * numMetrics, 0.0);
+
+  for (uint nodeId = 1; nodeId <= hdr.numNodes; ++nodeId) {
+    std::map<uint64_t, uint>::const_iterator it =
+      newKeyToId.find(oldKeys[nodeId]);
+    for (uint mId = 0; mId < numMetrics; ++mId) {
+      double mval = 0.0;
+      ret = hpcfmt_real8_fread(&mval, fs);
+      if (ret != HPCFMT_OK) {
+	DIAG_EMsg("failed reading metric db file '" << metricDBFnm
+		  << "'; aborting.");
+	prof_abort(-1);
+      }
+      if (it != newKeyToId.end()) {
+	values[(size_t)it->second * numMetrics + mId] = mval;
+      }
+    }
+  }
+  hpcio_fclose(fs);
+
+  // write a temporary file, then replace the old one
+  string tmpFnm = metricDBFnm + ".tmp";
+  fs = hpcio_fopen_w(tmpFnm.c_str(), 1);
+  if (!fs) {
+    DIAG_EMsg("failed opening metric db file '" << tmpFnm
+	      << "' for writing; aborting.");
+    prof_abort(-1);
+  }
+
+  hdr.numNodes = numNodes;
+  ret = hpcmetricDB_fmt_hdr_fwrite(&hdr, fs);
+  for (uint nodeId = 1; nodeId <= numNodes && ret == HPCFMT_OK; ++nodeId) {
+    for (uint mId = 0; mId < numMetrics && ret == HPCFMT_OK; ++mId) {
+      ret = hpcfmt_real8_fwrite(values[(size_t)nodeId * numMetrics + mId], fs);
+    }
+  }
+
+  if (ret != HPCFMT_OK || hpcio_fclose(fs) != 0
+      || rename(tmpFnm.c_str(), metricDBFnm.c_str()) != 0) {
+    DIAG_EMsg("failed writing metric db file '" << metricDBFnm
+	      << "'; aborting.");
+    prof_abort(-1);
+  }
+}
+
+
 //***************************************************************************
 
 static void
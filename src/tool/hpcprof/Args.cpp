@@ -111,6 +111,11 @@ Args::parse(int argc, const char* const argv[])
     hpcprof_forceMetrics = true;
   }
 
+  // hpcprof's databases have no metric db or summary state to update
+  if (db_incremental) {
+    ARG_ERROR("--incremental requires hpcprof-mpi");
+  }
+
   // Currently, hpcprof does not generate thread-level metric db
   db_makeMetricDB = false;
 }
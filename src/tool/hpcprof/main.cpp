@@ -74,6 +74,7 @@ using std::string;
 #include "Args.hpp"
 
 #include <lib/analysis/CallPath.hpp>
+#include <lib/analysis/CallPath-ProfileCache.hpp>
 #include <lib/analysis/Util.hpp>
 
 #include <lib/support/diagnostics.h>
@@ -177,7 +178,9 @@ realmain(int argc, char* const* argv)
   }
   uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
 
-  Prof::CallPath::Profile* prof =
+  Prof::CallPath::Profile* prof = (args.profileCache) ?
+    Analysis::CallPath::readCached(*nArgs.paths, groupMap, mergeTy, rFlags,
+				   mrgFlags) :
     Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags);
 
   prof->disable_redundancy(args.remove_redundancy);
@@ -198,12 +201,13 @@ realmain(int argc, char* const* argv)
     Analysis::CallPath::readStructure(structure, args);
   }
   prof->structure(structure);
+  Analysis::CallPath::readCachedStructure(*prof, args);
 
   bool printProgress = true;
 
   Analysis::CallPath::overlayStaticStructureMain(*prof, args.agent,
 						 args.doNormalizeTy,
-                                                 printProgress);
+                                                 printProgress, args.jobs);
   
   // -------------------------------------------------------
   // 2a. Create summary metrics for canonical CCT
@@ -95,16 +95,46 @@ using std::string;
 static const char* version_info = HPCTOOLKIT_VERSION_STRING;
 
 static const char* usage_summary =
-"profile-file [profile-file]*\n";
+"[options] profile-file [profile-file]*\n"
+"  hpcproftt --trace-stats [options] trace-file [trace-file]*\n";
 
 static const char* usage_details =
 		 "hpcproftt generates textual dumps of call path profiles\n"
 		 "recorded by hpcrun.  The profile list may contain one or\n"
 		 "more call path profiles.\n"
 		 "\n"
+		 "With --top, hpcproftt instead streams the profiles and prints,\n"
+		 "for each metric, the <n> call paths (or load modules) with the\n"
+		 "largest exclusive and inclusive values summed over all profiles.\n"
+		 "Call path frames are shown as <load-module>+<normalized-ip>.\n"
+		 "\n"
+		 "With --trace-stats, hpcproftt instead summarizes hpctrace files, one\n"
+		 "per rank or thread: the time in each call path id (or with --db,\n"
+		 "each procedure), the same per phase with its imbalance across ranks\n"
+		 "(max/mean), and sampling gaps (intervals over 10x the rank's median).\n"
+		 "\n"
 		 "Options:\n"
 		 "  -V, --version        Print version information.\n"
-		 "  -h, --help           Print this help.\n";
+		 "  -h, --help           Print this help.\n"
+		 "  --top <n>            Print the top <n> entries per metric instead\n"
+		 "                       of a dump.\n"
+		 "  --top-by <key>       Rank entries by <key>, one of:\n"
+		 "                         path: call paths {path}\n"
+		 "                         lm:   load modules\n"
+		 "  -j <num>, --jobs <num>\n"
+		 "                       Use <num> threads to read profiles with --top,\n"
+		 "                       or traces with --trace-stats. {1}\n"
+		 "\n"
+		 "Options: Trace statistics:\n"
+		 "  --trace-stats        Summarize traces instead of a dump.\n"
+		 "  --db <db-path>       Map call path ids to procedures with the\n"
+		 "                       experiment.xml of database <db-path>, whose\n"
+		 "                       traces are given.\n"
+		 "  --phases <n>         Cut the run into <n> phases of equal length. {10}\n"
+		 "  --csv <prefix>       Write <prefix>-ranks.csv, <prefix>-time.csv and\n"
+		 "                       <prefix>-phases.csv instead of a text summary.\n"
+		 "  --binary <file>      Also write the per-rank statistics and times to\n"
+		 "                       <file> in a compact binary format.\n";
 
 #define CLP CmdLineParser
 #define CLP_SEPARATOR "!!!"
@@ -116,6 +146,26 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      NULL },
   { 'h', "help",            CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+
+  // Top-N query
+  {  0 , "top",             CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "top-by",          CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+
+  // Trace statistics
+  {  0 , "trace-stats",     CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "db",              CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "phases",          CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "csv",             CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "binary",          CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -145,6 +195,12 @@ Args::Ctor()
   obj_showSourceCode = false;
   obj_procThreshold = 1;
 
+  top_n = 0;
+  top_byLM = false;
+
+  trace_stats = false;
+  trace_numPhases = 10;
+
   Diagnostics_SetDiagnosticFilterLevel(1);
 
 
@@ -229,6 +285,56 @@ Args::parse(int argc, const char* const argv[])
       exit(1);
     }
 
+    // Check for other options: Top-N query
+    if (parser.isOpt("top")) {
+      const string& arg = parser.getOptArg("top");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) { ARG_ERROR("--top must be at least 1"); }
+      top_n = (uint)n;
+    }
+    if (parser.isOpt("top-by")) {
+      const string& arg = parser.getOptArg("top-by");
+      if (arg == "path") {
+	top_byLM = false;
+      }
+      else if (arg == "lm") {
+	top_byLM = true;
+      }
+      else {
+	ARG_ERROR("--top-by: Unexpected value received: '" << arg << "'");
+      }
+    }
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) { ARG_ERROR("--jobs must be at least 1"); }
+      jobs = (uint)n;
+    }
+
+    // Check for other options: Trace statistics
+    if (parser.isOpt("trace-stats")) {
+      trace_stats = true;
+    }
+    if (parser.isOpt("db")) {
+      trace_dbDir = parser.getOptArg("db");
+    }
+    if (parser.isOpt("phases")) {
+      const string& arg = parser.getOptArg("phases");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) { ARG_ERROR("--phases must be at least 1"); }
+      trace_numPhases = (uint)n;
+    }
+    if (parser.isOpt("csv")) {
+      trace_csvPfx = parser.getOptArg("csv");
+    }
+    if (parser.isOpt("binary")) {
+      trace_binaryFnm = parser.getOptArg("binary");
+    }
+
+    if (trace_stats && top_n > 0) {
+      ARG_ERROR("--top and --trace-stats are exclusive");
+    }
+
     // FIXME: sanity check that options correspond to mode
     
     // Check for required arguments
@@ -142,6 +142,17 @@ public:
   bool obj_metricsAsPercents;
   bool obj_showSourceCode;
 
+  // Top-N query args
+  uint top_n; // 0: dump the profiles instead
+  bool top_byLM;
+
+  // Trace statistics args
+  bool trace_stats;
+  std::string trace_dbDir;
+  uint trace_numPhases;
+  std::string trace_csvPfx;
+  std::string trace_binaryFnm;
+
 private:
   void Ctor();
   void setHPCHome(); 
@@ -64,6 +64,8 @@ using std::string;
 #include <lib/analysis/Flat-SrcCorrelation.hpp>
 #include <lib/analysis/Flat-ObjCorrelation.hpp>
 #include <lib/analysis/Raw.hpp>
+#include <lib/analysis/Raw-TopN.hpp>
+#include <lib/analysis/Raw-TraceStats.hpp>
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/NaN.h>
@@ -76,6 +78,12 @@ realmain(int argc, char* const* argv);
 static int
 main_rawData(const std::vector<string>& profileFiles);
 
+static int
+main_topN(const Args& args);
+
+static int
+main_traceStats(const Args& args);
+
 
 //****************************************************************************
 
@@ -122,6 +130,12 @@ static int
 realmain(int argc, char* const* argv) 
 {
   Args args(argc, argv);  // exits if error on command line
+  if (args.top_n > 0) {
+    return main_topN(args);
+  }
+  if (args.trace_stats) {
+    return main_traceStats(args);
+  }
   return main_rawData(args.profileFiles); 
 }
 
@@ -148,4 +162,38 @@ main_rawData(const std::vector<string>& profileFiles)
   return 0;
 }
 
+
+static int
+main_topN(const Args& args)
+{
+  using Analysis::Raw::TopN;
+
+  TopN query(args.top_n, args.top_byLM ? TopN::KeyTy_LM : TopN::KeyTy_Path);
+  query.add(args.profileFiles, args.jobs);
+  query.write(std::cout);
+  return 0;
+}
+
+
+static int
+main_traceStats(const Args& args)
+{
+  Analysis::Raw::TraceStats stats(args.trace_numPhases);
+  if (!args.trace_dbDir.empty()) {
+    stats.readDB(args.trace_dbDir);
+  }
+  stats.add(args.profileFiles, args.jobs);
+
+  if (!args.trace_csvPfx.empty()) {
+    stats.writeCSV(args.trace_csvPfx);
+  }
+  else {
+    stats.write(std::cout);
+  }
+  if (!args.trace_binaryFnm.empty()) {
+    stats.writeBinary(args.trace_binaryFnm);
+  }
+  return 0;
+}
+
 //****************************************************************************
@@ -629,6 +629,55 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 }
 
 
+typedef struct {
+  cct2metrics_t* cct2metrics_map;
+  int num_metrics;
+  size_t num_nodes;
+  size_t num_nonzero;
+} count_metrics_arg_t;
+
+
+static void
+l_count_metrics(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  count_metrics_arg_t* my_arg = (count_metrics_arg_t*) arg;
+  metric_set_t* ms = hpcrun_get_metric_set_specific(&(my_arg->cct2metrics_map), node);
+
+  my_arg->num_nodes++;
+  my_arg->num_nonzero += hpcrun_metric_set_num_nonzero(ms, my_arg->num_metrics);
+}
+
+
+//
+// Whether the metrics of the cct nodes in 'ccts' take less space
+// written sparse (a count, then an (id, value) pair per nonzero
+// value) than dense (a value per metric).
+//
+bool
+hpcrun_cct_sparse_metrics_smaller(cct2metrics_t* cct2metrics_map,
+				  cct_node_t** ccts, int num_ccts)
+{
+  count_metrics_arg_t count_arg = {
+    .cct2metrics_map = cct2metrics_map,
+    .num_metrics     = hpcrun_get_num_metrics(),
+    .num_nodes       = 0,
+    .num_nonzero     = 0
+  };
+
+  for (int i = 0; i < num_ccts; i++) {
+    hpcrun_cct_walk_node_1st(ccts[i], l_count_metrics, &count_arg);
+  }
+
+  size_t sparse_sz = count_arg.num_nodes * sizeof(uint32_t)
+    + count_arg.num_nonzero * (sizeof(uint32_t) + sizeof(uint64_t));
+  size_t dense_sz = count_arg.num_nodes * count_arg.num_metrics * sizeof(uint64_t);
+
+  TMSG(DATA_WRITE, "metrics: %ld nodes, %ld nonzero: sparse %ld vs. dense %ld bytes",
+       count_arg.num_nodes, count_arg.num_nonzero, sparse_sz, dense_sz);
+
+  return sparse_sz < dense_sz;
+}
+
 //
 // Writing operation
 //
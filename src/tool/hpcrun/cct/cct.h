@@ -258,6 +258,11 @@ typedef struct cct2metrics_t cct2metrics_t;
 
 int hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map,
                       cct_node_t* cct, FILE* fs, epoch_flags_t flags);
+
+// whether the metrics of the trees 'ccts' are smaller written sparse
+// (epoch flag isSparseMetrics)
+bool hpcrun_cct_sparse_metrics_smaller(cct2metrics_t* cct2metrics_map,
+                                       cct_node_t** ccts, int num_ccts);
 //
 // Utilities
 //
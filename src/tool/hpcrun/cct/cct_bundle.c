@@ -132,6 +132,21 @@ hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
   return hpcrun_cct_fwrite(cct2metrics_map, bndl->top, fs, flags);
 }
 
+//
+// Decide the metric encoding before writing the epoch header, which
+// precedes the cct: count the tree as hpcrun_cct_bundle_fwrite will
+// write it, with the partial unwinds attached.
+//
+bool
+hpcrun_cct_bundle_sparse_metrics_smaller(cct_bundle_t* bndl,
+                                         cct2metrics_t* cct2metrics_map)
+{
+  cct_node_t* ccts[2] = { bndl->top, bndl->partial_unw_root };
+  int num_ccts = (hpcrun_cct_parent(bndl->partial_unw_root)) ? 1 : 2;
+
+  return hpcrun_cct_sparse_metrics_smaller(cct2metrics_map, ccts, num_ccts);
+}
+
 //
 // cct_fwrite helpers
 //
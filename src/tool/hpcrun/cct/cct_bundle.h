@@ -93,6 +93,10 @@ extern void hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt);
 extern int hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* x,
                                     cct2metrics_t* cct2metrics_map);
 
+// whether hpcrun_cct_bundle_fwrite should write sparse metrics
+extern bool hpcrun_cct_bundle_sparse_metrics_smaller(cct_bundle_t* x,
+                                                     cct2metrics_t* cct2metrics_map);
+
 //
 // utility functions
 //
@@ -0,0 +1,351 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+// A persistent, on-disk cache of fnbounds tables shared by all hpcrun
+// processes (on a node, or on all nodes if the directory is on a
+// shared file system).  Without it, every process asks the hpcfnbounds
+// server to recompute the table for every load module it maps.
+//
+// The cache is enabled by setting HPCRUN_FNBOUNDS_CACHE to a
+// directory (hpcrun --fnbounds-cache).  Each entry is one file named
+// by the binary's build-id and size, or failing a build-id, by its
+// device, inode, size and mtime.  The file has a header followed (at
+// a fixed, page-aligned offset) by the array of addresses, so a hit
+// is a single read-only mmap.
+//
+// Notes:
+// 1. Whichever process first computes a table writes the entry to a
+// private temp file and renames it into place, so readers never see
+// a partial entry.  Concurrent writers of the same entry are harmless.
+//
+// 2. Entries from a different hpctoolkit version or word size are
+// ignored (and eventually replaced).
+//
+// 3. As with the server, callers hold the FNBOUNDS_LOCK, and nothing
+// here allocates memory.
+
+//***************************************************************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <include/hpctoolkit-config.h>
+
+#include "fnbounds_cache.h"
+#include "fnbounds_file_header.h"
+#include "messages.h"
+
+#include <lib/prof-lean/build-id.h>
+
+//***************************************************************************
+
+#define FNBOUNDS_CACHE_MAGIC   0x48504346424e4331ULL  // "HPCFBNC1"
+#define FNBOUNDS_CACHE_SUFFIX  ".fnb"
+
+// The address array starts at this offset, a multiple of any likely
+// page size, so it can be mmapped directly.  The gap is a hole.
+#define FNBOUNDS_CACHE_DATA_OFFSET  (64 * 1024)
+
+struct fnbounds_cache_header {
+  uint64_t magic;
+  uint64_t version;        // hash of the hpctoolkit version and word size
+  uint64_t num_entries;
+  uint64_t reference_offset;
+  uint64_t is_relocatable;
+  uint64_t data_offset;
+};
+
+enum {
+  CACHE_UNKNOWN = 0,
+  CACHE_ENABLED,
+  CACHE_DISABLED
+};
+
+static int cache_status = CACHE_UNKNOWN;
+static char cache_dir[PATH_MAX];
+static uint64_t cache_version;
+
+
+//*****************************************************************
+// Helper Functions
+//*****************************************************************
+
+static int
+cache_enabled(void)
+{
+  if (cache_status != CACHE_UNKNOWN) {
+    return cache_status == CACHE_ENABLED;
+  }
+
+  cache_status = CACHE_DISABLED;
+
+  char *dir = getenv("HPCRUN_FNBOUNDS_CACHE");
+  if (dir == NULL || dir[0] == 0) {
+    return 0;
+  }
+  if (strlen(dir) + 2 * BUILD_ID_HEX_MAX + 64 >= PATH_MAX) {
+    EMSG("FNBOUNDS_CACHE: directory name too long: %s", dir);
+    return 0;
+  }
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    EMSG("FNBOUNDS_CACHE: unable to create directory: %s", dir);
+    return 0;
+  }
+  strcpy(cache_dir, dir);
+
+  const char *version = HPCTOOLKIT_VERSION_STRING;
+  size_t word_size = sizeof(void *);
+  cache_version = build_id_hash_bytes(BUILD_ID_HASH_INIT, version,
+				      strlen(version));
+  cache_version = build_id_hash_bytes(cache_version, &word_size,
+				      sizeof(word_size));
+
+  cache_status = CACHE_ENABLED;
+  TMSG(FNBOUNDS_CACHE, "cache directory: %s", cache_dir);
+
+  return 1;
+}
+
+
+// Fill in 'path' with the name of the cache entry for 'fname' with
+// the given suffix.
+// Returns: 0 on success, else -1 if 'fname' can't be stat'd.
+//
+static int
+cache_path(const char *fname, const char *suffix, char *path, size_t len)
+{
+  char id[BUILD_ID_HEX_MAX];
+  struct stat st;
+
+  if (stat(fname, &st) != 0) {
+    return -1;
+  }
+
+  // stripping a binary keeps its build-id, but changes its size (and
+  // its fnbounds), so the size is always part of the key.
+  if (build_id_from_file(fname, id, sizeof(id)) == 0) {
+    snprintf(path, len, "%s/%s-%lx%s",
+	     cache_dir, id, (unsigned long) st.st_size, suffix);
+  }
+  else {
+    snprintf(path, len, "%s/i%lx-%lx-%lx-%lx%s",
+	     cache_dir, (unsigned long) st.st_dev, (unsigned long) st.st_ino,
+	     (unsigned long) st.st_size, (unsigned long) st.st_mtime, suffix);
+  }
+
+  return 0;
+}
+
+
+static size_t
+page_size(void)
+{
+  long ans = sysconf(_SC_PAGESIZE);
+  return (ans > 0) ? (size_t) ans : 4096;
+}
+
+
+static int
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+  size_t len = 0;
+
+  while (len < count) {
+    ssize_t ret = pwrite(fd, ((const char *) buf) + len, count - len,
+			 offset + len);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return -1;
+    }
+    len += ret;
+  }
+
+  return 0;
+}
+
+
+//*****************************************************************
+// Interface Functions
+//*****************************************************************
+
+int
+fnbounds_cache_entry_path(const char *fname, const char *suffix,
+			  char *path, size_t len)
+{
+  if (! cache_enabled()) {
+    return -1;
+  }
+  return cache_path(fname, suffix, path, len);
+}
+
+
+int
+fnbounds_cache_tmp_path(const char *path, char *tmp_path, size_t len)
+{
+  char host[64];
+
+  // the temp name must be unique across nodes sharing the directory
+  if (gethostname(host, sizeof(host)) != 0) {
+    strcpy(host, "host");
+  }
+  host[sizeof(host) - 1] = 0;
+  int n = snprintf(tmp_path, len, "%s.%s.%d.tmp", path, host, (int) getpid());
+
+  return (n < 0 || n >= (int) len) ? -1 : 0;
+}
+
+
+void *
+fnbounds_cache_lookup(const char *fname, struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX];
+  struct fnbounds_cache_header hdr;
+  struct stat st;
+
+  if (! cache_enabled() || cache_path(fname, FNBOUNDS_CACHE_SUFFIX, path, sizeof(path)) != 0) {
+    return NULL;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    TMSG(FNBOUNDS_CACHE, "miss: %s", fname);
+    return NULL;
+  }
+
+  size_t num_bytes = 0;
+  int ok = pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)
+    && hdr.magic == FNBOUNDS_CACHE_MAGIC
+    && hdr.version == cache_version
+    && hdr.num_entries > 0
+    && hdr.data_offset % page_size() == 0
+    && fstat(fd, &st) == 0;
+
+  if (ok) {
+    num_bytes = hdr.num_entries * sizeof(void *);
+    ok = (uint64_t) st.st_size >= hdr.data_offset + num_bytes;
+  }
+
+  void *addr = MAP_FAILED;
+  if (ok) {
+    addr = mmap(NULL, num_bytes, PROT_READ, MAP_PRIVATE, fd, hdr.data_offset);
+  }
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    TMSG(FNBOUNDS_CACHE, "invalid entry: %s for %s", path, fname);
+    return NULL;
+  }
+
+  fh->num_entries = hdr.num_entries;
+  fh->reference_offset = hdr.reference_offset;
+  fh->is_relocatable = hdr.is_relocatable;
+  fh->mmap_size = ((num_bytes + page_size() - 1) / page_size()) * page_size();
+
+  TMSG(FNBOUNDS_CACHE, "hit: %s, symbols: %ld", fname,
+       (long) fh->num_entries);
+
+  return addr;
+}
+
+
+void
+fnbounds_cache_insert(const char *fname, void *addr,
+		      struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX], tmp_path[PATH_MAX];
+  struct fnbounds_cache_header hdr;
+
+  if (fh->num_entries < 1 || ! cache_enabled()
+      || cache_path(fname, FNBOUNDS_CACHE_SUFFIX, path, sizeof(path)) != 0) {
+    return;
+  }
+
+  // another process may have been first
+  if (access(path, F_OK) == 0) {
+    return;
+  }
+
+  if (fnbounds_cache_tmp_path(path, tmp_path, sizeof(tmp_path)) != 0) {
+    return;
+  }
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    TMSG(FNBOUNDS_CACHE, "unable to write: %s", tmp_path);
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = FNBOUNDS_CACHE_MAGIC;
+  hdr.version = cache_version;
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+  hdr.is_relocatable = fh->is_relocatable;
+  hdr.data_offset = FNBOUNDS_CACHE_DATA_OFFSET;
+
+  int ok = pwrite_all(fd, addr, fh->num_entries * sizeof(void *),
+		      FNBOUNDS_CACHE_DATA_OFFSET) == 0
+    && pwrite_all(fd, &hdr, sizeof(hdr), 0) == 0;
+
+  if (close(fd) != 0 || ! ok || rename(tmp_path, path) != 0) {
+    TMSG(FNBOUNDS_CACHE, "unable to write: %s", path);
+    unlink(tmp_path);
+    return;
+  }
+
+  TMSG(FNBOUNDS_CACHE, "insert: %s as %s", fname, path);
+}
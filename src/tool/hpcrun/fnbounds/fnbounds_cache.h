@@ -0,0 +1,76 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#ifndef _FNBOUNDS_CACHE_H_
+#define _FNBOUNDS_CACHE_H_
+
+#include "fnbounds_file_header.h"
+
+// fnbounds_cache_lookup(): Returns the cached fnbounds table for
+// 'fname' (mmapped read-only) and fills in 'fh', or else NULL if the
+// cache is disabled or has no valid entry.
+void *fnbounds_cache_lookup(const char *fname, struct fnbounds_file_header *fh);
+
+// fnbounds_cache_insert(): Saves the table 'addr' for 'fname', as
+// returned by the server, unless it is already cached.
+void fnbounds_cache_insert(const char *fname, void *addr,
+			   struct fnbounds_file_header *fh);
+
+// fnbounds_cache_entry_path(): Fills in 'path' with the name of the
+// cache entry for 'fname' with the given suffix, so that other
+// per-binary data can share the cache directory and its keys.
+// Returns 0 on success, else -1 if the cache is disabled or 'fname'
+// can't be stat'd.
+int fnbounds_cache_entry_path(const char *fname, const char *suffix,
+			      char *path, size_t len);
+
+// fnbounds_cache_tmp_path(): Fills in 'tmp_path' with a temp name for
+// writing 'path', unique across processes and nodes, to be renamed
+// into place.  Returns 0 on success, else -1.
+int fnbounds_cache_tmp_path(const char *path, char *tmp_path, size_t len);
+
+#endif  // _FNBOUNDS_CACHE_H_
@@ -72,7 +72,10 @@
 // 5. Dup the hpcrun log file fd onto stdout and stderr to prevent
 // stray output from the server.
 //
-// 6. The bottom of this file has code for an interactive, stand-alone
+// 6. Answers are saved in (and first looked up in) the persistent
+// fnbounds cache, if enabled, see fnbounds_cache.c.
+//
+// 7. The bottom of this file has code for an interactive, stand-alone
 // client for testing hpcfnbounds in server mode.
 //
 // Todo:
@@ -120,6 +123,7 @@ int zero_fcn(void) { return 0; }
 #include <hpcfnbounds/syserv-mesg.h>
 #include "client.h"
 #include "disabled.h"
+#include "fnbounds_cache.h"
 #include "fnbounds_file_header.h"
 #include "messages.h"
 #include "sample_sources_all.h"
@@ -127,6 +131,8 @@ int zero_fcn(void) { return 0; }
 #else
 #include "syserv-mesg.h"
 #include "fnbounds_file_header.h"
+#define fnbounds_cache_lookup(...)  NULL
+#define fnbounds_cache_insert(...)
 #endif
 
 // Limit on memory use at which we restart the server in Meg.
@@ -517,6 +523,12 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
     return NULL;
   }
 
+  // another process may already have computed this table
+  addr = fnbounds_cache_lookup(fname, fh);
+  if (addr != NULL) {
+    return addr;
+  }
+
   if (client_status != SYSERV_ACTIVE || my_pid != getpid()) {
     launch_server();
   }
@@ -617,6 +629,8 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
     shutdown_server();
   }
 
+  fnbounds_cache_insert(fname, addr, fh);
+
   return addr;
 }
 
@@ -145,8 +145,8 @@ static spinlock_t fnbounds_lock = SPINLOCK_UNLOCKED;
 // forward declarations
 //*********************************************************************
 
-static load_module_t *
-fnbounds_get_loadModule(void *ip);
+static bool
+fnbounds_get_dso(void *ip, dso_info_t *dso, load_module_t **lm);
 
 static dso_info_t *
 fnbounds_compute(const char *filename, void *start, void *end);
@@ -187,12 +187,11 @@ fnbounds_init()
 bool
 fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
 {
-  FNBOUNDS_LOCK;
-
   bool ret = false; // failure unless otherwise reset to 0 below
   
-  load_module_t* lm_ = fnbounds_get_loadModule(ip);
-  dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
+  load_module_t* lm_ = NULL;
+  dso_info_t dso_;
+  const dso_info_t* dso = (fnbounds_get_dso(ip, &dso_, &lm_)) ? &dso_ : NULL;
   
   if (dso && dso->nsymbols > 0) {
     void* ip_norm = ip;
@@ -221,8 +220,6 @@ fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
     *lm = lm_;
   }
 
-  FNBOUNDS_UNLOCK;
-
   return ret;
 }
 
@@ -485,14 +482,14 @@ fnbounds_compute(const char* incoming_filename, void* start, void* end)
 }
 
 
-// fnbounds_get_loadModule(): Given the (unnormalized) IP 'ip',
-// attempt to return the enclosing load module.  Note that the
-// function may fail.
-static load_module_t *
-fnbounds_get_loadModule(void *ip)
+// fnbounds_get_dso(): Given the (unnormalized) IP 'ip', attempt to
+// copy the dso of the enclosing load module (from the load map's
+// address index) into '*dso', and set '*lm' to the load module.  Takes
+// no lock in the common case.  Returns false if the function fails.
+static bool
+fnbounds_get_dso(void *ip, dso_info_t *dso, load_module_t **lm)
 {
-  load_module_t* lm = hpcrun_loadmap_findByAddr(ip, ip);
-  dso_info_t* dso = (lm) ? lm->dso_info : NULL;
+  bool found = hpcrun_loadmap_findDsoByAddr(ip, dso, lm);
 
   // We can't call dl_iterate_phdr() in general because catching a
   // sample at just the wrong point inside dlopen() will segfault or
@@ -501,19 +498,17 @@ fnbounds_get_loadModule(void *ip)
   // However, the risk is small, and if we're willing to take the
   // risk, then analyzing the new DSO here allows us to sample inside
   // an init constructor.
-  if (!dso && ENABLED(DLOPEN_RISKY) && hpcrun_dlopen_pending() > 0) {
+  if (!found && ENABLED(DLOPEN_RISKY) && hpcrun_dlopen_pending() > 0) {
     char module_name[PATH_MAX];
     void *mstart, *mend;
     
     if (dylib_find_module_containing_addr(ip, module_name, &mstart, &mend)) {
-      dso = fnbounds_compute(module_name, mstart, mend);
-      if (dso) {
-	lm = hpcrun_loadmap_map(dso);
-      }
+      fnbounds_ensure_mapped_dso(module_name, mstart, mend);
+      found = hpcrun_loadmap_findDsoByAddr(ip, dso, lm);
     }
   }
   
-  return lm;
+  return found;
 }
 
 
@@ -56,6 +56,7 @@
 
 #include "fnbounds_interface.h"
 #include "fnbounds_file_header.h"
+#include "fnbounds_cache.h"
 
 #include <loadmap.h>
 #include <files.h>
@@ -154,3 +155,19 @@ void
 fnbounds_release_lock(void)
 {
 }
+
+
+// A static binary has no fnbounds server, and no on-disk cache.
+int
+fnbounds_cache_entry_path(const char *fname, const char *suffix,
+			  char *path, size_t len)
+{
+  return -1;
+}
+
+
+int
+fnbounds_cache_tmp_path(const char *path, char *tmp_path, size_t len)
+{
+  return -1;
+}
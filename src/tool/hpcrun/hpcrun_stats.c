@@ -110,6 +110,9 @@ static atomic_long num_corrected_reuse_distance = ATOMIC_VAR_INIT(0);
 static atomic_long num_unwind_intervals_total = ATOMIC_VAR_INIT(0);
 static atomic_long num_unwind_intervals_suspicious = ATOMIC_VAR_INIT(0);
 
+static atomic_long uw_recipe_cache_hits = ATOMIC_VAR_INIT(0);
+static atomic_long uw_recipe_cache_misses = ATOMIC_VAR_INIT(0);
+
 static atomic_long trolled = ATOMIC_VAR_INIT(0);
 static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
@@ -129,6 +132,8 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&num_samples_segv, 0, memory_order_relaxed);
   atomic_store_explicit(&num_unwind_intervals_total, 0, memory_order_relaxed);
   atomic_store_explicit(&num_unwind_intervals_suspicious, 0, memory_order_relaxed);
+  atomic_store_explicit(&uw_recipe_cache_hits, 0, memory_order_relaxed);
+  atomic_store_explicit(&uw_recipe_cache_misses, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
@@ -569,6 +574,34 @@ hpcrun_stats_num_unwind_intervals_suspicious(void)
   return atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
 }
 
+//-----------------------------
+// unwind recipe cache hits and misses
+//-----------------------------
+
+void
+hpcrun_stats_uw_recipe_cache_hits_inc(long amt)
+{
+  atomic_fetch_add_explicit(&uw_recipe_cache_hits, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_uw_recipe_cache_hits(void)
+{
+  return atomic_load_explicit(&uw_recipe_cache_hits, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_uw_recipe_cache_misses_inc(long amt)
+{
+  atomic_fetch_add_explicit(&uw_recipe_cache_misses, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_uw_recipe_cache_misses(void)
+{
+  return atomic_load_explicit(&uw_recipe_cache_misses, memory_order_relaxed);
+}
+
 //------------------------------------------------------
 // samples that include 1 or more successful troll steps
 //------------------------------------------------------
@@ -671,6 +704,12 @@ hpcrun_stats_print_summary(void)
        frames_total, trolled_frames,
        num_unwind_intervals_total,  num_unwind_intervals_suspicious);
 
+  long uw_hits = atomic_load_explicit(&uw_recipe_cache_hits, memory_order_relaxed);
+  long uw_lookups = uw_hits +
+    atomic_load_explicit(&uw_recipe_cache_misses, memory_order_relaxed);
+  AMSG("UNWIND RECIPE CACHE: lookups: %ld, hits: %ld (%ld%%)",
+       uw_lookups, uw_hits, (uw_lookups > 0) ? (100 * uw_hits) / uw_lookups : 0L);
+
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
   }
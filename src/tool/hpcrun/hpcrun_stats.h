@@ -176,6 +176,17 @@ void hpcrun_stats_num_unwind_intervals_suspicious_inc(void);
 long hpcrun_stats_num_unwind_intervals_suspicious(void);
 
 
+//-----------------------------
+// unwind recipe cache hits and misses
+//-----------------------------
+
+void hpcrun_stats_uw_recipe_cache_hits_inc(long amt);
+long hpcrun_stats_uw_recipe_cache_hits(void);
+
+void hpcrun_stats_uw_recipe_cache_misses_inc(long amt);
+long hpcrun_stats_uw_recipe_cache_misses(void);
+
+
 //------------------------------------------------------
 // samples that include 1 or more successful troll steps
 //------------------------------------------------------
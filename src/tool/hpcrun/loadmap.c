@@ -44,6 +44,7 @@
 //
 // ******************************************************* EndRiceCopyright *
 
+#include <limits.h>
 #include <sys/time.h>
 #include "cct.h"
 #include "loadmap.h"
@@ -54,9 +55,11 @@
 #include "epoch.h"
 
 #include <messages/messages.h>
+#include <memory/mmap.h>
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define LOADMAP_DEBUG 0
 
@@ -74,6 +77,72 @@ static spinlock_t loadmap_lock = SPINLOCK_UNLOCKED;
 
 static loadmap_notify_t *notification_recipients = NULL;
 
+
+// The address index: the load modules that currently have a dso, as an
+// immutable array sorted by start address.  Lookups by address, which
+// run in signal handlers on every thread, take one acquire load and
+// binary search whatever index they got; they take no lock.
+//
+// Whenever a dso is mapped or unmapped, a new index is built and
+// published with a release store.  (Callers serialize the updates:
+// fnbounds_lock in the dynamic case.)  Each entry holds a copy of the
+// dso_info_t, so a reader never follows lm->dso_info, which unmap
+// clears and the dso free list recycles.
+//
+// Replaced indexes are reclaimed by epoch.  Each publish advances
+// s_loadmap_index_epoch and retires the old index, tagged with the new
+// epoch.  For as long as a lookup holds an index (it copies what it
+// needs out of it), it announces the epoch at which it started in its
+// thread's reader record, which is on a cache line of its own, so
+// readers do not contend with each other.  A lookup that started in
+// epoch e can only hold indexes retired in an epoch after e, so after
+// each publish the writer recycles every retired index whose epoch is
+// no later than the oldest announced one.  A lookup from a signal
+// handler that interrupts another keeps the outer lookup's (older)
+// epoch.
+//
+// Indexes live in hpcrun_malloc memory, which is never freed, so they
+// are allocated with room to grow and reused rather than built afresh
+// per dlopen or dlclose.  Reader records are carved from anonymous
+// pages (a lookup may come before the thread has its own memstore),
+// claimed on a thread's first lookup and given back at thread exit.
+
+typedef struct loadmap_index_entry_t {
+  void* max_end_addr; // max dso.end_addr over this and all lower entries
+  load_module_t* lm;
+  dso_info_t dso;     // copy of lm->dso_info when the index was built
+} loadmap_index_entry_t;
+
+typedef struct loadmap_index_t {
+  struct loadmap_index_t* next;   // on the retired or free list
+  long retired_epoch;             // on the retired list
+  size_t capacity;
+  size_t len;
+  loadmap_index_entry_t entry[];  // sorted by dso.start_addr
+} loadmap_index_t;
+
+#define LOADMAP_INDEX_MIN_CAPACITY 64
+
+#define LOADMAP_CACHE_LINE 64
+#define LOADMAP_INDEX_READERS_PER_ALLOC 64 // one page
+
+typedef struct loadmap_index_reader_t {
+  atomic_long epoch;   // epoch at which the current lookup began, or 0
+  atomic_int in_use;   // claimed by a live thread
+  struct loadmap_index_reader_t* next;  // immutable once on the list
+} __attribute__ ((aligned (LOADMAP_CACHE_LINE))) loadmap_index_reader_t;
+
+static atomic_uintptr_t s_loadmap_index = ATOMIC_VAR_INIT(0);
+static atomic_long s_loadmap_index_epoch = ATOMIC_VAR_INIT(1);
+
+// all reader records ever allocated
+static atomic_uintptr_t s_loadmap_index_readers = ATOMIC_VAR_INIT(0);
+static __thread loadmap_index_reader_t* s_loadmap_index_reader = NULL;
+
+// writers only (serialized, cf. above)
+static loadmap_index_t* s_loadmap_index_retired = NULL;
+static loadmap_index_t* s_loadmap_index_free = NULL;
+
 void hpcrun_set_ipc_load_map(bool val){
     ipc_load_map = val;
 }
@@ -298,32 +367,291 @@ hpcrun_loadmap_print(hpcrun_loadmap_t* loadmap)
 
 //***************************************************************************
 
+// Returns the entry of index 'x' whose dso contains [begin, end], else
+// NULL.  The caller must be a registered reader (cf. above).
+static loadmap_index_entry_t*
+hpcrun_loadmap_index_find(loadmap_index_t* x, void* begin, void* end)
+{
+  if (x == NULL) {
+    return NULL;
+  }
+
+  // find the first entry that starts above 'begin'
+  size_t lo = 0, hi = x->len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (x->entry[mid].dso.start_addr <= begin) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  // Usually the entry just below is the answer.  Ranges may overlap,
+  // so keep looking down while some lower entry could still reach.
+  for (size_t i = lo; i-- > 0; ) {
+    loadmap_index_entry_t* e = &x->entry[i];
+    if (end <= e->dso.end_addr) {
+      return e;
+    }
+    if (e->max_end_addr < end) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+// Returns this thread's reader record, claiming a free one, or
+// allocating a page of them, on the thread's first lookup.  Returns
+// NULL if out of memory.
+static loadmap_index_reader_t*
+hpcrun_loadmap_index_reader()
+{
+  loadmap_index_reader_t* r = s_loadmap_index_reader;
+  if (r) {
+    return r;
+  }
+
+  for (r = (loadmap_index_reader_t*)
+	 atomic_load_explicit(&s_loadmap_index_readers, memory_order_acquire);
+       r; r = r->next) {
+    int not_in_use = 0;
+    if (atomic_load_explicit(&r->in_use, memory_order_relaxed) == 0
+	&& atomic_compare_exchange_strong_explicit(&r->in_use, &not_in_use, 1,
+						   memory_order_acq_rel,
+						   memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  if (r == NULL) {
+    size_t n = LOADMAP_INDEX_READERS_PER_ALLOC;
+    loadmap_index_reader_t* page = (loadmap_index_reader_t*)
+      hpcrun_mmap_anon(n * sizeof(*r));
+    if (page == NULL) {
+      return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+      atomic_store_explicit(&page[i].epoch, 0, memory_order_relaxed);
+      atomic_store_explicit(&page[i].in_use, (i == 0), memory_order_relaxed);
+      page[i].next = (i + 1 < n) ? &page[i + 1] : NULL;
+    }
+    uintptr_t head =
+      atomic_load_explicit(&s_loadmap_index_readers, memory_order_relaxed);
+    do {
+      page[n - 1].next = (loadmap_index_reader_t*) head;
+    } while (!atomic_compare_exchange_weak_explicit(&s_loadmap_index_readers,
+						    &head, (uintptr_t) page,
+						    memory_order_release,
+						    memory_order_relaxed));
+    r = &page[0];
+  }
+
+  // a signal handler's lookup may have claimed one for this thread
+  // in the meantime
+  if (s_loadmap_index_reader) {
+    atomic_store_explicit(&r->in_use, 0, memory_order_release);
+    return s_loadmap_index_reader;
+  }
+  s_loadmap_index_reader = r;
+  return r;
+}
+
+
+// Finds the entry whose dso contains [begin, end] and copies out its
+// load module and (if 'dso' is non-NULL) dso.  Returns true if found.
+static bool
+hpcrun_loadmap_index_lookup(void* begin, void* end,
+			    load_module_t** lm, dso_info_t* dso)
+{
+  loadmap_index_reader_t* r = hpcrun_loadmap_index_reader();
+  if (r == NULL) {
+    return false;
+  }
+
+  // seq_cst orders the announcement before the load (cf. publish)
+  long outer = atomic_load_explicit(&r->epoch, memory_order_relaxed);
+  if (outer == 0) {
+    long epoch = atomic_load_explicit(&s_loadmap_index_epoch,
+				      memory_order_seq_cst);
+    atomic_store_explicit(&r->epoch, epoch, memory_order_seq_cst);
+  }
+  loadmap_index_t* x = (loadmap_index_t*)
+    atomic_load_explicit(&s_loadmap_index, memory_order_seq_cst);
+
+  loadmap_index_entry_t* e = hpcrun_loadmap_index_find(x, begin, end);
+  if (e) {
+    *lm = e->lm;
+    if (dso) {
+      *dso = e->dso;
+    }
+  }
+
+  if (outer == 0) {
+    atomic_store_explicit(&r->epoch, 0, memory_order_release);
+  }
+  return (e != NULL);
+}
+
+
+// Moves the retired indexes that no lookup can still hold to the free
+// list.
+static void
+hpcrun_loadmap_index_reclaim()
+{
+  long oldest = LONG_MAX;
+  for (loadmap_index_reader_t* r = (loadmap_index_reader_t*)
+	 atomic_load_explicit(&s_loadmap_index_readers, memory_order_acquire);
+       r; r = r->next) {
+    long epoch = atomic_load_explicit(&r->epoch, memory_order_seq_cst);
+    if (epoch != 0 && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+
+  loadmap_index_t** p = &s_loadmap_index_retired;
+  while (*p) {
+    loadmap_index_t* y = *p;
+    if (y->retired_epoch <= oldest) {
+      *p = y->next;
+      y->next = s_loadmap_index_free;
+      s_loadmap_index_free = y;
+    }
+    else {
+      p = &y->next;
+    }
+  }
+}
+
+
+// Returns an unused index with room for 'len' entries, from the free
+// list if possible.
+static loadmap_index_t*
+hpcrun_loadmap_index_alloc(size_t len)
+{
+  for (loadmap_index_t** p = &s_loadmap_index_free; *p; p = &(*p)->next) {
+    if ((*p)->capacity >= len) {
+      loadmap_index_t* x = *p;
+      *p = x->next;
+      return x;
+    }
+  }
+
+  // leave room for growth, so the indexes allocated over a run sum to
+  // a small multiple of the largest
+  size_t capacity = 2 * len;
+  if (capacity < LOADMAP_INDEX_MIN_CAPACITY) {
+    capacity = LOADMAP_INDEX_MIN_CAPACITY;
+  }
+  loadmap_index_t* x = (loadmap_index_t*)
+    hpcrun_malloc(sizeof(*x) + capacity * sizeof(x->entry[0]));
+  if (x) {
+    x->capacity = capacity;
+  }
+  return x;
+}
+
+
+// Builds and publishes an address index of the current load map.
+static void
+hpcrun_loadmap_index_publish()
+{
+  size_t len = 0;
+  for (load_module_t* lm = s_loadmap_ptr->lm_head; (lm); lm = lm->next) {
+    if (lm->dso_info) {
+      len++;
+    }
+  }
+
+  loadmap_index_t* x = hpcrun_loadmap_index_alloc(len);
+  if (x == NULL) {
+    EMSG("loadmap: unable to allocate an address index of %ld entries", len);
+    return;
+  }
+  x->next = NULL;
+
+  // Insertion sort: the load map is short next to the cost of a
+  // dlopen, and qsort is not async-signal-safe (cf. DLOPEN_RISKY).
+  x->len = 0;
+  for (load_module_t* lm = s_loadmap_ptr->lm_head; (lm); lm = lm->next) {
+    dso_info_t* dso = lm->dso_info;
+    if (dso == NULL) {
+      continue;
+    }
+    size_t i = x->len++;
+    for ( ; i > 0 && x->entry[i - 1].dso.start_addr > dso->start_addr; i--) {
+      x->entry[i] = x->entry[i - 1];
+    }
+    x->entry[i].lm = lm;
+    x->entry[i].dso = *dso;
+    x->entry[i].dso.next = NULL;
+    x->entry[i].dso.prev = NULL;
+  }
+
+  void* max_end = NULL;
+  for (size_t i = 0; i < x->len; i++) {
+    if (x->entry[i].dso.end_addr > max_end) {
+      max_end = x->entry[i].dso.end_addr;
+    }
+    x->entry[i].max_end_addr = max_end;
+  }
+
+  TMSG(LOADMAP, "published address index of %ld entries", x->len);
+  loadmap_index_t* old = (loadmap_index_t*)
+    atomic_exchange_explicit(&s_loadmap_index, (uintptr_t) x,
+			     memory_order_seq_cst);
+  long epoch = 1 + atomic_fetch_add_explicit(&s_loadmap_index_epoch, 1,
+					     memory_order_seq_cst);
+  if (old) {
+    old->retired_epoch = epoch;
+    old->next = s_loadmap_index_retired;
+    s_loadmap_index_retired = old;
+  }
+
+  hpcrun_loadmap_index_reclaim();
+}
+
+
+// Gives back this thread's reader record (cf. hpcrun_thread_fini).
+void
+hpcrun_loadmap_thread_fini()
+{
+  loadmap_index_reader_t* r = s_loadmap_index_reader;
+  if (r) {
+    s_loadmap_index_reader = NULL;
+    atomic_store_explicit(&r->in_use, 0, memory_order_release);
+  }
+}
+
+
 load_module_t*
 hpcrun_loadmap_findByAddr(void* begin, void* end)
 {
   TMSG(LOADMAP, "find by address %p -- %p", begin, end);
-  for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
-    TMSG(LOADMAP, "\tload module %s", x->name);
-    if (x->dso_info) {
-      TMSG(LOADMAP, "\t\t [%lx, %lx) table [%lx, %lx)", 
-	   (uintptr_t) x->dso_info->start_addr,
-	   (uintptr_t) x->dso_info->end_addr,
-	   ((uintptr_t) x->dso_info->table ? ((uintptr_t) x->dso_info->table[0] + 
-				  x->dso_info->start_to_ref_dist) : -1),
-	   ((uintptr_t) x->dso_info->table ? ((uintptr_t) x->dso_info->table[x->dso_info->nsymbols -1] +
-				  x->dso_info->start_to_ref_dist) : -1)
-	   );
-      if (x->dso_info->start_addr <= begin && end <= x->dso_info->end_addr) {
-	TMSG(LOADMAP, "       --->%s", x->name);
-	return x;
-      }
-    }
+  load_module_t* lm = NULL;
+  if (hpcrun_loadmap_index_lookup(begin, end, &lm, NULL)) {
+    TMSG(LOADMAP, "       --->%s", lm->name);
+    return lm;
   }
   TMSG(LOADMAP, "       --->(NOT FOUND)");
   return NULL;
 }
 
 
+bool
+hpcrun_loadmap_findDsoByAddr(void* addr, dso_info_t* dso, load_module_t** lm)
+{
+  load_module_t* lm_ = NULL;
+  bool found = hpcrun_loadmap_index_lookup(addr, addr, &lm_, dso);
+  if (lm) {
+    *lm = lm_;
+  }
+  return found;
+}
+
+
 load_module_t*
 hpcrun_loadmap_findByName(const char* name)
 {
@@ -443,6 +771,9 @@ hpcrun_loadmap_map(dso_info_t* dso)
       TMSG(LOADMAP, " !! Internal consistency check fires !!");
       hpcrun_loadmap_unmap(lm);
       lm->dso_info = dso;
+      hpcrun_loadmap_index_publish();
+      hpcrun_loadmap_notify_map(lm->dso_info->start_addr,
+                                lm->dso_info->end_addr);
     }
     else {
       EMSG("hpcrun_loadmap_map(): attempt to both map dso '%s' and place it on the free list!", dso->name);
@@ -453,6 +784,7 @@ hpcrun_loadmap_map(dso_info_t* dso)
 	lm = hpcrun_loadModule_new(dso->name);
 	lm->dso_info = dso;
 	hpcrun_loadmap_pushFront(lm);
+	hpcrun_loadmap_index_publish();
 
 #if UW_RECIPE_MAP_DEBUG
         fprintf(stderr, "hpcrun_loadmap_map: '%s' start=%p end=%p\n", 
@@ -483,6 +815,7 @@ hpcrun_loadmap_unmap(load_module_t* lm)
   void *end_addr = old_dso->end_addr;
 
   lm->dso_info = NULL;
+  hpcrun_loadmap_index_publish();
 
   // tallent: For now, do not move the loadmap to the back of the
   //   list.  If we want to enable, this, we could have
@@ -533,6 +866,9 @@ hpcrun_initLoadmap()
 
   s_loadmap_ptr = &s_loadmap;
   hpcrun_loadmap_init(s_loadmap_ptr);
+  atomic_store_explicit(&s_loadmap_index, 0, memory_order_release);
+  s_loadmap_index_retired = NULL;
+  s_loadmap_index_free = NULL;
 
   s_dso_free_list = NULL;
 }
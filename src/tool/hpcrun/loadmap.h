@@ -191,10 +191,20 @@ extern void hpcrun_loadmap_print(hpcrun_loadmap_t* loadmap);
 
 // hpcrun_loadmap_findByAddr: Find the (currently mapped) load module
 //   that 'contains' the address range [begin, end]
+//   (O(log n) and lock-free; safe in a signal handler)
 load_module_t*
 hpcrun_loadmap_findByAddr(void* begin, void* end);
 
 
+// hpcrun_loadmap_findDsoByAddr: Find the (currently mapped) load module
+//   that contains 'addr', set '*lm' to it if 'lm' is non-NULL, and
+//   copy its dso_info_t into '*dso'.  The copy stays valid after the
+//   module is unmapped, so unlike lm->dso_info it may be used without
+//   a lock.  Returns false if no mapped module contains 'addr'.
+bool
+hpcrun_loadmap_findDsoByAddr(void* addr, dso_info_t* dso, load_module_t** lm);
+
+
 // hpcrun_loadmap_findByName: Find a load module by name.
 load_module_t*
 hpcrun_loadmap_findByName(const char* name);
@@ -235,6 +245,11 @@ hpcrun_loadmap_unmap(load_module_t* lm);
 void
 hpcrun_initLoadmap();
 
+// hpcrun_loadmap_thread_fini: Release the calling thread's state for
+//   address lookups, for reuse by a later thread.
+void
+hpcrun_loadmap_thread_fini();
+
 hpcrun_loadmap_t*
 hpcrun_getLoadmap();
 
@@ -126,6 +126,7 @@
 
 #include <unwind/common/backtrace.h>
 #include <unwind/common/unwind.h>
+#include <unwind/common/uw_recipe_map.h>
 
 #include <utilities/arch/context-pc.h>
 
@@ -636,6 +637,7 @@ hpcrun_fini_internal()
     hpcrun_threadMgr_data_fini(hpcrun_get_thread_data());
 
     fnbounds_fini();
+    uw_recipe_map_cache_stats_flush();
     hpcrun_stats_print_summary();
     messages_fini();
   }
@@ -731,6 +733,8 @@ hpcrun_thread_fini(epoch_t *epoch)
     SAMPLE_SOURCES(stop);
     SAMPLE_SOURCES(thread_fini_action);
     lushPthr_thread_fini(&TD_GET(pthr_metrics));
+    uw_recipe_map_cache_stats_flush();
+    hpcrun_loadmap_thread_fini();
 
     if (hpcrun_get_disabled()) {
       return;
@@ -48,6 +48,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <assert.h>
 
@@ -69,22 +70,40 @@
 //*************************** Concrete Data Types ***************************
 
 //
-// following typedef accomplishes
-// metric_set_t* == array of metric values, but it does this abstractly
-// so that clients of the metric datatype must use the interface.
+// A metric set holds the metric values of one cct node.
+//
+// With fewer than METRIC_SET_SPARSE_MIN metrics, a set is a dense
+// array of all of them, as it always was: metric_set_t* == array of
+// metric values, abstractly, so that clients must use the interface.
+//
+// With more, a node is usually charged by only a few of them, so a set
+// is a metric_set_sparse_t: up to METRIC_SET_INLINE (id, value) pairs,
+// and a dense array once it needs more.  Neither part is ever
+// reallocated, so a set takes at most the dense size plus the fixed
+// size of the pairs.
+//
+// N.B.: the set grows without locking, so as with the dense array,
+// only its owning thread updates it (and only with samples blocked).
 //
 struct  metric_set_t {
   hpcrun_metricVal_t v1;
 };
 
+#define METRIC_SET_INLINE     4
+#define METRIC_SET_SPARSE_MIN 16  // dense 128 bytes vs. 64 bytes sparse
+
+typedef struct metric_set_sparse_t {
+  int len;                              // number of pairs
+  int id[METRIC_SET_INLINE];
+  hpcrun_metricVal_t* dense;            // NULL until pairs overflow
+  hpcrun_metricVal_t val[METRIC_SET_INLINE];
+} metric_set_sparse_t;
+
 //*************************** Local Data **************************
 
 // number of metrics requested
 static int n_metrics = 0;
 
-// Dense array holding "0" values for nodes with no metrics
-static hpcrun_metricVal_t* null_metrics;
-
 // information about tracked metrics
 static metric_list_t* metric_data = NULL;
 
@@ -217,14 +236,6 @@ hpcrun_get_num_metrics()
       TMSG(METRICS_FINALIZE, "metric_proc[%d] = %p", l->id, l->proc);
       metric_proc_tbl[l->id] = l->proc;
     }
-  // *** TEMPORARY ***
-  // *** create a "NULL METRICS" dense array for use with
-  // *** metric set dense copy
-
-    null_metrics = (hpcrun_metricVal_t*) hpcrun_metric_set_new();
-    for (int i = 0; i < n_metrics; i++) {
-      null_metrics[i].bits = 0;
-    }
   }
   has_set_max_metrics = true;
 
@@ -422,24 +433,90 @@ hpcrun_set_metric_name(int metric_id, char* name)
 
 
 
+static inline bool
+metric_set_is_sparse(void)
+{
+  return n_metrics >= METRIC_SET_SPARSE_MIN;
+}
+
+
 metric_set_t*
 hpcrun_metric_set_new(void)
 {
-  return hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
+  if (! metric_set_is_sparse()) {
+    return hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
+  }
+
+  metric_set_sparse_t* s = hpcrun_malloc(sizeof(metric_set_sparse_t));
+  if (s) {
+    s->len = 0;
+    s->dense = NULL;
+  }
+  return (metric_set_t*) s;
 }
 
 //
-// return an lvalue from metric_set_t*
+// return an lvalue from metric_set_t* if the set has a value for
+// metric 'id' (always, for a dense set), else NULL.
 //
 cct_metric_data_t*
-hpcrun_metric_set_loc(metric_set_t* s, int id)
+hpcrun_metric_set_find(metric_set_t* s, int id)
 {
-  if (s && (0 <= id) && (id < n_metrics)) {
+  if (!s || id < 0 || id >= n_metrics) {
+    return NULL;
+  }
+  if (! metric_set_is_sparse()) {
     return &(s->v1) + id;
   }
+
+  metric_set_sparse_t* x = (metric_set_sparse_t*) s;
+  if (x->dense) {
+    return &(x->dense[id]);
+  }
+  for (int i = 0; i < x->len; i++) {
+    if (x->id[i] == id) {
+      return &(x->val[i]);
+    }
+  }
   return NULL;
 }
 
+//
+// return an lvalue from metric_set_t*, adding the metric to the set
+// (as 0) if it is not there.
+// returns: NULL if 'id' is invalid or out of memory
+//
+// N.B.: the lvalue is valid only until the next metric is added to
+// the set.
+//
+cct_metric_data_t*
+hpcrun_metric_set_loc(metric_set_t* s, int id)
+{
+  cct_metric_data_t* loc = hpcrun_metric_set_find(s, id);
+  if (loc || !s || id < 0 || id >= n_metrics) {
+    return loc;
+  }
+
+  // INVARIANT: the set is sparse and has no dense array
+  metric_set_sparse_t* x = (metric_set_sparse_t*) s;
+  if (x->len < METRIC_SET_INLINE) {
+    int i = x->len++;
+    x->id[i] = id;
+    x->val[i].bits = 0;
+    return &(x->val[i]);
+  }
+
+  hpcrun_metricVal_t* dense = hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
+  if (!dense) {
+    return NULL;
+  }
+  memset(dense, 0, n_metrics * sizeof(hpcrun_metricVal_t));
+  for (int i = 0; i < x->len; i++) {
+    dense[x->id[i]] = x->val[i];
+  }
+  x->dense = dense;
+  return &(dense[id]);
+}
 
 void
 hpcrun_metric_std(int metric_id, metric_set_t* set,
@@ -451,6 +528,9 @@ hpcrun_metric_std(int metric_id, metric_set_t* set,
   }
 
   hpcrun_metricVal_t* loc = hpcrun_metric_set_loc(set, metric_id);
+  if (!loc) {
+    return;
+  }
   switch (minfo->flags.fields.valFmt) {
     case MetricFlags_ValFmt_Int:
       if (operation == '+')
@@ -498,8 +578,13 @@ hpcrun_get_weighted_metric_diff(int metric_id1, int metric_id2,
         return -1;
     }
 
+    // N.B.: adding metric_id2 may move metric_id1, so look it up again
     hpcrun_metricVal_t* loc1 = hpcrun_metric_set_loc(set, metric_id1);
     hpcrun_metricVal_t* loc2 = hpcrun_metric_set_loc(set, metric_id2);
+    loc1 = hpcrun_metric_set_loc(set, metric_id1);
+    if (!loc1 || !loc2) {
+        return -1;
+    }
 
     assert(minfo1->flags.fields.valFmt == minfo2->flags.fields.valFmt);
     switch (minfo1->flags.fields.valFmt) {
@@ -541,6 +626,51 @@ hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
 			     metric_set_t* set,
 			     int num_metrics)
 {
-  metric_set_t* actual = set ? set : (metric_set_t*) null_metrics;
-  memcpy((char*) dest, (char*) actual, num_metrics * sizeof(cct_metric_data_t));
+  if (!set) {
+    memset((char*) dest, 0, num_metrics * sizeof(cct_metric_data_t));
+    return;
+  }
+  if (! metric_set_is_sparse()) {
+    memcpy((char*) dest, (char*) set, num_metrics * sizeof(cct_metric_data_t));
+    return;
+  }
+
+  metric_set_sparse_t* x = (metric_set_sparse_t*) set;
+  if (x->dense) {
+    memcpy((char*) dest, (char*) x->dense, num_metrics * sizeof(cct_metric_data_t));
+    return;
+  }
+  memset((char*) dest, 0, num_metrics * sizeof(cct_metric_data_t));
+  for (int i = 0; i < x->len; i++) {
+    if (x->id[i] < num_metrics) {
+      dest[x->id[i]] = x->val[i];
+    }
+  }
+}
+
+//
+// count the nonzero values of a metric set
+//
+int
+hpcrun_metric_set_num_nonzero(metric_set_t* set, int num_metrics)
+{
+  if (!set) {
+    return 0;
+  }
+
+  hpcrun_metricVal_t* vals = &(set->v1);
+  int len = num_metrics;
+  if (metric_set_is_sparse()) {
+    metric_set_sparse_t* x = (metric_set_sparse_t*) set;
+    vals = (x->dense) ? x->dense : x->val;
+    len = (x->dense) ? num_metrics : x->len;
+  }
+
+  int n = 0;
+  for (int i = 0; i < len; i++) {
+    if (vals[i].bits != 0) {
+      n++;
+    }
+  }
+  return n;
 }
@@ -157,7 +157,10 @@ hpcrun_get_weighted_metric_diff(int metric_id1, int metric_id2,
                                 metric_set_t* set, cct_metric_data_t * diff, 
                                 cct_metric_data_t * diffWithPeriod);
 extern metric_set_t* hpcrun_metric_set_new(void);
+// hpcrun_metric_set_loc adds the metric (as 0) if the set has none;
+// hpcrun_metric_set_find does not, and returns NULL instead.
 extern cct_metric_data_t* hpcrun_metric_set_loc(metric_set_t* s, int id);
+extern cct_metric_data_t* hpcrun_metric_set_find(metric_set_t* s, int id);
 extern void hpcrun_metric_std_set(int metric_id, metric_set_t* set,
 				  hpcrun_metricVal_t value);
 extern void hpcrun_metric_std_inc(int metric_id, metric_set_t* set,
@@ -168,5 +171,9 @@ extern void hpcrun_metric_std_inc(int metric_id, metric_set_t* set,
 extern void hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
 					 metric_set_t* set,
 					 int num_metrics);
+//
+// count the nonzero values of a metric set
+//
+extern int hpcrun_metric_set_num_nonzero(metric_set_t* set, int num_metrics);
 
 #endif // METRICS_H
@@ -73,26 +73,10 @@
 #define N (128*1024)
 #define INDEX_MASK ((N)-1)
 
-#define LOSSLESS_BLAME
-
-#ifdef BLAME_MAP_LOCKING
-
-#define do_lock() \
-{ \
-  for(;;) { \
-    if (fetch_and_store_i64(&thelock, 1) == 0) break; \
-    while (thelock == 1); \
-  } \
-}
-
-#define do_unlock() thelock = 0
-
-#else
-
-#define do_lock() 
-#define do_unlock()
-
-#endif
+// an object's blame may live in any of the BLAME_MAP_PROBES slots
+// starting at its home slot.  a thread that finds no slot for its
+// object drops the blame (and counts it as lost).
+#define BLAME_MAP_PROBES 8
 
 
 
@@ -112,12 +96,22 @@ union blame_entry_t {
 };
 
 
+// per-thread counters, reported at thread exit
+typedef struct {
+  uint64_t adds;        // calls to blame_map_add_blame()
+  uint64_t collisions;  // adds that did not use the home slot
+  uint64_t retries;     // failed compare-and-swaps
+  uint64_t lost;        // adds dropped (no free slot, or overflow)
+  uint64_t lost_blame;  // blame dropped
+} blame_map_stats_t;
+
+
 
 /***************************************************************************
  * private data  
  ***************************************************************************/
 
-static uint64_t volatile thelock;
+static __thread blame_map_stats_t blame_map_stats;
 
 
 
@@ -149,6 +143,15 @@ blame_map_entry(uint64_t obj, uint32_t metric_value)
 }
 
 
+static inline blame_parts_t
+blame_map_parts(uint64_t all)
+{
+  blame_entry_t be;
+  atomic_store_explicit(&be.all, all, memory_order_relaxed);
+  return be.parts;
+}
+
+
 
 /***************************************************************************
  * interface operations
@@ -167,96 +170,118 @@ blame_map_init(blame_entry_t table[])
 {
   int i;
   for(i = 0; i < N; i++) {
-    table[i].parts.obj_id = 0;
-    table[i].parts.blame = 0;
+    atomic_store_explicit(&table[i].all, 0, memory_order_relaxed);
   }
 }
 
 
+// Each slot is updated with a compare-and-swap of the whole
+// (obj_id, blame) pair, so no lock is needed.  The object's blame is
+// added to the first of its slots that holds it, else the first free
+// one.  Two threads may claim different free slots for the same
+// object; blame_map_get_blame() collects all of them.
 void
 blame_map_add_blame(blame_entry_t table[],
 		    uint64_t obj, uint32_t metric_value)
 {
   uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      blame_entry_t newval = oldval;
-      newval.parts.blame += metric_value;
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      uint64_t newall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newall,
-						  memory_order_relaxed, memory_order_relaxed) 
-	    == testoldall) break;
-#else
-      oldval.parts.blame += metric_value;
-      table[index].all = oldval.all;
-      break;
-#endif
-    } else {
-      if(oldval.parts.obj_id == 0) {
-	uint64_t newval = blame_map_entry(obj, metric_value);
-#ifdef LOSSLESS_BLAME
-	uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-	uint64_t testoldall = oldall;
-	if ((atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newval,
-						     memory_order_relaxed, memory_order_relaxed)) 
-	    == testoldall) break;
-	// otherwise, try again
-#else
-	table[index].all = newval;
-	break;
-#endif
+  uint32_t home = blame_map_hash(obj);
+
+  assert(home < N);
+
+  blame_map_stats.adds++;
+
+  for (int k = 0; k < BLAME_MAP_PROBES; k++) {
+    atomic_uint_least64_t* slot = &table[(home + k) & INDEX_MASK].all;
+    uint64_t oldall = atomic_load_explicit(slot, memory_order_relaxed);
+
+    for (;;) {
+      blame_parts_t old = blame_map_parts(oldall);
+      uint64_t newall;
+
+      if (old.obj_id == obj_id) {
+	if (old.blame + metric_value < old.blame) {
+	  // overflow: keep what is there
+	  blame_map_stats.lost++;
+	  blame_map_stats.lost_blame += metric_value;
+	  return;
+	}
+	newall = blame_map_entry(obj, old.blame + metric_value);
+      }
+      else if (old.obj_id == 0) {
+	newall = blame_map_entry(obj, metric_value);
       }
       else {
-	EMSG("leaked blame %d\n", metric_value);
-	// entry in use for another object's blame
-	// in this case, since it isn't easy to shift 
-	// our blame efficiently, we simply drop it.
-	break;
+	break; // another object's slot; probe the next one
       }
+
+      if (atomic_compare_exchange_weak_explicit(slot, &oldall, newall,
+						memory_order_relaxed,
+						memory_order_relaxed)) {
+	if (k > 0) {
+	  blame_map_stats.collisions++;
+	}
+	return;
+      }
+      // 'oldall' now holds the current value; try this slot again
+      blame_map_stats.retries++;
     }
   }
-  do_unlock();
+
+  // every slot is in use for another object's blame.  since it isn't
+  // easy to shift our blame efficiently, we simply drop it.
+  blame_map_stats.lost++;
+  blame_map_stats.lost_blame += metric_value;
 }
 
 
 uint64_t 
 blame_map_get_blame(blame_entry_t table[], uint64_t obj)
 {
-  static uint64_t zero = 0;
   uint64_t val = 0;
   uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, zero,
-						  memory_order_relaxed, memory_order_relaxed)
-	  != testoldall) continue; // try again on failure
-#else
-      table[index].all = 0;
-#endif
-      val = (uint64_t)oldval.parts.blame;
+  uint32_t home = blame_map_hash(obj);
+
+  assert(home < N);
+
+  for (int k = 0; k < BLAME_MAP_PROBES; k++) {
+    atomic_uint_least64_t* slot = &table[(home + k) & INDEX_MASK].all;
+    uint64_t oldall = atomic_load_explicit(slot, memory_order_relaxed);
+
+    // take the slot's blame and free it, unless another thread
+    // changes it first
+    while (blame_map_parts(oldall).obj_id == obj_id) {
+      if (atomic_compare_exchange_weak_explicit(slot, &oldall, 0,
+						memory_order_relaxed,
+						memory_order_relaxed)) {
+	val += blame_map_parts(oldall).blame;
+	break;
+      }
+      blame_map_stats.retries++;
     }
-    break;
   }
-  do_unlock();
 
   return val;
 }
+
+
+void
+blame_map_thread_fini(const char* name)
+{
+  blame_map_stats_t* st = &blame_map_stats;
+
+  if (st->adds == 0) {
+    return;
+  }
+
+  if (st->lost > 0) {
+    EMSG("%s blame map: lost %ld of %ld blame updates (%ld units), "
+	 "collisions: %ld, retries: %ld", name, (long) st->lost,
+	 (long) st->adds, (long) st->lost_blame, (long) st->collisions,
+	 (long) st->retries);
+  }
+  else {
+    TMSG(LOCKWAIT, "%s blame map: updates: %ld, collisions: %ld, retries: %ld",
+	 name, (long) st->adds, (long) st->collisions, (long) st->retries);
+  }
+}
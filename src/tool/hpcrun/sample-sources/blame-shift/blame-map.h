@@ -75,4 +75,8 @@ void blame_map_add_blame(blame_entry_t* table,
 			 uint64_t obj, uint32_t metric_value);
 uint64_t blame_map_get_blame(blame_entry_t* table, uint64_t obj);
 
+// blame_map_thread_fini: reports this thread's blame map statistics
+// (collisions, and blame lost to a full table) to the log
+void blame_map_thread_fini(const char* name);
+
 #endif // _hpctoolkit_blame_map_h_
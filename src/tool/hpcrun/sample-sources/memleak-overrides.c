@@ -94,7 +94,6 @@
 #include <sample_event.h>
 #include <monitor-exts/monitor_ext.h>
 #include <lib/prof-lean/spinlock.h>
-#include <lib/prof-lean/splay-macros.h>
 
 // FIXME: the inline getcontext macro is broken on 32-bit x86, so
 // revert to the getcontext syscall for now.
@@ -117,8 +116,7 @@ typedef struct leakinfo_s {
   cct_node_t *context;
   size_t bytes;
   void *memblock;
-  struct leakinfo_s *left;
-  struct leakinfo_s *right;
+  struct leakinfo_s *next;
 } leakinfo_t;
 
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
@@ -141,6 +139,15 @@ typedef void *realloc_fcn(void *, size_t);
 #define MEMLEAK_DEFAULT_PAGESIZE  4096
 
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
+
+// Footer leakinfo structs are kept in a hash table of chains, split
+// into shards, each with its own lock.  Shards are cache-line aligned
+// so that threads freeing unrelated blocks do not contend.
+#define MEMLEAK_SHARD_BITS    8
+#define MEMLEAK_BUCKET_BITS   6
+#define MEMLEAK_NUM_SHARDS    (1 << MEMLEAK_SHARD_BITS)
+#define MEMLEAK_NUM_BUCKETS   (1 << MEMLEAK_BUCKET_BITS)
+#define MEMLEAK_CACHE_LINE    64
 #define DEFAULT_PROB  0.1
 
 #ifdef HPCRUN_STATIC_LINK
@@ -174,8 +181,14 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+typedef struct memleak_shard_s {
+  spinlock_t lock;
+  struct leakinfo_s *bucket[MEMLEAK_NUM_BUCKETS];
+} __attribute__ ((aligned (MEMLEAK_CACHE_LINE))) memleak_shard_t;
+
+static memleak_shard_t memleak_table[MEMLEAK_NUM_SHARDS] = {
+  [0 ... MEMLEAK_NUM_SHARDS - 1] = { .lock = SPINLOCK_UNLOCKED }
+};
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -193,80 +206,81 @@ static char *loc_name[4] = {
 
 
 /******************************************************************************
- * splay operations
+ * hash table operations
  *****************************************************************************/
 
-
-static struct leakinfo_s *
-splay(struct leakinfo_s *root, void *key)
+// Fibonacci hash of the block address (blocks are at least 8-byte
+// aligned, so the low bits carry nothing).  The top bits pick the
+// shard, the next ones the chain.
+static inline uint64_t
+memleak_hash(void *memblock)
 {
-  REGULAR_SPLAY_TREE(leakinfo_s, root, key, memblock, left, right);
-  return root;
+  return ((uint64_t) (uintptr_t) memblock >> 3) * 0x9e3779b97f4a7c15ULL;
 }
 
 
-static void
-splay_insert(struct leakinfo_s *node)
+static inline memleak_shard_t *
+memleak_shard(uint64_t hash)
 {
-  void *memblock = node->memblock;
+  return &memleak_table[hash >> (64 - MEMLEAK_SHARD_BITS)];
+}
 
-  node->left = node->right = NULL;
 
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
+static inline struct leakinfo_s **
+memleak_bucket(memleak_shard_t *shard, uint64_t hash)
+{
+  int k = (hash >> (64 - MEMLEAK_SHARD_BITS - MEMLEAK_BUCKET_BITS))
+    & (MEMLEAK_NUM_BUCKETS - 1);
+  return &shard->bucket[k];
+}
 
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
-    } else {
-      TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)", 
-	   node->memblock);
+
+static void
+memleak_table_insert(struct leakinfo_s *node)
+{
+  void *memblock = node->memblock;
+  uint64_t hash = memleak_hash(memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
+  struct leakinfo_s **bucket = memleak_bucket(shard, hash);
+  struct leakinfo_s *p;
+
+  spinlock_lock(&shard->lock);
+  for (p = *bucket; p != NULL; p = p->next) {
+    if (p->memblock == memblock) {
+      spinlock_unlock(&shard->lock);
+      TMSG(MEMLEAK, "memleak hash table: unable to insert %p (already present)",
+	   memblock);
       assert(0);
+      return;
     }
   }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);  
+  node->next = *bucket;
+  *bucket = node;
+  spinlock_unlock(&shard->lock);
 }
 
 
 static struct leakinfo_s *
-splay_delete(void *memblock)
+memleak_table_delete(void *memblock)
 {
-  struct leakinfo_s *result = NULL;
-
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
-    return NULL;
-  }
-
-  memleak_tree_root = splay(memleak_tree_root, memblock);
-
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
-    return NULL;
+  uint64_t hash = memleak_hash(memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
+  struct leakinfo_s **bucket = memleak_bucket(shard, hash);
+  struct leakinfo_s **pp, *result = NULL;
+
+  spinlock_lock(&shard->lock);
+  for (pp = bucket; *pp != NULL; pp = &(*pp)->next) {
+    if ((*pp)->memblock == memblock) {
+      result = *pp;
+      *pp = result->next;
+      break;
+    }
   }
+  spinlock_unlock(&shard->lock);
 
-  result = memleak_tree_root;
-
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);  
-    return result;
+  if (result == NULL) {
+    TMSG(MEMLEAK, "memleak hash table: %p not in table", memblock);
   }
-
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);  
   return result;
 }
 
@@ -412,7 +426,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = memleak_table_delete(appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -435,7 +449,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 }
 
 
-// Fill in the leakinfo struct, add metric to CCT, add to splay tree
+// Fill in the leakinfo struct, add metric to CCT, add to hash table
 // (if footer) and print TMSG.
 //
 static void
@@ -455,8 +469,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
   info_ptr->magic = MEMLEAK_MAGIC;
   info_ptr->bytes = bytes;
   info_ptr->memblock = appl_ptr;
-  info_ptr->left = NULL;
-  info_ptr->right = NULL;
+  info_ptr->next = NULL;
   if (hpcrun_memleak_active()) {
     sample_val_t smpl =
       hpcrun_sample_callpath(uc, hpcrun_memleak_alloc_id(), 
@@ -469,7 +482,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     loc_str = "inactive";
   }
   if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+    memleak_table_insert(info_ptr);
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
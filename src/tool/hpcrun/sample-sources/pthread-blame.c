@@ -324,6 +324,9 @@ METHOD_FN(start)
 static void
 METHOD_FN(thread_fini_action)
 {
+  if (lockwait_enabled) {
+    blame_map_thread_fini("pthread");
+  }
 }
 
 
@@ -739,7 +739,7 @@ TopN(cct_node_t* node, cct_op_arg_t arg, size_t level)
     if (node) {
         metric_set_t *set = hpcrun_get_metric_set(node);
         if (!set) return;
-        hpcrun_metricVal_t *loc = hpcrun_metric_set_loc(set, metricID);
+        hpcrun_metricVal_t *loc = hpcrun_metric_set_find(set, metricID);
         if (!loc) return;
 
         uint64_t val = loc->i;
@@ -756,8 +756,8 @@ TopN(cct_node_t* node, cct_op_arg_t arg, size_t level)
             min = ULLONG_MAX;
             for (i=0; i<N; i++) {
                 metric_set_t *seti = hpcrun_get_metric_set(topNNode[i]);
-                hpcrun_metricVal_t *loci = hpcrun_metric_set_loc(seti, metricID);
-                if (loci->i < min) {
+                hpcrun_metricVal_t *loci = hpcrun_metric_set_find(seti, metricID);
+                if (loci && loci->i < min) {
                     t = i;
                     min = loci->i;
                 }
@@ -784,14 +784,14 @@ PrintTopN(int metricID)
         cct_node_t *node1 = topNNode[i];
         if (!node1) goto end;
         metric_set_t *set1 = hpcrun_get_metric_set(node1);
-        hpcrun_metricVal_t *loc1 = hpcrun_metric_set_loc(set1, metricID);
-        uint64_t val1 = loc1->i;
+        hpcrun_metricVal_t *loc1 = hpcrun_metric_set_find(set1, metricID);
+        uint64_t val1 = (loc1) ? loc1->i : 0;
         for (j = i+1; j<N; j++) {
             cct_node_t *node2 = topNNode[j];
             if (!node2) break;
             metric_set_t *set2 = hpcrun_get_metric_set(node2);
-            hpcrun_metricVal_t *loc2 = hpcrun_metric_set_loc(set2, metricID);
-            uint64_t val2 = loc2->i;
+            hpcrun_metricVal_t *loc2 = hpcrun_metric_set_find(set2, metricID);
+            uint64_t val2 = (loc2) ? loc2->i : 0;
 
             if (val2 > val1) {
                 cct_node_t *tmp = topNNode[i];
@@ -830,8 +830,8 @@ end:
         cct_node_t *node = topNNode[i];
         if (!node) break;
         metric_set_t *set = hpcrun_get_metric_set(node);
-        hpcrun_metricVal_t *loc = hpcrun_metric_set_loc(set, metricID);
-        uint64_t val = loc->i;
+        hpcrun_metricVal_t *loc = hpcrun_metric_set_find(set, metricID);
+        uint64_t val = (loc) ? loc->i : 0;
         fprintf(fd, "%lu:%lf:", val, (double)val/deadBytes);
         //FIXME: +1 not needed
         fprintf(fd, "%d-%p", hpcrun_cct_addr(node)->ip_norm.lm_id, (void*) (hpcrun_cct_addr(node)->ip_norm.lm_ip+1));
@@ -1380,6 +1380,9 @@ static void *get_metric_data_ptr(int metric_id, cct_node_t *node){
         return NULL;
     }
     hpcrun_metricVal_t* loc = hpcrun_metric_set_loc(set, metric_id);
+    if (!loc) {
+        return NULL;
+    }
     switch (minfo->flags.fields.valFmt) {
         case MetricFlags_ValFmt_Int:
             return (void *) &(loc->i);
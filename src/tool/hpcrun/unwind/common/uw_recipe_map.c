@@ -90,6 +90,7 @@
 #include "binarytree_uwi.h"
 #include "segv_handler.h"
 #include <messages/messages.h>
+#include <hpcrun_stats.h>
 
 // libmonitor functions
 #include <monitor.h>
@@ -110,6 +111,12 @@
 
 #define NUM_NODES 10
 
+#define UW_RECIPE_CACHE_BITS 8
+#define UW_RECIPE_CACHE_SIZE (1 << UW_RECIPE_CACHE_BITS)
+
+// per-thread hit/miss counts are added to hpcrun_stats in batches
+#define UW_RECIPE_CACHE_STATS_BATCH 4096
+
 //******************************************************************************
 // type
 //******************************************************************************
@@ -121,6 +128,26 @@ typedef struct ilmstat_btuwi_pair_s {
   bitree_uwi_t *btuwi;
 } ilmstat_btuwi_pair_t;
 
+// Hot loops unwind through the same few return addresses over and over,
+// so each thread keeps a small direct-mapped cache of successful
+// lookups, (addr, uw) -> unwindr_info_t, in front of the skip list and
+// interval tree searches.  An entry is valid only in the generation in
+// which it was filled: uw_recipe_map_notify_unmap() bumps the global
+// generation before it frees any intervals, which invalidates every
+// thread's cache at once.
+typedef struct uw_recipe_cache_entry_t {
+  uintptr_t addr;
+  long gen;
+  unwinder_t uw;
+  unwindr_info_t info;
+} uw_recipe_cache_entry_t;
+
+struct uw_recipe_cache_t {
+  long hits;
+  long misses;
+  uw_recipe_cache_entry_t entry[UW_RECIPE_CACHE_SIZE];
+};
+
 //******************************************************************************
 // Comparators
 //******************************************************************************
@@ -275,6 +302,11 @@ static cskiplist_t *addr2recipe_map[NUM_UNWINDERS];
 // and inserting entries into addr2recipe_map:
 static mem_alloc my_alloc = hpcrun_malloc;
 
+// generation of the map as seen by the per-thread recipe caches
+static atomic_long uw_recipe_map_gen = ATOMIC_VAR_INIT(1);
+
+static __thread struct uw_recipe_cache_t *_uw_recipe_cache = NULL;
+
 //******************************************************************************
 // String output
 //******************************************************************************
@@ -569,6 +601,9 @@ uw_recipe_map_notify_unmap(void *start, void *end)
 {
   uw_recipe_map_report_and_dump("*** unmap: before poisoning", start, end);
 
+  // invalidate every thread's recipe cache before freeing intervals
+  atomic_fetch_add_explicit(&uw_recipe_map_gen, 1L, memory_order_acq_rel);
+
   // Remove intervals in the range [start, end) from the unwind interval tree.
   TMSG(UW_RECIPE_MAP, "uw_recipe_map_delete_range from %p to %p", start, end);
   unwinder_t uw;
@@ -594,10 +629,65 @@ uw_recipe_map_notify_init()
 
 
 
+//---------------------------------------------------------------------
+// per-thread recipe cache
+//---------------------------------------------------------------------
+
+static struct uw_recipe_cache_t *
+uw_recipe_cache_get(void)
+{
+  if (_uw_recipe_cache == NULL) {
+    struct uw_recipe_cache_t *cache = hpcrun_malloc(sizeof(*cache));
+    if (cache) {
+      memset(cache, 0, sizeof(*cache)); // gen 0 is never current
+    }
+    _uw_recipe_cache = cache;
+  }
+  return _uw_recipe_cache;
+}
+
+
+static inline uw_recipe_cache_entry_t *
+uw_recipe_cache_slot(struct uw_recipe_cache_t *cache, uintptr_t addr,
+		     unwinder_t uw)
+{
+  uintptr_t h = addr ^ (addr >> UW_RECIPE_CACHE_BITS) ^ (uintptr_t) uw;
+  return &cache->entry[h & (UW_RECIPE_CACHE_SIZE - 1)];
+}
+
+
+static void
+uw_recipe_cache_count(struct uw_recipe_cache_t *cache, bool hit)
+{
+  if (hit) {
+    cache->hits++;
+  }
+  else {
+    cache->misses++;
+  }
+  if (cache->hits + cache->misses >= UW_RECIPE_CACHE_STATS_BATCH) {
+    uw_recipe_map_cache_stats_flush();
+  }
+}
+
+
 //---------------------------------------------------------------------
 // interface operations
 //---------------------------------------------------------------------
 
+void
+uw_recipe_map_cache_stats_flush(void)
+{
+  struct uw_recipe_cache_t *cache = _uw_recipe_cache;
+  if (cache) {
+    hpcrun_stats_uw_recipe_cache_hits_inc(cache->hits);
+    hpcrun_stats_uw_recipe_cache_misses_inc(cache->misses);
+    cache->hits = 0;
+    cache->misses = 0;
+  }
+}
+
+
 void
 uw_recipe_map_init(void)
 {
@@ -626,6 +716,9 @@ uw_recipe_map_init(void)
 
   uw_recipe_map_notify_init();
 
+  // after fork, entries cached by the parent refer to the old map
+  atomic_fetch_add_explicit(&uw_recipe_map_gen, 1L, memory_order_acq_rel);
+
   // initialize the map with a POISONED node ({([0, UINTPTR_MAX), NULL), NEVER}, NULL)
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
     uw_recipe_map_poison(0, UINTPTR_MAX, uw);
@@ -653,6 +746,22 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   unwr_info->interval.start = 0;
   unwr_info->interval.end   = 0;
 
+  // Read the generation before searching: if an unmap races with the
+  // search, the result is cached under the old generation and never hit.
+  long gen = atomic_load_explicit(&uw_recipe_map_gen, memory_order_acquire);
+  struct uw_recipe_cache_t *cache = uw_recipe_cache_get();
+  uw_recipe_cache_entry_t *slot = NULL;
+  if (cache) {
+    slot = uw_recipe_cache_slot(cache, (uintptr_t)addr, uw);
+    bool hit = (slot->gen == gen && slot->addr == (uintptr_t)addr
+		&& slot->uw == uw);
+    uw_recipe_cache_count(cache, hit);
+    if (hit) {
+      *unwr_info = slot->info;
+      return true;
+    }
+  }
+
   // check if addr is already in the range of an interval key in the map
   ilmstat_btuwi_pair_t* ilm_btui =
     uw_recipe_map_inrange_find((uintptr_t)addr, uw);
@@ -742,5 +851,15 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   unwr_info->lm         = ilm_btui->lm;
   unwr_info->interval   = ilm_btui->interval;
 
-  return (unwr_info->btuwi != NULL);
+  if (unwr_info->btuwi == NULL) {
+    return false;
+  }
+
+  if (slot) {
+    slot->addr = (uintptr_t)addr;
+    slot->gen  = gen;
+    slot->uw   = uw;
+    slot->info = *unwr_info;
+  }
+  return true;
 }
@@ -68,4 +68,11 @@ uw_recipe_map_init(void);
 bool
 uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info);
 
+
+/*
+ * add the calling thread's recipe cache hit/miss counts to hpcrun_stats
+ */
+void
+uw_recipe_map_cache_stats_flush(void);
+
 #endif  /* !_UW_RECIPE_MAP_H_ */
@@ -0,0 +1,601 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File: x86-recipe-cache.c
+//
+// Purpose:
+//   Persistent cache of x86 unwind recipes (see x86-recipe-cache.h).
+//
+// File layout (native byte order and word size, as for the fnbounds
+// cache):
+//
+//   header
+//   x86_recipe_cache_fcn_t      fcn[num_fcns];           sorted by start
+//   x86_recipe_cache_interval_t interval[num_intervals];
+//
+// Function bounds are normalized (relative to the module's reference
+// address, cf. hpcrun_normalize_ip) and interval bounds are relative to
+// their function's start, so one file serves every address the module
+// is loaded at.
+//
+// Notes:
+// 1. Only the native unwinder's recipes are cached.  They hold stack
+// and frame offsets, never addresses.  prev_canonical is only used
+// while building, so it is not saved.
+//
+// 2. A lookup trusts an entry only if its normalized [start, end)
+// matches the function bounds exactly.  The key already pins down the
+// binary, and the version hash pins down the recipe layout.
+//
+// 3. Each process merges the file it mapped with what it analyzed,
+// writes a temp file, and renames it into place.  When processes exit
+// together, the last rename wins and the others' additions come back
+// on a later run.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+
+#include <hpcrun/main.h>
+#include <hpcrun/loadmap.h>
+#include <memory/hpcrun-malloc.h>
+#include <fnbounds/fnbounds_cache.h>
+#include <messages/messages.h>
+
+#include <lib/prof-lean/build-id.h>
+#include <lib/prof-lean/stdatomic.h>
+
+#include "x86-recipe-cache.h"
+#include "x86-unwind-interval.h"
+
+//***************************************************************************
+// types
+//***************************************************************************
+
+#define X86_RECIPE_CACHE_MAGIC   0x4850435557494331ULL  // "HPCUWIC1"
+#define X86_RECIPE_CACHE_SUFFIX  ".uwi"
+
+typedef struct x86_recipe_cache_header {
+  uint64_t magic;
+  uint64_t version;  // hash of the hpctoolkit version and record layout
+  uint64_t num_fcns;
+  uint64_t num_intervals;
+} x86_recipe_cache_header_t;
+
+// a function [start, end), normalized, and its run of intervals
+typedef struct x86_recipe_cache_fcn {
+  uint64_t start;
+  uint64_t end;
+  uint64_t first;
+  uint64_t count;
+} x86_recipe_cache_fcn_t;
+
+// an interval [start, end), relative to its function's start
+typedef struct x86_recipe_cache_interval {
+  int64_t start;
+  int64_t end;
+  int32_t ra_status;
+  int32_t sp_ra_pos;
+  int32_t sp_bp_pos;
+  int32_t bp_status;
+  int32_t bp_ra_pos;
+  int32_t bp_bp_pos;
+  int32_t has_tail_calls;
+  int32_t pad;
+} x86_recipe_cache_interval_t;
+
+// a function analyzed during this run
+typedef struct x86_recipe_record {
+  struct x86_recipe_record *next;
+  x86_recipe_cache_fcn_t fcn;
+  x86_recipe_cache_interval_t interval[];
+} x86_recipe_record_t;
+
+// per load module state: the mapped file, if any, and new records
+typedef struct x86_recipe_module {
+  load_module_t *lm;
+  char *path;
+
+  const x86_recipe_cache_fcn_t *fcn;
+  const x86_recipe_cache_interval_t *interval;
+  uint64_t num_fcns;
+  uint64_t num_intervals;
+
+  atomic_uintptr_t recorded;  // x86_recipe_record_t list
+  struct x86_recipe_module *next;
+} x86_recipe_module_t;
+
+//***************************************************************************
+// local data
+//***************************************************************************
+
+// Modules are only added, under the fnbounds lock (from the loadmap
+// notifier), and read lock-free.
+static atomic_uintptr_t x86_recipe_modules = ATOMIC_VAR_INIT(0);
+
+static uint64_t x86_recipe_cache_version = 0;
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static uint64_t
+cache_version(void)
+{
+  if (x86_recipe_cache_version == 0) {
+    const char *version = HPCTOOLKIT_VERSION_STRING;
+    size_t layout[] = {  // POISON: the number of ra_loc values
+      sizeof(void *),
+      sizeof(x86_recipe_cache_fcn_t),
+      sizeof(x86_recipe_cache_interval_t),
+      POISON,
+    };
+    uint64_t h = build_id_hash_bytes(BUILD_ID_HASH_INIT, version,
+				     strlen(version));
+    x86_recipe_cache_version = build_id_hash_bytes(h, layout, sizeof(layout));
+  }
+  return x86_recipe_cache_version;
+}
+
+
+static x86_recipe_module_t *
+find_module(load_module_t *lm)
+{
+  x86_recipe_module_t *m = (x86_recipe_module_t *)
+    atomic_load_explicit(&x86_recipe_modules, memory_order_acquire);
+  for (; m; m = m->next) {
+    if (m->lm == lm) {
+      return m;
+    }
+  }
+  return NULL;
+}
+
+
+// Map the cache file at 'm->path', if there is a valid one.
+static void
+map_file(x86_recipe_module_t *m)
+{
+  x86_recipe_cache_header_t hdr;
+  struct stat st;
+
+  int fd = open(m->path, O_RDONLY);
+  if (fd < 0) {
+    TMSG(UW_RECIPE_CACHE, "miss: %s", m->lm->name);
+    return;
+  }
+
+  int ok = pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)
+    && hdr.magic == X86_RECIPE_CACHE_MAGIC
+    && hdr.version == cache_version()
+    && fstat(fd, &st) == 0
+    && hdr.num_fcns <= (uint64_t) st.st_size / sizeof(x86_recipe_cache_fcn_t)
+    && hdr.num_intervals
+         <= (uint64_t) st.st_size / sizeof(x86_recipe_cache_interval_t)
+    && (uint64_t) st.st_size ==
+         sizeof(hdr) + hdr.num_fcns * sizeof(x86_recipe_cache_fcn_t)
+         + hdr.num_intervals * sizeof(x86_recipe_cache_interval_t);
+
+  void *addr = MAP_FAILED;
+  if (ok && hdr.num_fcns > 0) {
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    TMSG(UW_RECIPE_CACHE, "invalid entry: %s for %s", m->path, m->lm->name);
+    return;
+  }
+
+  const x86_recipe_cache_fcn_t *fcn = (const x86_recipe_cache_fcn_t *)
+    ((char *) addr + sizeof(hdr));
+
+  // lookups and merges rely on sorted functions with intervals in range
+  for (uint64_t i = 0; i < hdr.num_fcns; i++) {
+    if ((i > 0 && fcn[i - 1].start >= fcn[i].start)
+	|| fcn[i].count > hdr.num_intervals
+	|| fcn[i].first > hdr.num_intervals - fcn[i].count) {
+      TMSG(UW_RECIPE_CACHE, "invalid entry: %s for %s", m->path, m->lm->name);
+      munmap(addr, st.st_size);
+      return;
+    }
+  }
+
+  m->fcn = fcn;
+  m->interval = (const x86_recipe_cache_interval_t *) (fcn + hdr.num_fcns);
+  m->num_fcns = hdr.num_fcns;
+  m->num_intervals = hdr.num_intervals;
+
+  TMSG(UW_RECIPE_CACHE, "hit: %s, functions: %ld", m->lm->name,
+       (long) m->num_fcns);
+}
+
+
+static void
+x86_recipe_cache_notify_map(void *start, void *end)
+{
+  char path[PATH_MAX];
+
+  load_module_t *lm = hpcrun_loadmap_findByAddr(start, end);
+  if (lm == NULL || find_module(lm) != NULL) {
+    return;
+  }
+  if (fnbounds_cache_entry_path(lm->name, X86_RECIPE_CACHE_SUFFIX,
+				path, sizeof(path)) != 0) {
+    return;
+  }
+
+  x86_recipe_module_t *m = hpcrun_malloc(sizeof(*m));
+  char *m_path = hpcrun_malloc(strlen(path) + 1);
+  if (m == NULL || m_path == NULL) {
+    return;
+  }
+  memset(m, 0, sizeof(*m));
+  m->lm = lm;
+  m->path = strcpy(m_path, path);
+  atomic_store_explicit(&m->recorded, 0, memory_order_relaxed);
+  map_file(m);
+
+  m->next = (x86_recipe_module_t *)
+    atomic_load_explicit(&x86_recipe_modules, memory_order_relaxed);
+  atomic_store_explicit(&x86_recipe_modules, (uintptr_t) m,
+			memory_order_release);
+}
+
+
+static void
+x86_recipe_cache_notify_unmap(void *start, void *end)
+{
+  // Nothing to do: recipes are normalized, so a module's entry stays
+  // good if it is mapped again.
+}
+
+
+// Find the module state and normalized bounds for [fcn_start, fcn_end).
+static x86_recipe_module_t *
+find_fcn_module(void *fcn_start, void *fcn_end,
+		uint64_t *start, uint64_t *end)
+{
+  load_module_t *lm = NULL;
+  dso_info_t dso;
+  if (! hpcrun_loadmap_findDsoByAddr(fcn_start, &dso, &lm)) {
+    return NULL;
+  }
+  *start = (uintptr_t) fcn_start - dso.start_to_ref_dist;
+  *end = (uintptr_t) fcn_end - dso.start_to_ref_dist;
+  return find_module(lm);
+}
+
+
+static const x86_recipe_cache_fcn_t *
+find_fcn(const x86_recipe_module_t *m, uint64_t start)
+{
+  uint64_t lo = 0, hi = m->num_fcns;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (m->fcn[mid].start < start) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return (lo < m->num_fcns && m->fcn[lo].start == start) ? &m->fcn[lo] : NULL;
+}
+
+
+static int
+record_cmp(const void *a, const void *b)
+{
+  uint64_t x = (*(x86_recipe_record_t * const *) a)->fcn.start;
+  uint64_t y = (*(x86_recipe_record_t * const *) b)->fcn.start;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+// Write the union of 'm's file and its new records to a temp file and
+// rename it into place.
+static void
+write_module(x86_recipe_module_t *m)
+{
+  x86_recipe_record_t *list = (x86_recipe_record_t *)
+    atomic_load_explicit(&m->recorded, memory_order_acquire);
+
+  // collect the new records, sorted, without duplicates or functions
+  // the file already has
+  size_t num_rec = 0;
+  for (x86_recipe_record_t *r = list; r; r = r->next) {
+    num_rec++;
+  }
+  if (num_rec == 0) {
+    return;
+  }
+  x86_recipe_record_t **rec = hpcrun_malloc(num_rec * sizeof(*rec));
+  if (rec == NULL) {
+    return;
+  }
+  num_rec = 0;
+  for (x86_recipe_record_t *r = list; r; r = r->next) {
+    rec[num_rec++] = r;
+  }
+  qsort(rec, num_rec, sizeof(*rec), record_cmp);
+
+  size_t n = 0;
+  uint64_t num_intervals = m->num_intervals;
+  for (size_t j = 0; j < num_rec; j++) {
+    uint64_t start = rec[j]->fcn.start;
+    if ((n > 0 && rec[n - 1]->fcn.start == start) || find_fcn(m, start)) {
+      continue;
+    }
+    num_intervals += rec[j]->fcn.count;
+    rec[n++] = rec[j];
+  }
+  num_rec = n;
+  if (num_rec == 0) {
+    return;
+  }
+
+  char tmp_path[PATH_MAX];
+  if (fnbounds_cache_tmp_path(m->path, tmp_path, sizeof(tmp_path)) != 0) {
+    return;
+  }
+  FILE *fs = fopen(tmp_path, "w");
+  if (fs == NULL) {
+    TMSG(UW_RECIPE_CACHE, "unable to write: %s", tmp_path);
+    return;
+  }
+
+  x86_recipe_cache_header_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = X86_RECIPE_CACHE_MAGIC;
+  hdr.version = cache_version();
+  hdr.num_fcns = m->num_fcns + num_rec;
+  hdr.num_intervals = num_intervals;
+  int ok = fwrite(&hdr, sizeof(hdr), 1, fs) == 1;
+
+  // Merge the two sorted lists twice: once for the functions, and
+  // again, in the same order, for their intervals.
+  for (int pass = 0; pass < 2 && ok; pass++) {
+    uint64_t i = 0, j = 0, first = 0;
+    while (ok && (i < m->num_fcns || j < num_rec)) {
+      x86_recipe_cache_fcn_t fcn;
+      const x86_recipe_cache_interval_t *interval;
+      if (j == num_rec || (i < m->num_fcns && m->fcn[i].start < rec[j]->fcn.start)) {
+	fcn = m->fcn[i];
+	interval = m->interval + fcn.first;
+	i++;
+      }
+      else {
+	fcn = rec[j]->fcn;
+	interval = rec[j]->interval;
+	j++;
+      }
+      if (pass == 0) {
+	fcn.first = first;
+	first += fcn.count;
+	ok = fwrite(&fcn, sizeof(fcn), 1, fs) == 1;
+      }
+      else {
+	ok = fwrite(interval, sizeof(*interval), fcn.count, fs) == fcn.count;
+      }
+    }
+  }
+
+  if (fclose(fs) != 0 || ! ok || rename(tmp_path, m->path) != 0) {
+    TMSG(UW_RECIPE_CACHE, "unable to write: %s", m->path);
+    unlink(tmp_path);
+    return;
+  }
+
+  TMSG(UW_RECIPE_CACHE, "insert: %s, new functions: %ld, as %s",
+       m->lm->name, (long) num_rec, m->path);
+}
+
+
+static void
+x86_recipe_cache_write(void *arg)
+{
+  x86_recipe_module_t *m = (x86_recipe_module_t *)
+    atomic_load_explicit(&x86_recipe_modules, memory_order_acquire);
+  for (; m; m = m->next) {
+    write_module(m);
+  }
+}
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+void
+x86_recipe_cache_init(void)
+{
+  static loadmap_notify_t x86_recipe_cache_notifiers;
+  static bool write_registered = false;
+
+  // after fork, the child starts over with a new load map
+  atomic_store_explicit(&x86_recipe_modules, 0, memory_order_release);
+
+  x86_recipe_cache_notifiers.map = x86_recipe_cache_notify_map;
+  x86_recipe_cache_notifiers.unmap = x86_recipe_cache_notify_unmap;
+  hpcrun_loadmap_notify_register(&x86_recipe_cache_notifiers);
+
+  if (! write_registered) {
+    hpcrun_process_aux_cleanup_add(x86_recipe_cache_write, NULL);
+    write_registered = true;
+  }
+}
+
+
+bool
+x86_recipe_cache_lookup(void *fcn_start, void *fcn_end,
+			btuwi_status_t *status)
+{
+  uint64_t start, end;
+  x86_recipe_module_t *m = find_fcn_module(fcn_start, fcn_end, &start, &end);
+  if (m == NULL || m->num_fcns == 0) {
+    return false;
+  }
+
+  const x86_recipe_cache_fcn_t *fcn = find_fcn(m, start);
+  if (fcn == NULL || fcn->end != end || fcn->count == 0) {
+    return false;
+  }
+
+  bitree_uwi_t *first = NULL, *prev = NULL;
+  for (uint64_t k = 0; k < fcn->count; k++) {
+    const x86_recipe_cache_interval_t *iv = &m->interval[fcn->first + k];
+    bitree_uwi_t *u = bitree_uwi_malloc(NATIVE_UNWINDER, sizeof(x86recipe_t));
+    if (u == NULL) {
+      bitree_uwi_free(NATIVE_UNWINDER, first);
+      return false;
+    }
+    uwi_t *uwi = bitree_uwi_rootval(u);
+    uwi->interval.start = (uintptr_t) fcn_start + iv->start;
+    uwi->interval.end = (uintptr_t) fcn_start + iv->end;
+
+    x86recipe_t *xr = (x86recipe_t *) uwi->recipe;
+    xr->ra_status = (ra_loc) iv->ra_status;
+    xr->reg.sp_ra_pos = iv->sp_ra_pos;
+    xr->reg.sp_bp_pos = iv->sp_bp_pos;
+    xr->reg.bp_status = (bp_loc) iv->bp_status;
+    xr->reg.bp_ra_pos = iv->bp_ra_pos;
+    xr->reg.bp_bp_pos = iv->bp_bp_pos;
+    xr->prev_canonical = NULL;
+    xr->has_tail_calls = (iv->has_tail_calls != 0);
+
+    if (prev) {
+      bitree_uwi_set_rightsubtree(prev, u);
+    }
+    else {
+      first = u;
+    }
+    prev = u;
+  }
+
+  status->first_undecoded_ins = (char *) fcn_end;
+  status->first = first;
+  status->count = fcn->count;
+  status->error = 0;
+
+  return true;
+}
+
+
+void
+x86_recipe_cache_record(void *fcn_start, void *fcn_end,
+			const btuwi_status_t *status)
+{
+  if (status->error != 0 || status->count <= 0) {
+    return;
+  }
+
+  uint64_t start, end;
+  x86_recipe_module_t *m = find_fcn_module(fcn_start, fcn_end, &start, &end);
+  if (m == NULL) {
+    return;
+  }
+
+  // the list must be exactly what the map will rebalance
+  int count = 0;
+  for (bitree_uwi_t *u = status->first; u; u = bitree_uwi_rightsubtree(u)) {
+    count++;
+  }
+  if (count != status->count) {
+    return;
+  }
+
+  x86_recipe_record_t *r =
+    hpcrun_malloc(sizeof(*r) + count * sizeof(r->interval[0]));
+  if (r == NULL) {
+    return;
+  }
+  r->fcn.start = start;
+  r->fcn.end = end;
+  r->fcn.first = 0;
+  r->fcn.count = count;
+
+  x86_recipe_cache_interval_t *iv = r->interval;
+  for (bitree_uwi_t *u = status->first; u; u = bitree_uwi_rightsubtree(u)) {
+    uwi_t *uwi = bitree_uwi_rootval(u);
+    x86recipe_t *xr = (x86recipe_t *) uwi->recipe;
+    memset(iv, 0, sizeof(*iv));
+    iv->start = (intptr_t) (uwi->interval.start - (uintptr_t) fcn_start);
+    iv->end = (intptr_t) (uwi->interval.end - (uintptr_t) fcn_start);
+    iv->ra_status = xr->ra_status;
+    iv->sp_ra_pos = xr->reg.sp_ra_pos;
+    iv->sp_bp_pos = xr->reg.sp_bp_pos;
+    iv->bp_status = xr->reg.bp_status;
+    iv->bp_ra_pos = xr->reg.bp_ra_pos;
+    iv->bp_bp_pos = xr->reg.bp_bp_pos;
+    iv->has_tail_calls = xr->has_tail_calls;
+    iv++;
+  }
+
+  uintptr_t head = atomic_load_explicit(&m->recorded, memory_order_relaxed);
+  do {
+    r->next = (x86_recipe_record_t *) head;
+  } while (! atomic_compare_exchange_weak_explicit(&m->recorded, &head,
+						   (uintptr_t) r,
+						   memory_order_release,
+						   memory_order_relaxed));
+}
@@ -0,0 +1,83 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// A persistent, on-disk cache of x86 unwind recipes, one file per load
+// module, kept in the fnbounds cache directory (HPCRUN_FNBOUNDS_CACHE)
+// under the same build-id key as the fnbounds table.
+//
+// A module's file is mapped when the module is, so the first sample in
+// a function rebuilds its intervals from the file rather than by
+// decoding the function inside the signal handler.  Functions analyzed
+// during the run are added to the file at process exit.
+//
+//***************************************************************************
+
+#ifndef X86_RECIPE_CACHE_H
+#define X86_RECIPE_CACHE_H
+
+#include <stdbool.h>
+
+#include <unwind/common/binarytree_uwi.h>
+
+// register the loadmap notifier and the exit-time writer
+void
+x86_recipe_cache_init(void);
+
+// If the cache holds the intervals of the function [fcn_start,
+// fcn_end), rebuild them as a list in 'status' and return true.
+bool
+x86_recipe_cache_lookup(void *fcn_start, void *fcn_end,
+			btuwi_status_t *status);
+
+// Remember the intervals just built for [fcn_start, fcn_end), to be
+// written at process exit.  Safe in a signal handler.
+void
+x86_recipe_cache_record(void *fcn_start, void *fcn_end,
+			const btuwi_status_t *status);
+
+#endif // X86_RECIPE_CACHE_H
@@ -96,6 +96,7 @@
 #include <hpcrun/main.h>
 #include <hpcrun/thread_data.h>
 #include "x86-build-intervals.h"
+#include "x86-recipe-cache.h"
 #include "x86-unwind-interval.h"
 #include "x86-validate-retn-addr.h"
 
@@ -181,6 +182,7 @@ hpcrun_unw_init(void)
 {
   x86_family_decoder_init();
   uw_recipe_map_init();
+  x86_recipe_cache_init();
 }
 
 typedef unw_frame_regnum_t unw_reg_code_t;
@@ -279,8 +281,14 @@ hpcrun_unw_get_ra_loc(hpcrun_unw_cursor_t* cursor)
 btuwi_status_t
 build_intervals(char *ins, unsigned int len, unwinder_t uw)
 {
-  if (uw == NATIVE_UNWINDER)
-    return x86_build_intervals(ins, len, 0);
+  if (uw == NATIVE_UNWINDER) {
+    btuwi_status_t stat;
+    if (x86_recipe_cache_lookup(ins, ins + len, &stat))
+      return stat;
+    stat = x86_build_intervals(ins, len, 0);
+    x86_recipe_cache_record(ins, ins + len, &stat);
+    return stat;
+  }
   return libunw_build_intervals(ins, len);
 }
 
@@ -70,14 +70,21 @@ ip_normalized_t
 hpcrun_normalize_ip(void* unnormalized_ip, load_module_t* lm)
 {
   TMSG(NORM_IP, "normalizing %p, w load_module %s", unnormalized_ip, NULL_OR_NAME(lm));
+  const dso_info_t* dso = NULL;
+  dso_info_t dso_;
   if (!lm) {
-    lm = hpcrun_loadmap_findByAddr(unnormalized_ip, unnormalized_ip);
+    if (hpcrun_loadmap_findDsoByAddr(unnormalized_ip, &dso_, &lm)) {
+      dso = &dso_;
+    }
+  }
+  else {
+    dso = lm->dso_info;
   }
   
-  if (lm && lm->dso_info) {
+  if (lm && dso) {
     ip_normalized_t ip_norm = (ip_normalized_t) {
       .lm_id = lm->id,
-      .lm_ip = (uintptr_t)unnormalized_ip - lm->dso_info->start_to_ref_dist };
+      .lm_ip = (uintptr_t)unnormalized_ip - dso->start_to_ref_dist };
     return ip_norm;
   }
 
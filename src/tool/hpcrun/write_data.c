@@ -48,9 +48,14 @@
 // system includes
 //*****************************************************************************
 
+#include <sys/mman.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
 
 //*****************************************************************************
 // local includes
@@ -67,6 +72,7 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "env.h"
 
 #include <messages/messages.h>
 
@@ -75,6 +81,8 @@
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #include <lib/support-lean/OSUtil.h>
 
@@ -89,12 +97,239 @@ static epoch_flags_t epoch_flags = {
 
 static const uint64_t default_measurement_granularity = 1;
 
+// The profile file is written in large chunks from a page-aligned
+// buffer, at offsets that are multiples of the chunk size.
+#define PROFILE_WRITE_BUFSIZE  (4 * 1024 * 1024)
+
+typedef struct profile_stream_t {
+  char*  buf;
+  size_t len;
+  int    fd;
+} profile_stream_t;
+
+// HPCRUN_WRITE_THROTTLE=<writers>[:<MB/s>] limits the number of
+// threads that write their profiles at the same time (0 for no
+// limit), and optionally the rate at which each of them writes.
+static spinlock_t throttle_lock = SPINLOCK_UNLOCKED;
+static bool throttle_init_done = false;
+static long throttle_max_writers = 0;
+static double throttle_bytes_per_sec = 0.0;
+
+static atomic_long throttle_num_writers = ATOMIC_VAR_INIT(0);
+
+// the writing thread, which need not be the profile's thread
+static __thread bool throttle_active = false;
+static __thread uint64_t throttle_bytes = 0;
+static __thread struct timespec throttle_start;
+
 
 
 //*****************************************************************************
 // local utilities
 //*****************************************************************************
 
+static double
+elapsed_sec(struct timespec* start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1.0e-9;
+}
+
+
+static void
+sleep_sec(double sec)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t) sec;
+  ts.tv_nsec = (long) ((sec - ts.tv_sec) * 1.0e9);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+}
+
+
+static void
+throttle_init(void)
+{
+  spinlock_lock(&throttle_lock);
+  if (! throttle_init_done) {
+    char* str = getenv(HPCRUN_WRITE_THROTTLE);
+    if (str != NULL && str[0] != 0) {
+      char* end = NULL;
+      throttle_max_writers = strtol(str, &end, 10);
+      if (end != NULL && *end == ':') {
+        throttle_bytes_per_sec = strtod(end + 1, &end) * 1024 * 1024;
+      }
+      if (end == str || (end != NULL && *end != 0)
+          || throttle_max_writers < 0 || throttle_bytes_per_sec < 0) {
+        EMSG("ignoring invalid %s: %s", HPCRUN_WRITE_THROTTLE, str);
+        throttle_max_writers = 0;
+        throttle_bytes_per_sec = 0.0;
+      }
+      TMSG(DATA_WRITE, "write throttle: writers: %ld, bytes/sec: %ld",
+           throttle_max_writers, (long) throttle_bytes_per_sec);
+    }
+    throttle_init_done = true;
+  }
+  spinlock_unlock(&throttle_lock);
+}
+
+
+// Wait for one of the writer slots, so that at most
+// throttle_max_writers threads write their profiles at once.
+static void
+throttle_begin(void)
+{
+  throttle_init();
+
+  if (throttle_max_writers > 0) {
+    long n = atomic_load_explicit(&throttle_num_writers, memory_order_relaxed);
+    for (;;) {
+      if (n < throttle_max_writers
+          && atomic_compare_exchange_weak_explicit(&throttle_num_writers, &n, n + 1,
+                                                   memory_order_acquire,
+                                                   memory_order_relaxed)) {
+        break;
+      }
+      if (n >= throttle_max_writers) {
+        sleep_sec(0.001);
+        n = atomic_load_explicit(&throttle_num_writers, memory_order_relaxed);
+      }
+    }
+  }
+
+  throttle_active = true;
+  throttle_bytes = 0;
+  clock_gettime(CLOCK_MONOTONIC, &throttle_start);
+}
+
+
+static void
+throttle_end(void)
+{
+  if (throttle_max_writers > 0) {
+    atomic_fetch_sub_explicit(&throttle_num_writers, 1, memory_order_release);
+  }
+  throttle_active = false;
+}
+
+
+// Sleep as needed to keep this thread's write rate under the limit.
+// Writes from the sample handler (hpcrun_flush_epochs) are never
+// throttled.
+static void
+throttle_wrote(size_t bytes)
+{
+  if (! throttle_active || throttle_bytes_per_sec <= 0) {
+    return;
+  }
+  throttle_bytes += bytes;
+  double ahead = throttle_bytes / throttle_bytes_per_sec - elapsed_sec(&throttle_start);
+  if (ahead > 0) {
+    sleep_sec(ahead);
+  }
+}
+
+
+static int
+profile_stream_flush(profile_stream_t* ps)
+{
+  size_t done = 0;
+
+  while (done < ps->len) {
+    ssize_t ret = write(ps->fd, ps->buf + done, ps->len - done);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return -1;
+    }
+    done += ret;
+  }
+  throttle_wrote(ps->len);
+  ps->len = 0;
+
+  return 0;
+}
+
+
+static ssize_t
+profile_stream_write(void* cookie, const char* buf, size_t size)
+{
+  profile_stream_t* ps = (profile_stream_t*) cookie;
+  size_t done = 0;
+
+  while (done < size) {
+    size_t len = PROFILE_WRITE_BUFSIZE - ps->len;
+    if (len > size - done) {
+      len = size - done;
+    }
+    memcpy(ps->buf + ps->len, buf + done, len);
+    ps->len += len;
+    done += len;
+
+    if (ps->len == PROFILE_WRITE_BUFSIZE && profile_stream_flush(ps) != 0) {
+      return -1;
+    }
+  }
+
+  return size;
+}
+
+
+static int
+profile_stream_close(void* cookie)
+{
+  profile_stream_t* ps = (profile_stream_t*) cookie;
+
+  int ret = profile_stream_flush(ps);
+  if (close(ps->fd) != 0) {
+    ret = -1;
+  }
+  munmap(ps->buf, PROFILE_WRITE_BUFSIZE + sizeof(profile_stream_t));
+
+  return ret;
+}
+
+
+// Returns a stream that writes to 'fd' through a page-aligned buffer
+// of PROFILE_WRITE_BUFSIZE bytes, or else NULL.  The buffer is
+// mmapped (and unmapped on fclose) instead of taken from the hpcrun
+// memory, which is never freed.
+static FILE*
+profile_stream_open(int fd)
+{
+  if (fd < 0) {
+    return NULL;
+  }
+
+  void* mem = mmap(NULL, PROFILE_WRITE_BUFSIZE + sizeof(profile_stream_t),
+                   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return fdopen(fd, "w");
+  }
+
+  profile_stream_t* ps = (profile_stream_t*) ((char*) mem + PROFILE_WRITE_BUFSIZE);
+  ps->buf = (char*) mem;
+  ps->len = 0;
+  ps->fd = fd;
+
+  cookie_io_functions_t fns = {
+    .read  = NULL,
+    .write = profile_stream_write,
+    .seek  = NULL,
+    .close = profile_stream_close,
+  };
+
+  FILE* fs = fopencookie(ps, "w", fns);
+  if (fs == NULL) {
+    munmap(mem, PROFILE_WRITE_BUFSIZE + sizeof(profile_stream_t));
+    return fdopen(fd, "w");
+  }
+
+  return fs;
+}
+
 
 //***************************************************************************
 //
@@ -146,7 +381,7 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
     rank = 0;
   }
   int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
+  fs = profile_stream_open(fd);
   if (fs == NULL) {
     EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
     return NULL;
@@ -249,6 +484,11 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 
     epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
     TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
+
+    // cct nodes are written with only their nonzero metrics when that
+    // is smaller
+    epoch_flags.fields.isSparseMetrics =
+      hpcrun_cct_bundle_sparse_metrics_smaller(&(s->csdata), cptd->cct2metrics_map);
     
     TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
     hpcrun_fmt_epochHdr_fwrite(fs, epoch_flags,
@@ -329,14 +569,19 @@ int
 hpcrun_write_profile_data(core_profile_trace_data_t * cptd)
 {
   TMSG(DATA_WRITE,"Writing hpcrun profile data");
+  throttle_begin();
+
   FILE* fs = lazy_open_data_file(cptd);
-  if (fs == NULL)
+  if (fs == NULL) {
+    throttle_end();
     return HPCRUN_ERR;
+  }
 
   write_epochs(fs, cptd, cptd->epoch);
 
   TMSG(DATA_WRITE,"closing file");
   hpcio_fclose(fs);
+  throttle_end();
   TMSG(DATA_WRITE,"Done!");
 
   return HPCRUN_OK;
@@ -73,6 +73,7 @@ using std::string;
 #include "Args.hpp"
 
 #include <lib/analysis/Util.hpp>
+#include <lib/analysis/StructCache.hpp>
 #include <lib/support/diagnostics.h>
 #include <lib/support/FileUtil.hpp>
 #include <lib/support/StrUtil.hpp>
@@ -119,6 +120,9 @@ Options: General\n\
   --jobs-parse <num>   Use <num> openmp threads for ParseAPI::parse(),\n\
                        default is same value for --jobs.\n\
   --jobs-symtab <num>  Use <num> openmp threads for Symtab methods.\n\
+  --jobs-images <num>  For inputs with many ELF images (e.g., CUDA fatbins),\n\
+                       analyze up to <num> images at once, one thread each,\n\
+                       at most the value for --jobs.  Default 1.\n\
   --time               Display stats on time and space usage.\n\
 \n\
 Options: Structure recovery\n\
@@ -172,6 +176,16 @@ Options: Output:\n\
                        Write hpcstruct file to <file>.\n\
                        Use '--output=-' to write output to stdout.\n\
   --compact            Generate compact output, eliminating extra white space\n\
+  --format <xml|binary>\n\
+                       Write the structure file as XML (default) or in the\n\
+                       binary format, which hpcprof loads much faster.\n\
+  --cache <dir>        Keep results in the structure cache <dir>, keyed by\n\
+                       the binary's build-id (or, lacking one, the file's\n\
+                       identity and mtime) and the options above.  If the\n\
+                       cache already holds a result, copy it instead of\n\
+                       re-analyzing the binary.  hpcprof can also find\n\
+                       structure files made with default options there.\n\
+                       Default: $HPCTOOLKIT_HPCSTRUCT_CACHE, if set.\n\
 ";
 
 // Possible extensions:
@@ -192,6 +206,7 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
   { 'j',  "jobs",  CLP::ARG_REQ,  CLP::DUPOPT_CLOB,  NULL,  NULL },
   {  0 ,  "jobs-parse",   CLP::ARG_REQ,  CLP::DUPOPT_CLOB,  NULL,  NULL },
   {  0 ,  "jobs-symtab",  CLP::ARG_REQ,  CLP::DUPOPT_CLOB,  NULL,  NULL },
+  {  0 ,  "jobs-images",  CLP::ARG_REQ,  CLP::DUPOPT_CLOB,  NULL,  NULL },
   {  0 ,  "time",         CLP::ARG_NONE, CLP::DUPOPT_CLOB,  NULL,  NULL },
 
   // Demangler library
@@ -219,6 +234,10 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      NULL },
   {  0 , "compact",         CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "format",          CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "cache",           CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // General
   { 'v', "verbose",     CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,
@@ -265,11 +284,14 @@ Args::Ctor()
   jobs = -1;
   jobs_parse = -1;
   jobs_symtab = -1;
+  jobs_images = -1;
   show_time = false;
   searchPathStr = ".";
   isIrreducibleIntervalLoop = true;
   isForwardSubstitution = true;
   prettyPrintOutput = true;
+  binaryOutput = false;
+  cacheDir = Analysis::StructCache::defaultDir();
   useBinutils = false;
   show_gaps = false;
 }
@@ -371,6 +393,10 @@ Args::parse(int argc, const char* const argv[])
       const string & arg = parser.getOptArg("jobs-symtab");
       jobs_symtab = (int) CmdLineParser::toLong(arg);
     }
+    if (parser.isOpt("jobs-images")) {
+      const string & arg = parser.getOptArg("jobs-images");
+      jobs_images = (int) CmdLineParser::toLong(arg);
+    }
     if (parser.isOpt("time")) {
       show_time = true;
     }
@@ -400,7 +426,8 @@ Args::parse(int argc, const char* const argv[])
 
     if (parser.isOpt("replace-path")) {
       string arg = parser.getOptArg("replace-path");
-      
+      replacePathStr = arg;
+
       std::vector<std::string> replacePaths;
       StrUtil::tokenize_str(arg, CLP_SEPARATOR, replacePaths);
       
@@ -441,6 +468,18 @@ Args::parse(int argc, const char* const argv[])
     if (parser.isOpt("compact")) {
       prettyPrintOutput = false;
     }
+    if (parser.isOpt("format")) {
+      const string& arg = parser.getOptArg("format");
+      if (arg == "binary") {
+	binaryOutput = true;
+      }
+      else if (arg != "xml") {
+	ARG_ERROR("Unknown structure file format: " << arg);
+      }
+    }
+    if (parser.isOpt("cache")) {
+      cacheDir = parser.getOptArg("cache");
+    }
 
     // Check for required arguments
     if (parser.getNumArgs() != 1) {
@@ -112,6 +112,7 @@ public:
   int jobs;
   int jobs_parse;
   int jobs_symtab;
+  int jobs_images;
   bool show_time;
 
   // Parsed Data: optional arguments
@@ -122,9 +123,12 @@ public:
   bool isIrreducibleIntervalLoop;     // default: true
   bool isForwardSubstitution;         // default: false
   std::string dbgProcGlob;
+  std::string replacePathStr;         // default: ""
 
   std::string out_filenm;
   bool prettyPrintOutput;         // default: true
+  bool binaryOutput;              // default: false
+  std::string cacheDir;           // default: $HPCTOOLKIT_HPCSTRUCT_CACHE
   bool useBinutils;		  // default: false
   bool show_gaps;                 // default: false
 
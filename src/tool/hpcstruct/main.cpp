@@ -63,6 +63,8 @@ using std::endl;
 
 #include "Args.hpp"
 
+#include <lib/analysis/StructCache.hpp>
+
 #include <lib/banal/Struct.hpp>
 #include <lib/binutils/Demangler.hpp>
 #include <lib/prof-lean/hpcio.h>
@@ -122,6 +124,22 @@ hpctoolkit_demangler_init(const char *demangler_library_filename, const char *de
   } 
 }
 
+// The options that determine the structure recovered from the
+// binary, for the cache key.
+static Analysis::StructCache::ContentOptions
+cacheContentOptions(const Args& args)
+{
+  Analysis::StructCache::ContentOptions copts;
+  copts.searchPath = args.searchPathStr;
+  copts.replacePath = args.replacePathStr;
+  copts.isIrreducibleIntervalLoop = args.isIrreducibleIntervalLoop;
+  copts.isForwardSubstitution = args.isForwardSubstitution;
+  copts.useBinutils = args.useBinutils;
+  copts.demangleLibrary = args.demangle_library;
+  copts.demangleFunction = args.demangle_function;
+  return copts;
+}
+
 //****************************** Main Program *******************************
 
 int
@@ -166,6 +184,7 @@ realmain(int argc, char* argv[])
   opts.jobs = args.jobs;
   opts.jobs_parse = args.jobs_parse;
   opts.jobs_symtab = args.jobs_symtab;
+  opts.jobs_images = args.jobs_images;
 
   // default is to run serial (for correctness), unless --jobs is
   // specified.
@@ -181,14 +200,24 @@ realmain(int argc, char* argv[])
   if (opts.jobs_symtab < 1) {
     opts.jobs_symtab = 1;
   }
+
+  // images run one thread each, so --jobs bounds the total.
+  if (opts.jobs_images < 1) {
+    opts.jobs_images = 1;
+  }
+  if (opts.jobs_images > opts.jobs) {
+    opts.jobs_images = opts.jobs;
+  }
   omp_set_num_threads(1);
 #else
   opts.jobs = 1;
   opts.jobs_parse = 1;
   opts.jobs_symtab = 1;
+  opts.jobs_images = 1;
 #endif
 
   opts.show_time = args.show_time;
+  opts.binary_format = args.binaryOutput;
 
   // ------------------------------------------------------------
   // Set the demangler before reading the executable 
@@ -203,6 +232,39 @@ realmain(int argc, char* argv[])
     opts.ourDemangle = true;
   }
 
+  // ------------------------------------------------------------
+  // Use the cached result, if there is one
+  // ------------------------------------------------------------
+
+  // The cache holds only the structure file, so a gaps file or
+  // output to stdout bypasses it.
+  bool useCache = (!args.cacheDir.empty() && args.out_filenm != "-"
+		   && !args.show_gaps);
+  std::string binKey, contKey, fmtKey;
+
+  if (useCache) {
+    binKey = Analysis::StructCache::binaryKey(args.in_filenm);
+    contKey = Analysis::StructCache::contentKey(cacheContentOptions(args));
+    fmtKey = Analysis::StructCache::formatKey(args.binaryOutput,
+					      args.prettyPrintOutput);
+
+    std::string entry =
+      Analysis::StructCache::lookup(args.cacheDir, binKey, contKey, fmtKey);
+    if (!entry.empty()) {
+      // The entry may have been made from a copy of the binary at
+      // another path, so name the load module as makeStructure would.
+      try {
+	Analysis::StructCache::copyEntry(entry, args.out_filenm,
+					 args.in_filenm);
+	DIAG_Msg(1, "Using cached structure '" << entry << "'");
+	return (0);
+      }
+      catch (const Diagnostics::Exception& x) {
+	DIAG_WMsgIf(1, x.message() << "; re-analyzing the binary");
+      }
+    }
+  }
+
   // ------------------------------------------------------------
   // Build and print the program structure tree
   // ------------------------------------------------------------
@@ -254,5 +316,10 @@ realmain(int argc, char* argv[])
     delete[] gapsBuf;
   }
 
+  if (useCache) {
+    Analysis::StructCache::insert(args.cacheDir, binKey, contKey, fmtKey,
+				  args.out_filenm);
+  }
+
   return (0);
 }